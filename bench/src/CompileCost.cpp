@@ -0,0 +1,329 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "CodeGeneration.hpp"
+#include "SyntheticSchema.hpp"
+#include "cxxopts.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#    include <fcntl.h>
+#    include <sys/resource.h>
+#    include <sys/wait.h>
+#    include <unistd.h>
+#endif
+
+namespace caffql {
+
+namespace fs = std::filesystem;
+
+// A schema to generate and compile, either synthesized from a shape or read from a schema file.
+struct CompileInput {
+    std::string name;
+    Json shape;
+    std::string schemaText;
+};
+
+struct CompileSettings {
+    std::string compiler;
+    std::vector<std::string> flags;
+    std::vector<std::string> includeDirectories;
+    fs::path workDirectory;
+    size_t iterations;
+};
+
+struct CompileResult {
+    bool succeeded;
+    double wallMilliseconds;
+    long peakResidentSetKilobytes;
+};
+
+static std::string readFile(fs::path const & path) {
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+static std::string compilerVersion(std::string const & compiler) {
+#if defined(__unix__) || defined(__APPLE__)
+    auto const command = "\"" + compiler + "\" --version 2>/dev/null";
+    auto pipe = popen(command.c_str(), "r");
+    if (!pipe) {
+        return "";
+    }
+    char buffer[256] = {};
+    auto const line = fgets(buffer, sizeof(buffer), pipe) ? std::string(buffer) : std::string();
+    pclose(pipe);
+    return line.substr(0, line.find('\n'));
+#else
+    return "";
+#endif
+}
+
+// Runs the compiler as a child process so its peak memory can be measured separately from this process.
+static CompileResult runCompiler(std::vector<std::string> const & arguments, fs::path const & logFile) {
+    auto const start = std::chrono::steady_clock::now();
+    auto elapsed = [&] {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+#if defined(__unix__) || defined(__APPLE__)
+    std::vector<char *> argv;
+    for (auto const & argument : arguments) {
+        argv.push_back(const_cast<char *>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    auto const pid = fork();
+    if (pid == 0) {
+        auto const log = open(logFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log >= 0) {
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+        }
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    if (pid < 0) {
+        return {false, 0, 0};
+    }
+
+    int status = 0;
+    rusage usage{};
+    wait4(pid, &status, 0, &usage);
+
+#    if defined(__APPLE__)
+    long const peakKilobytes = usage.ru_maxrss / 1024;
+#    else
+    long const peakKilobytes = usage.ru_maxrss;
+#    endif
+
+    return {WIFEXITED(status) && WEXITSTATUS(status) == 0, elapsed(), peakKilobytes};
+#else
+    std::string command;
+    for (auto const & argument : arguments) {
+        command += "\"" + argument + "\" ";
+    }
+    command += "> \"" + logFile.string() + "\" 2>&1";
+    auto const succeeded = std::system(command.c_str()) == 0;
+    return {succeeded, elapsed(), 0};
+#endif
+}
+
+// A translation unit that includes the generated header and takes the address of every operation's request and
+// response function, so their serialization code is compiled and emitted the way it would be in a real client.
+static std::string usingTranslationUnit(Schema const & schema) {
+    std::string source = "#include \"Generated.hpp\"\n\n";
+
+    for (auto const & operationType : {schema.queryType, schema.mutationType, schema.subscriptionType}) {
+        if (!operationType) {
+            continue;
+        }
+        auto const type = std::find_if(schema.types.begin(), schema.types.end(), [&](Type const & type) {
+            return type.name == operationType->name;
+        });
+        if (type == schema.types.end()) {
+            continue;
+        }
+        for (auto const & field : type->fields) {
+            auto const operation = "bench::" + type->name + "::" + capitalize(field.name) + "Field";
+            auto const name = uncapitalize(type->name) + capitalize(field.name);
+            source += "auto " + name + "Request = &" + operation + "::request;\n";
+            source += "auto " + name + "Response = &" + operation + "::response;\n";
+        }
+    }
+
+    return source;
+}
+
+static Json compileGeneratedHeader(
+        CompileInput const & input, Schema const & schema, AlgebraicNamespace mode, CompileSettings const & settings) {
+    auto const modeName = algrebraicNamespaceName(mode);
+    auto const directory = settings.workDirectory / (input.name + "-" + modeName);
+    fs::create_directories(directory);
+
+    GenerationOptions options;
+    options.algebraicNamespace = mode;
+    auto const header = generateTypes(schema, "bench", options);
+
+    std::ofstream(directory / "Generated.hpp") << header;
+    std::ofstream(directory / "Generated.cpp") << usingTranslationUnit(schema);
+
+    auto const objectFile = directory / "Generated.o";
+    auto const logFile = directory / "compiler.log";
+
+    std::vector<std::string> arguments{settings.compiler};
+    arguments.insert(arguments.end(), settings.flags.begin(), settings.flags.end());
+    for (auto const & includeDirectory : settings.includeDirectories) {
+        arguments.push_back("-I" + includeDirectory);
+    }
+    arguments.insert(arguments.end(), {"-c", (directory / "Generated.cpp").string(), "-o", objectFile.string()});
+
+    double total = 0;
+    double minimum = 0;
+    long peakKilobytes = 0;
+
+    for (size_t i = 0; i < settings.iterations; ++i) {
+        auto const result = runCompiler(arguments, logFile);
+        if (!result.succeeded) {
+            return {{"scenario", input.name},
+                    {"mode", modeName},
+                    {"headerBytes", header.size()},
+                    {"error", readFile(logFile)}};
+        }
+        total += result.wallMilliseconds;
+        minimum = i == 0 ? result.wallMilliseconds : std::min(minimum, result.wallMilliseconds);
+        peakKilobytes = std::max(peakKilobytes, result.peakResidentSetKilobytes);
+    }
+
+    return {{"scenario", input.name},
+            {"shape", input.shape},
+            {"mode", modeName},
+            {"headerBytes", header.size()},
+            {"minCompileMs", minimum},
+            {"meanCompileMs", total / settings.iterations},
+            {"peakCompilerRssKb", peakKilobytes},
+            {"objectBytes", fs::file_size(objectFile)}};
+}
+
+// Annotates results with the matching results of an earlier report and the ratio of each measurement to it.
+static void compareWithPrevious(Json & results, Json const & previousReport) {
+    for (auto & result : results) {
+        auto const & previousResults = previousReport.at("results");
+        auto previous = std::find_if(previousResults.begin(), previousResults.end(), [&](Json const & candidate) {
+            return candidate.value("scenario", "") == result.at("scenario") &&
+                   candidate.value("mode", "") == result.at("mode");
+        });
+
+        if (previous == previousResults.end() || result.count("error") || previous->count("error")) {
+            continue;
+        }
+
+        Json change;
+        for (auto const key : {"headerBytes", "minCompileMs", "peakCompilerRssKb", "objectBytes"}) {
+            auto const before = previous->at(key).get<double>();
+            change[key] = before > 0 ? result.at(key).get<double>() / before : 0.0;
+        }
+
+        result["previous"] = *previous;
+        result["previous"].erase("shape");
+        result["change"] = std::move(change);
+    }
+}
+
+} // namespace caffql
+
+int main(int argc, char * argv[]) {
+    using namespace caffql;
+
+    cxxopts::Options options(
+            "caffql-compile-cost",
+            "Compile generated headers with the host compiler and print compile time, compiler peak memory and object "
+            "size as json.");
+
+    options.add_options()("s,scenario", "only run the named preset scenario", cxxopts::value<std::string>())(
+            "f,schema-file",
+            "compile the code generated from this schema file instead of the presets, may be repeated",
+            cxxopts::value<std::vector<std::string>>())(
+            "m,mode", "std, absl or both", cxxopts::value<std::string>()->default_value(CAFFQL_BENCH_DEFAULT_MODES))(
+            "i,iterations", "compiles of each header", cxxopts::value<size_t>()->default_value("1"))(
+            "c,compiler", "compiler to run", cxxopts::value<std::string>()->default_value(CAFFQL_BENCH_CXX_COMPILER))(
+            "flags", "compiler flags", cxxopts::value<std::string>()->default_value("-std=c++17 -O2"))(
+            "I,include", "additional include directory, may be repeated", cxxopts::value<std::vector<std::string>>())(
+            "compare", "earlier report to compare against", cxxopts::value<std::string>())(
+            "work-directory",
+            "where generated headers and objects are written",
+            cxxopts::value<std::string>()->default_value(
+                    (std::filesystem::temp_directory_path() / "caffql-compile-cost").string()))("h,help", "help");
+
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (result.count("help")) {
+            printf("%s\n", options.help().c_str());
+            return 0;
+        }
+
+        std::vector<CompileInput> inputs;
+        for (auto const & scenario : presetScenarios()) {
+            if (!result.count("scenario") || result["scenario"].as<std::string>() == scenario.name) {
+                inputs.push_back(
+                        {scenario.name, shapeToJson(scenario.shape), generateSyntheticSchema(scenario.shape).dump()});
+            }
+        }
+
+        if (result.count("scenario") && inputs.empty()) {
+            printf("Unknown scenario %s\n", result["scenario"].as<std::string>().c_str());
+            return 1;
+        }
+
+        if (result.count("schema-file")) {
+            // Only the schema files are compiled unless a scenario is also asked for.
+            if (!result.count("scenario")) {
+                inputs.clear();
+            }
+            for (auto const & schemaFile : result["schema-file"].as<std::vector<std::string>>()) {
+                inputs.push_back({fs::path(schemaFile).stem().string(), nullptr, readFile(schemaFile)});
+            }
+        }
+
+        std::vector<AlgebraicNamespace> modes;
+        auto const mode = result["mode"].as<std::string>();
+        if (mode == "std" || mode == "both") {
+            modes.push_back(AlgebraicNamespace::Std);
+        }
+        if (mode == "absl" || mode == "both") {
+            modes.push_back(AlgebraicNamespace::Absl);
+        }
+        if (modes.empty()) {
+            printf("Unknown mode %s\n", mode.c_str());
+            return 1;
+        }
+
+        CompileSettings settings;
+        settings.compiler = result["compiler"].as<std::string>();
+        std::istringstream flags(result["flags"].as<std::string>());
+        for (std::string flag; flags >> flag;) {
+            settings.flags.push_back(flag);
+        }
+        settings.includeDirectories = {CAFFQL_BENCH_JSON_INCLUDE_DIR};
+#if defined(CAFFQL_BENCH_ABSL_INCLUDE_DIR)
+        settings.includeDirectories.push_back(CAFFQL_BENCH_ABSL_INCLUDE_DIR);
+#endif
+        if (result.count("include")) {
+            auto const includes = result["include"].as<std::vector<std::string>>();
+            settings.includeDirectories.insert(settings.includeDirectories.end(), includes.begin(), includes.end());
+        }
+        settings.workDirectory = result["work-directory"].as<std::string>();
+        settings.iterations = std::max<size_t>(result["iterations"].as<size_t>(), 1);
+
+        Json report = {{"compiler", settings.compiler},
+                       {"compilerVersion", compilerVersion(settings.compiler)},
+                       {"flags", settings.flags},
+                       {"iterations", settings.iterations},
+                       {"results", Json::array()}};
+
+        bool succeeded = true;
+        for (auto const & input : inputs) {
+            Schema const schema = Json::parse(input.schemaText).at("data").at("__schema");
+            for (auto const algebraicNamespace : modes) {
+                report["results"].push_back(compileGeneratedHeader(input, schema, algebraicNamespace, settings));
+                succeeded = succeeded && !report["results"].back().count("error");
+            }
+        }
+
+        if (result.count("compare")) {
+            compareWithPrevious(report["results"], Json::parse(readFile(result["compare"].as<std::string>())));
+        }
+
+        printf("%s\n", report.dump(2).c_str());
+        return succeeded ? 0 : 1;
+    } catch (cxxopts::OptionException const & e) {
+        printf("Error parsing options: %s\n", e.what());
+    } catch (std::exception const & e) {
+        printf("Error occurred: %s\n", e.what());
+    }
+
+    return 1;
+}
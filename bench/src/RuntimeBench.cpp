@@ -0,0 +1,315 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include "CodeGeneration.hpp"
+#include "RuntimeCases.hpp"
+#include "cxxopts.hpp"
+
+// Every allocation made by the generated code goes through these, so allocations can be counted per operation.
+static std::atomic<size_t> allocationCount{0};
+
+void * operator new(size_t size) {
+    ++allocationCount;
+    if (auto pointer = std::malloc(size > 0 ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void * pointer) noexcept { std::free(pointer); }
+
+void operator delete(void * pointer, size_t) noexcept { std::free(pointer); }
+
+namespace caffql {
+
+// Builds json responses for types of the fixture schema, selecting every field like the generated query documents.
+// Only the outermost list on any path has listLength elements, nested lists have two, so that the size of a payload
+// grows linearly with listLength.
+class PayloadGenerator {
+public:
+    PayloadGenerator(TypeMap const & typeMap, size_t listLength): typeMap(typeMap), listLength(listLength) {}
+
+    Json value(TypeRef const & type, bool isOutermostList = true, size_t depth = 0) {
+        switch (type.kind) {
+            case TypeKind::NonNull:
+                return value(*type.ofType, isOutermostList, depth);
+            case TypeKind::List: {
+                auto list = Json::array();
+                auto const length = depth >= maximumDepth ? 0 : isOutermostList ? listLength : 2;
+                for (size_t i = 0; i < length; ++i) {
+                    list.push_back(value(*type.ofType, false, depth + 1));
+                }
+                return list;
+            }
+            case TypeKind::Scalar:
+                return scalarValue(*type.name);
+            case TypeKind::Enum: {
+                auto const & enumValues = typeMap.at(*type.name).enumValues;
+                return enumValues.empty() ? Json() : Json(enumValues[counter++ % enumValues.size()].name);
+            }
+            case TypeKind::Object: {
+                Json object = {{"__typename", *type.name}};
+                if (depth < maximumDepth) {
+                    for (auto const & field : typeMap.at(*type.name).fields) {
+                        object[field.name] = value(field.type, isOutermostList, depth + 1);
+                    }
+                }
+                return object;
+            }
+            case TypeKind::Interface:
+            case TypeKind::Union: {
+                auto const & possibleTypes = typeMap.at(*type.name).possibleTypes;
+                if (possibleTypes.empty()) {
+                    return {{"__typename", *type.name}};
+                }
+                return value(possibleTypes[counter++ % possibleTypes.size()], isOutermostList, depth);
+            }
+            case TypeKind::InputObject:
+                return Json::object();
+        }
+        return {};
+    }
+
+private:
+    // Bounds payloads of self referencing types.
+    static constexpr size_t maximumDepth = 32;
+
+    TypeMap const & typeMap;
+    size_t listLength;
+    size_t counter = 0;
+
+    Json scalarValue(std::string const & name) {
+        ++counter;
+        if (name == "ID") {
+            return "id-" + std::to_string(counter);
+        } else if (name == "Int") {
+            return static_cast<int32_t>(counter);
+        } else if (name == "Float") {
+            return counter * 0.5;
+        } else if (name == "Boolean") {
+            return counter % 2 == 0;
+        }
+        return "value " + std::to_string(counter);
+    }
+};
+
+struct Measurement {
+    double milliseconds;
+    size_t allocations;
+};
+
+// Runs run iterations times, reporting the minimum wall time and the allocations of the last run.
+static Measurement measure(size_t iterations, std::function<void()> const & run) {
+    Measurement measurement{0, 0};
+
+    for (size_t i = 0; i < iterations; ++i) {
+        auto const allocationsBefore = allocationCount.load();
+        auto const start = std::chrono::steady_clock::now();
+        run();
+        auto const milliseconds =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        measurement.allocations = allocationCount.load() - allocationsBefore;
+        measurement.milliseconds = i == 0 ? milliseconds : std::min(measurement.milliseconds, milliseconds);
+    }
+
+    return measurement;
+}
+
+static double megabytesPerSecond(size_t bytes, double milliseconds) {
+    return milliseconds > 0 ? bytes / 1e6 / (milliseconds / 1000) : 0;
+}
+
+// Parses sizes like 512, 64K or 256M.
+static size_t parseSize(std::string const & size) {
+    size_t suffixStart = 0;
+    auto const number = std::stoull(size, &suffixStart);
+    auto const suffix = size.substr(suffixStart);
+    if (suffix.empty()) {
+        return number;
+    } else if (suffix == "K") {
+        return number << 10;
+    } else if (suffix == "M") {
+        return number << 20;
+    } else if (suffix == "G") {
+        return number << 30;
+    }
+    throw std::invalid_argument("Unknown size suffix " + suffix);
+}
+
+static Json responsePayload(Field const & field, TypeMap const & typeMap, size_t listLength) {
+    PayloadGenerator generator(typeMap, listLength);
+    return {{"data", {{field.name, generator.value(field.type)}}}};
+}
+
+static Json benchmarkResponses(
+        RuntimeCases const & cases, TypeMap const & typeMap, size_t targetBytes, bool isSmallest, size_t iterations) {
+    auto results = Json::array();
+
+    for (auto const & responseCase : cases.responses) {
+        auto const & fields = typeMap.at(responseCase.operationType).fields;
+        auto const field = std::find_if(fields.begin(), fields.end(), [&](Field const & field) {
+            return field.name == responseCase.field;
+        });
+
+        // Sizes are linear in the list length, so two samples give the length that reaches the target.
+        auto const oneElementBytes = responsePayload(*field, typeMap, 1).dump().size();
+        auto const elementBytes = responsePayload(*field, typeMap, 2).dump().size() - oneElementBytes;
+
+        size_t listLength = 0;
+        if (elementBytes > 0) {
+            listLength = targetBytes > oneElementBytes ? 1 + (targetBytes - oneElementBytes) / elementBytes : 1;
+        } else if (!isSmallest) {
+            // Without a list the payload has a fixed size, which is only measured once.
+            continue;
+        }
+
+        auto const text = responsePayload(*field, typeMap, listLength).dump();
+
+        Json json;
+        auto const parse = measure(iterations, [&] { json = Json::parse(text); });
+        auto const decode = measure(iterations, [&] { responseCase.decode(json); });
+        auto const parseResponse = measure(iterations, [&] { responseCase.parseResponse(text); });
+
+        results.push_back({{"name", responseCase.operationType + "." + responseCase.field},
+                           {"payloadBytes", text.size()},
+                           {"listLength", listLength},
+                           {"parseMBps", megabytesPerSecond(text.size(), parse.milliseconds)},
+                           {"decodeMBps", megabytesPerSecond(text.size(), decode.milliseconds)},
+                           {"allocationsPerResponse", decode.allocations},
+                           {"parseResponseMBps", megabytesPerSecond(text.size(), parseResponse.milliseconds)},
+                           {"allocationsPerParseResponse", parseResponse.allocations}});
+    }
+
+    return results;
+}
+
+static Json benchmarkVariants(
+        RuntimeCases const & cases, TypeMap const & typeMap, size_t targetBytes, size_t iterations) {
+    constexpr size_t sampleCount = 16;
+    auto results = Json::array();
+
+    for (auto const & variantCase : cases.variants) {
+        TypeRef const type = typeMap.at(variantCase.typeName);
+
+        PayloadGenerator sampleGenerator(typeMap, 2);
+        auto samples = Json::array();
+        for (size_t i = 0; i < sampleCount; ++i) {
+            samples.push_back(sampleGenerator.value(type));
+        }
+
+        auto const sampleBytes = std::max<size_t>(samples.dump().size() / sampleCount, 1);
+        auto const count = std::max<size_t>(targetBytes / sampleBytes, 1);
+
+        PayloadGenerator generator(typeMap, 2);
+        auto json = Json::array();
+        for (size_t i = 0; i < count; ++i) {
+            json.push_back(generator.value(type));
+        }
+        auto const payloadBytes = json.dump().size();
+
+        auto const decode = measure(iterations, [&] { variantCase.decodeArray(json); });
+
+        results.push_back({{"name", variantCase.typeName},
+                           {"count", count},
+                           {"payloadBytes", payloadBytes},
+                           {"decodeMBps", megabytesPerSecond(payloadBytes, decode.milliseconds)},
+                           {"allocationsPerValue", static_cast<double>(decode.allocations) / count}});
+    }
+
+    return results;
+}
+
+static Json benchmarkRequests(RuntimeCases const & cases, size_t iterations) {
+    constexpr size_t repetitions = 1000;
+    auto results = Json::array();
+
+    for (auto const & requestCase : cases.requests) {
+        auto const encodedBytes = requestCase.encode().dump().size();
+
+        auto const encode = measure(iterations, [&] {
+            for (size_t i = 0; i < repetitions; ++i) {
+                keepValue(requestCase.encode());
+            }
+        });
+
+        auto const milliseconds = encode.milliseconds / repetitions;
+        results.push_back({{"name", requestCase.name},
+                           {"encodedBytes", encodedBytes},
+                           {"requestsPerSecond", milliseconds > 0 ? 1000 / milliseconds : 0},
+                           {"encodeMBps", megabytesPerSecond(encodedBytes, milliseconds)},
+                           {"allocationsPerRequest", static_cast<double>(encode.allocations) / repetitions}});
+    }
+
+    return results;
+}
+
+} // namespace caffql
+
+int main(int argc, char * argv[]) {
+    using namespace caffql;
+
+    cxxopts::Options options(
+            "caffql-runtime-bench",
+            "Benchmark the code caffql generated for the fixture schema and print the results as json.");
+
+    options.add_options()(
+            "sizes",
+            "comma separated payload sizes with an optional K, M or G suffix",
+            cxxopts::value<std::string>()->default_value("1K,1M,32M"))(
+            "i,iterations", "iterations of each measurement", cxxopts::value<size_t>()->default_value("3"))(
+            "h,help", "help");
+
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (result.count("help")) {
+            printf("%s\n", options.help().c_str());
+            return 0;
+        }
+
+        std::vector<size_t> sizes;
+        std::stringstream sizeList(result["sizes"].as<std::string>());
+        for (std::string size; std::getline(sizeList, size, ',');) {
+            sizes.push_back(parseSize(size));
+        }
+        std::sort(sizes.begin(), sizes.end());
+
+        auto const iterations = std::max<size_t>(result["iterations"].as<size_t>(), 1);
+
+        std::ifstream file(CAFFQL_RUNTIME_BENCH_SCHEMA_FILE);
+        Schema schema = Json::parse(file).at("data").at("__schema");
+
+        TypeMap typeMap;
+        for (auto const & type : schema.types) {
+            typeMap[type.name] = type;
+        }
+
+        auto const cases = runtimeCases();
+
+        Json report = {{"schemaFile", CAFFQL_RUNTIME_BENCH_SCHEMA_FILE},
+                       {"generationOptions", CAFFQL_RUNTIME_BENCH_OPTIONS},
+                       {"iterations", iterations},
+                       {"sizes", Json::array()}};
+
+        for (auto const size : sizes) {
+            report["sizes"].push_back(
+                    {{"targetBytes", size},
+                     {"responses", benchmarkResponses(cases, typeMap, size, size == sizes.front(), iterations)},
+                     {"variants", benchmarkVariants(cases, typeMap, size, iterations)}});
+        }
+
+        report["requests"] = benchmarkRequests(cases, iterations);
+
+        printf("%s\n", report.dump(2).c_str());
+        return 0;
+    } catch (cxxopts::OptionException const & e) {
+        printf("Error parsing options: %s\n", e.what());
+    } catch (std::exception const & e) {
+        printf("Error occurred: %s\n", e.what());
+    }
+
+    return 1;
+}
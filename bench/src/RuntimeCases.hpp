@@ -0,0 +1,53 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "nlohmann/json.hpp"
+
+namespace caffql {
+
+// The generated functions under benchmark. runtimeCases is defined in a source file that caffql-runtime-fixture
+// writes for the fixture schema, next to the header caffql generates for it.
+
+struct ResponseCase {
+    std::string operationType;
+    std::string field;
+    // Calls the operation's generated response function.
+    std::function<void(nlohmann::json const &)> decode;
+    // Decodes response text with the generated json backend, with the operation's parseResponse function for backends
+    // that have one and otherwise by parsing the text and calling response.
+    std::function<void(std::string_view)> parseResponse;
+};
+
+struct VariantCase {
+    std::string typeName;
+    // Deserializes an array of the union or interface.
+    std::function<void(nlohmann::json const &)> decodeArray;
+};
+
+struct RequestCase {
+    std::string name;
+    // Calls an operation's generated request function or serializes an input object.
+    std::function<nlohmann::json()> encode;
+};
+
+struct RuntimeCases {
+    std::vector<ResponseCase> responses;
+    std::vector<VariantCase> variants;
+    std::vector<RequestCase> requests;
+};
+
+RuntimeCases runtimeCases();
+
+// Stops the compiler from discarding a decoded value whose only use is being destroyed.
+template <typename T>
+void keepValue(T const & value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    (void)value;
+#endif
+}
+
+} // namespace caffql
@@ -0,0 +1,153 @@
+#include <fstream>
+#include "CodeGeneration.hpp"
+#include "SyntheticSchema.hpp"
+#include "cxxopts.hpp"
+
+namespace caffql {
+
+// Writes the definition of runtimeCases for the code caffql generates from schema into generatedNamespace with
+// jsonBackend.
+static std::string generateRuntimeCases(
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        std::string const & generatedHeader,
+        JsonBackend jsonBackend) {
+    std::string source =
+            "// This file was automatically generated by caffql-runtime-fixture and should not be edited.\n";
+    source += "#include \"RuntimeCases.hpp\"\n";
+    source += "#include \"" + generatedHeader + "\"\n\n";
+    source += "namespace caffql {\n\n";
+    source += "RuntimeCases runtimeCases() {\n";
+    source += indent(1) + "RuntimeCases cases;\n\n";
+
+    auto const scope = generatedNamespace + "::";
+
+    TypeMap typeMap;
+    for (auto const & type : schema.types) {
+        typeMap[type.name] = type;
+    }
+
+    std::vector<std::pair<std::optional<Schema::OperationType>, Operation>> const operationTypes{
+            {schema.queryType, Operation::Query},
+            {schema.mutationType, Operation::Mutation},
+            {schema.subscriptionType, Operation::Subscription}};
+
+    for (auto const & [operationType, operationKind] : operationTypes) {
+        if (!operationType) {
+            continue;
+        }
+        auto const type = std::find_if(schema.types.begin(), schema.types.end(), [&](Type const & type) {
+            return type.name == operationType->name;
+        });
+        if (type == schema.types.end()) {
+            continue;
+        }
+
+        for (auto const & field : type->fields) {
+            auto const operation = scope + type->name + "::" + capitalize(field.name) + "Field";
+
+            // Arguments of nested fields are request parameters as well.
+            auto const variableCount = generateQueryDocument(field, operationKind, typeMap, 0).variables.size();
+            std::string arguments;
+            for (size_t i = 0; i < variableCount; ++i) {
+                arguments += i == 0 ? "{}" : ", {}";
+            }
+
+            source += indent(1) + "cases.responses.push_back({\"" + type->name + "\", \"" + field.name +
+                      "\", [](nlohmann::json const & json) {\n";
+            source += indent(3) + "keepValue(" + operation + "::response(json));\n";
+            source += indent(1) + "}, [](std::string_view text) {\n";
+            if (jsonBackend == JsonBackend::Nlohmann) {
+                source += indent(3) + "keepValue(" + operation + "::response(nlohmann::json::parse(text)));\n";
+            } else {
+                source += indent(3) + "keepValue(" + operation + "::parseResponse(text));\n";
+            }
+            source += indent(1) + "}});\n";
+
+            source += indent(1) + "cases.requests.push_back({\"" + type->name + "." + field.name + "\", [] {\n";
+            source += indent(3) + "return " + operation + "::request(" + arguments + ");\n";
+            source += indent(1) + "}});\n\n";
+        }
+    }
+
+    for (auto const & type : schema.types) {
+        switch (type.kind) {
+            case TypeKind::Union:
+            case TypeKind::Interface:
+                source += indent(1) + "cases.variants.push_back({\"" + type.name +
+                          "\", [](nlohmann::json const & json) {\n";
+                source += indent(3) + "keepValue(json.get<std::vector<" + scope + type.name + ">>());\n";
+                source += indent(1) + "}});\n\n";
+                break;
+            case TypeKind::InputObject:
+                source += indent(1) + "cases.requests.push_back({\"" + type.name + "\", [] {\n";
+                source += indent(3) + "return nlohmann::json(" + scope + type.name + "{});\n";
+                source += indent(1) + "}});\n\n";
+                break;
+            default:
+                break;
+        }
+    }
+
+    source += indent(1) + "return cases;\n";
+    source += "}\n\n";
+    source += "} // namespace caffql\n";
+
+    return source;
+}
+
+} // namespace caffql
+
+int main(int argc, char * argv[]) {
+    using namespace caffql;
+
+    cxxopts::Options options(
+            "caffql-runtime-fixture",
+            "Write the fixture schema for caffql-runtime-bench and the source listing its generated functions.");
+
+    options.add_options()(
+            "f,schema-file", "fixture schema, a synthetic schema is used by default", cxxopts::value<std::string>())(
+            "s,schema-output", "where to write the fixture schema", cxxopts::value<std::string>())(
+            "c,cases-output", "where to write the runtime cases source", cxxopts::value<std::string>())(
+            "generated-header",
+            "header caffql generates from the fixture schema",
+            cxxopts::value<std::string>()->default_value("RuntimeGenerated.hpp"))(
+            "n,namespace", "namespace of the generated code", cxxopts::value<std::string>()->default_value("bench"))(
+            "json-backend",
+            "json backend the header is generated with",
+            cxxopts::value<std::string>()->default_value("nlohmann"));
+
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (!result.count("schema-output") || !result.count("cases-output")) {
+            printf("%s\n", options.help().c_str());
+            return 1;
+        }
+
+        Json json;
+        if (result.count("schema-file")) {
+            std::ifstream file(result["schema-file"].as<std::string>());
+            json = Json::parse(file);
+        } else {
+            json = generateSyntheticSchema({});
+        }
+
+        Schema const schema = json.at("data").at("__schema");
+
+        std::ofstream(result["schema-output"].as<std::string>()) << json.dump(2);
+        std::ofstream(result["cases-output"].as<std::string>()) << generateRuntimeCases(
+                schema,
+                result["namespace"].as<std::string>(),
+                result["generated-header"].as<std::string>(),
+                jsonBackendNamed(result["json-backend"].as<std::string>()));
+
+        return 0;
+    } catch (cxxopts::OptionException const & e) {
+        printf("Error parsing options: %s\n", e.what());
+    } catch (std::exception const & e) {
+        printf("Error occurred: %s\n", e.what());
+    }
+
+    return 1;
+}
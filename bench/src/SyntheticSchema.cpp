@@ -0,0 +1,335 @@
+#include "SyntheticSchema.hpp"
+
+namespace caffql {
+
+static Json namedType(char const * kind, std::string const & name) {
+    return {{"kind", kind}, {"name", name}, {"ofType", nullptr}};
+}
+
+static Json wrappedType(char const * kind, Json ofType) {
+    return {{"kind", kind}, {"name", nullptr}, {"ofType", std::move(ofType)}};
+}
+
+static Json nonNull(Json ofType) { return wrappedType("NON_NULL", std::move(ofType)); }
+
+static Json list(Json ofType) { return wrappedType("LIST", std::move(ofType)); }
+
+static Json field(std::string const & name, Json type, Json args = Json::array()) {
+    return {{"name", name},
+            {"description", nullptr},
+            {"args", std::move(args)},
+            {"type", std::move(type)},
+            {"isDeprecated", false},
+            {"deprecationReason", nullptr}};
+}
+
+static Json inputValue(std::string const & name, Json type) {
+    return {{"name", name}, {"description", nullptr}, {"type", std::move(type)}, {"defaultValue", nullptr}};
+}
+
+static Json type(char const * kind, std::string const & name) {
+    return {{"kind", kind},
+            {"name", name},
+            {"description", nullptr},
+            {"fields", nullptr},
+            {"inputFields", nullptr},
+            {"interfaces", nullptr},
+            {"enumValues", nullptr},
+            {"possibleTypes", nullptr}};
+}
+
+static std::string objectName(size_t index) { return "Object" + std::to_string(index); }
+
+static std::string enumName(size_t index) { return "Enum" + std::to_string(index); }
+
+static std::string unionName(size_t index) { return "Union" + std::to_string(index); }
+
+static std::string interfaceName(size_t index) { return "Interface" + std::to_string(index); }
+
+static std::string inputObjectName(size_t index) { return "InputObject" + std::to_string(index); }
+
+// Cycles through the scalars so objects have a realistic mix of field types.
+static Json scalarFieldType(size_t index) {
+    static char const * const scalars[] = {"ID", "String", "Int", "Float", "Boolean"};
+    auto type = namedType("SCALAR", scalars[index % 5]);
+    return index % 2 == 0 ? nonNull(std::move(type)) : type;
+}
+
+Json shapeToJson(SchemaShape const & shape) {
+    return {{"objectCount", shape.objectCount},
+            {"fieldsPerObject", shape.fieldsPerObject},
+            {"nestingDepth", shape.nestingDepth},
+            {"enumCount", shape.enumCount},
+            {"valuesPerEnum", shape.valuesPerEnum},
+            {"unionCount", shape.unionCount},
+            {"typesPerUnion", shape.typesPerUnion},
+            {"interfaceCount", shape.interfaceCount},
+            {"implementationsPerInterface", shape.implementationsPerInterface},
+            {"inputObjectCount", shape.inputObjectCount},
+            {"operationCount", shape.operationCount}};
+}
+
+Json generateSyntheticSchema(SchemaShape const & shape) {
+    auto types = Json::array();
+
+    for (auto scalar : {"ID", "String", "Int", "Float", "Boolean"}) {
+        types.push_back(type("SCALAR", scalar));
+    }
+
+    for (size_t i = 0; i < shape.enumCount; ++i) {
+        auto enumType = type("ENUM", enumName(i));
+        enumType["enumValues"] = Json::array();
+        for (size_t j = 0; j < shape.valuesPerEnum; ++j) {
+            enumType["enumValues"].push_back({{"name", "VALUE_" + std::to_string(j)},
+                                              {"description", nullptr},
+                                              {"isDeprecated", false},
+                                              {"deprecationReason", nullptr}});
+        }
+        types.push_back(std::move(enumType));
+    }
+
+    auto const depth = std::max<size_t>(shape.nestingDepth, 1);
+    auto const objectsPerLevel = std::max<size_t>(shape.objectCount / depth, 1);
+    auto const levelOf = [&](size_t object) { return std::min(object / objectsPerLevel, depth - 1); };
+
+    // Interfaces are implemented by objects of the first level, and their fields are the first scalar fields that
+    // every object has.
+    auto const interfaceFieldCount = std::min<size_t>(shape.fieldsPerObject, 2);
+    std::vector<std::vector<size_t>> interfacesOfObject(shape.objectCount);
+
+    for (size_t i = 0; i < shape.interfaceCount; ++i) {
+        auto interfaceType = type("INTERFACE", interfaceName(i));
+        interfaceType["fields"] = Json::array();
+        for (size_t j = 0; j < interfaceFieldCount; ++j) {
+            interfaceType["fields"].push_back(field("field" + std::to_string(j), scalarFieldType(j)));
+        }
+
+        interfaceType["possibleTypes"] = Json::array();
+        auto const firstLevelCount = std::min(objectsPerLevel, shape.objectCount);
+        for (size_t j = 0; j < std::min(shape.implementationsPerInterface, firstLevelCount); ++j) {
+            auto const object = (i + j) % firstLevelCount;
+            interfaceType["possibleTypes"].push_back(namedType("OBJECT", objectName(object)));
+            interfacesOfObject[object].push_back(i);
+        }
+        types.push_back(std::move(interfaceType));
+    }
+
+    for (size_t i = 0; i < shape.objectCount; ++i) {
+        auto objectType = type("OBJECT", objectName(i));
+        objectType["fields"] = Json::array();
+
+        for (size_t j = 0; j < shape.fieldsPerObject; ++j) {
+            objectType["fields"].push_back(field("field" + std::to_string(j), scalarFieldType(j)));
+        }
+
+        if (shape.enumCount > 0) {
+            objectType["fields"].push_back(field("enumField", namedType("ENUM", enumName(i % shape.enumCount))));
+        }
+
+        auto const level = levelOf(i);
+        if (level > 0) {
+            // A single reference per object keeps selection sets linear in the nesting depth.
+            auto const child = (level - 1) * objectsPerLevel + i % objectsPerLevel;
+            objectType["fields"].push_back(
+                    field("children",
+                          list(nonNull(namedType("OBJECT", objectName(child)))),
+                          Json::array({inputValue("first", namedType("SCALAR", "Int"))})));
+        }
+
+        objectType["interfaces"] = Json::array();
+        for (auto const interface : interfacesOfObject[i]) {
+            objectType["interfaces"].push_back(namedType("INTERFACE", interfaceName(interface)));
+        }
+
+        types.push_back(std::move(objectType));
+    }
+
+    for (size_t i = 0; i < shape.unionCount; ++i) {
+        auto unionType = type("UNION", unionName(i));
+        unionType["possibleTypes"] = Json::array();
+        for (size_t j = 0; j < std::min(shape.typesPerUnion, shape.objectCount); ++j) {
+            unionType["possibleTypes"].push_back(namedType("OBJECT", objectName((i + j) % shape.objectCount)));
+        }
+        types.push_back(std::move(unionType));
+    }
+
+    for (size_t i = 0; i < shape.inputObjectCount; ++i) {
+        auto inputObjectType = type("INPUT_OBJECT", inputObjectName(i));
+        inputObjectType["inputFields"] = Json::array();
+        for (size_t j = 0; j < shape.fieldsPerObject; ++j) {
+            inputObjectType["inputFields"].push_back(inputValue("field" + std::to_string(j), scalarFieldType(j)));
+        }
+        if (i > 0) {
+            inputObjectType["inputFields"].push_back(
+                    inputValue("nested", namedType("INPUT_OBJECT", inputObjectName(i - 1))));
+        }
+        types.push_back(std::move(inputObjectType));
+    }
+
+    // Operations alternate between the deepest objects, unions and interfaces.
+    std::vector<std::vector<Json>> operationTypes(3);
+    for (size_t i = (depth - 1) * objectsPerLevel; i < shape.objectCount; ++i) {
+        operationTypes[0].push_back(namedType("OBJECT", objectName(i)));
+    }
+    for (size_t i = 0; i < shape.unionCount; ++i) {
+        operationTypes[1].push_back(list(nonNull(namedType("UNION", unionName(i)))));
+    }
+    for (size_t i = 0; i < shape.interfaceCount; ++i) {
+        operationTypes[2].push_back(namedType("INTERFACE", interfaceName(i)));
+    }
+    operationTypes.erase(
+            std::remove_if(
+                    operationTypes.begin(), operationTypes.end(), [](auto const & types) { return types.empty(); }),
+            operationTypes.end());
+
+    auto queryType = type("OBJECT", "Query");
+    queryType["fields"] = Json::array();
+    for (size_t i = 0; i < shape.operationCount && !operationTypes.empty(); ++i) {
+        auto const & category = operationTypes[i % operationTypes.size()];
+        auto args = Json::array({inputValue("id", nonNull(namedType("SCALAR", "ID")))});
+        if (shape.inputObjectCount > 0) {
+            auto const filterType = inputObjectName(i % shape.inputObjectCount);
+            args.push_back(inputValue("filter", namedType("INPUT_OBJECT", filterType)));
+        }
+        auto const & operationType = category[i / operationTypes.size() % category.size()];
+        queryType["fields"].push_back(field("operation" + std::to_string(i), operationType, std::move(args)));
+    }
+    types.push_back(std::move(queryType));
+
+    return {{"data",
+             {{"__schema",
+               {{"queryType", {{"name", "Query"}}},
+                {"mutationType", nullptr},
+                {"subscriptionType", nullptr},
+                {"types", std::move(types)},
+                {"directives", Json::array()}}}}}};
+}
+
+static void printDescription(std::string & sdl, std::optional<std::string> const & description, char const * indent) {
+    if (description) {
+        // Json string escapes are a subset of GraphQL's
+        sdl += indent + Json(*description).dump() + "\n";
+    }
+}
+
+static void printFields(std::string & sdl, std::vector<Field> const & fields) {
+    sdl += " {\n";
+    for (auto const & field : fields) {
+        printDescription(sdl, field.description, "  ");
+        sdl += "  " + field.name;
+        if (!field.args.empty()) {
+            sdl += "(";
+            for (auto const & arg : field.args) {
+                sdl += (&arg == &field.args.front() ? "" : ", ") + arg.name + ": " + graphqlTypeName(arg.type);
+            }
+            sdl += ")";
+        }
+        sdl += ": " + graphqlTypeName(field.type) + "\n";
+    }
+    sdl += "}\n";
+}
+
+std::string printSchemaDefinitionLanguage(Schema const & schema) {
+    std::string sdl = "schema {\n";
+    std::pair<char const *, std::optional<Schema::OperationType> const *> const operationTypes[] = {
+            {"query", &schema.queryType},
+            {"mutation", &schema.mutationType},
+            {"subscription", &schema.subscriptionType}};
+    for (auto const & [operation, type] : operationTypes) {
+        if (*type) {
+            sdl += std::string("  ") + operation + ": " + (*type)->name + "\n";
+        }
+    }
+    sdl += "}\n";
+
+    for (auto const & type : schema.types) {
+        if (type.kind == TypeKind::Scalar && isBuiltinScalar(type.name)) {
+            continue;
+        }
+
+        sdl += "\n";
+        printDescription(sdl, type.description, "");
+
+        switch (type.kind) {
+            case TypeKind::Scalar:
+                sdl += "scalar " + type.name + "\n";
+                break;
+            case TypeKind::Object:
+            case TypeKind::Interface:
+                sdl += (type.kind == TypeKind::Object ? "type " : "interface ") + type.name;
+                for (auto const & interface : type.interfaces) {
+                    sdl += (&interface == &type.interfaces.front() ? " implements " : " & ") + *interface.name;
+                }
+                printFields(sdl, type.fields);
+                break;
+            case TypeKind::Union:
+                sdl += "union " + type.name;
+                for (auto const & possibleType : type.possibleTypes) {
+                    sdl += (&possibleType == &type.possibleTypes.front() ? " = " : " | ") + *possibleType.name;
+                }
+                sdl += "\n";
+                break;
+            case TypeKind::Enum:
+                sdl += "enum " + type.name + " {\n";
+                for (auto const & value : type.enumValues) {
+                    printDescription(sdl, value.description, "  ");
+                    sdl += "  " + value.name + "\n";
+                }
+                sdl += "}\n";
+                break;
+            case TypeKind::InputObject:
+                sdl += "input " + type.name + " {\n";
+                for (auto const & field : type.inputFields) {
+                    printDescription(sdl, field.description, "  ");
+                    sdl += "  " + field.name + ": " + graphqlTypeName(field.type) + "\n";
+                }
+                sdl += "}\n";
+                break;
+            case TypeKind::List:
+            case TypeKind::NonNull:
+                break;
+        }
+    }
+
+    return sdl;
+}
+
+std::vector<Scenario> presetScenarios() {
+    std::vector<Scenario> scenarios;
+
+    scenarios.push_back({"baseline", {}});
+
+    SchemaShape manyTypes;
+    manyTypes.objectCount = 2000;
+    manyTypes.enumCount = 200;
+    manyTypes.inputObjectCount = 200;
+    manyTypes.operationCount = 200;
+    scenarios.push_back({"many-types", manyTypes});
+
+    SchemaShape wideObjects;
+    wideObjects.fieldsPerObject = 200;
+    scenarios.push_back({"wide-objects", wideObjects});
+
+    SchemaShape deepNesting;
+    deepNesting.objectCount = 400;
+    deepNesting.nestingDepth = 100;
+    scenarios.push_back({"deep-nesting", deepNesting});
+
+    SchemaShape largeUnionsAndInterfaces;
+    largeUnionsAndInterfaces.objectCount = 400;
+    largeUnionsAndInterfaces.nestingDepth = 2;
+    largeUnionsAndInterfaces.unionCount = 20;
+    largeUnionsAndInterfaces.typesPerUnion = 100;
+    largeUnionsAndInterfaces.interfaceCount = 20;
+    largeUnionsAndInterfaces.implementationsPerInterface = 100;
+    scenarios.push_back({"large-unions-and-interfaces", largeUnionsAndInterfaces});
+
+    SchemaShape longEnums;
+    longEnums.enumCount = 50;
+    longEnums.valuesPerEnum = 1000;
+    scenarios.push_back({"long-enums", longEnums});
+
+    return scenarios;
+}
+
+} // namespace caffql
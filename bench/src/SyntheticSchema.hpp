@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "CodeGeneration.hpp"
+#include "Json.hpp"
+
+namespace caffql {
+
+// Shape of a synthesized schema. Object types are arranged in nestingDepth levels where every object after the first
+// level has a field referencing an object of the previous level, so selection sets are nestingDepth objects deep.
+struct SchemaShape {
+    size_t objectCount = 100;
+    size_t fieldsPerObject = 8;
+    size_t nestingDepth = 4;
+    size_t enumCount = 10;
+    size_t valuesPerEnum = 10;
+    size_t unionCount = 5;
+    size_t typesPerUnion = 5;
+    size_t interfaceCount = 5;
+    size_t implementationsPerInterface = 5;
+    size_t inputObjectCount = 10;
+    size_t operationCount = 20;
+};
+
+Json shapeToJson(SchemaShape const & shape);
+
+// Generates an introspection query response in the same format as the schema files passed to caffql.
+Json generateSyntheticSchema(SchemaShape const & shape);
+
+// Prints schema as a schema definition language document. Descriptions are kept, default values aren't part of the
+// schema so are lost.
+std::string printSchemaDefinitionLanguage(Schema const & schema);
+
+struct Scenario {
+    std::string name;
+    SchemaShape shape;
+};
+
+// Named shapes that each stress one dimension of a schema, shared by the benchmarks so their results line up.
+std::vector<Scenario> presetScenarios();
+
+} // namespace caffql
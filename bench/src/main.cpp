@@ -0,0 +1,206 @@
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include "CodeGeneration.hpp"
+#include "SdlParser.hpp"
+#include "SyntheticSchema.hpp"
+#include "cxxopts.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#    include <sys/resource.h>
+#endif
+
+#if defined(__GLIBC__)
+#    include <malloc.h>
+#endif
+
+namespace caffql {
+
+// Resets the peak resident set size where supported, so that it is measured per phase instead of per process.
+static void resetPeakResidentSet() {
+#if defined(__GLIBC__)
+    // Return memory freed by earlier phases to the system so it isn't counted again.
+    malloc_trim(0);
+#endif
+#if defined(__linux__)
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+#endif
+}
+
+// Peak resident set size since the last reset, in kilobytes.
+static long peakResidentSetKilobytes() {
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stol(line.substr(6));
+        }
+    }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#    if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#    else
+    return usage.ru_maxrss;
+#    endif
+#else
+    return 0;
+#endif
+}
+
+// Runs phase iterations times, reporting the minimum and mean wall time.
+static Json measurePhase(std::string const & name, size_t iterations, std::function<void()> const & phase) {
+    using namespace std::chrono;
+
+    double total = 0;
+    double minimum = 0;
+
+    resetPeakResidentSet();
+
+    for (size_t i = 0; i < iterations; ++i) {
+        auto const start = steady_clock::now();
+        phase();
+        auto const milliseconds = duration<double, std::milli>(steady_clock::now() - start).count();
+        total += milliseconds;
+        minimum = i == 0 ? milliseconds : std::min(minimum, milliseconds);
+    }
+
+    return {{"name", name},
+            {"minWallMs", minimum},
+            {"meanWallMs", total / iterations},
+            {"peakRssKb", peakResidentSetKilobytes()}};
+}
+
+static Json runScenario(Scenario const & scenario, size_t iterations) {
+    auto const schemaText = generateSyntheticSchema(scenario.shape).dump();
+
+    Json json;
+    Schema schema;
+    QueryDocument lastDocument;
+    std::string source;
+    auto phases = Json::array();
+
+    phases.push_back(measurePhase("parse", iterations, [&] { json = Json::parse(schemaText); }));
+
+    phases.push_back(measurePhase("schema", iterations, [&] { schema = json.at("data").at("__schema"); }));
+
+    // The same schema as schema definition language, parsed straight into a Schema
+    auto const sdlText = printSchemaDefinitionLanguage(schema);
+    Schema sdlSchema;
+    phases.push_back(measurePhase("sdlParse", iterations, [&] {
+        sdlSchema = parseSdlSchema({{"bench.graphql", sdlText}});
+    }));
+
+    phases.push_back(measurePhase("sort", iterations, [&] { sortCustomTypesByDependencyOrder(schema.types); }));
+
+    TypeMap typeMap;
+    for (auto const & type : schema.types) {
+        typeMap[type.name] = type;
+    }
+
+    size_t queryBytes = 0;
+    phases.push_back(measurePhase("queryDocuments", iterations, [&] {
+        queryBytes = 0;
+        for (auto const & field : typeMap.at(schema.queryType->name).fields) {
+            lastDocument = generateQueryDocument(field, Operation::Query, typeMap, 0);
+            queryBytes += lastDocument.query.size();
+        }
+    }));
+
+    phases.push_back(measurePhase("emission", iterations, [&] { source = generateTypes(schema, "bench", {}); }));
+
+    return {{"name", scenario.name},
+            {"shape", shapeToJson(scenario.shape)},
+            {"schemaBytes", schemaText.size()},
+            {"sdlBytes", sdlText.size()},
+            {"typeCount", schema.types.size()},
+            {"queryDocumentBytes", queryBytes},
+            {"generatedBytes", source.size()},
+            {"phases", std::move(phases)}};
+}
+
+} // namespace caffql
+
+int main(int argc, char * argv[]) {
+    using namespace caffql;
+
+    cxxopts::Options options(
+            "caffql-bench",
+            "Benchmark each phase of caffql code generation on synthesized schemas and print the results as json.");
+
+    SchemaShape customShape;
+
+    // Shape options override the defaults of a custom scenario that replaces the presets.
+    std::vector<std::pair<char const *, size_t SchemaShape::*>> const shapeOptions{
+            {"objects", &SchemaShape::objectCount},
+            {"fields", &SchemaShape::fieldsPerObject},
+            {"depth", &SchemaShape::nestingDepth},
+            {"enums", &SchemaShape::enumCount},
+            {"enum-values", &SchemaShape::valuesPerEnum},
+            {"unions", &SchemaShape::unionCount},
+            {"union-types", &SchemaShape::typesPerUnion},
+            {"interfaces", &SchemaShape::interfaceCount},
+            {"implementations", &SchemaShape::implementationsPerInterface},
+            {"input-objects", &SchemaShape::inputObjectCount},
+            {"operations", &SchemaShape::operationCount}};
+
+    options.add_options()("s,scenario", "only run the named preset scenario", cxxopts::value<std::string>())(
+            "i,iterations", "iterations of each phase", cxxopts::value<size_t>()->default_value("5"))("h,help", "help");
+
+    for (auto const & option : shapeOptions) {
+        options.add_options("Custom scenario")(option.first, "", cxxopts::value<size_t>());
+    }
+
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (result.count("help")) {
+            printf("%s\n", options.help({"", "Custom scenario"}).c_str());
+            return 0;
+        }
+
+        auto scenarios = presetScenarios();
+
+        bool isCustom = false;
+        for (auto const & option : shapeOptions) {
+            if (result.count(option.first)) {
+                customShape.*option.second = result[option.first].as<size_t>();
+                isCustom = true;
+            }
+        }
+
+        if (isCustom) {
+            scenarios = {{"custom", customShape}};
+        } else if (result.count("scenario")) {
+            auto const name = result["scenario"].as<std::string>();
+            auto it = std::find_if(scenarios.begin(), scenarios.end(), [&](Scenario const & scenario) {
+                return scenario.name == name;
+            });
+            if (it == scenarios.end()) {
+                printf("Unknown scenario %s\n", name.c_str());
+                return 1;
+            }
+            scenarios = {*it};
+        }
+
+        auto const iterations = std::max<size_t>(result["iterations"].as<size_t>(), 1);
+
+        Json report = {{"iterations", iterations}, {"scenarios", Json::array()}};
+        for (auto const & scenario : scenarios) {
+            report["scenarios"].push_back(runScenario(scenario, iterations));
+        }
+
+        printf("%s\n", report.dump(2).c_str());
+        return 0;
+    } catch (cxxopts::OptionException const & e) {
+        printf("Error parsing options: %s\n", e.what());
+    } catch (std::exception const & e) {
+        printf("Error occurred: %s\n", e.what());
+    }
+
+    return 1;
+}
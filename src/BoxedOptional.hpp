@@ -1,55 +1,313 @@
 #pragma once
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "Json.hpp"
 
 namespace caffql {
 
+// Whether copying a BoxedOptional copies its value into an allocation of its own, or isn't allowed so that values
+// are only ever moved.
+enum class BoxCopying { Deep, MoveOnly };
+
+// Allocates boxes from a free list per thread, so that boxes freed on a thread are reused by the next ones allocated
+// on it instead of going back to the heap. Boxes may be freed on another thread than the one they were allocated on,
+// and after the thread's free list is destroyed, during thread or static teardown, in which case they go to the heap.
 template <typename T>
-struct BoxedOptional {
+struct BoxPool {
+    using value_type = T;
 
-    BoxedOptional() = default;
+    // Freed boxes beyond this many per thread go back to the heap
+    static size_t constexpr maxFreeCount = 4096;
 
-    BoxedOptional(T value) : value{std::make_unique<T>(std::move(value))} {}
+    BoxPool() = default;
 
-    BoxedOptional(BoxedOptional const & optional) { *this = optional; }
+    template <typename U>
+    BoxPool(BoxPool<U> const &) {}
 
-    BoxedOptional & operator=(BoxedOptional const & optional) {
-        reset();
-        if (optional) {
-            value = std::make_unique<T>(*optional.value);
+    T * allocate(size_t count) {
+        if (count != 1) {
+            return std::allocator<T>().allocate(count);
+        }
+        if (isFreeListDestroyed()) {
+            return reinterpret_cast<T *>(new Node);
+        }
+        auto & list = freeList();
+        if (!list.head) {
+            return reinterpret_cast<T *>(new Node);
+        }
+        auto const node = list.head;
+        list.head = node->next;
+        --list.size;
+        return reinterpret_cast<T *>(node);
+    }
+
+    void deallocate(T * pointer, size_t count) noexcept {
+        if (count != 1) {
+            std::allocator<T>().deallocate(pointer, count);
+            return;
+        }
+        auto const node = reinterpret_cast<Node *>(pointer);
+        if (isFreeListDestroyed()) {
+            delete node;
+            return;
+        }
+        auto & list = freeList();
+        if (list.size == maxFreeCount) {
+            delete node;
+            return;
+        }
+        node->next = list.head;
+        list.head = node;
+        ++list.size;
+    }
+
+    // The number of freed boxes kept for reuse on this thread
+    static size_t freeCount() { return isFreeListDestroyed() ? 0 : freeList().size; }
+
+private:
+    union Node {
+        Node * next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct FreeList {
+        Node * head = nullptr;
+        size_t size = 0;
+
+        ~FreeList() {
+            while (head) {
+                delete std::exchange(head, head->next);
+            }
+            isFreeListDestroyed() = true;
+        }
+    };
+
+    static FreeList & freeList() {
+        thread_local FreeList list;
+        return list;
+    }
+
+    // Trivially destructible, so that it can still be read after the free list is destroyed
+    static bool & isFreeListDestroyed() {
+        thread_local bool isDestroyed = false;
+        return isDestroyed;
+    }
+};
+
+template <typename T, typename U>
+bool operator==(BoxPool<T> const &, BoxPool<U> const &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(BoxPool<T> const &, BoxPool<U> const &) {
+    return false;
+}
+
+// Owns the memory of boxes allocated with BoxArenaAllocator while a Scope of it is active on their thread, freeing all
+// of it at once when it is destroyed instead of box by box. Values allocated in an arena must not outlive it.
+class BoxArena {
+public:
+    // Makes arena the one that BoxArenaAllocator allocates from on this thread until the scope ends.
+    class Scope {
+    public:
+        explicit Scope(BoxArena & arena) : previous{std::exchange(current(), &arena)} {}
+        Scope(Scope const &) = delete;
+        Scope & operator=(Scope const &) = delete;
+        ~Scope() { current() = previous; }
+
+    private:
+        BoxArena * previous;
+    };
+
+    explicit BoxArena(size_t blockSize = 16384) : blockSize{blockSize} {}
+    BoxArena(BoxArena const &) = delete;
+    BoxArena & operator=(BoxArena const &) = delete;
+
+    void * allocate(size_t size, size_t alignment) {
+        allocatedBytes += size;
+
+        if (size + alignment > blockSize) {
+            // Oversized allocations get a block of their own, before the one being filled
+            auto space = size + alignment;
+            auto const block = blocks.insert(blocks.end() - (blocks.empty() ? 0 : 1),
+                                             std::unique_ptr<unsigned char[]>(new unsigned char[space]));
+            void * memory = block->get();
+            return std::align(alignment, size, memory, space);
+        }
+
+        void * next = nullptr;
+        size_t space = 0;
+        if (!blocks.empty()) {
+            next = blocks.back().get() + used;
+            space = blockSize - used;
+        }
+        if (!next || !std::align(alignment, size, next, space)) {
+            blocks.emplace_back(new unsigned char[blockSize]);
+            next = blocks.back().get();
+            space = blockSize;
+            std::align(alignment, size, next, space);
+        }
+        used = blockSize - space + size;
+        return next;
+    }
+
+    // The total size of the allocations made in the arena
+    size_t size() const { return allocatedBytes; }
+
+    static BoxArena *& current() {
+        thread_local BoxArena * arena = nullptr;
+        return arena;
+    }
+
+private:
+    size_t blockSize;
+    std::vector<std::unique_ptr<unsigned char[]>> blocks;
+    // Bytes used in the last block
+    size_t used = 0;
+    size_t allocatedBytes = 0;
+};
+
+// Allocates boxes in the current BoxArena of the thread. Deallocating does nothing, the arena frees the memory.
+template <typename T>
+struct BoxArenaAllocator {
+    using value_type = T;
+
+    BoxArenaAllocator() = default;
+
+    template <typename U>
+    BoxArenaAllocator(BoxArenaAllocator<U> const &) {}
+
+    T * allocate(size_t count) {
+        auto const arena = BoxArena::current();
+        if (!arena) {
+            throw std::logic_error{"Boxes can only be allocated in an arena while a BoxArena::Scope is active"};
+        }
+        return static_cast<T *>(arena->allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void deallocate(T *, size_t) noexcept {}
+};
+
+template <typename T, typename U>
+bool operator==(BoxArenaAllocator<T> const &, BoxArenaAllocator<U> const &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(BoxArenaAllocator<T> const &, BoxArenaAllocator<U> const &) {
+    return false;
+}
+
+// An owning pointer to a T allocated with Allocator, which moves but doesn't copy. Allocators are default
+// constructed for every allocation, so they can't have state of their own.
+template <typename T, typename Allocator>
+class Box {
+public:
+    Box() = default;
+
+    Box(Box && other) noexcept : pointer{std::exchange(other.pointer, nullptr)} {}
+
+    Box & operator=(Box && other) noexcept {
+        if (this != &other) {
+            reset();
+            pointer = std::exchange(other.pointer, nullptr);
         }
         return *this;
     }
 
-    BoxedOptional(BoxedOptional && optional) { *this = std::move(optional); }
+    ~Box() { reset(); }
 
-    BoxedOptional & operator=(BoxedOptional && optional) {
+    template <typename... Args>
+    void emplace(Args &&... args) {
         reset();
-        if (optional) {
-            value = std::move(optional.value);
+        Allocator allocator;
+        auto const allocated = Traits::allocate(allocator, 1);
+        try {
+            Traits::construct(allocator, allocated, std::forward<Args>(args)...);
+        } catch (...) {
+            Traits::deallocate(allocator, allocated, 1);
+            throw;
+        }
+        pointer = allocated;
+    }
+
+    void reset() noexcept {
+        if (pointer) {
+            Allocator allocator;
+            Traits::destroy(allocator, pointer);
+            Traits::deallocate(allocator, pointer, 1);
+            pointer = nullptr;
+        }
+    }
+
+    T * get() const noexcept { return pointer; }
+
+private:
+    using Traits = std::allocator_traits<Allocator>;
+
+    T * pointer = nullptr;
+};
+
+// A Box that copies its value. Assigning to a box that has a value assigns to the value instead of allocating.
+template <typename T, typename Allocator>
+class CopyableBox : public Box<T, Allocator> {
+public:
+    CopyableBox() = default;
+
+    CopyableBox(CopyableBox const & other) : Box<T, Allocator>() {
+        if (other.get()) {
+            this->emplace(*other.get());
+        }
+    }
+
+    CopyableBox & operator=(CopyableBox const & other) {
+        if (!other.get()) {
+            this->reset();
+        } else if (!this->get()) {
+            this->emplace(*other.get());
+        } else if (this != &other) {
+            *this->get() = *other.get();
         }
         return *this;
     }
 
+    CopyableBox(CopyableBox &&) noexcept = default;
+    CopyableBox & operator=(CopyableBox &&) noexcept = default;
+};
+
+// An optional that allocates its value, so that types can contain optionals of themselves. Values are allocated with
+// Allocator, e.g. BoxPool or BoxArenaAllocator.
+template <typename T, typename Allocator = std::allocator<T>, BoxCopying copying = BoxCopying::Deep>
+struct BoxedOptional {
+
+    BoxedOptional() = default;
+
+    BoxedOptional(T value) { this->value.emplace(std::move(value)); }
+
     void reset() { value.reset(); }
 
-    bool has_value() const { return value != nullptr; }
+    bool has_value() const { return value.get() != nullptr; }
 
     explicit operator bool() const { return has_value(); }
 
-    T & operator*() { return *value; }
+    T & operator*() { return *value.get(); }
 
-    T const & operator*() const { return *value; }
+    T const & operator*() const { return *value.get(); }
 
     T * operator->() { return value.get(); }
 
     T const * operator->() const { return value.get(); }
 
 private:
-    std::unique_ptr<T> value;
+    std::conditional_t<copying == BoxCopying::Deep, CopyableBox<T, Allocator>, Box<T, Allocator>> value;
 };
 
-template <typename T>
-bool operator==(BoxedOptional<T> const & lhs, BoxedOptional<T> const & rhs) {
+template <typename T, typename Allocator, BoxCopying copying>
+bool operator==(BoxedOptional<T, Allocator, copying> const & lhs, BoxedOptional<T, Allocator, copying> const & rhs) {
     if (lhs.has_value() != rhs.has_value()) {
         return false;
     }
@@ -59,17 +317,17 @@ bool operator==(BoxedOptional<T> const & lhs, BoxedOptional<T> const & rhs) {
     return *lhs == *rhs;
 }
 
-template <typename T>
-bool operator!=(BoxedOptional<T> const & lhs, BoxedOptional<T> const & rhs) {
+template <typename T, typename Allocator, BoxCopying copying>
+bool operator!=(BoxedOptional<T, Allocator, copying> const & lhs, BoxedOptional<T, Allocator, copying> const & rhs) {
     return !(lhs == rhs);
 }
 
 } // namespace caffql
 
 namespace nlohmann {
-template <typename T>
-struct adl_serializer<caffql::BoxedOptional<T>> {
-    static void to_json(json & json, caffql::BoxedOptional<T> const & opt) {
+template <typename T, typename Allocator, caffql::BoxCopying copying>
+struct adl_serializer<caffql::BoxedOptional<T, Allocator, copying>> {
+    static void to_json(json & json, caffql::BoxedOptional<T, Allocator, copying> const & opt) {
         if (opt.has_value()) {
             json = *opt;
         } else {
@@ -77,7 +335,7 @@ struct adl_serializer<caffql::BoxedOptional<T>> {
         }
     }
 
-    static void from_json(const json & json, caffql::BoxedOptional<T> & opt) {
+    static void from_json(const json & json, caffql::BoxedOptional<T, Allocator, copying> & opt) {
         if (json.is_null()) {
             opt.reset();
         } else {
@@ -89,8 +347,8 @@ struct adl_serializer<caffql::BoxedOptional<T>> {
 
 namespace caffql {
 
-template <typename T>
-void get_value_to(Json const & json, char const * key, BoxedOptional<T> & target) {
+template <typename T, typename Allocator, BoxCopying copying>
+void get_value_to(Json const & json, char const * key, BoxedOptional<T, Allocator, copying> & target) {
     auto it = json.find(key);
     if (it != json.end()) {
         it->get_to(target);
@@ -1,4 +1,8 @@
 #include "CodeGeneration.hpp"
+#include <cctype>
+#include <chrono>
+#include <functional>
+#include <string_view>
 
 namespace caffql {
 
@@ -19,11 +23,16 @@ void from_json(Json const & json, Field & field) {
     get_value_to(json, "description", field.description);
     get_value_to(json, "args", field.args);
     get_value_to(json, "type", field.type);
+    // Missing from responses to introspection queries that don't select it
+    field.isDeprecated = json.value("isDeprecated", false);
+    get_value_to(json, "deprecationReason", field.deprecationReason);
 }
 
 void from_json(Json const & json, EnumValue & value) {
     get_value_to(json, "name", value.name);
     get_value_to(json, "description", value.description);
+    value.isDeprecated = json.value("isDeprecated", false);
+    get_value_to(json, "deprecationReason", value.deprecationReason);
 }
 
 void from_json(Json const & json, Type & type) {
@@ -45,6 +54,31 @@ void from_json(Json const & json, Type & type) {
     get_optional_array_to("possibleTypes", type.possibleTypes);
 }
 
+void from_json(Json const & json, ScalarMapping & mapping) {
+    get_value_to(json, "type", mapping.cppType);
+    get_value_to(json, "decode", mapping.decode);
+    get_value_to(json, "encode", mapping.encode);
+    get_value_to(json, "include", mapping.include);
+
+    if (mapping.decode.has_value() != mapping.encode.has_value()) {
+        throw std::invalid_argument{"Scalar mapping to " + mapping.cppType + " needs both decode and encode"};
+    }
+}
+
+void to_json(Json & json, ScalarMapping const & mapping) {
+    json = {{"type", mapping.cppType}};
+
+    auto setIfPresent = [&](char const * key, std::optional<std::string> const & value) {
+        if (value) {
+            json[key] = *value;
+        }
+    };
+
+    setIfPresent("decode", mapping.decode);
+    setIfPresent("encode", mapping.encode);
+    setIfPresent("include", mapping.include);
+}
+
 void from_json(Json const & json, Schema::OperationType & operationType) {
     get_value_to(json, "name", operationType.name);
 }
@@ -56,47 +90,296 @@ void from_json(Json const & json, Schema & schema) {
     get_value_to(json, "types", schema.types);
 }
 
-std::vector<Type> sortCustomTypesByDependencyOrder(std::vector<Type> const & types) {
-    using namespace std;
+// Finds the text of json values without building them. Throws std::invalid_argument on unexpected input.
+class JsonScanner {
+public:
+    explicit JsonScanner(std::string const & text): text(text) {}
 
-    struct TypeWithDependencies {
-        Type type;
-        unordered_set<string> dependencies;
-    };
+    size_t position = 0;
 
-    unordered_map<string, unordered_set<string>> typesToDependents;
-    map<string, TypeWithDependencies> typesToDependencies;
+    void skipWhitespace() {
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) {
+            ++position;
+        }
+    }
 
-    auto isCustomType = [](TypeKind kind) {
-        switch (kind) {
-        case TypeKind::Object:
-        case TypeKind::Interface:
-        case TypeKind::Union:
-        case TypeKind::Enum:
-        case TypeKind::InputObject:
+    bool consume(char character) {
+        skipWhitespace();
+        if (position < text.size() && text[position] == character) {
+            ++position;
             return true;
+        }
+        return false;
+    }
 
-        case TypeKind::Scalar:
-        case TypeKind::List:
-        case TypeKind::NonNull:
-            return false;
+    void expect(char character) {
+        if (!consume(character)) {
+            throw std::invalid_argument{std::string("Expected ") + character};
+        }
+    }
+
+    // Returns the string at position without unescaping it.
+    std::string_view readString() {
+        expect('"');
+        auto const start = position;
+        while (position < text.size() && text[position] != '"') {
+            position += text[position] == '\\' ? 2 : 1;
+        }
+        if (position >= text.size()) {
+            throw std::invalid_argument{"Unterminated string"};
+        }
+        return std::string_view(text).substr(start, position++ - start);
+    }
+
+    void skipValue() {
+        skipWhitespace();
+        if (position >= text.size()) {
+            throw std::invalid_argument{"Expected value"};
+        }
+
+        switch (text[position]) {
+        case '"':
+            readString();
+            return;
+        case '{':
+        case '[': {
+            size_t depth = 0;
+            do {
+                switch (text[position]) {
+                case '"':
+                    readString();
+                    continue;
+                case '{':
+                case '[':
+                    ++depth;
+                    break;
+                case '}':
+                case ']':
+                    --depth;
+                    break;
+                }
+                ++position;
+            } while (depth > 0 && position < text.size());
+
+            if (depth > 0) {
+                throw std::invalid_argument{"Unterminated value"};
+            }
+            return;
+        }
+        default:
+            // Numbers, booleans and null end at the next delimiter.
+            static std::string_view const delimiters = ",}] \t\r\n";
+            while (position < text.size() && delimiters.find(text[position]) == std::string_view::npos) {
+                ++position;
+            }
+        }
+    }
+
+    // Calls member with each key of the object at position, which must skip or read its value.
+    template <typename Member>
+    void forEachMember(Member member) {
+        expect('{');
+        if (consume('}')) {
+            return;
+        }
+        do {
+            auto const key = readString();
+            expect(':');
+            member(key);
+        } while (consume(','));
+        expect('}');
+    }
+
+    // Calls element with the start and end of each value in the array at position.
+    template <typename Element>
+    void forEachElement(Element element) {
+        expect('[');
+        if (consume(']')) {
+            return;
+        }
+        do {
+            skipWhitespace();
+            auto const start = position;
+            skipValue();
+            element(start, position);
+        } while (consume(','));
+        expect(']');
+    }
+
+private:
+    std::string const & text;
+};
+
+static Schema parseSchemaIncrementally(std::string const & text, SchemaParseCache & cache) {
+    Schema schema;
+    SchemaParseCache parsed;
+    bool hasTypes = false;
+
+    JsonScanner scanner(text);
+
+    auto parseValue = [&](auto & target) {
+        scanner.skipWhitespace();
+        auto const start = scanner.position;
+        scanner.skipValue();
+        Json::parse(text.begin() + start, text.begin() + scanner.position).get_to(target);
+    };
+
+    auto parseSchemaMember = [&](std::string_view key) {
+        if (key == "queryType") {
+            parseValue(schema.queryType);
+        } else if (key == "mutationType") {
+            parseValue(schema.mutationType);
+        } else if (key == "subscriptionType") {
+            parseValue(schema.subscriptionType);
+        } else if (key == "types") {
+            hasTypes = true;
+            scanner.forEachElement([&](size_t start, size_t end) {
+                auto const typeText = std::string_view(text).substr(start, end - start);
+                auto const hash = std::hash<std::string_view>{}(typeText);
+
+                // Moving cached types over avoids copying their text.
+                auto cached = cache.types.extract(hash);
+                if (cached.empty() || cached.mapped().text != typeText) {
+                    cached = parsed.types.extract(hash);
+                }
+                if (cached.empty() || cached.mapped().text != typeText) {
+                    SchemaParseCache::ParsedType parsedType{std::string(typeText), Json::parse(typeText).get<Type>()};
+                    schema.types.push_back(parsedType.type);
+                    parsed.types.insert_or_assign(hash, std::move(parsedType));
+                    return;
+                }
+
+                schema.types.push_back(cached.mapped().type);
+                parsed.types.insert(std::move(cached));
+            });
+        } else {
+            scanner.skipValue();
+        }
+    };
+
+    scanner.forEachMember([&](std::string_view key) {
+        if (key != "data") {
+            scanner.skipValue();
+            return;
+        }
+        scanner.forEachMember([&](std::string_view key) {
+            if (key == "__schema") {
+                scanner.forEachMember(parseSchemaMember);
+            } else {
+                scanner.skipValue();
+            }
+        });
+    });
+
+    if (!hasTypes) {
+        throw std::invalid_argument{"Schema has no types"};
+    }
+
+    cache = std::move(parsed);
+    return schema;
+}
+
+Schema parseSchema(std::string const & text, SchemaParseCache * cache) {
+    if (cache) {
+        try {
+            return parseSchemaIncrementally(text, *cache);
+        } catch (std::exception const &) {
+            // Falls back to parsing everything, which reports errors precisely.
+        }
+    }
+
+    return Json::parse(text).at("data").at("__schema");
+}
+
+static bool isCustomType(TypeKind kind) {
+    switch (kind) {
+    case TypeKind::Object:
+    case TypeKind::Interface:
+    case TypeKind::Union:
+    case TypeKind::Enum:
+    case TypeKind::InputObject:
+        return true;
+
+    case TypeKind::Scalar:
+    case TypeKind::List:
+    case TypeKind::NonNull:
+        return false;
+    }
+
+    throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(kind))};
+}
+
+static bool isListType(TypeRef const & type) {
+    return (type.kind == TypeKind::NonNull ? *type.ofType : type).kind == TypeKind::List;
+}
+
+// Orders the types of a cycle. Objects and input objects come first, each after the ones it contains by value where
+// possible, then interfaces and unions, whose variants need their implementations to be complete.
+static std::vector<Type> sortCycle(std::vector<Type const *> const & component) {
+    using namespace std;
+
+    map<string, Type const *> structs;
+    vector<Type const *> variants;
+    for (auto const type : component) {
+        if (type->kind == TypeKind::Object || type->kind == TypeKind::InputObject) {
+            structs[type->name] = type;
+        } else {
+            variants.push_back(type);
         }
+    }
+    sort(variants.begin(), variants.end(), [](Type const * lhs, Type const * rhs) { return lhs->name < rhs->name; });
+
+    vector<Type> sorted;
+    unordered_set<string> visited;
+
+    function<void(Type const &)> visit = [&](Type const & type) {
+        visited.insert(type.name);
+
+        auto visitField = [&](auto const & field) {
+            auto const it = structs.find(field.type.underlyingType().name.value_or(""));
+            if (!isListType(field.type) && it != structs.end() && !visited.count(it->first)) {
+                visit(*it->second);
+            }
+        };
+        for_each(type.fields.begin(), type.fields.end(), visitField);
+        for_each(type.inputFields.begin(), type.inputFields.end(), visitField);
 
-        throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(kind))};
+        sorted.push_back(type);
     };
 
+    for (auto const & pair : structs) {
+        if (!visited.count(pair.first)) {
+            visit(*pair.second);
+        }
+    }
+    for (auto const type : variants) {
+        sorted.push_back(*type);
+    }
+
+    return sorted;
+}
+
+std::vector<std::vector<Type>> sortCustomTypeComponents(std::vector<Type> const & types) {
+    using namespace std;
+
+    map<string, Type const *> customTypes;
+
     for (auto const & type : types) {
         // Ignore metatypes, which begin with underscores
-        if (!isCustomType(type.kind) || type.name.rfind("__", 0) == 0) {
-            continue;
+        if (isCustomType(type.kind) && type.name.rfind("__", 0) != 0) {
+            customTypes[type.name] = &type;
         }
+    }
+
+    unordered_map<string, vector<string>> typesToDependencies;
 
-        unordered_set<string> dependencies;
+    for (auto const & pair : customTypes) {
+        auto const & type = *pair.second;
+        auto & dependencies = typesToDependencies[type.name];
 
-        auto addDependency = [&](auto const & dependency) {
-            if (dependency.name && isCustomType(dependency.kind)) {
-                typesToDependents[*dependency.name].insert(type.name);
-                dependencies.insert(*dependency.name);
+        auto addDependency = [&](TypeRef const & dependency) {
+            if (dependency.name && isCustomType(dependency.kind) && customTypes.count(*dependency.name)) {
+                dependencies.push_back(*dependency.name);
             }
         };
 
@@ -115,42 +398,334 @@ std::vector<Type> sortCustomTypesByDependencyOrder(std::vector<Type> const & typ
         for (auto const & possibleType : type.possibleTypes) {
             addDependency(possibleType);
         }
-
-        typesToDependencies[type.name] = {type, move(dependencies)};
     }
 
-    vector<Type> sortedTypes;
+    // Tarjan's algorithm finds the strongly connected components, the types that depend on each other.
+    struct Visit {
+        size_t index;
+        size_t lowLink;
+        bool isOnStack;
+    };
 
-    while (!typesToDependencies.empty()) {
-        auto const initialCount = typesToDependencies.size();
+    unordered_map<string, Visit> visits;
+    vector<string> stack;
+    vector<vector<Type const *>> components;
+    unordered_map<string, size_t> typesToComponents;
+
+    function<void(string const &)> visit = [&](string const & name) {
+        auto const index = visits.size();
+        visits[name] = {index, index, true};
+        stack.push_back(name);
+
+        for (auto const & dependency : typesToDependencies[name]) {
+            auto const visited = visits.find(dependency);
+            if (visited == visits.end()) {
+                visit(dependency);
+                visits[name].lowLink = min(visits[name].lowLink, visits[dependency].lowLink);
+            } else if (visited->second.isOnStack) {
+                visits[name].lowLink = min(visits[name].lowLink, visited->second.index);
+            }
+        }
 
-        vector<string> addedTypeNames;
+        if (visits[name].lowLink == index) {
+            vector<Type const *> component;
+            string member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                visits[member].isOnStack = false;
+                typesToComponents[member] = components.size();
+                component.push_back(customTypes[member]);
+            } while (member != name);
+            components.push_back(move(component));
+        }
+    };
 
-        for (auto const & pair : typesToDependencies) {
-            if (pair.second.dependencies.empty()) {
-                sortedTypes.push_back(pair.second.type);
-                addedTypeNames.push_back(pair.first);
+    for (auto const & pair : customTypes) {
+        if (!visits.count(pair.first)) {
+            visit(pair.first);
+        }
+    }
 
-                for (auto const & dependentName : typesToDependents[pair.first]) {
-                    typesToDependencies[dependentName].dependencies.erase(pair.first);
+    // Components are keyed by the alphabetically first name of their types, which for types outside of cycles is
+    // their own name.
+    map<string, size_t> pendingComponents;
+    vector<unordered_set<size_t>> componentDependencies(components.size());
+    vector<unordered_set<size_t>> componentDependents(components.size());
+
+    for (size_t component = 0; component < components.size(); ++component) {
+        auto const & members = components[component];
+        auto const first = min_element(members.begin(), members.end(), [](Type const * lhs, Type const * rhs) {
+            return lhs->name < rhs->name;
+        });
+        pendingComponents[(*first)->name] = component;
+
+        for (auto const type : members) {
+            for (auto const & dependency : typesToDependencies[type->name]) {
+                auto const dependencyComponent = typesToComponents[dependency];
+                if (dependencyComponent != component) {
+                    componentDependencies[component].insert(dependencyComponent);
+                    componentDependents[dependencyComponent].insert(component);
                 }
             }
         }
+    }
+
+    vector<vector<Type>> sortedComponents;
 
-        for (auto const & addedName : addedTypeNames) {
-            typesToDependencies.erase(addedName);
+    while (!pendingComponents.empty()) {
+        vector<string> addedKeys;
+
+        for (auto const & pair : pendingComponents) {
+            auto const component = pair.second;
+            if (!componentDependencies[component].empty()) {
+                continue;
+            }
+
+            auto const & members = components[component];
+            auto const & type = *members.front();
+            auto const isCycle = members.size() > 1 || find(typesToDependencies[type.name].begin(),
+                                                            typesToDependencies[type.name].end(),
+                                                            type.name) != typesToDependencies[type.name].end();
+            sortedComponents.push_back(isCycle ? sortCycle(members) : vector<Type>{type});
+            addedKeys.push_back(pair.first);
+
+            for (auto const dependent : componentDependents[component]) {
+                componentDependencies[dependent].erase(component);
+            }
         }
 
-        if (typesToDependencies.size() == initialCount) {
-            throw runtime_error{"Circular dependencies in schema"};
+        for (auto const & addedKey : addedKeys) {
+            pendingComponents.erase(addedKey);
         }
     }
 
+    return sortedComponents;
+}
+
+std::vector<Type> sortCustomTypesByDependencyOrder(std::vector<Type> const & types) {
+    std::vector<Type> sortedTypes;
+    for (auto & component : sortCustomTypeComponents(types)) {
+        std::move(component.begin(), component.end(), std::back_inserter(sortedTypes));
+    }
     return sortedTypes;
 }
 
+FieldRecursions findFieldRecursions(std::vector<std::vector<Type>> const & components) {
+    FieldRecursions recursions;
+
+    for (auto const & component : components) {
+        std::unordered_map<std::string, size_t> positions;
+        for (size_t position = 0; position < component.size(); ++position) {
+            positions[component[position].name] = position;
+        }
+
+        // Fields whose type is declared at or after their own type's position refer to an incomplete type.
+        for (size_t position = 0; position < component.size(); ++position) {
+            auto const & type = component[position];
+            auto addRecursion = [&](auto const & field) {
+                auto const it = positions.find(field.type.underlyingType().name.value_or(""));
+                if (it != positions.end()) {
+                    auto const isBoxed = !isListType(field.type) && it->second >= position;
+                    recursions[type.name + "." + field.name] =
+                            isBoxed ? FieldRecursion::Boxed : FieldRecursion::Recursive;
+                }
+            };
+            std::for_each(type.fields.begin(), type.fields.end(), addRecursion);
+            std::for_each(type.inputFields.begin(), type.inputFields.end(), addRecursion);
+        }
+    }
+
+    // Interfaces return the fields of their implementations, so a field takes the strongest recursion it has in an
+    // interface or any of its implementations. Repeats until types implementing several interfaces agree with all.
+    std::vector<Type const *> interfaces;
+    for (auto const & component : components) {
+        for (auto const & type : component) {
+            if (type.kind == TypeKind::Interface) {
+                interfaces.push_back(&type);
+            }
+        }
+    }
+
+    auto isChanged = true;
+    while (isChanged) {
+        isChanged = false;
+
+        for (auto const interface : interfaces) {
+            for (auto const & field : interface->fields) {
+                auto recursion = fieldRecursion(recursions, interface->name, field.name);
+                for (auto const & possibleType : interface->possibleTypes) {
+                    auto const implementationRecursion =
+                            fieldRecursion(recursions, possibleType.name.value_or(""), field.name);
+                    recursion = std::max(recursion, implementationRecursion);
+                }
+                if (recursion == FieldRecursion::None) {
+                    continue;
+                }
+
+                auto unify = [&](std::string const & typeName) {
+                    auto & unified = recursions[typeName + "." + field.name];
+                    isChanged |= unified != recursion;
+                    unified = recursion;
+                };
+                unify(interface->name);
+                for (auto const & possibleType : interface->possibleTypes) {
+                    unify(possibleType.name.value_or(""));
+                }
+            }
+        }
+    }
+
+    return recursions;
+}
+
+FieldRecursion fieldRecursion(
+        FieldRecursions const & recursions, std::string const & typeName, std::string const & fieldName) {
+    auto const it = recursions.find(typeName + "." + fieldName);
+    return it != recursions.end() ? it->second : FieldRecursion::None;
+}
+
 std::string indent(size_t indentation) { return std::string(indentation * spacesPerIndent, ' '); }
 
+// Indents each non empty line of a block of fixed source text.
+static std::string indentBlock(std::string const & block, size_t indentation) {
+    std::string generated;
+    bool isLineStart = true;
+
+    for (auto const character : block) {
+        if (isLineStart && character != '\n') {
+            generated += indent(indentation);
+        }
+        generated += character;
+        isLineStart = character == '\n';
+    }
+
+    return generated;
+}
+
+// Removes indentation from the start of each line of block that has it.
+static std::string dedentBlock(std::string const & block, size_t indentation) {
+    auto const prefix = indent(indentation);
+    std::string generated;
+
+    size_t lineStart = 0;
+    while (lineStart < block.size()) {
+        auto lineEnd = block.find('\n', lineStart);
+        lineEnd = lineEnd == std::string::npos ? block.size() : lineEnd + 1;
+        if (block.compare(lineStart, prefix.size(), prefix) == 0) {
+            lineStart += prefix.size();
+        }
+        generated.append(block, lineStart, lineEnd - lineStart);
+        lineStart = lineEnd;
+    }
+
+    return generated;
+}
+
+GeneratedCode::GeneratedCode(GeneratedFunction function) { *this += std::move(function); }
+
+GeneratedCode & GeneratedCode::operator+=(std::string const & text) {
+    if (text.empty()) {
+        return *this;
+    }
+    if (parts.empty() || parts.back().function) {
+        parts.push_back({text, std::nullopt});
+    } else {
+        parts.back().text += text;
+    }
+    return *this;
+}
+
+GeneratedCode & GeneratedCode::operator+=(GeneratedFunction function) {
+    if (parts.empty() || parts.back().function) {
+        parts.push_back({"", std::move(function)});
+    } else {
+        parts.back().function = std::move(function);
+    }
+    return *this;
+}
+
+GeneratedCode & GeneratedCode::operator+=(GeneratedCode const & code) {
+    for (auto const & part : code.parts) {
+        *this += part.text;
+        if (part.function) {
+            *this += *part.function;
+        }
+    }
+    return *this;
+}
+
+GeneratedCode operator+(GeneratedCode lhs, GeneratedCode const & rhs) {
+    lhs += rhs;
+    return lhs;
+}
+
+static GeneratedFunction inlineFunction(std::string returnType, std::string declarator, size_t indentation) {
+    return {std::move(returnType), std::move(declarator), "", indentation, std::nullopt};
+}
+
+// A static member function, which memberFunctionsOf qualifies by the struct it is generated in.
+static GeneratedFunction staticMemberFunction(std::string returnType, std::string declarator, size_t indentation) {
+    return {std::move(returnType), std::move(declarator), "", indentation, ""};
+}
+
+// code, generated in a struct named structName, with its static member functions qualified by it.
+static GeneratedCode memberFunctionsOf(std::string const & structName, GeneratedCode code) {
+    for (auto & part : code.parts) {
+        if (part.function && part.function->memberScope) {
+            part.function->memberScope = structName + "::" + *part.function->memberScope;
+        }
+    }
+    return code;
+}
+
+std::string defineFunctionsInline(GeneratedCode const & code) {
+    std::string generated;
+
+    for (auto const & part : code.parts) {
+        generated += part.text;
+        if (auto const & function = part.function) {
+            generated += indent(function->indentation) + (function->memberScope ? "static " : "inline ") +
+                         function->returnType + " " + function->declarator + " {\n";
+            generated += function->body;
+            generated += indent(function->indentation) + "}\n\n";
+        }
+    }
+
+    return generated;
+}
+
+std::string moveFunctionsOutOfLine(
+        GeneratedCode const & code,
+        std::string const & scope,
+        size_t definitionIndentation,
+        std::string & declarations) {
+    std::string definitions;
+
+    for (auto const & part : code.parts) {
+        declarations += part.text;
+        auto const & function = part.function;
+        if (!function) {
+            continue;
+        }
+
+        auto const signature = function->returnType + " " + function->declarator;
+        if (function->memberScope) {
+            declarations += indent(function->indentation) + "static " + signature + ";\n\n";
+            // Use a trailing return type so that it is looked up in the scope of the struct.
+            definitions += indent(definitionIndentation) + "auto " + scope + *function->memberScope +
+                           function->declarator + " -> " + function->returnType + " {\n";
+        } else {
+            declarations += indent(function->indentation) + signature + ";\n\n";
+            definitions += indent(definitionIndentation) + signature + " {\n";
+        }
+        definitions += dedentBlock(function->body, function->indentation - definitionIndentation);
+        definitions += indent(definitionIndentation) + "}\n\n";
+    }
+
+    return definitions;
+}
+
 std::string generateDescription(std::optional<std::string> const & optionalDescription, size_t indentation) {
     if (!optionalDescription) {
         return "";
@@ -253,6 +828,49 @@ std::string generateEnumSerialization(Type const & type, size_t indentation) {
     return generated;
 }
 
+GeneratedCode generateEnumSerializationFunctions(Type const & type, size_t indentation) {
+    GeneratedCode generated;
+
+    auto toJson = inlineFunction(
+            "void", std::string{"to_json("} + cppJsonTypeName + " & json, " + type.name + " const & value)",
+            indentation);
+    toJson.body += indent(indentation + 1) + "switch (value) {\n";
+
+    for (auto const & value : type.enumValues) {
+        toJson.body += indent(indentation + 1) + "case " + type.name + "::" +
+                       screamingSnakeCaseToPascalCase(value.name) + ":\n";
+        toJson.body += indent(indentation + 2) + "json = \"" + value.name + "\";\n";
+        toJson.body += indent(indentation + 2) + "break;\n";
+    }
+
+    toJson.body += indent(indentation + 1) + "default:\n";
+    toJson.body += indent(indentation + 2) + "json = nullptr;\n";
+    toJson.body += indent(indentation + 2) + "break;\n";
+    toJson.body += indent(indentation + 1) + "}\n";
+    generated += toJson;
+
+    auto fromJson = deserializationFunction(type.name, indentation);
+    fromJson.body += indent(indentation + 1);
+
+    for (auto const & value : type.enumValues) {
+        fromJson.body += "if (json == \"" + value.name + "\") {\n";
+        fromJson.body += indent(indentation + 2) + "value = " + type.name + "::" +
+                         screamingSnakeCaseToPascalCase(value.name) + ";\n";
+        fromJson.body += indent(indentation + 1) + "} else ";
+    }
+
+    fromJson.body += "{\n";
+    fromJson.body += indent(indentation + 2) + "value = " + type.name + "::" + unknownCaseName + ";\n";
+    fromJson.body += indent(indentation + 1) + "}\n";
+    generated += fromJson;
+
+    return generated;
+}
+
+bool isBuiltinScalar(std::string const & name) {
+    return name == "Int" || name == "Float" || name == "String" || name == "Boolean" || name == "ID";
+}
+
 Scalar scalarType(std::string const & name) {
     if (name == "Int") {
         return Scalar::Int;
@@ -301,7 +919,8 @@ std::string cppTypeName(TypeRef const & type, bool shouldCheckNullability) {
         return type.name.value();
 
     case TypeKind::Scalar:
-        return cppScalarName(scalarType(type.name.value()));
+        // Custom scalars are declared under their own name.
+        return isBuiltinScalar(type.name.value()) ? cppScalarName(scalarType(type.name.value())) : type.name.value();
 
     case TypeKind::List:
         return "std::vector<" + cppTypeName(*type.ofType) + ">";
@@ -313,6 +932,30 @@ std::string cppTypeName(TypeRef const & type, bool shouldCheckNullability) {
     throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(type.kind))};
 }
 
+template <typename FieldType>
+static std::string cppMemberTypeName(FieldType const & field, FieldRecursion recursion) {
+    switch (recursion) {
+    case FieldRecursion::None:
+        return cppTypeName(field.type);
+    case FieldRecursion::Recursive:
+        // Optional even when non null, since it is left out past the query's recursion depth
+        return "optional<" + cppTypeName(field.type, false) + ">";
+    case FieldRecursion::Boxed:
+        return boxedTypeName + ("<" + field.type.underlyingType().name.value() + ">");
+    }
+
+    throw std::invalid_argument{"Invalid FieldRecursion value: " + std::to_string(static_cast<int>(recursion))};
+}
+
+std::string cppFieldTypeName(Field const & field, FieldRecursion recursion) {
+    return cppMemberTypeName(field, recursion);
+}
+
+std::string cppFieldTypeName(InputValue const & field, FieldRecursion recursion) {
+    // Input values are only sent, so they are never left out, only boxed
+    return cppMemberTypeName(field, recursion == FieldRecursion::Boxed ? recursion : FieldRecursion::None);
+}
+
 std::string graphqlTypeName(TypeRef const & type) {
     switch (type.kind) {
     case TypeKind::Scalar:
@@ -342,17 +985,49 @@ std::string cppVariant(std::vector<TypeRef> const & possibleTypes, std::string c
     return generated;
 }
 
-std::string generateDeserializationFunctionDeclaration(std::string const & typeName, size_t indentation) {
-    return indent(indentation) + "inline void from_json(" + cppJsonTypeName + " const & json, " + typeName +
-           " & value) {\n";
+GeneratedFunction deserializationFunction(std::string const & typeName, size_t indentation) {
+    return inlineFunction(
+            "void", std::string{"from_json("} + cppJsonTypeName + " const & json, " + typeName + " & value)",
+            indentation);
+}
+
+bool isRequiredField(Field const & field, FieldRecursion recursion) {
+    return field.type.kind == TypeKind::NonNull && field.delivery != IncrementalDelivery::Deferred &&
+           recursion == FieldRecursion::None;
 }
 
-std::string generateFieldDeserialization(Field const & field, size_t indentation) {
-    if (field.type.kind == TypeKind::NonNull) {
+std::string generateFieldDeserialization(Field const & field, size_t indentation, FieldRecursion recursion) {
+    // Unmapped custom scalars are json, which get_to can't decode into.
+    auto const isCustomScalar = field.type.kind == TypeKind::NonNull && field.type.ofType->kind == TypeKind::Scalar &&
+                                !isBuiltinScalar(field.type.ofType->name.value());
+
+    if (isRequiredField(field, recursion)) {
+        if (isCustomScalar) {
+            return indent(indentation) + "value." + field.name + " = json.at(\"" + field.name + "\").get<" +
+                   cppTypeName(field.type) + ">();\n";
+        }
         return indent(indentation) + "json.at(\"" + field.name + "\").get_to(value." + field.name + ");\n";
     }
 
     std::string generated;
+
+    // Recursive fields are optional, and reset like nullable ones when the query's recursion depth leaves them out
+    if (field.type.kind == TypeKind::NonNull && recursion == FieldRecursion::None) {
+        // Deferred, so only the payload delivering its fragment has it
+        generated += indent(indentation) + "{\n";
+        generated += indent(indentation + 1) + "auto it = json.find(\"" + field.name + "\");\n";
+        generated += indent(indentation + 1) + "if (it != json.end()) {\n";
+        if (isCustomScalar) {
+            generated += indent(indentation + 2) + "value." + field.name + " = it->get<" + cppTypeName(field.type) +
+                         ">();\n";
+        } else {
+            generated += indent(indentation + 2) + "it->get_to(value." + field.name + ");\n";
+        }
+        generated += indent(indentation + 1) + "}\n";
+        generated += indent(indentation) + "}\n";
+        return generated;
+    }
+
     generated += indent(indentation) + "{\n";
     generated += indent(indentation + 1) + "auto it = json.find(\"" + field.name + "\");\n";
     generated += indent(indentation + 1) + "if (it != json.end()) {\n";
@@ -365,31 +1040,27 @@ std::string generateFieldDeserialization(Field const & field, size_t indentation
     return generated;
 }
 
-std::string generateVariantDeserialization(
+GeneratedCode generateVariantDeserialization(
         Type const & type, std::string const & constructUnknown, size_t indentation) {
-    std::string generated;
-
-    generated += generateDeserializationFunctionDeclaration(type.name, indentation);
+    auto function = deserializationFunction(type.name, indentation);
 
-    generated += indent(indentation + 1) + "std::string occupiedType = json.at(\"__typename\");\n";
-    generated += indent(indentation + 1);
+    function.body += indent(indentation + 1) + "std::string occupiedType = json.at(\"__typename\");\n";
+    function.body += indent(indentation + 1);
 
     for (auto const & possibleType : type.possibleTypes) {
-        generated += "if (occupiedType == \"" + possibleType.name.value() + "\") {\n";
-        generated += indent(indentation + 2) + "value = {" + possibleType.name.value() + "(json)};\n";
-        generated += indent(indentation + 1) + "} else ";
+        function.body += "if (occupiedType == \"" + possibleType.name.value() + "\") {\n";
+        function.body += indent(indentation + 2) + "value = {" + possibleType.name.value() + "(json)};\n";
+        function.body += indent(indentation + 1) + "} else ";
     }
 
-    generated += "{\n";
-    generated += indent(indentation + 2) + "value = {" + constructUnknown + "};\n";
-    generated += indent(indentation + 1) + "}\n";
-
-    generated += indent(indentation) + "}\n\n";
+    function.body += "{\n";
+    function.body += indent(indentation + 2) + "value = {" + constructUnknown + "};\n";
+    function.body += indent(indentation + 1) + "}\n";
 
-    return generated;
+    return function;
 }
 
-std::string generateInterface(Type const & type, size_t indentation) {
+std::string generateInterface(Type const & type, size_t indentation, FieldRecursions const & recursions) {
     std::string interface;
     std::string unknownImplementation;
 
@@ -403,7 +1074,7 @@ std::string generateInterface(Type const & type, size_t indentation) {
     interface += indent(fieldIndentation) + cppVariant(type.possibleTypes, unknownTypeName) + " implementation;\n\n";
 
     for (auto const & field : type.fields) {
-        auto const typeName = cppTypeName(field.type);
+        auto const typeName = cppFieldTypeName(field, fieldRecursion(recursions, type.name, field.name));
         unknownImplementation += indent(fieldIndentation) + typeName + " " + field.name + ";\n";
 
         auto const typeNameConstRef = typeName + " const & ";
@@ -422,24 +1093,21 @@ std::string generateInterface(Type const & type, size_t indentation) {
     return unknownImplementation + interface;
 }
 
-std::string generateInterfaceUnknownCaseDeserialization(Type const & type, size_t indentation) {
-    std::string generated;
-
-    auto const unknownTypeName = unknownCaseName + type.name;
-
-    generated += generateDeserializationFunctionDeclaration(unknownTypeName, indentation);
+GeneratedCode generateInterfaceUnknownCaseDeserialization(
+        Type const & type, size_t indentation, FieldRecursions const & recursions) {
+    auto function = deserializationFunction(unknownCaseName + type.name, indentation);
 
     for (auto const & field : type.fields) {
-        generated += generateFieldDeserialization(field, indentation + 1);
+        function.body += generateFieldDeserialization(
+                field, indentation + 1, fieldRecursion(recursions, type.name, field.name));
     }
 
-    generated += indent(indentation) + "}\n\n";
-
-    return generated;
+    return function;
 }
 
-std::string generateInterfaceDeserialization(Type const & type, size_t indentation) {
-    return generateInterfaceUnknownCaseDeserialization(type, indentation) +
+GeneratedCode generateInterfaceDeserialization(
+        Type const & type, size_t indentation, FieldRecursions const & recursions) {
+    return generateInterfaceUnknownCaseDeserialization(type, indentation, recursions) +
            generateVariantDeserialization(type, unknownCaseName + type.name + "(json)", indentation);
 }
 
@@ -454,19 +1122,19 @@ std::string generateUnion(Type const & type, size_t indentation) {
     return generated;
 }
 
-std::string generateUnionDeserialization(Type const & type, size_t indentation) {
+GeneratedCode generateUnionDeserialization(Type const & type, size_t indentation) {
     return generateVariantDeserialization(type, unknownCaseName + type.name + "()", indentation);
 }
 
 template <typename T>
-static std::string generateField(T const & field, size_t indentation) {
+static std::string generateField(T const & field, FieldRecursion recursion, size_t indentation) {
     std::string generated;
     generated += generateDescription(field.description, indentation);
-    generated += indent(indentation) + cppTypeName(field.type) + " " + field.name + ";\n";
+    generated += indent(indentation) + cppFieldTypeName(field, recursion) + " " + field.name + ";\n";
     return generated;
 }
 
-std::string generateObject(Type const & type, size_t indentation) {
+std::string generateObject(Type const & type, size_t indentation, FieldRecursions const & recursions) {
     std::string generated;
 
     generated += generateDescription(type.description, indentation);
@@ -475,29 +1143,338 @@ std::string generateObject(Type const & type, size_t indentation) {
     auto const fieldIndentation = indentation + 1;
 
     for (auto const & field : type.fields) {
-        generated += generateField(field, fieldIndentation);
+        generated += generateField(field, fieldRecursion(recursions, type.name, field.name), fieldIndentation);
+    }
+
+    generated += indent(indentation) + "};\n\n";
+
+    return generated;
+}
+
+GeneratedCode generateObjectDeserialization(
+        Type const & type, size_t indentation, FieldRecursions const & recursions) {
+    auto function = deserializationFunction(type.name, indentation);
+
+    for (auto const & field : type.fields) {
+        function.body += generateFieldDeserialization(
+                field, indentation + 1, fieldRecursion(recursions, type.name, field.name));
+    }
+
+    return function;
+}
+
+bool isPresenceTracked(Field const & field) {
+    if (field.type.kind == TypeKind::Enum) {
+        return true;
+    }
+    if (field.type.kind != TypeKind::Scalar || !isBuiltinScalar(field.type.name.value())) {
+        return false;
+    }
+
+    switch (scalarType(field.type.name.value())) {
+    case Scalar::Int:
+    case Scalar::Float:
+    case Scalar::Boolean:
+        return true;
+    case Scalar::String:
+    case Scalar::ID:
+        return false;
+    }
+
+    throw std::invalid_argument{"Invalid Scalar value: " + field.type.name.value()};
+}
+
+size_t estimatedAlignment(TypeRef const & type) {
+    switch (type.kind) {
+    case TypeKind::NonNull:
+        return estimatedAlignment(*type.ofType);
+
+    case TypeKind::Scalar:
+        if (!isBuiltinScalar(type.name.value())) {
+            return 8;
+        }
+        switch (scalarType(type.name.value())) {
+        case Scalar::Int:
+            return 4;
+        case Scalar::Boolean:
+            return 1;
+        case Scalar::Float:
+        case Scalar::String:
+        case Scalar::ID:
+            return 8;
+        }
+        break;
+
+    case TypeKind::Enum:
+        return 4;
+
+    // Containers, and objects made up of them, hold pointers.
+    case TypeKind::Object:
+    case TypeKind::Interface:
+    case TypeKind::Union:
+    case TypeKind::InputObject:
+    case TypeKind::List:
+        return 8;
     }
 
+    throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(type.kind))};
+}
+
+std::string generatePresenceBits(size_t indentation) {
+    std::string generated;
+
+    generated += indent(indentation) +
+                 "// Whether each nullable scalar field of a compact object is present, one bit per field.\n";
+    generated += indent(indentation) + "template <size_t Count>\n";
+    generated += indent(indentation) + "struct PresenceBits {\n";
+    generated += indent(indentation + 1) + "uint8_t bits[(Count + 7) / 8] = {};\n\n";
+    generated += indent(indentation + 1) +
+                 "bool test(size_t index) const { return (bits[index / 8] >> (index % 8)) & 1u; }\n\n";
+    generated += indent(indentation + 1) + "void set(size_t index, bool isPresent) {\n";
+    generated += indent(indentation + 2) + "uint8_t const mask = 1u << (index % 8);\n";
+    generated += indent(indentation + 2) +
+                 "bits[index / 8] = isPresent ? (bits[index / 8] | mask) : (bits[index / 8] & ~mask);\n";
+    generated += indent(indentation + 1) + "}\n";
     generated += indent(indentation) + "};\n\n";
 
     return generated;
 }
 
-std::string generateObjectDeserialization(Type const & type, size_t indentation) {
+// Names of the members of a compact object that store its presence tracked fields and their presence bits, which
+// are suffixed until they are distinct from the names of its fields and of the fields' accessors.
+struct CompactStorageNames {
+    std::unordered_map<std::string, std::string> fields;
+    std::string presence;
+};
+
+static CompactStorageNames compactStorageNames(Type const & type) {
+    std::unordered_set<std::string> usedNames;
+    for (auto const & field : type.fields) {
+        usedNames.insert(field.name);
+        if (isPresenceTracked(field)) {
+            usedNames.insert("set" + capitalize(field.name));
+        }
+    }
+
+    auto uniqueName = [&](std::string const & name) {
+        auto unique = name;
+        for (size_t suffix = 1; usedNames.count(unique) > 0; ++suffix) {
+            unique = name + std::to_string(suffix);
+        }
+        usedNames.insert(unique);
+        return unique;
+    };
+
+    CompactStorageNames names;
+    for (auto const & field : type.fields) {
+        if (isPresenceTracked(field)) {
+            names.fields[field.name] = uniqueName(field.name + "_");
+        }
+    }
+    names.presence = uniqueName("presence");
+    return names;
+}
+
+// Fields of a compact object from most to least aligned, which its members, including the storage of presence tracked
+// fields, are declared in, each paired with its index among the presence tracked fields if it is one.
+static std::vector<std::pair<Field const *, std::optional<size_t>>> compactMembers(Type const & type) {
+    std::vector<std::pair<Field const *, std::optional<size_t>>> members;
+
+    size_t presenceIndex = 0;
+    for (auto const & field : type.fields) {
+        members.emplace_back(&field, isPresenceTracked(field) ? std::optional<size_t>(presenceIndex++) : std::nullopt);
+    }
+
+    std::stable_sort(members.begin(), members.end(), [](auto const & lhs, auto const & rhs) {
+        return estimatedAlignment(lhs.first->type) > estimatedAlignment(rhs.first->type);
+    });
+
+    return members;
+}
+
+std::string generateCompactObject(Type const & type, size_t indentation, FieldRecursions const & recursions) {
     std::string generated;
 
-    generated += generateDeserializationFunctionDeclaration(type.name, indentation);
+    generated += generateDescription(type.description, indentation);
+    generated += indent(indentation) + "struct " + type.name + " {\n";
+
+    auto const fieldIndentation = indentation + 1;
+    auto const members = compactMembers(type);
+    auto const storageNames = compactStorageNames(type);
+
+    // Sorted as a single sequence, so that presence tracked storage fills the padding after other members too.
+    size_t presenceTrackedCount = 0;
+    for (auto const & member : members) {
+        auto const & field = *member.first;
+        if (member.second) {
+            generated += indent(fieldIndentation) + cppTypeName(field.type, false) + " " +
+                         storageNames.fields.at(field.name) + " = {};\n";
+            ++presenceTrackedCount;
+        } else {
+            generated += generateField(field, fieldRecursion(recursions, type.name, field.name), fieldIndentation);
+        }
+    }
+
+    if (presenceTrackedCount == 0) {
+        generated += indent(indentation) + "};\n\n";
+        return generated;
+    }
+
+    // The least aligned, so it goes last
+    auto const & presence = storageNames.presence;
+    generated += indent(fieldIndentation) + "PresenceBits<" + std::to_string(presenceTrackedCount) + "> " + presence +
+                 ";\n\n";
+
+    for (auto const & field : type.fields) {
+        if (!isPresenceTracked(field)) {
+            continue;
+        }
+
+        auto const member = std::find_if(members.begin(), members.end(), [&](auto const & member) {
+            return member.first == &field;
+        });
+        auto const index = std::to_string(*member->second);
+        auto const typeName = cppTypeName(field.type);
+        auto const valueTypeName = cppTypeName(field.type, false);
+        auto const & storageName = storageNames.fields.at(field.name);
+
+        generated += generateDescription(field.description, fieldIndentation);
+        generated += indent(fieldIndentation) + typeName + " " + field.name + "() const { return " + presence +
+                     ".test(" + index + ") ? " + typeName + "(" + storageName + ") : " + typeName + "(); }\n";
+        generated += indent(fieldIndentation) + "void set" + capitalize(field.name) + "(" + typeName +
+                     " value) {\n";
+        generated += indent(fieldIndentation + 1) + presence + ".set(" + index + ", value.has_value());\n";
+        generated += indent(fieldIndentation + 1) + storageName + " = value.value_or(" + valueTypeName + "());\n";
+        generated += indent(fieldIndentation) + "}\n";
+    }
+
+    generated += indent(indentation) + "};\n\n";
+
+    return generated;
+}
+
+GeneratedCode generateCompactObjectDeserialization(
+        Type const & type, size_t indentation, FieldRecursions const & recursions) {
+    auto function = deserializationFunction(type.name, indentation);
 
     for (auto const & field : type.fields) {
-        generated += generateFieldDeserialization(field, indentation + 1);
+        if (!isPresenceTracked(field)) {
+            function.body += generateFieldDeserialization(
+                    field, indentation + 1, fieldRecursion(recursions, type.name, field.name));
+            continue;
+        }
+
+        auto const typeName = cppTypeName(field.type);
+        function.body += indent(indentation + 1) + "{\n";
+        function.body += indent(indentation + 2) + "auto it = json.find(\"" + field.name + "\");\n";
+        function.body += indent(indentation + 2) + "value.set" + capitalize(field.name) +
+                         "(it != json.end() ? it->get<" + typeName + ">() : " + typeName + "());\n";
+        function.body += indent(indentation + 1) + "}\n";
+    }
+
+    return function;
+}
+
+std::string generateLayoutReport(
+        std::vector<Type> const & types, GenerationOptions const & options, size_t indentation) {
+    std::string generated;
+
+    generated += indent(indentation) + "struct TypeLayout {\n";
+    generated += indent(indentation + 1) + "char const * name;\n";
+    generated += indent(indentation + 1) + "size_t size;\n";
+    generated += indent(indentation + 1) + "// Bytes of size that no member uses\n";
+    generated += indent(indentation + 1) + "size_t padding;\n";
+    generated += indent(indentation) + "};\n\n";
+
+    generated += indent(indentation) + "inline std::vector<TypeLayout> layoutReport() {\n";
+    generated += indent(indentation + 1) + "return {\n";
+
+    for (auto const & type : types) {
+        if (type.kind != TypeKind::Object) {
+            continue;
+        }
+
+        std::vector<std::string> memberNames;
+        if (options.lazyDecoding) {
+            memberNames = {"lazyNode", "decoded"};
+        } else {
+            auto const storageNames = compactStorageNames(type);
+            bool hasPresenceTrackedFields = false;
+            for (auto const & field : type.fields) {
+                auto const isCompact = options.compactLayout && isPresenceTracked(field);
+                memberNames.push_back(isCompact ? storageNames.fields.at(field.name) : field.name);
+                hasPresenceTrackedFields = hasPresenceTrackedFields || isCompact;
+            }
+            if (hasPresenceTrackedFields) {
+                memberNames.push_back(storageNames.presence);
+            }
+        }
+
+        std::string memberSizes;
+        for (auto const & memberName : memberNames) {
+            memberSizes += (memberSizes.empty() ? "sizeof(" : " + sizeof(") + type.name + "::" + memberName + ")";
+        }
+
+        generated += indent(indentation + 2) + "{\"" + type.name + "\", sizeof(" + type.name + "), sizeof(" +
+                     type.name + ") - (" + (memberSizes.empty() ? "0" : memberSizes) + ")},\n";
     }
 
+    generated += indent(indentation + 1) + "};\n";
     generated += indent(indentation) + "}\n\n";
 
     return generated;
 }
 
-std::string generateInputObject(Type const & type, size_t indentation) {
+std::string generateCustomScalar(
+        Type const & type, std::optional<ScalarMapping> const & mapping, size_t indentation) {
+    std::string generated;
+
+    generated += generateDescription(type.description, indentation);
+
+    if (!mapping) {
+        generated += indent(indentation) + "using " + type.name + " = " + cppJsonTypeName + ";\n\n";
+        return generated;
+    }
+
+    if (!mapping->decode) {
+        generated += indent(indentation) + "using " + type.name + " = " + mapping->cppType + ";\n\n";
+        return generated;
+    }
+
+    // A distinct type, so that its serialization can call the codec.
+    generated += indent(indentation) + "struct " + type.name + " {\n";
+    generated += indent(indentation + 1) + mapping->cppType + " value{};\n\n";
+    generated += indent(indentation + 1) + type.name + "() = default;\n";
+    generated += indent(indentation + 1) + type.name + "(" + mapping->cppType +
+                 " value) : value{std::move(value)} {}\n";
+    generated += indent(indentation + 1) + "operator " + mapping->cppType + " const &() const { return value; }\n";
+    generated += indent(indentation) + "};\n\n";
+
+    return generated;
+}
+
+GeneratedCode generateCustomScalarSerialization(
+        Type const & type, std::optional<ScalarMapping> const & mapping, size_t indentation) {
+    if (!mapping || !mapping->decode) {
+        return {};
+    }
+
+    GeneratedCode generated;
+
+    auto fromJson = deserializationFunction(type.name, indentation);
+    fromJson.body += indent(indentation + 1) + "value.value = " + *mapping->decode + "(json);\n";
+    generated += fromJson;
+
+    auto toJson = inlineFunction(
+            "void", std::string{"to_json("} + cppJsonTypeName + " & json, " + type.name + " const & value)",
+            indentation);
+    toJson.body += indent(indentation + 1) + "json = " + *mapping->encode + "(value.value);\n";
+    generated += toJson;
+
+    return generated;
+}
+
+std::string generateInputObject(Type const & type, size_t indentation, FieldRecursions const & recursions) {
     std::string generated;
 
     generated += generateDescription(type.description, indentation);
@@ -506,7 +1483,7 @@ std::string generateInputObject(Type const & type, size_t indentation) {
     auto const fieldIndentation = indentation + 1;
 
     for (auto const & field : type.inputFields) {
-        generated += generateField(field, fieldIndentation);
+        generated += generateField(field, fieldRecursion(recursions, type.name, field.name), fieldIndentation);
     }
 
     generated += indent(indentation) + "};\n\n";
@@ -520,19 +1497,27 @@ static std::string generateFieldSerialization(
     return indent(indentation) + jsonName + "[\"" + field.name + "\"] = " + fieldPrefix + field.name + ";\n";
 }
 
-std::string generateInputObjectSerialization(Type const & type, size_t indentation) {
-    std::string generated;
-
-    generated += indent(indentation) + "inline void to_json(" + cppJsonTypeName + " & json, " + type.name +
-                 " const & value) {\n";
+GeneratedCode generateInputObjectSerialization(Type const & type, size_t indentation) {
+    auto function = inlineFunction(
+            "void", std::string{"to_json("} + cppJsonTypeName + " & json, " + type.name + " const & value)",
+            indentation);
 
     for (auto const & field : type.inputFields) {
-        generated += generateFieldSerialization(field, "value.", "json", indentation + 1);
+        function.body += generateFieldSerialization(field, "value.", "json", indentation + 1);
     }
 
-    generated += indent(indentation) + "}\n\n";
+    return function;
+}
 
-    return generated;
+GeneratedCode generateInputObjectCacheKeyEncoding(Type const & type, size_t indentation) {
+    auto function = inlineFunction(
+            "void", "encodeCacheArgument(std::string & bytes, " + type.name + " const & value)", indentation);
+
+    for (auto const & field : type.inputFields) {
+        function.body += indent(indentation + 1) + "encodeCacheArgument(bytes, value." + field.name + ");\n";
+    }
+
+    return function;
 }
 
 std::string operationQueryName(Operation operation) {
@@ -548,6 +1533,10 @@ std::string operationQueryName(Operation operation) {
     throw std::invalid_argument{"Invalid Operation value: " + std::to_string(static_cast<int>(operation))};
 }
 
+std::string operationName(Field const & field, Operation operation) {
+    return operationQueryName(operation) + " " + capitalize(field.name);
+}
+
 std::string appendNameToVariablePrefix(std::string const & variablePrefix, std::string const & name) {
     return variablePrefix.empty() ? uncapitalize(name) : variablePrefix + capitalize(name);
 }
@@ -557,7 +1546,23 @@ std::string generateQueryField(
         TypeMap const & typeMap,
         std::string const & variablePrefix,
         std::vector<QueryVariable> & variables,
-        size_t indentation) {
+        size_t indentation,
+        size_t recursionDepth,
+        FieldRecursions const & recursions) {
+    if (field.delivery == IncrementalDelivery::Deferred) {
+        auto immediateField = field;
+        immediateField.delivery = IncrementalDelivery::None;
+        return indent(indentation) + "... @defer {\n" +
+               generateQueryField(immediateField,
+                                  typeMap,
+                                  variablePrefix,
+                                  variables,
+                                  indentation + 1,
+                                  recursionDepth,
+                                  recursions) +
+               indent(indentation) + "}\n";
+    }
+
     std::string generated;
 
     generated += indent(indentation) + field.name;
@@ -572,17 +1577,26 @@ std::string generateQueryField(
         generated += indent(indentation) + ")";
     }
 
+    if (field.delivery == IncrementalDelivery::Streamed) {
+        generated += " @stream(initialCount: 0)";
+    }
+
     auto const & underlyingFieldType = field.type.underlyingType();
     if (underlyingFieldType.kind != TypeKind::Scalar && underlyingFieldType.kind != TypeKind::Enum) {
-        generated += " {\n";
-        generated += generateQueryFields(
+        auto selectionSet = generateQueryFields(
                 typeMap.at(underlyingFieldType.name.value()),
                 typeMap,
                 appendNameToVariablePrefix(variablePrefix, underlyingFieldType.name.value()),
                 variables,
                 {},
-                indentation + 1);
-        generated += indent(indentation) + "}";
+                indentation + 1,
+                recursionDepth,
+                recursions);
+        // Every field of the selection may have been left out for being recursive
+        if (selectionSet.empty()) {
+            selectionSet = indent(indentation + 1) + "__typename\n";
+        }
+        generated += " {\n" + selectionSet + indent(indentation) + "}";
     }
 
     generated += "\n";
@@ -596,15 +1610,34 @@ std::string generateQueryFields(
         std::string const & variablePrefix,
         std::vector<QueryVariable> & variables,
         std::vector<Field> const & ignoredFields,
-        size_t indentation) {
+        size_t indentation,
+        size_t recursionDepth,
+        FieldRecursions const & recursions) {
     std::string generated;
 
+    auto isIgnored = [&](Field const & field) {
+        return std::any_of(ignoredFields.begin(), ignoredFields.end(), [&](Field const & ignored) {
+            return ignored.type == field.type && ignored.name == field.name &&
+                   ignored.description == field.description && ignored.args == field.args &&
+                   ignored.delivery == field.delivery;
+        });
+    };
+
     auto addTypeFields = [&] {
         for (auto const & field : type.fields) {
-            if (std::find(ignoredFields.begin(), ignoredFields.end(), field) == ignoredFields.end()) {
-                generated += generateQueryField(
-                        field, typeMap, appendNameToVariablePrefix(variablePrefix, field.name), variables, indentation);
+            // Whether fields are recursive depends on the type they are in, so an interface's fields and its
+            // implementations' can differ in it.
+            auto const isRecursive = fieldRecursion(recursions, type.name, field.name) != FieldRecursion::None;
+            if (isIgnored(field) || (isRecursive && recursionDepth == 0)) {
+                continue;
             }
+            generated += generateQueryField(field,
+                                            typeMap,
+                                            appendNameToVariablePrefix(variablePrefix, field.name),
+                                            variables,
+                                            indentation,
+                                            isRecursive ? recursionDepth - 1 : recursionDepth,
+                                            recursions);
         }
     };
 
@@ -620,7 +1653,9 @@ std::string generateQueryFields(
                     appendNameToVariablePrefix(variablePrefix, possibleType.name.value()),
                     variables,
                     type.fields,
-                    indentation + 1);
+                    indentation + 1,
+                    recursionDepth,
+                    recursions);
             if (!possibleTypeQuery.empty()) {
                 generated += indent(indentation) + "...on " + possibleType.name.value() + " {\n";
                 generated += possibleTypeQuery;
@@ -635,14 +1670,20 @@ std::string generateQueryFields(
 }
 
 QueryDocument generateQueryDocument(
-        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation) {
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        size_t indentation,
+        size_t recursionDepth,
+        FieldRecursions const & recursions) {
     QueryDocument document;
     auto & query = document.query;
     auto & variables = document.variables;
 
-    auto selectionSet = generateQueryField(field, typeMap, "", variables, indentation + 1);
+    auto selectionSet =
+            generateQueryField(field, typeMap, "", variables, indentation + 1, recursionDepth, recursions);
 
-    query += indent(indentation) + operationQueryName(operation) + " " + capitalize(field.name);
+    query += indent(indentation) + operationName(field, operation);
 
     if (variables.size()) {
         query += "(\n";
@@ -664,6 +1705,9 @@ bool shouldPassByReferenceToRequestFunction(TypeRef const & type) {
     while (true) {
         switch (currentType->kind) {
         case TypeKind::Scalar:
+            if (!isBuiltinScalar(currentType->name.value())) {
+                return true;
+            }
             switch (scalarType(currentType->name.value())) {
             case Scalar::Int:
             case Scalar::Float:
@@ -697,111 +1741,292 @@ bool shouldPassByReferenceToRequestFunction(TypeRef const & type) {
     }
 }
 
-std::string generateOperationRequestFunction(
-        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation) {
+// The parameters of request functions, which functions taking the same arguments share.
+static std::string generateRequestParameters(std::vector<QueryVariable> const & variables) {
+    std::string parameters;
+    for (auto const & variable : variables) {
+        auto typeName = cppTypeName(variable.type);
+        if (shouldPassByReferenceToRequestFunction(variable.type)) {
+            typeName += " const &";
+        }
+        parameters += (parameters.empty() ? "" : ", ") + typeName + " " + variable.name;
+    }
+    return parameters;
+}
+
+GeneratedCode generateOperationRequestFunction(
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        size_t indentation,
+        size_t recursionDepth,
+        FieldRecursions const & recursions) {
     auto const functionIndentation = indentation + 1;
     auto const queryIndentation = functionIndentation + 1;
 
-    auto const document = generateQueryDocument(field, operation, typeMap, queryIndentation);
+    auto const document =
+            generateQueryDocument(field, operation, typeMap, queryIndentation, recursionDepth, recursions);
 
-    std::string generated;
-    generated += indent(indentation) + "static " + cppJsonTypeName + " request(";
+    auto function = staticMemberFunction(
+            cppJsonTypeName, "request(" + generateRequestParameters(document.variables) + ")", indentation);
 
-    for (auto it = document.variables.begin(); it != document.variables.end(); ++it) {
-        auto typeName = cppTypeName(it->type);
-        if (shouldPassByReferenceToRequestFunction(it->type)) {
-            typeName += " const &";
-        }
-        generated += typeName + " " + it->name;
+    // Use raw string literal for the query.
+    function.body += indent(functionIndentation) + cppJsonTypeName + " query = R\"(\n" + document.query +
+                     indent(functionIndentation) + ")\";\n";
+    function.body += indent(functionIndentation) + cppJsonTypeName + " variables;\n";
 
-        if (it != document.variables.end() - 1) {
-            generated += ", ";
-        }
+    for (auto const & variable : document.variables) {
+        function.body += generateFieldSerialization(variable, "", "variables", functionIndentation);
     }
 
-    generated += ") {\n";
+    function.body += indent(functionIndentation) +
+                     "return {{\"query\", std::move(query)}, {\"variables\", std::move(variables)}};\n";
 
-    // Use raw string literal for the query.
-    generated += indent(functionIndentation) + cppJsonTypeName + " query = R\"(\n" + document.query +
-                 indent(functionIndentation) + ")\";\n";
-    generated += indent(functionIndentation) + cppJsonTypeName + " variables;\n";
+    return function;
+}
 
-    for (auto const & variable : document.variables) {
-        generated += generateFieldSerialization(variable, "", "variables", functionIndentation);
-    }
+GeneratedCode generateOperationResponseFunction(Field const & field, size_t indentation) {
+    GeneratedCode generated;
 
-    generated += indent(functionIndentation) +
-                 "return {{\"query\", std::move(query)}, {\"variables\", std::move(variables)}};\n";
+    auto const dataType = cppTypeName(field.type);
+    auto const errorsType = "std::vector<" + std::string{grapqlErrorTypeName} + ">";
 
-    generated += indent(indentation) + "}\n\n";
+    generated += indent(indentation) + "using ResponseData = " + dataType + ";\n\n";
+    auto function = staticMemberFunction(
+            "GraphqlResponse<ResponseData>", std::string{"response("} + cppJsonTypeName + " const & json)",
+            indentation);
+
+    function.body += indent(indentation + 1) + "auto errors = json.find(\"errors\");\n";
+    function.body += indent(indentation + 1) + "if (errors != json.end()) {\n";
+    function.body += indent(indentation + 2) + errorsType + " errorsList = " + "*errors;\n";
+    function.body += indent(indentation + 2) + "return errorsList;\n";
+    function.body += indent(indentation + 1) + "} else {\n";
+
+    function.body += indent(indentation + 2) + "auto const & data = json.at(\"data\");\n";
+
+    if (isRequiredField(field)) {
+        function.body += indent(indentation + 2) + "return ResponseData(data.at(\"" + field.name + "\"));\n";
+    } else {
+        function.body += indent(indentation + 2) + "auto it = data.find(\"" + field.name + "\");\n";
+        function.body += indent(indentation + 2) + "if (it != data.end()) {\n";
+        function.body += indent(indentation + 3) + "return ResponseData(*it);\n";
+        function.body += indent(indentation + 2) + "} else {\n";
+        function.body += indent(indentation + 3) + "return ResponseData{};\n";
+        function.body += indent(indentation + 2) + "}\n";
+    }
+
+    function.body += indent(indentation + 1) + "}\n";
+    generated += function;
 
     return generated;
 }
 
-std::string generateOperationResponseFunction(Field const & field, size_t indentation) {
-    std::string generated;
+GeneratedCode generateLazyOperationResponseFunction(Field const & field, size_t indentation) {
+    GeneratedCode generated;
 
     auto const dataType = cppTypeName(field.type);
     auto const errorsType = "std::vector<" + std::string{grapqlErrorTypeName} + ">";
-    auto const responseType = "GraphqlResponse<ResponseData>";
 
     generated += indent(indentation) + "using ResponseData = " + dataType + ";\n\n";
-    generated += indent(indentation) + "static " + responseType + " response(" + cppJsonTypeName + " const & json) {\n";
+    // Take the json by value so that the lazily decoded data can share ownership of it.
+    auto function = staticMemberFunction(
+            "GraphqlResponse<ResponseData>", std::string{"response("} + cppJsonTypeName + " json)", indentation);
+
+    function.body += indent(indentation + 1) + "auto errors = json.find(\"errors\");\n";
+    function.body += indent(indentation + 1) + "if (errors != json.end()) {\n";
+    function.body += indent(indentation + 2) + errorsType + " errorsList = " + "*errors;\n";
+    function.body += indent(indentation + 2) + "return errorsList;\n";
+    function.body += indent(indentation + 1) + "} else {\n";
+
+    function.body += indent(indentation + 2) + "auto document = std::make_shared<" + cppJsonTypeName +
+                     " const>(std::move(json));\n";
+    function.body += indent(indentation + 2) + "auto const & data = document->at(\"data\");\n";
+    function.body += indent(indentation + 2) + "ResponseData responseData{};\n";
+
+    if (isRequiredField(field)) {
+        function.body += indent(indentation + 2) + "decodeLazy(LazyNode{document, &data.at(\"" + field.name +
+                         "\")}, responseData);\n";
+    } else {
+        function.body += indent(indentation + 2) + "auto it = data.find(\"" + field.name + "\");\n";
+        function.body += indent(indentation + 2) + "if (it != data.end()) {\n";
+        function.body += indent(indentation + 3) + "decodeLazy(LazyNode{document, &*it}, responseData);\n";
+        function.body += indent(indentation + 2) + "}\n";
+    }
 
-    generated += indent(indentation + 1) + "auto errors = json.find(\"errors\");\n";
-    generated += indent(indentation + 1) + "if (errors != json.end()) {\n";
-    generated += indent(indentation + 2) + errorsType + " errorsList = " + "*errors;\n";
-    generated += indent(indentation + 2) + "return errorsList;\n";
-    generated += indent(indentation + 1) + "} else {\n";
+    function.body += indent(indentation + 2) + "return responseData;\n";
+    function.body += indent(indentation + 1) + "}\n";
+    generated += function;
+
+    return generated;
+}
+
+GeneratedCode generateOperationParseResponseFunction(Field const & field, size_t indentation) {
+    auto function =
+            staticMemberFunction("GraphqlResponse<ResponseData>", "parseResponse(std::string_view text)", indentation);
+    function.body += indent(indentation + 1) + "return parseOnDemandResponse<ResponseData>(text, \"" + field.name +
+                     "\", " + (isRequiredField(field) ? "true" : "false") + ");\n";
+    return function;
+}
 
-    generated += indent(indentation + 2) + "auto const & data = json.at(\"data\");\n";
+GeneratedCode generateOperationTryResponseFunctions(Field const & field, size_t indentation) {
+    GeneratedCode generated;
 
-    if (field.type.kind == TypeKind::NonNull) {
-        generated += indent(indentation + 2) + "return ResponseData(data.at(\"" + field.name + "\"));\n";
-    } else {
-        generated += indent(indentation + 2) + "auto it = data.find(\"" + field.name + "\");\n";
-        generated += indent(indentation + 2) + "if (it != data.end()) {\n";
-        generated += indent(indentation + 3) + "return ResponseData(*it);\n";
-        generated += indent(indentation + 2) + "} else {\n";
-        generated += indent(indentation + 3) + "return ResponseData{};\n";
-        generated += indent(indentation + 2) + "}\n";
+    auto const resultType = "DecodeResult<GraphqlResponse<ResponseData>>";
+
+    auto tryResponse = staticMemberFunction(
+            resultType, std::string{"tryResponse("} + cppJsonTypeName + " const & json)", indentation);
+    tryResponse.body += indent(indentation + 1) + "return tryDecodeResponse<ResponseData>(json, \"" + field.name +
+                        "\", " + (isRequiredField(field) ? "true" : "false") + ");\n";
+    generated += tryResponse;
+
+    auto tryParseResponse = staticMemberFunction(resultType, "tryParseResponse(std::string_view text)", indentation);
+    tryParseResponse.body += indent(indentation + 1) + "auto const json = " + cppJsonTypeName +
+                             "::parse(text, nullptr, false);\n";
+    tryParseResponse.body += indent(indentation + 1) + "if (json.is_discarded()) {\n";
+    tryParseResponse.body += indent(indentation + 2) + "return DecodeError{DecodeErrorCode::InvalidJson, \"\"};\n";
+    tryParseResponse.body += indent(indentation + 1) + "}\n";
+    tryParseResponse.body += indent(indentation + 1) + "return tryResponse(json);\n";
+    generated += tryParseResponse;
+
+    return generated;
+}
+
+GeneratedCode generateOperationApplyPayloadFunction(Field const & field, size_t indentation) {
+    auto function = staticMemberFunction(
+            "IncrementalPayload",
+            std::string{"applyPayload("} + cppJsonTypeName + " const & payload, ResponseData & data)",
+            indentation);
+    function.body += indent(indentation + 1) + "return applyIncrementalPayload(payload, \"" + field.name +
+                     "\", data);\n";
+    return function;
+}
+
+GeneratedCode generateOperationExecuteFunction(std::vector<QueryVariable> const & variables, size_t indentation) {
+    std::string parameters;
+    std::string arguments;
+    for (auto const & variable : variables) {
+        // By value, since the coroutine may outlive the caller's arguments
+        parameters += ", " + cppTypeName(variable.type) + " " + variable.name;
+        arguments += (arguments.empty() ? "" : ", ") + variable.name;
     }
 
-    generated += indent(indentation + 1) + "}\n";
+    GeneratedCode generated;
 
+    // Text rather than a function, since as a template it stays in the header when functions are moved to
+    // implementation files
+    generated += indent(indentation) +
+                 "template <GraphqlTransport Transport> static GraphqlTask<GraphqlResponse<ResponseData>> "
+                 "execute(Transport & transport" +
+                 parameters + ") {\n";
+    generated += indent(indentation + 1) + "co_return response(co_await transport.send(request(" + arguments +
+                 ")));\n";
     generated += indent(indentation) + "}\n\n";
 
     return generated;
 }
 
-std::string generateOperationType(
-        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation) {
-    auto const document = generateQueryDocument(field, operation, typeMap, 0);
+GeneratedCode generateOperationFetchFunction(
+        Field const & field, Operation operation, std::vector<QueryVariable> const & variables, size_t indentation) {
+    auto const parameters = generateRequestParameters(variables);
+    std::string arguments;
+    for (auto const & variable : variables) {
+        arguments += (arguments.empty() ? "" : ", ") + variable.name;
+    }
 
-    std::string generated;
+    auto function = staticMemberFunction(
+            "std::shared_ptr<GraphqlResponse<ResponseData> const>",
+            "fetch(GraphqlRequestCoalescer & coalescer" + (parameters.empty() ? "" : ", " + parameters) + ")",
+            indentation);
+    // Keyed like the result cache, so that both share requests with the same arguments
+    function.body += indent(indentation + 1) + "return coalescer.fetch<ResponseData>(makeCacheKey(\"" +
+                     operationName(field, operation) + "\"" + (arguments.empty() ? "" : ", " + arguments) +
+                     "), request(" + arguments + "), &response);\n";
 
-    generated += generateDescription(field.description, indentation);
-    generated += indent(indentation) + "struct " + capitalize(field.name) + "Field" + " {\n\n";
+    return function;
+}
 
-    generated += indent(indentation + 1) +
-                 "static Operation constexpr operation = Operation::" + capitalize(operationQueryName(operation)) +
-                 ";\n\n";
-    generated += generateOperationRequestFunction(field, operation, typeMap, indentation + 1);
-    generated += generateOperationResponseFunction(field, indentation + 1);
+GeneratedCode generateOperationCacheKeyFunction(
+        Field const & field, Operation operation, std::vector<QueryVariable> const & variables, size_t indentation) {
+    std::string arguments;
+    for (auto const & variable : variables) {
+        arguments += ", " + variable.name;
+    }
+
+    auto function = staticMemberFunction(
+            "GraphqlCacheKey", "cacheKey(" + generateRequestParameters(variables) + ")", indentation);
+    function.body += indent(indentation + 1) + "return makeCacheKey(\"" + operationName(field, operation) + "\"" +
+                     arguments + ");\n";
+
+    return function;
+}
+
+GeneratedCode generateOperationType(
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        GenerationOptions const & options,
+        size_t indentation,
+        FieldRecursions const & recursions) {
+    auto const document = generateQueryDocument(field, operation, typeMap, 0, options.recursionDepth, recursions);
+    auto const structName = capitalize(field.name) + "Field";
+
+    GeneratedCode members;
+
+    members += indent(indentation + 1) +
+               "static Operation constexpr operation = Operation::" + capitalize(operationQueryName(operation)) +
+               ";\n\n";
+    members += generateOperationRequestFunction(
+            field, operation, typeMap, indentation + 1, options.recursionDepth, recursions);
+    if (options.lazyDecoding) {
+        members += generateLazyOperationResponseFunction(field, indentation + 1);
+    } else {
+        members += generateOperationResponseFunction(field, indentation + 1);
+    }
+    if (options.jsonBackend == JsonBackend::Simdjson) {
+        members += generateOperationParseResponseFunction(field, indentation + 1);
+    }
+    if (options.checkedDecoding) {
+        members += generateOperationTryResponseFunctions(field, indentation + 1);
+    }
+    if (!options.deferredFields.empty() || !options.streamedFields.empty()) {
+        members += generateOperationApplyPayloadFunction(field, indentation + 1);
+    }
+    if (options.asyncOperations) {
+        members += generateOperationExecuteFunction(document.variables, indentation + 1);
+    }
+    // Only queries are shared, since every mutation must be sent for its effect and every subscription has its own
+    // stream of events
+    if (options.coalescedRequests && operation == Operation::Query) {
+        members += generateOperationFetchFunction(field, operation, document.variables, indentation + 1);
+    }
+    // Mutations and subscriptions aren't cached, since every one must be sent for its effect or events
+    if (options.resultCache && operation == Operation::Query) {
+        members += generateOperationCacheKeyFunction(field, operation, document.variables, indentation + 1);
+    }
 
+    GeneratedCode generated;
+
+    generated += generateDescription(field.description, indentation);
+    generated += indent(indentation) + "struct " + structName + " {\n\n";
+    generated += memberFunctionsOf(structName, std::move(members));
     generated += indent(indentation) + "};\n\n";
 
     return generated;
 }
 
-std::string generateOperationTypes(
-        Type const & type, Operation operation, TypeMap const & typeMap, size_t indentation) {
-    std::string generated;
+GeneratedCode generateOperationTypes(
+        Type const & type,
+        Operation operation,
+        TypeMap const & typeMap,
+        GenerationOptions const & options,
+        size_t indentation,
+        FieldRecursions const & recursions) {
+    GeneratedCode generated;
 
     generated += indent(indentation) + "namespace " + type.name + " {\n\n";
 
     for (auto const & field : type.fields) {
-        generated += generateOperationType(field, operation, typeMap, indentation + 1);
+        generated += generateOperationType(field, operation, typeMap, options, indentation + 1, recursions);
     }
 
     generated += indent(indentation) + "} // namespace " + type.name + "\n\n";
@@ -821,32 +2046,2815 @@ std::string generateGraphqlErrorType(size_t indentation) {
     return generated;
 }
 
-std::string generateGraphqlErrorDeserialization(size_t indentation) {
-    std::string generated;
+GeneratedCode generateGraphqlErrorDeserialization(size_t indentation) {
+    auto function = deserializationFunction(grapqlErrorTypeName, indentation);
+    function.body += indent(indentation + 1) + "json.at(\"message\").get_to(value.message);\n";
+    return function;
+}
 
-    generated += generateDeserializationFunctionDeclaration(grapqlErrorTypeName, indentation);
-    generated += indent(indentation + 1) + "json.at(\"message\").get_to(value.message);\n";
-    generated += indent(indentation) + "}\n\n";
+bool isEntityType(Type const & type) {
+    if (type.kind != TypeKind::Object) {
+        return false;
+    }
 
-    return generated;
+    return std::any_of(type.fields.begin(), type.fields.end(), [](Field const & field) {
+        return field.name == "id" && field.type.kind == TypeKind::NonNull &&
+               field.type.ofType->kind == TypeKind::Scalar && field.type.ofType->name == "ID";
+    });
 }
 
-std::string algrebraicNamespaceName(AlgebraicNamespace algebraicNamespace) {
-    switch (algebraicNamespace) {
-    case AlgebraicNamespace::Std:
-        return "std";
-    case AlgebraicNamespace::Absl:
-        return "absl";
+std::string generateEntityCache(
+        std::vector<Type> const & types,
+        GenerationOptions const & options,
+        size_t indentation,
+        FieldRecursions const & recursions) {
+    // Types are in dependency order, so whether a type contains entities is known before its dependents are visited,
+    // except in cycles, where types can contain entities through the types after them. Types are visited again until
+    // none of them changes.
+    std::unordered_set<std::string> typesContainingEntities;
+    std::vector<Type const *> entityTypes;
+    auto hasBoxedFields = false;
+
+    for (auto const & type : types) {
+        if (isEntityType(type)) {
+            entityTypes.push_back(&type);
+        }
+        hasBoxedFields |= std::any_of(type.fields.begin(), type.fields.end(), [&](Field const & field) {
+            return fieldRecursion(recursions, type.name, field.name) == FieldRecursion::Boxed;
+        });
     }
 
-    throw std::invalid_argument{"Invalid AlgebraicNamespace value: " +
-                                std::to_string(static_cast<int>(algebraicNamespace))};
-}
+    for (auto isChanged = true; isChanged;) {
+        isChanged = false;
 
-static std::string generateOptionalSerialization(AlgebraicNamespace algebraicNamespace) {
-    auto const namespaceName = algrebraicNamespaceName(algebraicNamespace);
-    char const * optionalInclude;
-    char const * variantInclude;
+        for (auto const & type : types) {
+            auto containsEntities = isEntityType(type);
+
+            for (auto const & field : type.fields) {
+                auto const & fieldType = field.type.underlyingType();
+                containsEntities |= fieldType.name && typesContainingEntities.count(*fieldType.name);
+            }
+
+            for (auto const & possibleType : type.possibleTypes) {
+                containsEntities |= typesContainingEntities.count(possibleType.name.value()) > 0;
+            }
+
+            if (containsEntities) {
+                isChanged |= typesContainingEntities.insert(type.name).second;
+            }
+        }
+    }
+
+    // Unions are variants, which are normalized like any other variant.
+    std::vector<Type const *> normalizedTypes;
+    for (auto const & type : types) {
+        if (typesContainingEntities.count(type.name) && type.kind != TypeKind::Union) {
+            normalizedTypes.push_back(&type);
+        }
+    }
+
+    auto entityMapName = [](Type const & type) { return uncapitalize(type.name) + "Entities"; };
+    auto recordName = [](Type const & type) { return "EntityRecord<" + type.name + ">"; };
+
+    std::string generated;
+
+    generated += indentBlock(
+            R"(// A reference to the entity of type Entity with id in an EntityCache.
+template <typename Entity>
+struct EntityReference {
+    Id id;
+};
+
+// The fields of a value of type T that an EntityCache stores, with the entities it contains replaced by references.
+// Fields that were never written are empty.
+template <typename T>
+struct EntityRecord;
+
+// The type an EntityCache stores values of type T as.
+template <typename T>
+struct NormalizedType {
+    using type = T;
+};
+
+template <typename T>
+using Normalized = typename NormalizedType<T>::type;
+
+template <typename T>
+struct NormalizedType<optional<T>> {
+    using type = optional<Normalized<T>>;
+};
+
+template <typename T>
+struct NormalizedType<std::vector<T>> {
+    using type = std::vector<Normalized<T>>;
+};
+
+template <typename... Types>
+struct NormalizedType<variant<Types...>> {
+    using type = variant<Normalized<Types>...>;
+};
+
+)",
+            indentation);
+
+    if (hasBoxedFields) {
+        generated += indentBlock(
+                R"(template <typename T>
+struct NormalizedType<BoxedOptional<T>> {
+    using type = optional<Normalized<T>>;
+};
+
+)",
+                indentation);
+    }
+
+    // Objects are specialized before the interfaces whose implementations they are.
+    for (auto const isInterface : {false, true}) {
+        for (auto const type : normalizedTypes) {
+            if ((type->kind == TypeKind::Interface) != isInterface) {
+                continue;
+            }
+
+            std::string normalizedType;
+            if (isInterface) {
+                normalizedType = "Normalized<" + cppVariant(type->possibleTypes, unknownCaseName + type->name) + ">";
+            } else if (isEntityType(*type)) {
+                normalizedType = "EntityReference<" + type->name + ">";
+            } else {
+                normalizedType = "std::shared_ptr<" + recordName(*type) + " const>";
+            }
+
+            generated += indent(indentation) + "template <>\n";
+            generated += indent(indentation) + "struct NormalizedType<" + type->name + "> {\n";
+            generated += indent(indentation + 1) + "using type = " + normalizedType + ";\n";
+            generated += indent(indentation) + "};\n\n";
+        }
+    }
+
+    for (auto const type : normalizedTypes) {
+        if (type->kind == TypeKind::Interface) {
+            continue;
+        }
+
+        generated += indent(indentation) + "template <>\n";
+        generated += indent(indentation) + "struct " + recordName(*type) + " {\n";
+        for (auto const & field : type->fields) {
+            auto const fieldTypeName = cppFieldTypeName(field, fieldRecursion(recursions, type->name, field.name));
+            generated += indent(indentation + 1) + "optional<Normalized<" + fieldTypeName + ">> " + field.name +
+                         ";\n";
+        }
+        generated += indent(indentation) + "};\n\n";
+    }
+
+    auto const memberIndentation = indentation + 1;
+    auto const bodyIndentation = indentation + 2;
+    auto const depth = std::to_string(options.recursionDepth);
+
+    generated += indent(indentation) +
+                 "// Stores the fields of each entity once, keyed by typename and id, with the entities they contain\n";
+    generated += indent(indentation) +
+                 "// replaced by references. Writing a value merges the fields it has into the entities it contains,\n";
+    generated += indent(indentation) +
+                 "// and finding an entity rebuilds it from the references, to the queries' recursion depth.\n";
+    generated += indent(indentation) + "// Readers may look up entities concurrently.\n";
+    generated += indent(indentation) + "class EntityCache {\n";
+    generated += indent(indentation) + "public:\n";
+
+    generated += indent(memberIndentation) + "// Of the generated queries\n";
+    generated += indent(memberIndentation) + "static constexpr size_t recursionDepth = " + depth + ";\n\n";
+
+    generated += indent(memberIndentation) + "template <typename Entity>\n";
+    generated += indent(memberIndentation) + "std::shared_ptr<Entity const> find(" + cppIdTypeName +
+                 " const & id) const {\n";
+    generated += indent(bodyIndentation) + "std::shared_lock<std::shared_mutex> lock{mutex};\n";
+    generated += indent(bodyIndentation) + "auto const & entities = entityMap(static_cast<Entity const *>(nullptr));\n";
+    generated += indent(bodyIndentation) + "if (entities.count(id) == 0) {\n";
+    generated += indent(bodyIndentation + 1) + "return nullptr;\n";
+    generated += indent(bodyIndentation) + "}\n";
+    generated += indent(bodyIndentation) + "auto entity = std::make_shared<Entity>();\n";
+    generated += indent(bodyIndentation) + "denormalize(EntityReference<Entity>{id}, *entity, recursionDepth);\n";
+    generated += indent(bodyIndentation) + "return entity;\n";
+    generated += indent(memberIndentation) + "}\n\n";
+
+    generated += indent(memberIndentation) +
+                 "// depth is the number of times the value's query selected recursive fields within their own "
+                 "selection.\n";
+    generated += indent(memberIndentation) + "template <typename Value>\n";
+    generated += indent(memberIndentation) + "void write(Value const & value, size_t depth = recursionDepth) {\n";
+    generated += indent(bodyIndentation) + "std::unique_lock<std::shared_mutex> lock{mutex};\n";
+    generated += indent(bodyIndentation) + "normalizedValue(value, depth);\n";
+    generated += indent(memberIndentation) + "}\n\n";
+
+    generated += indent(memberIndentation) + "size_t size() const {\n";
+    generated += indent(bodyIndentation) + "std::shared_lock<std::shared_mutex> lock{mutex};\n";
+    generated += indent(bodyIndentation) + "return 0";
+    for (auto const type : entityTypes) {
+        generated += " + " + entityMapName(*type) + ".size()";
+    }
+    generated += ";\n";
+    generated += indent(memberIndentation) + "}\n\n";
+
+    generated += indent(memberIndentation) + "void clear() {\n";
+    generated += indent(bodyIndentation) + "std::unique_lock<std::shared_mutex> lock{mutex};\n";
+    for (auto const type : entityTypes) {
+        generated += indent(bodyIndentation) + entityMapName(*type) + ".clear();\n";
+    }
+    generated += indent(memberIndentation) + "}\n\n";
+
+    generated += indent(indentation) + "private:\n";
+
+    generated += indent(memberIndentation) + "template <typename Entity>\n";
+    generated += indent(memberIndentation) + "using EntityMap = std::unordered_map<" + cppIdTypeName +
+                 ", EntityRecord<Entity>>;\n\n";
+
+    for (auto const type : entityTypes) {
+        generated += indent(memberIndentation) + "EntityMap<" + type->name + "> const & entityMap(" + type->name +
+                     " const *) const { return " + entityMapName(*type) + "; }\n";
+    }
+    if (!entityTypes.empty()) {
+        generated += "\n";
+    }
+
+    // Values that don't contain entities are copied as they are, and containers of values that do are normalized
+    // element by element.
+    generated += indentBlock(
+            R"(template <typename T>
+Normalized<T> normalizedValue(T const & value, size_t depth) {
+    Normalized<T> normalized{};
+    normalize(value, normalized, depth);
+    return normalized;
+}
+
+template <typename T>
+T denormalizedValue(Normalized<T> const & normalized, size_t depth) const {
+    T value{};
+    denormalize(normalized, value, depth);
+    return value;
+}
+
+template <typename T>
+void normalize(T const & value, T & normalized, size_t) {
+    normalized = value;
+}
+
+template <typename T>
+void denormalize(T const & normalized, T & value, size_t) const {
+    value = normalized;
+}
+
+template <typename T, typename N, typename = std::enable_if_t<!std::is_same_v<T, N>>>
+void normalize(optional<T> const & value, optional<N> & normalized, size_t depth) {
+    normalized.reset();
+    if (value) {
+        normalized = normalizedValue(*value, depth);
+    }
+}
+
+template <typename T, typename N, typename = std::enable_if_t<!std::is_same_v<T, N>>>
+void denormalize(optional<N> const & normalized, optional<T> & value, size_t depth) const {
+    value.reset();
+    if (normalized) {
+        value = denormalizedValue<T>(*normalized, depth);
+    }
+}
+
+template <typename T, typename N, typename = std::enable_if_t<!std::is_same_v<T, N>>>
+void normalize(std::vector<T> const & values, std::vector<N> & normalized, size_t depth) {
+    normalized.clear();
+    normalized.reserve(values.size());
+    for (auto const & value : values) {
+        normalized.push_back(normalizedValue(value, depth));
+    }
+}
+
+template <typename T, typename N, typename = std::enable_if_t<!std::is_same_v<T, N>>>
+void denormalize(std::vector<N> const & normalized, std::vector<T> & values, size_t depth) const {
+    values.clear();
+    values.reserve(normalized.size());
+    for (auto const & value : normalized) {
+        values.push_back(denormalizedValue<T>(value, depth));
+    }
+}
+
+template <typename... Types,
+          typename... NormalizedTypes,
+          typename = std::enable_if_t<!std::is_same_v<variant<Types...>, variant<NormalizedTypes...>>>>
+void normalize(variant<Types...> const & value, variant<NormalizedTypes...> & normalized, size_t depth) {
+    visit([&](auto const & alternative) { normalized = normalizedValue(alternative, depth); }, value);
+}
+
+template <typename... Types,
+          typename... NormalizedTypes,
+          typename = std::enable_if_t<!std::is_same_v<variant<Types...>, variant<NormalizedTypes...>>>>
+void denormalize(variant<NormalizedTypes...> const & normalized, variant<Types...> & value, size_t depth) const {
+    visit([&](auto const & alternative) {
+        // Normalized types are distinct, so exactly one of the value's alternatives is normalized as the occupied one.
+        auto denormalizeAs = [&](auto * type) {
+            using T = std::remove_pointer_t<decltype(type)>;
+            if constexpr (std::is_same_v<Normalized<T>, std::decay_t<decltype(alternative)>>) {
+                value = denormalizedValue<T>(alternative, depth);
+            }
+        };
+        (denormalizeAs(static_cast<Types *>(nullptr)), ...);
+    }, normalized);
+}
+
+)",
+            memberIndentation);
+
+    if (hasBoxedFields) {
+        generated += indentBlock(
+                R"(template <typename T, typename N>
+void normalize(BoxedOptional<T> const & value, optional<N> & normalized, size_t depth) {
+    normalized.reset();
+    if (value) {
+        normalized = normalizedValue(*value, depth);
+    }
+}
+
+template <typename T, typename N>
+void denormalize(optional<N> const & normalized, BoxedOptional<T> & value, size_t depth) const {
+    value.reset();
+    if (normalized) {
+        value = denormalizedValue<T>(*normalized, depth);
+    }
+}
+
+)",
+                memberIndentation);
+    }
+
+    for (auto const type : normalizedTypes) {
+        auto const normalizedTypeName = "Normalized<" + type->name + ">";
+
+        if (type->kind == TypeKind::Interface) {
+            generated += indent(memberIndentation) + "void normalize(" + type->name + " const & value, " +
+                         normalizedTypeName + " & normalized, size_t depth) {\n";
+            generated += indent(bodyIndentation) + "normalize(value.implementation, normalized, depth);\n";
+            generated += indent(memberIndentation) + "}\n\n";
+
+            generated += indent(memberIndentation) + "void denormalize(" + normalizedTypeName +
+                         " const & normalized, " + type->name + " & value, size_t depth) const {\n";
+            generated += indent(bodyIndentation) + "denormalize(normalized, value.implementation, depth);\n";
+            generated += indent(memberIndentation) + "}\n\n";
+            continue;
+        }
+
+        auto const isEntity = isEntityType(*type);
+
+        std::string normalizeFields;
+        std::string denormalizeFields;
+        for (auto const & field : type->fields) {
+            auto const recursion = fieldRecursion(recursions, type->name, field.name);
+            auto const isRecursive = recursion != FieldRecursion::None;
+            auto const isPresenceTrackedField = options.compactLayout && isPresenceTracked(field);
+            auto const fieldDepth = isRecursive ? "depth - 1" : "depth";
+            auto const value = "value." + field.name + (isPresenceTrackedField ? "()" : "");
+            auto const member = "record." + field.name;
+
+            if (field.delivery == IncrementalDelivery::Deferred && field.type.kind == TypeKind::NonNull &&
+                !isRecursive) {
+                // Default constructed until the payload delivering it arrives, so it can't tell whether it has a value
+                normalizeFields += indent(bodyIndentation) + "// " + field.name +
+                                   " is deferred, and left out since its value may not have been delivered\n";
+            } else {
+                // Recursive fields past the recursion depth and deferred fields without a value weren't delivered
+                std::string condition;
+                if (isRecursive) {
+                    condition = "depth > 0";
+                }
+                if (field.delivery == IncrementalDelivery::Deferred) {
+                    condition += (condition.empty() ? "" : " && ") + value;
+                }
+
+                auto const assignment = member + " = normalizedValue(" + value + ", " + fieldDepth + ");\n";
+                if (condition.empty()) {
+                    normalizeFields += indent(bodyIndentation) + assignment;
+                } else {
+                    normalizeFields += indent(bodyIndentation) + "if (" + condition + ") {\n";
+                    normalizeFields += indent(bodyIndentation + 1) + assignment;
+                    normalizeFields += indent(bodyIndentation) + "}\n";
+                }
+            }
+
+            denormalizeFields += indent(bodyIndentation) + "if (" + member + (isRecursive ? " && depth > 0" : "") +
+                                 ") {\n";
+            if (isPresenceTrackedField) {
+                denormalizeFields += indent(bodyIndentation + 1) + "value.set" + capitalize(field.name) +
+                                     "(denormalizedValue<" + cppFieldTypeName(field) + ">(*" + member + ", depth));\n";
+            } else {
+                denormalizeFields += indent(bodyIndentation + 1) + "denormalize(*" + member + ", value." +
+                                     field.name + ", " + fieldDepth + ");\n";
+            }
+            denormalizeFields += indent(bodyIndentation) + "}\n";
+        }
+
+        generated += indent(memberIndentation) + "void normalize(" + type->name + " const & value, " +
+                     normalizedTypeName + " & normalized, size_t depth) {\n";
+        if (isEntity) {
+            generated += indent(bodyIndentation) + "normalized.id = value.id;\n";
+            generated += indent(bodyIndentation) + "// Merged into the fields written before\n";
+            generated += indent(bodyIndentation) + "auto & record = " + entityMapName(*type) + "[value.id];\n";
+            generated += normalizeFields;
+        } else {
+            generated += indent(bodyIndentation) + recordName(*type) + " record;\n";
+            generated += normalizeFields;
+            generated += indent(bodyIndentation) + "normalized = std::make_shared<" + recordName(*type) +
+                         " const>(std::move(record));\n";
+        }
+        generated += indent(memberIndentation) + "}\n\n";
+
+        generated += indent(memberIndentation) + "void denormalize(" + normalizedTypeName + " const & normalized, " +
+                     type->name + " & value, size_t depth) const {\n";
+        if (isEntity) {
+            generated += indent(bodyIndentation) + "auto const & record = " + entityMapName(*type) +
+                         ".at(normalized.id);\n";
+        } else {
+            generated += indent(bodyIndentation) + "auto const & record = *normalized;\n";
+        }
+        generated += denormalizeFields;
+        generated += indent(memberIndentation) + "}\n\n";
+    }
+
+    generated += indent(memberIndentation) + "mutable std::shared_mutex mutex;\n";
+    for (auto const type : entityTypes) {
+        generated += indent(memberIndentation) + "EntityMap<" + type->name + "> " + entityMapName(*type) + ";\n";
+    }
+
+    generated += indent(indentation) + "};\n\n";
+
+    return generated;
+}
+
+std::string generateLazyDecodingSupport(size_t indentation) {
+    return indentBlock(
+            R"(// A node of a shared json document that lazily decoded objects read their fields from.
+struct LazyNode {
+    std::shared_ptr<Json const> document;
+    Json const * json = nullptr;
+};
+
+template <typename T>
+void decodeLazy(LazyNode const & node, T & value) {
+    node.json->get_to(value);
+}
+
+inline void decodeLazy(LazyNode const & node, Json & value) {
+    value = *node.json;
+}
+
+template <typename T>
+void decodeLazy(LazyNode const & node, optional<T> & value) {
+    if (node.json->is_null()) {
+        value.reset();
+    } else {
+        value.emplace();
+        decodeLazy(node, *value);
+    }
+}
+
+template <typename T>
+void decodeLazy(LazyNode const & node, std::vector<T> & values) {
+    values.clear();
+    values.reserve(node.json->size());
+    for (auto const & element : *node.json) {
+        values.emplace_back();
+        decodeLazy(LazyNode{node.document, &element}, values.back());
+    }
+}
+
+// Decodes value from a single shared copy of json, which all of its nested objects, list elements and variants refer
+// to. The json is taken by value so that callers can move it in instead of copying it.
+template <typename T>
+T decodeLazyDocument(Json json) {
+    auto const document = std::make_shared<Json const>(std::move(json));
+    T value{};
+    decodeLazy(LazyNode{document, document.get()}, value);
+    return value;
+}
+
+// Decodes a field on first access and memoizes it in decoded. Memoizing isn't synchronized, so a lazily decoded object
+// must not be read from several threads at once.
+template <typename T>
+T const & decodeLazyField(LazyNode const & node, char const * key, bool isRequired, optional<T> & decoded) {
+    if (!decoded) {
+        T value{};
+        if (isRequired) {
+            decodeLazy(LazyNode{node.document, &node.json->at(key)}, value);
+        } else {
+            auto it = node.json->find(key);
+            if (it != node.json->end()) {
+                decodeLazy(LazyNode{node.document, &*it}, value);
+            }
+        }
+        decoded = std::move(value);
+    }
+    return *decoded;
+}
+
+)",
+            indentation);
+}
+
+std::string generateInternedId(std::string const & generatedNamespace) {
+    std::string generated;
+
+    generated += "namespace " + generatedNamespace + " {\n\n";
+    generated += indentBlock(
+            R"(// An ID interned in a table shared by all threads, so that it is compared and hashed in constant time
+// and repeated ids share one string. Interned strings are reference counted and freed with the last id holding
+// them.
+class Id {
+public:
+    Id() = default;
+    Id(std::string_view value) : entry{intern(value)} {}
+    Id(std::string const & value) : Id(std::string_view(value)) {}
+    Id(char const * value) : Id(std::string_view(value)) {}
+    Id(Id const & other) : entry{other.entry} { retain(entry); }
+    Id(Id && other) noexcept : entry{other.entry} { other.entry = nullptr; }
+    ~Id() { release(entry); }
+
+    Id & operator=(Id other) noexcept {
+        std::swap(entry, other.entry);
+        return *this;
+    }
+
+    std::string const & str() const { return entry ? entry->string : emptyString(); }
+    operator std::string const &() const { return str(); }
+
+    bool operator==(Id const & other) const { return entry == other.entry; }
+    bool operator!=(Id const & other) const { return entry != other.entry; }
+    // Ordered by string so that ordered containers of ids iterate in the same order in every run.
+    bool operator<(Id const & other) const { return entry != other.entry && str() < other.str(); }
+
+    size_t hash() const { return std::hash<void const *>()(entry); }
+
+    // The number of distinct strings held by live ids.
+    static size_t internedCount() {
+        auto & table = Id::table();
+        std::shared_lock<std::shared_mutex> lock{table.mutex};
+        return table.entries.size();
+    }
+
+private:
+    struct Entry {
+        explicit Entry(std::string_view string) : string{string} {}
+
+        std::string const string;
+        std::atomic<size_t> references{1};
+    };
+
+    struct Table {
+        std::shared_mutex mutex;
+        std::unordered_map<std::string_view, std::unique_ptr<Entry>> entries;
+    };
+
+    // Null for the empty string so that default constructed ids need no lookup.
+    Entry * entry = nullptr;
+
+    static std::string const & emptyString() {
+        static std::string const empty;
+        return empty;
+    }
+
+    // Never destroyed so that ids in other static objects can still be released at exit.
+    static Table & table() {
+        static Table & table = *new Table;
+        return table;
+    }
+
+    static Entry * intern(std::string_view value) {
+        if (value.empty()) {
+            return nullptr;
+        }
+
+        auto & table = Id::table();
+        {
+            std::shared_lock<std::shared_mutex> lock{table.mutex};
+            auto it = table.entries.find(value);
+            if (it != table.entries.end()) {
+                it->second->references.fetch_add(1, std::memory_order_relaxed);
+                return it->second.get();
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock{table.mutex};
+        auto it = table.entries.find(value);
+        if (it != table.entries.end()) {
+            it->second->references.fetch_add(1, std::memory_order_relaxed);
+            return it->second.get();
+        }
+        auto entry = std::make_unique<Entry>(value);
+        std::string_view const key = entry->string;
+        return table.entries.emplace(key, std::move(entry)).first->second.get();
+    }
+
+    // The copied id holds a reference, so the entry can't be freed meanwhile.
+    static void retain(Entry * entry) {
+        if (entry) {
+            entry->references.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Drops a reference without locking unless it may be the last one. That is decided under the exclusive lock,
+    // which interning the string again has to wait for, so an entry is never freed while it is being looked up.
+    static void release(Entry * entry) {
+        if (!entry) {
+            return;
+        }
+
+        auto references = entry->references.load(std::memory_order_relaxed);
+        while (references > 1) {
+            if (entry->references.compare_exchange_weak(references, references - 1, std::memory_order_release)) {
+                return;
+            }
+        }
+
+        auto & table = Id::table();
+        std::unique_lock<std::shared_mutex> lock{table.mutex};
+        if (entry->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            table.entries.erase(table.entries.find(entry->string));
+        }
+    }
+};
+
+// Interns the string of the parsed json without copying it first.
+inline void from_json(nlohmann::json const & json, Id & value) {
+    value = Id(json.get_ref<std::string const &>());
+}
+
+inline void to_json(nlohmann::json & json, Id const & value) {
+    json = value.str();
+}
+
+)",
+            1);
+    generated += "} // namespace " + generatedNamespace + "\n\n";
+
+    generated += "namespace std {\n\n";
+    generated += indent(1) + "template <>\n";
+    generated += indent(1) + "struct hash<" + generatedNamespace + "::" + cppIdTypeName + "> {\n";
+    generated += indent(2) + "size_t operator()(" + generatedNamespace + "::" + cppIdTypeName +
+                 " const & id) const { return id.hash(); }\n";
+    generated += indent(1) + "};\n\n";
+    generated += "} // namespace std\n\n";
+
+    return generated;
+}
+
+// A lazy struct named structName with the fields of type, which is an object or an interface whose unknown
+// implementation it is.
+static std::string generateLazyStruct(
+        Type const & type, std::string const & structName, size_t indentation, FieldRecursions const & recursions) {
+    std::string generated;
+
+    generated += generateDescription(type.description, indentation);
+    generated += indent(indentation) + "struct " + structName + " {\n";
+
+    auto const memberIndentation = indentation + 1;
+
+    generated += indent(memberIndentation) + structName + "() = default;\n";
+    generated += indent(memberIndentation) + "explicit " + structName +
+                 "(LazyNode node) : lazyNode{std::move(node)} {}\n\n";
+
+    for (auto const & field : type.fields) {
+        auto const recursion = fieldRecursion(recursions, type.name, field.name);
+        auto const isRequired = isRequiredField(field, recursion) ? "true" : "false";
+        generated += generateDescription(field.description, memberIndentation);
+        // Calls for recursive fields are parenthesized, turning off argument dependent lookup, which would instantiate
+        // the variants of unions in the field's cycle before their possible types are complete.
+        auto const decodeField = recursion != FieldRecursion::None ? "(decodeLazyField)" : "decodeLazyField";
+        generated += indent(memberIndentation) + cppFieldTypeName(field, recursion) + " const & " + field.name +
+                     "() const { return " + decodeField + "(lazyNode, \"" + field.name + "\", " + isRequired +
+                     ", decoded." + field.name + "); }\n";
+    }
+
+    if (!type.fields.empty()) {
+        generated += "\n";
+    }
+
+    generated += indent(indentation) + "private:\n";
+    generated += indent(memberIndentation) + "LazyNode lazyNode;\n";
+    generated += indent(memberIndentation) + "mutable struct {\n";
+
+    for (auto const & field : type.fields) {
+        generated += indent(memberIndentation + 1) + "optional<" +
+                     cppFieldTypeName(field, fieldRecursion(recursions, type.name, field.name)) + "> " + field.name +
+                     ";\n";
+    }
+
+    generated += indent(memberIndentation) + "} decoded;\n";
+    generated += indent(indentation) + "};\n\n";
+
+    return generated;
+}
+
+std::string generateLazyObject(Type const & type, size_t indentation, FieldRecursions const & recursions) {
+    return generateLazyStruct(type, type.name, indentation, recursions);
+}
+
+static GeneratedFunction generateLazyDocumentDeserialization(std::string const & typeName, size_t indentation) {
+    // Copies the json, so decoding a whole list or response through decodeLazyDocument shares a single copy instead
+    // of one per object.
+    auto function = deserializationFunction(typeName, indentation);
+    function.body += indent(indentation + 1) + "value = decodeLazyDocument<" + typeName + ">(json);\n";
+    return function;
+}
+
+static GeneratedFunction lazyDecodingFunction(std::string const & typeName, size_t indentation) {
+    return inlineFunction("void", "decodeLazy(LazyNode const & node, " + typeName + " & value)", indentation);
+}
+
+GeneratedCode generateLazyObjectDeserialization(Type const & type, size_t indentation) {
+    GeneratedCode generated;
+
+    auto decodeLazy = lazyDecodingFunction(type.name, indentation);
+    decodeLazy.body += indent(indentation + 1) + "value = " + type.name + "(node);\n";
+    generated += decodeLazy;
+
+    generated += generateLazyDocumentDeserialization(type.name, indentation);
+
+    return generated;
+}
+
+static Type unknownInterfaceImplementation(Type const & type) {
+    Type unknownImplementation;
+    unknownImplementation.kind = TypeKind::Object;
+    unknownImplementation.name = unknownCaseName + type.name;
+    unknownImplementation.fields = type.fields;
+    return unknownImplementation;
+}
+
+std::string generateLazyInterface(Type const & type, size_t indentation, FieldRecursions const & recursions) {
+    std::string generated;
+
+    auto unknownImplementation = type;
+    unknownImplementation.description.reset();
+    generated += generateLazyStruct(unknownImplementation, unknownCaseName + type.name, indentation, recursions);
+
+    generated += generateDescription(type.description, indentation);
+    generated += indent(indentation) + "struct " + type.name + " {\n";
+
+    auto const fieldIndentation = indentation + 1;
+
+    generated += indent(fieldIndentation) + cppVariant(type.possibleTypes, unknownCaseName + type.name) +
+                 " implementation;\n\n";
+
+    for (auto const & field : type.fields) {
+        auto const typeNameConstRef =
+                cppFieldTypeName(field, fieldRecursion(recursions, type.name, field.name)) + " const & ";
+        generated += generateDescription(field.description, fieldIndentation);
+        generated += indent(fieldIndentation) + typeNameConstRef + field.name + "() const {\n";
+        generated += indent(fieldIndentation + 1) + "return visit([](auto const & implementation) -> " +
+                     typeNameConstRef + "{\n";
+        generated += indent(fieldIndentation + 2) + "return implementation." + field.name + "();\n";
+        generated += indent(fieldIndentation + 1) + "}, implementation);\n";
+        generated += indent(fieldIndentation) + "}\n\n";
+    }
+
+    generated += indent(indentation) + "};\n\n";
+
+    return generated;
+}
+
+static GeneratedCode generateLazyVariantDeserialization(
+        Type const & type, std::string const & constructUnknown, size_t indentation) {
+    GeneratedCode generated;
+
+    auto decodeLazy = lazyDecodingFunction(type.name, indentation);
+
+    decodeLazy.body += indent(indentation + 1) + "std::string occupiedType = node.json->at(\"__typename\");\n";
+    decodeLazy.body += indent(indentation + 1);
+
+    for (auto const & possibleType : type.possibleTypes) {
+        decodeLazy.body += "if (occupiedType == \"" + possibleType.name.value() + "\") {\n";
+        decodeLazy.body += indent(indentation + 2) + "value = {" + possibleType.name.value() + "(node)};\n";
+        decodeLazy.body += indent(indentation + 1) + "} else ";
+    }
+
+    decodeLazy.body += "{\n";
+    decodeLazy.body += indent(indentation + 2) + "value = {" + constructUnknown + "};\n";
+    decodeLazy.body += indent(indentation + 1) + "}\n";
+    generated += decodeLazy;
+
+    generated += generateLazyDocumentDeserialization(type.name, indentation);
+
+    return generated;
+}
+
+GeneratedCode generateLazyInterfaceDeserialization(Type const & type, size_t indentation) {
+    return generateLazyObjectDeserialization(unknownInterfaceImplementation(type), indentation) +
+           generateLazyVariantDeserialization(type, unknownCaseName + type.name + "(node)", indentation);
+}
+
+GeneratedCode generateLazyUnionDeserialization(Type const & type, size_t indentation) {
+    return generateLazyVariantDeserialization(type, unknownCaseName + type.name + "()", indentation);
+}
+
+std::string generateOnDemandDecodingSupport(GenerationOptions const & options, size_t indentation) {
+    std::string generated = indentBlock(
+            R"(// Decoding with simdjson's on demand parser, which reads values straight out of the response text into
+// default constructed values.
+template <typename T>
+void decodeOnDemand(simdjson::ondemand::value json, T & value);
+
+template <typename T>
+void decodeOnDemand(simdjson::ondemand::value json, optional<T> & value);
+
+template <typename T>
+void decodeOnDemand(simdjson::ondemand::value json, std::vector<T> & values);
+
+inline void decodeOnDemand(simdjson::ondemand::value json, std::string & value) {
+    value = std::string_view(json.get_string());
+}
+
+inline void decodeOnDemand(simdjson::ondemand::value json, int32_t & value) {
+    value = static_cast<int32_t>(int64_t(json.get_int64()));
+}
+
+inline void decodeOnDemand(simdjson::ondemand::value json, int64_t & value) {
+    value = json.get_int64();
+}
+
+inline void decodeOnDemand(simdjson::ondemand::value json, double & value) {
+    value = json.get_double();
+}
+
+inline void decodeOnDemand(simdjson::ondemand::value json, bool & value) {
+    value = json.get_bool();
+}
+
+inline void decodeOnDemand(simdjson::ondemand::value json, Json & value) {
+    value = Json::parse(std::string_view(json.raw_json()));
+}
+
+)",
+            indentation);
+
+    if (options.internedIds) {
+        generated += indentBlock(
+                R"(inline void decodeOnDemand(simdjson::ondemand::value json, Id & value) {
+    value = Id(std::string_view(json.get_string()));
+}
+
+)",
+                indentation);
+    }
+
+    generated += indentBlock(
+            R"(// Values without an overload of their own, like custom scalars and errors, are parsed from their text.
+template <typename T>
+void decodeOnDemand(simdjson::ondemand::value json, T & value) {
+    Json::parse(std::string_view(json.raw_json())).get_to(value);
+}
+
+template <typename T>
+void decodeOnDemand(simdjson::ondemand::value json, optional<T> & value) {
+    if (json.is_null()) {
+        value.reset();
+    } else {
+        value.emplace();
+        decodeOnDemand(json, *value);
+    }
+}
+
+template <typename T>
+void decodeOnDemand(simdjson::ondemand::value json, std::vector<T> & values) {
+    values.clear();
+    for (simdjson::ondemand::value element : json.get_array()) {
+        if constexpr (std::is_same_v<T, bool>) {
+            values.push_back(element.get_bool());
+        } else {
+            values.emplace_back();
+            decodeOnDemand(element, values.back());
+        }
+    }
+}
+
+// Decodes the field of a response's data named fieldName, or its errors, from text.
+template <typename Data>
+GraphqlResponse<Data> parseOnDemandResponse(std::string_view text, std::string_view fieldName, bool isRequired) {
+    // Reused so that its buffers are only allocated again for larger responses
+    thread_local simdjson::ondemand::parser parser;
+    simdjson::padded_string const padded(text);
+    simdjson::ondemand::document document = parser.iterate(padded);
+
+    Data data{};
+    bool hasDataObject = false;
+    bool hasData = false;
+    for (simdjson::ondemand::field field : document.get_object()) {
+        auto const key = field.escaped_key();
+        if (key == "errors") {
+            std::vector<GraphqlError> errors;
+            decodeOnDemand(field.value(), errors);
+            return errors;
+        } else if (key == "data") {
+            // Data is null when errors, which may come after it, prevented the whole operation.
+            if (field.value().is_null()) {
+                continue;
+            }
+            hasDataObject = true;
+            for (simdjson::ondemand::field dataField : field.value().get_object()) {
+                if (dataField.escaped_key() == fieldName) {
+                    decodeOnDemand(dataField.value(), data);
+                    hasData = true;
+                }
+            }
+        }
+    }
+
+    if (!hasDataObject || (isRequired && !hasData)) {
+        throw std::out_of_range("Response has no data for " + std::string(fieldName));
+    }
+    return data;
+}
+
+)",
+            indentation);
+
+    return generated;
+}
+
+static GeneratedFunction onDemandDecodingFunction(std::string const & typeName, size_t indentation) {
+    return inlineFunction(
+            "void", "decodeOnDemand(simdjson::ondemand::value json, " + typeName + " & value)", indentation);
+}
+
+GeneratedCode generateOnDemandEnumDecoding(Type const & type, size_t indentation) {
+    auto function = onDemandDecodingFunction(type.name, indentation);
+
+    function.body += indent(indentation + 1) + "auto const string = std::string_view(json.get_string());\n";
+    function.body += indent(indentation + 1);
+
+    for (auto const & value : type.enumValues) {
+        function.body += "if (string == \"" + value.name + "\") {\n";
+        function.body += indent(indentation + 2) + "value = " + type.name + "::" +
+                         screamingSnakeCaseToPascalCase(value.name) + ";\n";
+        function.body += indent(indentation + 1) + "} else ";
+    }
+
+    function.body += "{\n";
+    function.body += indent(indentation + 2) + "value = " + type.name + "::" + unknownCaseName + ";\n";
+    function.body += indent(indentation + 1) + "}\n";
+
+    return function;
+}
+
+// decodeOnDemandFields, decoding the fields of type into typeName, an object that has already been read as one.
+static GeneratedFunction generateOnDemandFieldsDecoding(std::string const & typeName,
+                                                        Type const & type,
+                                                        bool isCompact,
+                                                        size_t indentation,
+                                                        FieldRecursions const & recursions) {
+    auto const & fields = type.fields;
+    auto const isRequired = [&](Field const & field) {
+        return isRequiredField(field, fieldRecursion(recursions, type.name, field.name));
+    };
+
+    size_t requiredFieldCount = 0;
+    for (auto const & field : fields) {
+        requiredFieldCount += isRequired(field);
+    }
+
+    auto function = inlineFunction(
+            "void", "decodeOnDemandFields(simdjson::ondemand::object json, " + typeName + " & value)", indentation);
+    auto & body = function.body;
+
+    if (requiredFieldCount > 0) {
+        body += indent(indentation + 1) + "size_t requiredFieldCount = 0;\n";
+    }
+    body += indent(indentation + 1) + "for (simdjson::ondemand::field field : json) {\n";
+    body += indent(indentation + 2) + "auto const key = field.escaped_key();\n";
+    body += indent(indentation + 2);
+
+    for (auto const & field : fields) {
+        body += "if (key == \"" + field.name + "\") {\n";
+        if (isCompact && isPresenceTracked(field)) {
+            body += indent(indentation + 3) + cppTypeName(field.type) + " decoded;\n";
+            body += indent(indentation + 3) + "decodeOnDemand(field.value(), decoded);\n";
+            body += indent(indentation + 3) + "value.set" + capitalize(field.name) + "(decoded);\n";
+        } else {
+            body += indent(indentation + 3) + "decodeOnDemand(field.value(), value." + field.name + ");\n";
+        }
+        if (isRequired(field)) {
+            body += indent(indentation + 3) + "++requiredFieldCount;\n";
+        }
+        body += indent(indentation + 2) + "} else ";
+    }
+
+    // Other fields, like __typename, are skipped.
+    body.resize(body.size() - std::string{" else "}.size());
+    body += "\n";
+    body += indent(indentation + 1) + "}\n";
+
+    if (requiredFieldCount > 0) {
+        body += indent(indentation + 1) + "if (requiredFieldCount < " + std::to_string(requiredFieldCount) + ") {\n";
+        body += indent(indentation + 2) + "throw std::out_of_range(\"" + typeName +
+                " is missing a required field\");\n";
+        body += indent(indentation + 1) + "}\n";
+    }
+
+    return function;
+}
+
+GeneratedCode generateOnDemandObjectDecoding(
+        Type const & type, bool isCompact, size_t indentation, FieldRecursions const & recursions) {
+    GeneratedCode generated = generateOnDemandFieldsDecoding(type.name, type, isCompact, indentation, recursions);
+
+    auto function = onDemandDecodingFunction(type.name, indentation);
+    function.body += indent(indentation + 1) + "decodeOnDemandFields(json.get_object(), value);\n";
+    generated += function;
+
+    return generated;
+}
+
+static GeneratedFunction generateOnDemandVariantDecoding(
+        Type const & type, bool decodesUnknownCase, size_t indentation) {
+    auto function = onDemandDecodingFunction(type.name, indentation);
+    auto & body = function.body;
+
+    body += indent(indentation + 1) + "simdjson::ondemand::object object = json.get_object();\n";
+    body += indent(indentation + 1) +
+            "std::string_view const occupiedType = object.find_field_unordered(\"__typename\").get_string();\n";
+    body += indent(indentation + 1) + "object.reset();\n";
+    body += indent(indentation + 1);
+
+    auto decodeImplementation = [&](std::string const & typeName) {
+        body += indent(indentation + 2) + typeName + " implementation{};\n";
+        body += indent(indentation + 2) + "decodeOnDemandFields(object, implementation);\n";
+        body += indent(indentation + 2) + "value = {std::move(implementation)};\n";
+    };
+
+    for (auto const & possibleType : type.possibleTypes) {
+        body += "if (occupiedType == \"" + possibleType.name.value() + "\") {\n";
+        decodeImplementation(possibleType.name.value());
+        body += indent(indentation + 1) + "} else ";
+    }
+
+    body += "{\n";
+    if (decodesUnknownCase) {
+        decodeImplementation(unknownCaseName + type.name);
+    } else {
+        body += indent(indentation + 2) + "value = {" + unknownCaseName + type.name + "()};\n";
+    }
+    body += indent(indentation + 1) + "}\n";
+
+    return function;
+}
+
+GeneratedCode generateOnDemandInterfaceDecoding(
+        Type const & type, size_t indentation, FieldRecursions const & recursions) {
+    GeneratedCode generated =
+            generateOnDemandFieldsDecoding(unknownCaseName + type.name, type, false, indentation, recursions);
+    generated += generateOnDemandVariantDecoding(type, true, indentation);
+    return generated;
+}
+
+GeneratedCode generateOnDemandUnionDecoding(Type const & type, size_t indentation) {
+    return generateOnDemandVariantDecoding(type, false, indentation);
+}
+
+std::string generateCheckedDecodingSupport(GenerationOptions const & options, size_t indentation) {
+    std::string generated = indentBlock(
+            R"(// Decoding that reports malformed responses as a DecodeError instead of throwing.
+enum class DecodeErrorCode {
+    // The response isn't json
+    InvalidJson,
+    // A required field, or the data of a response, is missing
+    MissingField,
+    // A value isn't of the type that the schema declares
+    TypeMismatch,
+};
+
+struct DecodeError {
+    DecodeErrorCode code = DecodeErrorCode::InvalidJson;
+    // Path of the value that failed to decode, like data.user.friends[3].name
+    std::string path;
+};
+
+template <typename T>
+using DecodeResult = variant<T, DecodeError>;
+
+// A step of the path to a value being decoded, only rendered when decoding fails.
+struct DecodePath {
+    DecodePath const * parent = nullptr;
+    // Null for list elements
+    char const * key = nullptr;
+    size_t index = 0;
+
+    DecodePath field(char const * fieldKey) const {
+        return {this, fieldKey, 0};
+    }
+
+    DecodePath element(size_t elementIndex) const {
+        return {this, nullptr, elementIndex};
+    }
+
+    std::string str() const {
+        std::string rendered = parent ? parent->str() : "";
+        if (key) {
+            rendered += rendered.empty() ? key : "." + std::string(key);
+        } else {
+            rendered += "[" + std::to_string(index) + "]";
+        }
+        return rendered;
+    }
+};
+
+inline bool decodeFailure(DecodePath const & path, DecodeErrorCode code, DecodeError & error) {
+    error = {code, path.str()};
+    return false;
+}
+
+template <typename T>
+bool tryDecode(Json const & json, T & value, DecodePath const & path, DecodeError & error);
+
+template <typename T>
+bool tryDecode(Json const & json, optional<T> & value, DecodePath const & path, DecodeError & error);
+
+template <typename T>
+bool tryDecode(Json const & json, std::vector<T> & values, DecodePath const & path, DecodeError & error);
+
+// Decodes the field of an object named key, which is only an error to be missing if it is required.
+template <typename T>
+bool tryDecodeField(
+        Json const & json, char const * key, bool isRequired, T & value, DecodePath const & path, DecodeError & error);
+
+inline bool tryDecode(Json const & json, std::string & value, DecodePath const & path, DecodeError & error) {
+    if (!json.is_string()) {
+        return decodeFailure(path, DecodeErrorCode::TypeMismatch, error);
+    }
+    value = json.get_ref<std::string const &>();
+    return true;
+}
+
+inline bool tryDecode(Json const & json, int32_t & value, DecodePath const & path, DecodeError & error) {
+    if (!json.is_number_integer()) {
+        return decodeFailure(path, DecodeErrorCode::TypeMismatch, error);
+    }
+    value = json.get<int32_t>();
+    return true;
+}
+
+inline bool tryDecode(Json const & json, int64_t & value, DecodePath const & path, DecodeError & error) {
+    if (!json.is_number_integer()) {
+        return decodeFailure(path, DecodeErrorCode::TypeMismatch, error);
+    }
+    value = json.get<int64_t>();
+    return true;
+}
+
+inline bool tryDecode(Json const & json, double & value, DecodePath const & path, DecodeError & error) {
+    if (!json.is_number()) {
+        return decodeFailure(path, DecodeErrorCode::TypeMismatch, error);
+    }
+    value = json.get<double>();
+    return true;
+}
+
+inline bool tryDecode(Json const & json, bool & value, DecodePath const & path, DecodeError & error) {
+    if (!json.is_boolean()) {
+        return decodeFailure(path, DecodeErrorCode::TypeMismatch, error);
+    }
+    value = json.get<bool>();
+    return true;
+}
+
+inline bool tryDecode(Json const & json, Json & value, DecodePath const &, DecodeError &) {
+    value = json;
+    return true;
+}
+
+)",
+            indentation);
+
+    if (options.internedIds) {
+        generated += indentBlock(
+                R"(inline bool tryDecode(Json const & json, Id & value, DecodePath const & path, DecodeError & error) {
+    if (!json.is_string()) {
+        return decodeFailure(path, DecodeErrorCode::TypeMismatch, error);
+    }
+    value = Id(json.get_ref<std::string const &>());
+    return true;
+}
+
+)",
+                indentation);
+    }
+
+    generated += indentBlock(
+            R"(inline bool tryDecode(
+        Json const & json, GraphqlError & value, DecodePath const & path, DecodeError & error) {
+    if (!json.is_object()) {
+        return decodeFailure(path, DecodeErrorCode::TypeMismatch, error);
+    }
+    return tryDecodeField(json, "message", true, value.message, path, error);
+}
+
+// Values without an overload of their own, like custom scalars, are decoded with their from_json.
+template <typename T>
+bool tryDecode(Json const & json, T & value, DecodePath const &, DecodeError &) {
+    json.get_to(value);
+    return true;
+}
+
+template <typename T>
+bool tryDecode(Json const & json, optional<T> & value, DecodePath const & path, DecodeError & error) {
+    if (json.is_null()) {
+        value.reset();
+        return true;
+    }
+    value.emplace();
+    return tryDecode(json, *value, path, error);
+}
+
+template <typename T>
+bool tryDecode(Json const & json, std::vector<T> & values, DecodePath const & path, DecodeError & error) {
+    if (!json.is_array()) {
+        return decodeFailure(path, DecodeErrorCode::TypeMismatch, error);
+    }
+    values.clear();
+    values.reserve(json.size());
+    size_t index = 0;
+    for (auto const & element : json) {
+        if constexpr (std::is_same_v<T, bool>) {
+            bool decoded = false;
+            if (!tryDecode(element, decoded, path.element(index), error)) {
+                return false;
+            }
+            values.push_back(decoded);
+        } else {
+            values.emplace_back();
+            if (!tryDecode(element, values.back(), path.element(index), error)) {
+                return false;
+            }
+        }
+        ++index;
+    }
+    return true;
+}
+
+template <typename T>
+bool tryDecodeField(
+        Json const & json, char const * key, bool isRequired, T & value, DecodePath const & path, DecodeError & error) {
+    auto it = json.find(key);
+    if (it == json.end()) {
+        return !isRequired || decodeFailure(path.field(key), DecodeErrorCode::MissingField, error);
+    }
+    return tryDecode(*it, value, path.field(key), error);
+}
+
+// Decodes the field of a response's data named fieldName, or its errors.
+template <typename Data>
+DecodeResult<GraphqlResponse<Data>> tryDecodeResponse(Json const & json, char const * fieldName, bool isRequired) {
+    DecodeError error;
+    if (!json.is_object()) {
+        return DecodeError{DecodeErrorCode::TypeMismatch, ""};
+    }
+
+    auto errors = json.find("errors");
+    if (errors != json.end()) {
+        std::vector<GraphqlError> errorsList;
+        if (!tryDecode(*errors, errorsList, DecodePath{nullptr, "errors"}, error)) {
+            return error;
+        }
+        return GraphqlResponse<Data>{std::move(errorsList)};
+    }
+
+    DecodePath const dataPath{nullptr, "data"};
+    auto data = json.find("data");
+    if (data == json.end() || data->is_null()) {
+        return DecodeError{DecodeErrorCode::MissingField, dataPath.str()};
+    }
+    if (!data->is_object()) {
+        return DecodeError{DecodeErrorCode::TypeMismatch, dataPath.str()};
+    }
+
+    Data value{};
+    if (!tryDecodeField(*data, fieldName, isRequired, value, dataPath, error)) {
+        return error;
+    }
+    return GraphqlResponse<Data>{std::move(value)};
+}
+
+)",
+            indentation);
+
+    return generated;
+}
+
+static GeneratedFunction checkedDecodingFunction(
+        std::string const & functionName, std::string const & typeName, size_t indentation) {
+    return inlineFunction("bool",
+                          functionName + "(" + cppJsonTypeName + " const & json, " + typeName +
+                                  " & value, DecodePath const & path, DecodeError & error)",
+                          indentation);
+}
+
+static std::string generateCheckedObjectCheck(size_t indentation) {
+    std::string generated;
+    generated += indent(indentation) + "if (!json.is_object()) {\n";
+    generated += indent(indentation + 1) + "return decodeFailure(path, DecodeErrorCode::TypeMismatch, error);\n";
+    generated += indent(indentation) + "}\n";
+    return generated;
+}
+
+GeneratedCode generateCheckedEnumDecoding(Type const & type, size_t indentation) {
+    auto function = checkedDecodingFunction("tryDecode", type.name, indentation);
+    auto & body = function.body;
+
+    body += indent(indentation + 1) + "if (!json.is_string()) {\n";
+    body += indent(indentation + 2) + "return decodeFailure(path, DecodeErrorCode::TypeMismatch, error);\n";
+    body += indent(indentation + 1) + "}\n";
+    body += indent(indentation + 1) + "auto const & string = json.get_ref<std::string const &>();\n";
+    body += indent(indentation + 1);
+
+    for (auto const & value : type.enumValues) {
+        body += "if (string == \"" + value.name + "\") {\n";
+        body += indent(indentation + 2) + "value = " + type.name + "::" + screamingSnakeCaseToPascalCase(value.name) +
+                ";\n";
+        body += indent(indentation + 1) + "} else ";
+    }
+
+    body += "{\n";
+    body += indent(indentation + 2) + "value = " + type.name + "::" + unknownCaseName + ";\n";
+    body += indent(indentation + 1) + "}\n";
+    body += indent(indentation + 1) + "return true;\n";
+
+    return function;
+}
+
+static GeneratedFunction generateCheckedFieldsDecoding(std::string const & typeName,
+                                                       Type const & type,
+                                                       bool isCompact,
+                                                       size_t indentation,
+                                                       FieldRecursions const & recursions) {
+    auto function = checkedDecodingFunction("tryDecodeFields", typeName, indentation);
+    auto & body = function.body;
+
+    for (auto const & field : type.fields) {
+        auto const recursion = fieldRecursion(recursions, type.name, field.name);
+        auto const isRequired = isRequiredField(field, recursion) ? "true" : "false";
+        auto const decodeField = [&](std::string const & target, size_t fieldIndentation) {
+            std::string decoding;
+            decoding += indent(fieldIndentation) + "if (!tryDecodeField(json, \"" + field.name + "\", " + isRequired +
+                        ", " + target + ", path, error)) {\n";
+            decoding += indent(fieldIndentation + 1) + "return false;\n";
+            decoding += indent(fieldIndentation) + "}\n";
+            return decoding;
+        };
+
+        if (isCompact && isPresenceTracked(field)) {
+            body += indent(indentation + 1) + "{\n";
+            body += indent(indentation + 2) + cppTypeName(field.type) + " decoded;\n";
+            body += decodeField("decoded", indentation + 2);
+            body += indent(indentation + 2) + "value.set" + capitalize(field.name) + "(decoded);\n";
+            body += indent(indentation + 1) + "}\n";
+        } else {
+            body += decodeField("value." + field.name, indentation + 1);
+        }
+    }
+
+    body += indent(indentation + 1) + "return true;\n";
+
+    return function;
+}
+
+GeneratedCode generateCheckedObjectDecoding(
+        Type const & type, bool isCompact, size_t indentation, FieldRecursions const & recursions) {
+    GeneratedCode generated = generateCheckedFieldsDecoding(type.name, type, isCompact, indentation, recursions);
+
+    auto function = checkedDecodingFunction("tryDecode", type.name, indentation);
+    function.body += generateCheckedObjectCheck(indentation + 1);
+    function.body += indent(indentation + 1) + "return tryDecodeFields(json, value, path, error);\n";
+    generated += function;
+
+    return generated;
+}
+
+static GeneratedFunction generateCheckedVariantDecoding(
+        Type const & type, bool decodesUnknownCase, size_t indentation) {
+    auto function = checkedDecodingFunction("tryDecode", type.name, indentation);
+    auto & body = function.body;
+
+    body += generateCheckedObjectCheck(indentation + 1);
+    body += indent(indentation + 1) + "std::string occupiedType;\n";
+    body += indent(indentation + 1) + "if (!tryDecodeField(json, \"__typename\", true, occupiedType, path, error)) {\n";
+    body += indent(indentation + 2) + "return false;\n";
+    body += indent(indentation + 1) + "}\n";
+    body += indent(indentation + 1);
+
+    auto decodeImplementation = [&](std::string const & typeName) {
+        body += indent(indentation + 2) + typeName + " implementation{};\n";
+        body += indent(indentation + 2) + "if (!tryDecodeFields(json, implementation, path, error)) {\n";
+        body += indent(indentation + 3) + "return false;\n";
+        body += indent(indentation + 2) + "}\n";
+        body += indent(indentation + 2) + "value = {std::move(implementation)};\n";
+    };
+
+    for (auto const & possibleType : type.possibleTypes) {
+        body += "if (occupiedType == \"" + possibleType.name.value() + "\") {\n";
+        decodeImplementation(possibleType.name.value());
+        body += indent(indentation + 1) + "} else ";
+    }
+
+    body += "{\n";
+    if (decodesUnknownCase) {
+        decodeImplementation(unknownCaseName + type.name);
+    } else {
+        body += indent(indentation + 2) + "value = {" + unknownCaseName + type.name + "()};\n";
+    }
+    body += indent(indentation + 1) + "}\n";
+    body += indent(indentation + 1) + "return true;\n";
+
+    return function;
+}
+
+GeneratedCode generateCheckedInterfaceDecoding(
+        Type const & type, size_t indentation, FieldRecursions const & recursions) {
+    GeneratedCode generated =
+            generateCheckedFieldsDecoding(unknownCaseName + type.name, type, false, indentation, recursions);
+    generated += generateCheckedVariantDecoding(type, true, indentation);
+    return generated;
+}
+
+GeneratedCode generateCheckedUnionDecoding(Type const & type, size_t indentation) {
+    return generateCheckedVariantDecoding(type, false, indentation);
+}
+
+std::string generateTableDecodingSupport(size_t indentation) {
+    return indentBlock(
+            R"(// Table driven decoding, where decodeFields decodes every object from a table of its fields.
+enum class FieldKind : uint8_t {
+    String,
+    Id,
+    Int,
+    Float,
+    Boolean,
+    // Any other type, decoded by the descriptor's decode function
+    Value,
+};
+
+struct FieldDescriptor {
+    char const * name;
+    // Of the field's member in its object
+    size_t offset;
+    FieldKind kind;
+    // Whether the member is optional, so that null or missing values reset it
+    bool isNullable;
+    // Whether decoding fails without the field. Fields that are neither nullable nor required keep their value when
+    // they are missing.
+    bool isRequired;
+    // Decodes the member of Value fields, null for the others
+    void (*decode)(Json const & json, void * member);
+};
+
+template <typename T>
+void decodeFieldValue(Json const & json, void * member) {
+    // Unmapped custom scalars are json, which get_to can't decode into.
+    if constexpr (std::is_same_v<T, Json>) {
+        *static_cast<T *>(member) = json;
+    } else {
+        json.get_to(*static_cast<T *>(member));
+    }
+}
+
+template <typename T>
+void decodeScalarField(Json const & json, void * member, bool isNullable) {
+    if (isNullable) {
+        decodeFieldValue<optional<T>>(json, member);
+    } else {
+        json.get_to(*static_cast<T *>(member));
+    }
+}
+
+inline void decodeFields(Json const & json, void * object, FieldDescriptor const * fields, size_t count) {
+    static Json const null;
+    for (auto field = fields; field != fields + count; ++field) {
+        auto const found = json.find(field->name);
+        if (found == json.end() && !field->isNullable && !field->isRequired) {
+            continue;
+        }
+        // Missing nullable fields are reset like null ones, and json.at throws for missing required ones
+        auto const & value = found != json.end() ? *found : field->isNullable ? null : json.at(field->name);
+        auto const member = static_cast<char *>(object) + field->offset;
+        switch (field->kind) {
+        case FieldKind::String:
+            decodeScalarField<std::string>(value, member, field->isNullable);
+            break;
+        case FieldKind::Id:
+            decodeScalarField<Id>(value, member, field->isNullable);
+            break;
+        case FieldKind::Int:
+            decodeScalarField<int32_t>(value, member, field->isNullable);
+            break;
+        case FieldKind::Float:
+            decodeScalarField<double>(value, member, field->isNullable);
+            break;
+        case FieldKind::Boolean:
+            decodeScalarField<bool>(value, member, field->isNullable);
+            break;
+        case FieldKind::Value:
+            field->decode(value, member);
+            break;
+        }
+    }
+}
+
+)",
+            indentation);
+}
+
+// The FieldKind that decodeFields decodes field as.
+static std::string tableFieldKind(Field const & field) {
+    auto const & type = field.type.kind == TypeKind::NonNull ? *field.type.ofType : field.type;
+    if (type.kind != TypeKind::Scalar || !isBuiltinScalar(type.name.value())) {
+        return "Value";
+    }
+
+    switch (scalarType(type.name.value())) {
+    case Scalar::Int:
+        return "Int";
+    case Scalar::Float:
+        return "Float";
+    case Scalar::String:
+        return "String";
+    case Scalar::Boolean:
+        return "Boolean";
+    case Scalar::ID:
+        return "Id";
+    }
+
+    throw std::invalid_argument{"Invalid Scalar value: " + type.name.value()};
+}
+
+GeneratedCode generateTableDeserialization(
+        std::string const & typeName, Type const & type, size_t indentation, FieldRecursions const & recursions) {
+    auto const & fields = type.fields;
+
+    auto function = deserializationFunction(typeName, indentation);
+    auto & body = function.body;
+
+    if (!fields.empty()) {
+        body += indent(indentation + 1) + "static constexpr FieldDescriptor fields[] = {\n";
+        for (auto const & field : fields) {
+            auto const recursion = fieldRecursion(recursions, type.name, field.name);
+            auto const kind = tableFieldKind(field);
+            auto const decode =
+                    kind == "Value" ? "decodeFieldValue<" + cppFieldTypeName(field, recursion) + ">" : "nullptr";
+            auto const isNullable = field.type.kind != TypeKind::NonNull || recursion != FieldRecursion::None;
+            body += indent(indentation + 2) + "{\"" + field.name + "\", offsetof(" + typeName + ", " + field.name +
+                    "), FieldKind::" + kind + ", " + (isNullable ? "true" : "false") + ", " +
+                    (isRequiredField(field, recursion) ? "true" : "false") + ", " + decode + "},\n";
+        }
+        body += indent(indentation + 1) + "};\n";
+        body += indent(indentation + 1) + "decodeFields(json, &value, fields, " + std::to_string(fields.size()) +
+                ");\n";
+    }
+
+    return function;
+}
+
+std::string generateIncrementalDeliverySupport(size_t indentation) {
+    return indentBlock(
+            R"(// Incremental delivery, where each subsequent payload of a response has entries carrying the data of a
+// deferred fragment, which is merged into the object at the entry's path, or the items of a streamed list, which are
+// inserted at the index that the entry's path ends with.
+struct IncrementalPayload {
+    // Whether more payloads follow
+    bool hasNext = false;
+    std::vector<GraphqlError> errors;
+};
+
+inline std::out_of_range incrementalPathError(Json const & path) {
+    return std::out_of_range("Incremental payload path " + path.dump() + " doesn't lead to deferred or streamed data");
+}
+
+template <typename T>
+void applyIncremental(Json const & entry, Json const & path, size_t depth, T & value);
+
+template <typename T>
+void applyIncremental(Json const & entry, Json const & path, size_t depth, optional<T> & value);
+
+template <typename T>
+void applyIncremental(Json const & entry, Json const & path, size_t depth, std::vector<T> & values);
+
+// Fields of unknown union members aren't selected, so they have nothing to apply.
+inline void applyIncremental(Json const &, Json const &, size_t, monostate &) {}
+
+template <typename T>
+void applyIncremental(Json const &, Json const & path, size_t, T &) {
+    throw incrementalPathError(path);
+}
+
+template <typename T>
+void applyIncremental(Json const & entry, Json const & path, size_t depth, optional<T> & value) {
+    if (!value) {
+        value.emplace();
+    }
+    applyIncremental(entry, path, depth, *value);
+}
+
+template <typename T>
+void applyIncremental(Json const & entry, Json const & path, size_t depth, std::vector<T> & values) {
+    auto const index = path.at(depth).get<size_t>();
+    auto const items = entry.find("items");
+    if (depth + 1 == path.size() && items != entry.end()) {
+        // Items continue the list, so they can't start past its end
+        if (index > values.size()) {
+            throw incrementalPathError(path);
+        }
+        values.resize(std::max(values.size(), index + items->size()));
+        for (size_t offset = 0; offset < items->size(); ++offset) {
+            values[index + offset] = (*items)[offset].template get<T>();
+        }
+        return;
+    }
+    if constexpr (std::is_same_v<T, bool>) {
+        throw incrementalPathError(path);
+    } else {
+        applyIncremental(entry, path, depth + 1, values.at(index));
+    }
+}
+
+// Applies the entries of a subsequent payload whose path starts with the operation's field, fieldName, to its data.
+template <typename Data>
+IncrementalPayload applyIncrementalPayload(Json const & payload, char const * fieldName, Data & data) {
+    IncrementalPayload applied;
+    applied.hasNext = payload.value("hasNext", false);
+
+    auto addErrors = [&](Json const & json) {
+        auto errors = json.find("errors");
+        if (errors != json.end()) {
+            for (auto const & error : *errors) {
+                applied.errors.push_back(error.get<GraphqlError>());
+            }
+        }
+    };
+
+    addErrors(payload);
+    auto incremental = payload.find("incremental");
+    if (incremental == payload.end()) {
+        return applied;
+    }
+
+    for (auto const & entry : *incremental) {
+        addErrors(entry);
+        auto const fragmentData = entry.find("data");
+        auto const items = entry.find("items");
+        // Errors prevented the fragment or items from being delivered
+        if ((fragmentData == entry.end() || fragmentData->is_null()) && (items == entry.end() || items->is_null())) {
+            continue;
+        }
+        auto const & path = entry.at("path");
+        if (path.empty() || path.front() != fieldName) {
+            throw std::out_of_range("Incremental payload path " + path.dump() + " is outside of " + fieldName);
+        }
+        applyIncremental(entry, path, 1, data);
+    }
+
+    return applied;
+}
+
+)",
+            indentation);
+}
+
+static GeneratedFunction incrementalFunction(std::string const & typeName, size_t indentation) {
+    return inlineFunction("void",
+                          std::string{"applyIncremental("} + cppJsonTypeName + " const & entry, " + cppJsonTypeName +
+                                  " const & path, size_t depth, " + typeName + " & value)",
+                          indentation);
+}
+
+static GeneratedFunction generateIncrementalFieldsDecoding(std::string const & typeName,
+                                                           Type const & type,
+                                                           bool isCompact,
+                                                           size_t indentation,
+                                                           FieldRecursions const & recursions) {
+    std::vector<Field const *> deferredFields;
+    std::vector<Field const *> pathFields;
+    for (auto const & field : type.fields) {
+        if (field.delivery == IncrementalDelivery::Deferred) {
+            deferredFields.push_back(&field);
+        }
+        auto const kind = field.type.underlyingType().kind;
+        if (field.delivery == IncrementalDelivery::Streamed || kind == TypeKind::Object ||
+            kind == TypeKind::Interface || kind == TypeKind::Union) {
+            pathFields.push_back(&field);
+        }
+    }
+
+    // Without deferred fields or fields to follow the path into, every path is invalid
+    if (deferredFields.empty() && pathFields.empty()) {
+        auto function = inlineFunction(
+                "void",
+                std::string{"applyIncremental("} + cppJsonTypeName + " const &, " + cppJsonTypeName +
+                        " const & path, size_t, " + typeName + " &)",
+                indentation);
+        function.body += indent(indentation + 1) + "throw incrementalPathError(path);\n";
+        return function;
+    }
+
+    auto function = incrementalFunction(typeName, indentation);
+    auto & body = function.body;
+
+    if (!deferredFields.empty()) {
+        body += indent(indentation + 1) + "if (depth == path.size()) {\n";
+        body += indent(indentation + 2) + "auto const & data = entry.at(\"data\");\n";
+        for (auto const field : deferredFields) {
+            auto const typeName = cppFieldTypeName(*field, fieldRecursion(recursions, type.name, field->name));
+            body += indent(indentation + 2) + "{\n";
+            body += indent(indentation + 3) + "auto it = data.find(\"" + field->name + "\");\n";
+            body += indent(indentation + 3) + "if (it != data.end()) {\n";
+            if (isCompact && isPresenceTracked(*field)) {
+                body += indent(indentation + 4) + "value.set" + capitalize(field->name) + "(it->get<" + typeName +
+                        ">());\n";
+            } else {
+                body += indent(indentation + 4) + "value." + field->name + " = it->get<" + typeName + ">();\n";
+            }
+            body += indent(indentation + 3) + "}\n";
+            body += indent(indentation + 2) + "}\n";
+        }
+        body += indent(indentation + 2) + "return;\n";
+        body += indent(indentation + 1) + "}\n";
+    }
+
+    if (pathFields.empty()) {
+        body += indent(indentation + 1) + "throw incrementalPathError(path);\n";
+        return function;
+    }
+
+    body += indent(indentation + 1) + "auto const & key = path.at(depth).get_ref<std::string const &>();\n";
+    body += indent(indentation + 1);
+    for (auto const field : pathFields) {
+        body += "if (key == \"" + field->name + "\") {\n";
+        body += indent(indentation + 2) + "applyIncremental(entry, path, depth + 1, value." + field->name + ");\n";
+        body += indent(indentation + 1) + "} else ";
+    }
+    body += "{\n";
+    body += indent(indentation + 2) + "throw incrementalPathError(path);\n";
+    body += indent(indentation + 1) + "}\n";
+
+    return function;
+}
+
+GeneratedCode generateIncrementalObjectDecoding(
+        Type const & type, bool isCompact, size_t indentation, FieldRecursions const & recursions) {
+    return generateIncrementalFieldsDecoding(type.name, type, isCompact, indentation, recursions);
+}
+
+GeneratedCode generateIncrementalInterfaceDecoding(
+        Type const & type, size_t indentation, FieldRecursions const & recursions) {
+    GeneratedCode generated =
+            generateIncrementalFieldsDecoding(unknownCaseName + type.name, type, false, indentation, recursions);
+
+    auto function = incrementalFunction(type.name, indentation);
+    function.body += indent(indentation + 1) + "visit([&](auto & implementation) {\n";
+    function.body += indent(indentation + 2) + "applyIncremental(entry, path, depth, implementation);\n";
+    function.body += indent(indentation + 1) + "}, value.implementation);\n";
+    generated += function;
+
+    return generated;
+}
+
+GeneratedCode generateIncrementalUnionDecoding(Type const & type, size_t indentation) {
+    auto function = incrementalFunction(type.name, indentation);
+    function.body += indent(indentation + 1) + "visit([&](auto & member) {\n";
+    function.body += indent(indentation + 2) + "applyIncremental(entry, path, depth, member);\n";
+    function.body += indent(indentation + 1) + "}, value);\n";
+    return function;
+}
+
+std::string generateAsyncSupport(size_t indentation) {
+    return indentBlock(
+            R"(// Awaitable operations, which need c++20 coroutines.
+
+// A coroutine producing a T that starts when it is awaited and resumes its awaiter when it finishes.
+template <typename T>
+class GraphqlTask {
+public:
+    struct promise_type {
+        optional<T> value;
+        std::exception_ptr exception;
+        std::coroutine_handle<> continuation;
+
+        GraphqlTask get_return_object() {
+            return GraphqlTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        auto final_suspend() noexcept {
+            struct ResumeContinuation {
+                bool await_ready() noexcept {
+                    return false;
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                    auto const continuation = handle.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+            return ResumeContinuation{};
+        }
+
+        void return_value(T result) {
+            value.emplace(std::move(result));
+        }
+
+        void unhandled_exception() {
+            exception = std::current_exception();
+        }
+    };
+
+    GraphqlTask(GraphqlTask && other) noexcept : handle{std::exchange(other.handle, {})} {}
+
+    GraphqlTask & operator=(GraphqlTask && other) noexcept {
+        std::swap(handle, other.handle);
+        return *this;
+    }
+
+    ~GraphqlTask() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        if (handle.promise().exception) {
+            std::rethrow_exception(handle.promise().exception);
+        }
+        return std::move(*handle.promise().value);
+    }
+
+private:
+    explicit GraphqlTask(std::coroutine_handle<promise_type> handle) : handle{handle} {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Sends requests, like an http client, with send(Json request) returning an awaitable of the response json. Awaiting
+// it should suspend rather than block, so that other operations can run on the thread until the response arrives.
+template <typename T>
+concept GraphqlTransport = requires(T & transport, Json request) {
+    transport.send(std::move(request));
+};
+
+// A coroutine that runs as soon as it is called and destroys itself when it finishes.
+struct DetachedGraphqlTask {
+    struct promise_type {
+        DetachedGraphqlTask get_return_object() noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        // Like a std::thread, handle exceptions in the task or onResult
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+// Starts task from code that isn't a coroutine, calling onResult with its result when it finishes.
+template <typename T, typename OnResult>
+void spawn(GraphqlTask<T> task, OnResult onResult) {
+    [](GraphqlTask<T> task, OnResult onResult) -> DetachedGraphqlTask {
+        onResult(co_await task);
+    }(std::move(task), std::move(onResult));
+}
+
+// An in process transport for tests, answering requests with a handler when run is called. Any number of operations
+// can wait for it on the thread that runs it.
+class LocalGraphqlTransport {
+public:
+    explicit LocalGraphqlTransport(std::function<Json(Json const & request)> handler) : handler{std::move(handler)} {}
+
+    auto send(Json request) {
+        struct ResponseAwaiter {
+            LocalGraphqlTransport & transport;
+            Json request;
+            Json response;
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                transport.pending.push_back({&request, &response, handle});
+            }
+
+            Json await_resume() {
+                return std::move(response);
+            }
+        };
+        return ResponseAwaiter{*this, std::move(request), {}};
+    }
+
+    // Answers requests in the order they were sent, including those sent by the operations it resumes, until none
+    // are left. Returns how many were answered.
+    size_t run() {
+        size_t answered = 0;
+        while (!pending.empty()) {
+            auto const request = pending.front();
+            pending.pop_front();
+            *request.response = handler(*request.request);
+            request.handle.resume();
+            ++answered;
+        }
+        return answered;
+    }
+
+private:
+    struct PendingRequest {
+        Json const * request;
+        Json * response;
+        std::coroutine_handle<> handle;
+    };
+
+    std::function<Json(Json const & request)> handler;
+    std::deque<PendingRequest> pending;
+};
+
+)",
+            indentation);
+}
+
+std::string generateCoalescingSupport(size_t indentation) {
+    return indentBlock(
+            R"(// Sends requests with a fetch function, like an http client, sharing each one between the callers that
+// make it while it is in flight: concurrent fetches of an operation with the same variables make a single request
+// and decode its response once, then every caller gets the same immutable result. Thread safe.
+class GraphqlRequestCoalescer {
+public:
+    explicit GraphqlRequestCoalescer(std::function<Json(Json const & request)> fetchResponse)
+        : fetchResponse{std::move(fetchResponse)} {}
+
+    // Fetches request, the request of the operation and arguments of key, and decodes its response with decode.
+    // Exceptions from either are thrown to every caller sharing the request.
+    template <typename Data, typename Decode>
+    std::shared_ptr<GraphqlResponse<Data> const> fetch(
+            GraphqlCacheKey const & key, Json const & request, Decode decode) {
+        std::promise<std::shared_ptr<void const>> promise;
+        std::shared_future<std::shared_ptr<void const>> shared;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            auto const inserted = inFlight.try_emplace(key);
+            if (inserted.second) {
+                inserted.first->second = promise.get_future().share();
+            } else {
+                shared = inserted.first->second;
+            }
+        }
+        if (shared.valid()) {
+            // Another caller is making the request, wait for its result
+            return std::static_pointer_cast<GraphqlResponse<Data> const>(shared.get());
+        }
+
+        std::shared_ptr<GraphqlResponse<Data> const> response;
+        try {
+            response = std::make_shared<GraphqlResponse<Data> const>(decode(fetchResponse(request)));
+        } catch (...) {
+            finish(key);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+        finish(key);
+        promise.set_value(response);
+        return response;
+    }
+
+    // The number of requests in flight
+    size_t size() const {
+        std::lock_guard<std::mutex> lock{mutex};
+        return inFlight.size();
+    }
+
+private:
+    // Later fetches make a new request, since the response may have changed
+    void finish(GraphqlCacheKey const & key) {
+        std::lock_guard<std::mutex> lock{mutex};
+        inFlight.erase(key);
+    }
+
+    std::function<Json(Json const & request)> fetchResponse;
+    mutable std::mutex mutex;
+    std::unordered_map<GraphqlCacheKey, std::shared_future<std::shared_ptr<void const>>, GraphqlCacheKeyHash>
+            inFlight;
+};
+
+)",
+            indentation);
+}
+
+// Whether operations get cache keys, for the result cache or for coalescing requests.
+static bool hasCacheKeys(GenerationOptions const & options) {
+    return options.resultCache || options.coalescedRequests;
+}
+
+std::string generateCacheKeySupport(GenerationOptions const & options, size_t indentation) {
+    std::string generated = indentBlock(
+            R"(// Identifies the result of an operation with some arguments by the operation's name and a canonical
+// encoding of the arguments, with a hash of both.
+struct GraphqlCacheKey {
+    std::string operation;
+    std::string arguments;
+    uint64_t hash = 0;
+};
+
+inline bool operator==(GraphqlCacheKey const & lhs, GraphqlCacheKey const & rhs) {
+    return lhs.hash == rhs.hash && lhs.operation == rhs.operation && lhs.arguments == rhs.arguments;
+}
+
+struct GraphqlCacheKeyHash {
+    size_t operator()(GraphqlCacheKey const & key) const {
+        return static_cast<size_t>(key.hash);
+    }
+};
+
+// Arguments are encoded from their values rather than their json, in bytes that are the same on every platform:
+// integers and doubles as 8 little endian bytes, with negative zero made positive so that it equals zero, strings
+// and lists prefixed with their length, and optional values with whether they are present.
+inline void encodeCacheInteger(std::string & bytes, uint64_t value) {
+    for (size_t byte = 0; byte < sizeof(value); ++byte) {
+        bytes += static_cast<char>((value >> (8 * byte)) & 0xff);
+    }
+}
+
+template <typename T>
+void encodeCacheArgument(std::string & bytes, T const & value);
+
+template <typename T>
+void encodeCacheArgument(std::string & bytes, optional<T> const & value);
+
+template <typename T>
+void encodeCacheArgument(std::string & bytes, std::vector<T> const & values);
+
+inline void encodeCacheArgument(std::string & bytes, std::string const & value) {
+    encodeCacheInteger(bytes, value.size());
+    bytes += value;
+}
+
+// Makes json serialize the same for equal values: objects are already ordered by key, and negative zero is made
+// positive so that it equals zero.
+inline void canonicalizeCacheArgument(Json & json) {
+    if (json.is_number_float() && json.get<double>() == 0) {
+        json = 0.0;
+    } else if (json.is_structured()) {
+        for (auto & element : json) {
+            canonicalizeCacheArgument(element);
+        }
+    }
+}
+
+// Custom scalars kept as json are encoded as their canonical serialization.
+inline void encodeCacheArgument(std::string & bytes, Json const & value) {
+    auto canonical = value;
+    canonicalizeCacheArgument(canonical);
+    encodeCacheArgument(bytes, canonical.dump());
+}
+
+)",
+            indentation);
+
+    if (options.internedIds) {
+        generated += indentBlock(
+                R"(inline void encodeCacheArgument(std::string & bytes, Id const & value) {
+    encodeCacheArgument(bytes, value.str());
+}
+
+)",
+                indentation);
+    }
+
+    generated += indentBlock(
+            R"(// Booleans, numbers and enums encode their value. Values without an overload of their own, like custom
+// scalars mapped to types, are encoded as their json.
+template <typename T>
+void encodeCacheArgument(std::string & bytes, T const & value) {
+    if constexpr (std::is_same_v<T, bool>) {
+        bytes += value ? '\1' : '\0';
+    } else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+        encodeCacheInteger(bytes, static_cast<uint64_t>(static_cast<int64_t>(value)));
+    } else if constexpr (std::is_floating_point_v<T>) {
+        double const number = value == 0 ? 0.0 : static_cast<double>(value);
+        uint64_t bits;
+        std::memcpy(&bits, &number, sizeof(bits));
+        encodeCacheInteger(bytes, bits);
+    } else {
+        encodeCacheArgument(bytes, Json(value));
+    }
+}
+
+template <typename T>
+void encodeCacheArgument(std::string & bytes, optional<T> const & value) {
+    bytes += value ? '\1' : '\0';
+    if (value) {
+        encodeCacheArgument(bytes, *value);
+    }
+}
+
+template <typename T>
+void encodeCacheArgument(std::string & bytes, std::vector<T> const & values) {
+    encodeCacheInteger(bytes, values.size());
+    for (auto const & value : values) {
+        encodeCacheArgument(bytes, value);
+    }
+}
+
+// The key of operation with arguments. Hashes the operation's name and the encoding of the arguments with FNV-1a,
+// so keys are the same on every platform.
+template <typename... Arguments>
+GraphqlCacheKey makeCacheKey(char const * operation, Arguments const &... arguments) {
+    GraphqlCacheKey key{operation, {}};
+    (encodeCacheArgument(key.arguments, arguments), ...);
+
+    key.hash = 0xcbf29ce484222325ull;
+    auto const hashBytes = [&](std::string const & bytes) {
+        for (auto const byte : bytes) {
+            key.hash = (key.hash ^ static_cast<unsigned char>(byte)) * 0x100000001b3ull;
+        }
+    };
+    hashBytes(key.operation);
+    hashBytes("\n");
+    hashBytes(key.arguments);
+    return key;
+}
+
+)",
+            indentation);
+
+    return generated;
+}
+
+std::string generateResultCacheSupport(size_t indentation) {
+    return indentBlock(
+            R"(// Decoded results of operations by cache key, reused until they are older than timeToLive. Holds results
+// with a total size of at most capacity, evicting the least recently used ones first. Thread safe.
+class GraphqlResultCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    GraphqlResultCache(size_t capacity, Clock::duration timeToLive) : capacity{capacity}, timeToLive{timeToLive} {}
+
+    // The result stored for key, or null if there is none, it has expired or it isn't a Data.
+    template <typename Data>
+    std::shared_ptr<Data const> find(GraphqlCacheKey const & key) {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto const it = entries.find(key);
+        if (it == entries.end() || it->second->type != typeTag<Data>()) {
+            return nullptr;
+        }
+        if (Clock::now() >= it->second->expiry) {
+            erase(it);
+            return nullptr;
+        }
+        order.splice(order.begin(), order, it->second);
+        return std::static_pointer_cast<Data const>(it->second->data);
+    }
+
+    // Stores data for key, replacing any result stored for it, and returns it. size counts towards capacity, e.g.
+    // the length of the response it was decoded from. Results larger than capacity aren't stored, but still remove
+    // the result stored for key.
+    template <typename Data>
+    std::shared_ptr<Data const> insert(GraphqlCacheKey const & key, Data data, size_t size) {
+        auto stored = std::make_shared<Data const>(std::move(data));
+
+        std::lock_guard<std::mutex> lock{mutex};
+        auto const it = entries.find(key);
+        if (it != entries.end()) {
+            erase(it);
+        }
+        if (size > capacity) {
+            return stored;
+        }
+
+        order.push_front({key, stored, typeTag<Data>(), size, Clock::now() + timeToLive});
+        entries.emplace(key, order.begin());
+        totalSize += size;
+        while (totalSize > capacity) {
+            erase(entries.find(order.back().key));
+        }
+        return stored;
+    }
+
+    // Removes the result stored for key, e.g. after a mutation changed it.
+    void erase(GraphqlCacheKey const & key) {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto const it = entries.find(key);
+        if (it != entries.end()) {
+            erase(it);
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock{mutex};
+        entries.clear();
+        order.clear();
+        totalSize = 0;
+    }
+
+    // The total size of the stored results
+    size_t size() const {
+        std::lock_guard<std::mutex> lock{mutex};
+        return totalSize;
+    }
+
+private:
+    struct Entry {
+        GraphqlCacheKey key;
+        std::shared_ptr<void const> data;
+        void const * type;
+        size_t size;
+        Clock::time_point expiry;
+    };
+
+    using Entries = std::unordered_map<GraphqlCacheKey, std::list<Entry>::iterator, GraphqlCacheKeyHash>;
+
+    // An address unique to Data, so that a key can't return a result of another type.
+    template <typename Data>
+    static void const * typeTag() {
+        static char const tag = 0;
+        return &tag;
+    }
+
+    void erase(Entries::iterator it) {
+        totalSize -= it->second->size;
+        order.erase(it->second);
+        entries.erase(it);
+    }
+
+    size_t const capacity;
+    Clock::duration const timeToLive;
+    mutable std::mutex mutex;
+    // Most recently used first
+    std::list<Entry> order;
+    Entries entries;
+    size_t totalSize = 0;
+};
+
+)",
+            indentation);
+}
+
+std::string boxAllocatorName(BoxAllocator allocator) {
+    switch (allocator) {
+    case BoxAllocator::Heap:
+        return "heap";
+    case BoxAllocator::Pool:
+        return "pool";
+    case BoxAllocator::Arena:
+        return "arena";
+    }
+
+    throw std::invalid_argument{"Invalid BoxAllocator value: " + std::to_string(static_cast<int>(allocator))};
+}
+
+BoxAllocator boxAllocatorNamed(std::string const & name) {
+    for (auto const allocator : {BoxAllocator::Heap, BoxAllocator::Pool, BoxAllocator::Arena}) {
+        if (boxAllocatorName(allocator) == name) {
+            return allocator;
+        }
+    }
+
+    throw std::invalid_argument{"Unknown box allocator " + name + ", expected heap, pool or arena"};
+}
+
+// The allocator of the values of BoxedOptional<T>.
+static std::string cppBoxAllocatorName(BoxAllocator allocator) {
+    switch (allocator) {
+    case BoxAllocator::Heap:
+        return "std::allocator<T>";
+    case BoxAllocator::Pool:
+        return "BoxPool<T>";
+    case BoxAllocator::Arena:
+        return "BoxArenaAllocator<T>";
+    }
+
+    throw std::invalid_argument{"Invalid BoxAllocator value: " + std::to_string(static_cast<int>(allocator))};
+}
+
+// The allocators of BoxedOptional.hpp, which generated boxes can allocate with instead of the heap.
+static std::string generateBoxAllocator(BoxAllocator allocator, size_t indentation) {
+    switch (allocator) {
+    case BoxAllocator::Heap:
+        return "";
+
+    case BoxAllocator::Pool:
+        return indentBlock(
+                R"(// Allocates boxes from a free list per thread, so that boxes freed on a thread are
+// reused by the next ones allocated on it instead of going back to the heap. Boxes may be
+// freed on another thread than the one they were allocated on, and after the thread's free
+// list is destroyed, during thread or static teardown, in which case they go to the heap.
+template <typename T>
+struct BoxPool {
+    using value_type = T;
+
+    // Freed boxes beyond this many per thread go back to the heap
+    static size_t constexpr maxFreeCount = 4096;
+
+    BoxPool() = default;
+
+    template <typename U>
+    BoxPool(BoxPool<U> const &) {}
+
+    T * allocate(size_t count) {
+        if (count != 1) {
+            return std::allocator<T>().allocate(count);
+        }
+        if (isFreeListDestroyed()) {
+            return reinterpret_cast<T *>(new Node);
+        }
+        auto & list = freeList();
+        if (!list.head) {
+            return reinterpret_cast<T *>(new Node);
+        }
+        auto const node = list.head;
+        list.head = node->next;
+        --list.size;
+        return reinterpret_cast<T *>(node);
+    }
+
+    void deallocate(T * pointer, size_t count) noexcept {
+        if (count != 1) {
+            std::allocator<T>().deallocate(pointer, count);
+            return;
+        }
+        auto const node = reinterpret_cast<Node *>(pointer);
+        if (isFreeListDestroyed()) {
+            delete node;
+            return;
+        }
+        auto & list = freeList();
+        if (list.size == maxFreeCount) {
+            delete node;
+            return;
+        }
+        node->next = list.head;
+        list.head = node;
+        ++list.size;
+    }
+
+    // The number of freed boxes kept for reuse on this thread
+    static size_t freeCount() { return isFreeListDestroyed() ? 0 : freeList().size; }
+
+private:
+    union Node {
+        Node * next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct FreeList {
+        Node * head = nullptr;
+        size_t size = 0;
+
+        ~FreeList() {
+            while (head) {
+                delete std::exchange(head, head->next);
+            }
+            isFreeListDestroyed() = true;
+        }
+    };
+
+    static FreeList & freeList() {
+        thread_local FreeList list;
+        return list;
+    }
+
+    // Trivially destructible, so that it can still be read after the free list is destroyed
+    static bool & isFreeListDestroyed() {
+        thread_local bool isDestroyed = false;
+        return isDestroyed;
+    }
+};
+
+template <typename T, typename U>
+bool operator==(BoxPool<T> const &, BoxPool<U> const &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(BoxPool<T> const &, BoxPool<U> const &) {
+    return false;
+}
+
+)",
+                indentation);
+
+    case BoxAllocator::Arena:
+        return indentBlock(
+                R"(// Owns the memory of boxes allocated with BoxArenaAllocator while a Scope of it is
+// active on their thread, freeing all of it at once when it is destroyed instead of box by
+// box. Values allocated in an arena must not outlive it.
+class BoxArena {
+public:
+    // Makes arena the one that BoxArenaAllocator allocates from on this thread until the scope ends.
+    class Scope {
+    public:
+        explicit Scope(BoxArena & arena) : previous{std::exchange(current(), &arena)} {}
+        Scope(Scope const &) = delete;
+        Scope & operator=(Scope const &) = delete;
+        ~Scope() { current() = previous; }
+
+    private:
+        BoxArena * previous;
+    };
+
+    explicit BoxArena(size_t blockSize = 16384) : blockSize{blockSize} {}
+    BoxArena(BoxArena const &) = delete;
+    BoxArena & operator=(BoxArena const &) = delete;
+
+    void * allocate(size_t size, size_t alignment) {
+        allocatedBytes += size;
+
+        if (size + alignment > blockSize) {
+            // Oversized allocations get a block of their own, before the one being filled
+            auto space = size + alignment;
+            auto const block = blocks.insert(blocks.end() - (blocks.empty() ? 0 : 1),
+                                             std::unique_ptr<unsigned char[]>(new unsigned char[space]));
+            void * memory = block->get();
+            return std::align(alignment, size, memory, space);
+        }
+
+        void * next = nullptr;
+        size_t space = 0;
+        if (!blocks.empty()) {
+            next = blocks.back().get() + used;
+            space = blockSize - used;
+        }
+        if (!next || !std::align(alignment, size, next, space)) {
+            blocks.emplace_back(new unsigned char[blockSize]);
+            next = blocks.back().get();
+            space = blockSize;
+            std::align(alignment, size, next, space);
+        }
+        used = blockSize - space + size;
+        return next;
+    }
+
+    // The total size of the allocations made in the arena
+    size_t size() const { return allocatedBytes; }
+
+    static BoxArena *& current() {
+        thread_local BoxArena * arena = nullptr;
+        return arena;
+    }
+
+private:
+    size_t blockSize;
+    std::vector<std::unique_ptr<unsigned char[]>> blocks;
+    // Bytes used in the last block
+    size_t used = 0;
+    size_t allocatedBytes = 0;
+};
+
+// Allocates boxes in the current BoxArena of the thread. Deallocating does nothing, the arena frees the memory.
+template <typename T>
+struct BoxArenaAllocator {
+    using value_type = T;
+
+    BoxArenaAllocator() = default;
+
+    template <typename U>
+    BoxArenaAllocator(BoxArenaAllocator<U> const &) {}
+
+    T * allocate(size_t count) {
+        auto const arena = BoxArena::current();
+        if (!arena) {
+            throw std::logic_error{"Boxes can only be allocated in an arena while a BoxArena::Scope is active"};
+        }
+        return static_cast<T *>(arena->allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void deallocate(T *, size_t) noexcept {}
+};
+
+template <typename T, typename U>
+bool operator==(BoxArenaAllocator<T> const &, BoxArenaAllocator<U> const &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(BoxArenaAllocator<T> const &, BoxArenaAllocator<U> const &) {
+    return false;
+}
+
+)",
+                indentation);
+    }
+
+    throw std::invalid_argument{"Invalid BoxAllocator value: " + std::to_string(static_cast<int>(allocator))};
+}
+
+std::string generateBoxedSupport(GenerationOptions const & options, size_t indentation) {
+    std::string generated = indentBlock(
+            R"(// Whether copying a BoxedOptional copies its value into an allocation of its own, or
+// isn't allowed so that values are only ever moved.
+enum class BoxCopying { Deep, MoveOnly };
+
+)",
+            indentation);
+
+    generated += generateBoxAllocator(options.boxAllocator, indentation);
+
+    generated += indentBlock(
+            R"(// An owning pointer to a T allocated with Allocator, which moves but doesn't copy.
+// Allocators are default constructed for every allocation, so they can't have state of
+// their own.
+template <typename T, typename Allocator>
+class Box {
+public:
+    Box() = default;
+
+    Box(Box && other) noexcept : pointer{std::exchange(other.pointer, nullptr)} {}
+
+    Box & operator=(Box && other) noexcept {
+        if (this != &other) {
+            reset();
+            pointer = std::exchange(other.pointer, nullptr);
+        }
+        return *this;
+    }
+
+    ~Box() { reset(); }
+
+    template <typename... Args>
+    void emplace(Args &&... args) {
+        reset();
+        Allocator allocator;
+        auto const allocated = Traits::allocate(allocator, 1);
+        try {
+            Traits::construct(allocator, allocated, std::forward<Args>(args)...);
+        } catch (...) {
+            Traits::deallocate(allocator, allocated, 1);
+            throw;
+        }
+        pointer = allocated;
+    }
+
+    void reset() noexcept {
+        if (pointer) {
+            Allocator allocator;
+            Traits::destroy(allocator, pointer);
+            Traits::deallocate(allocator, pointer, 1);
+            pointer = nullptr;
+        }
+    }
+
+    T * get() const noexcept { return pointer; }
+
+private:
+    using Traits = std::allocator_traits<Allocator>;
+
+    T * pointer = nullptr;
+};
+
+// A Box that copies its value. Assigning to a box that has a value assigns to the value instead of allocating.
+template <typename T, typename Allocator>
+class CopyableBox : public Box<T, Allocator> {
+public:
+    CopyableBox() = default;
+
+    CopyableBox(CopyableBox const & other) : Box<T, Allocator>() {
+        if (other.get()) {
+            this->emplace(*other.get());
+        }
+    }
+
+    CopyableBox & operator=(CopyableBox const & other) {
+        if (!other.get()) {
+            this->reset();
+        } else if (!this->get()) {
+            this->emplace(*other.get());
+        } else if (this != &other) {
+            *this->get() = *other.get();
+        }
+        return *this;
+    }
+
+    CopyableBox(CopyableBox &&) noexcept = default;
+    CopyableBox & operator=(CopyableBox &&) noexcept = default;
+};
+
+)",
+            indentation);
+
+    generated += indentBlock(
+            R"(// A nullable value that is allocated separately, for fields whose type isn't complete
+// where the field is declared because the types refer to each other. Values are allocated
+// with Allocator, and copied unless copying is BoxCopying::MoveOnly.
+template <typename T, typename Allocator = )" +
+                    cppBoxAllocatorName(options.boxAllocator) + ", BoxCopying copying = BoxCopying::" +
+                    (options.moveOnlyBoxes ? "MoveOnly" : "Deep") + R"(>
+class BoxedOptional {
+public:
+    BoxedOptional() = default;
+
+    // A template so that copying doesn't check whether BoxedOptional converts to T, which needs T to be complete
+    template <typename U, typename = std::enable_if_t<!std::is_same_v<std::decay_t<U>, BoxedOptional>>>
+    BoxedOptional(U && value) {
+        this->value.emplace(std::forward<U>(value));
+    }
+
+    bool has_value() const { return value.get() != nullptr; }
+    explicit operator bool() const { return has_value(); }
+    void reset() { value.reset(); }
+
+    T & emplace() {
+        value.emplace();
+        return *value.get();
+    }
+
+    T & operator*() { return *value.get(); }
+    T const & operator*() const { return *value.get(); }
+    T * operator->() { return value.get(); }
+    T const * operator->() const { return value.get(); }
+
+private:
+    std::conditional_t<copying == BoxCopying::Deep, CopyableBox<T, Allocator>, Box<T, Allocator>> value;
+};
+
+)",
+            indentation);
+
+    generated += indentBlock(
+            R"(template <typename T>
+void from_json(Json const & json, BoxedOptional<T> & value) {
+    if (json.is_null()) {
+        value.reset();
+    } else {
+        json.get_to(value.emplace());
+    }
+}
+
+template <typename T>
+void to_json(Json & json, BoxedOptional<T> const & value) {
+    if (value) {
+        json = *value;
+    } else {
+        json = nullptr;
+    }
+}
+
+)",
+            indentation);
+
+    if (options.lazyDecoding) {
+        generated += indentBlock(
+                R"(template <typename T>
+void decodeLazy(LazyNode const & node, BoxedOptional<T> & value) {
+    if (node.json->is_null()) {
+        value.reset();
+    } else {
+        decodeLazy(node, value.emplace());
+    }
+}
+
+)",
+                indentation);
+    }
+
+    if (options.jsonBackend == JsonBackend::Simdjson) {
+        generated += indentBlock(
+                R"(template <typename T>
+void decodeOnDemand(simdjson::ondemand::value json, BoxedOptional<T> & value) {
+    if (json.is_null()) {
+        value.reset();
+    } else {
+        decodeOnDemand(json, value.emplace());
+    }
+}
+
+)",
+                indentation);
+    }
+
+    if (options.checkedDecoding) {
+        generated += indentBlock(
+                R"(template <typename T>
+bool tryDecode(Json const & json, BoxedOptional<T> & value, DecodePath const & path, DecodeError & error) {
+    if (json.is_null()) {
+        value.reset();
+        return true;
+    }
+    return tryDecode(json, value.emplace(), path, error);
+}
+
+)",
+                indentation);
+    }
+
+    if (!options.deferredFields.empty() || !options.streamedFields.empty()) {
+        generated += indentBlock(
+                R"(template <typename T>
+void applyIncremental(Json const & entry, Json const & path, size_t depth, BoxedOptional<T> & value) {
+    if (!value) {
+        value.emplace();
+    }
+    applyIncremental(entry, path, depth, *value);
+}
+
+)",
+                indentation);
+    }
+
+    if (hasCacheKeys(options)) {
+        generated += indentBlock(
+                R"(template <typename T>
+void encodeCacheArgument(std::string & bytes, BoxedOptional<T> const & value) {
+    bytes += value ? '\1' : '\0';
+    if (value) {
+        encodeCacheArgument(bytes, *value);
+    }
+}
+
+)",
+                indentation);
+    }
+
+    return generated;
+}
+
+std::string generateForwardDeclarations(std::vector<Type> const & component, size_t indentation) {
+    std::string generated;
+
+    for (auto const & type : component) {
+        if (type.kind == TypeKind::Object || type.kind == TypeKind::InputObject || type.kind == TypeKind::Interface) {
+            generated += indent(indentation) + "struct " + type.name + ";\n";
+        }
+    }
+    generated += "\n";
+
+    for (auto const & type : component) {
+        if (type.kind == TypeKind::Union) {
+            generated += generateUnion(type, indentation);
+        }
+    }
+
+    return generated;
+}
+
+std::string algrebraicNamespaceName(AlgebraicNamespace algebraicNamespace) {
+    switch (algebraicNamespace) {
+    case AlgebraicNamespace::Std:
+        return "std";
+    case AlgebraicNamespace::Absl:
+        return "absl";
+    }
+
+    throw std::invalid_argument{"Invalid AlgebraicNamespace value: " +
+                                std::to_string(static_cast<int>(algebraicNamespace))};
+}
+
+std::string jsonBackendName(JsonBackend backend) {
+    switch (backend) {
+    case JsonBackend::Nlohmann:
+        return "nlohmann";
+    case JsonBackend::Simdjson:
+        return "simdjson";
+    }
+
+    throw std::invalid_argument{"Invalid JsonBackend value: " + std::to_string(static_cast<int>(backend))};
+}
+
+JsonBackend jsonBackendNamed(std::string const & name) {
+    for (auto const backend : {JsonBackend::Nlohmann, JsonBackend::Simdjson}) {
+        if (jsonBackendName(backend) == name) {
+            return backend;
+        }
+    }
+
+    throw std::invalid_argument{"Unknown json backend " + name + ", expected nlohmann or simdjson"};
+}
+
+static std::string generateOptionalSerialization(AlgebraicNamespace algebraicNamespace) {
+    auto const namespaceName = algrebraicNamespaceName(algebraicNamespace);
+    auto upperNamespaceName = namespaceName;
+    std::transform(upperNamespaceName.begin(), upperNamespaceName.end(), upperNamespaceName.begin(), ::toupper);
+    char const * optionalInclude;
+    char const * variantInclude;
 
     switch (algebraicNamespace) {
     case AlgebraicNamespace::Std:
@@ -854,58 +4862,858 @@ static std::string generateOptionalSerialization(AlgebraicNamespace algebraicNam
         variantInclude = "<variant>";
         break;
 
-    case AlgebraicNamespace::Absl:
-        optionalInclude = "\"absl/types/optional.h\"";
-        variantInclude = "\"absl/types/variant.h\"";
-        break;
+    case AlgebraicNamespace::Absl:
+        optionalInclude = "\"absl/types/optional.h\"";
+        variantInclude = "\"absl/types/variant.h\"";
+        break;
+    }
+
+
+    // Guarded so that headers generated for different namespaces can be included together
+    auto format = R"(
+#include %s
+#include %s
+
+// optional serialization
+#ifndef CAFFQL_%s_OPTIONAL_SERIALIZATION
+#define CAFFQL_%s_OPTIONAL_SERIALIZATION
+namespace nlohmann {
+    template <typename T>
+    struct adl_serializer<%s::optional<T>> {
+        static void to_json(json & json, %s::optional<T> const & opt) {
+            if (opt.has_value()) {
+                json = *opt;
+            } else {
+                json = nullptr;
+            }
+        }
+
+        static void from_json(const json & json, %s::optional<T> & opt) {
+            if (json.is_null()) {
+                opt.reset();
+            } else {
+                opt = json.get<T>();
+            }
+        }
+    };
+}
+#endif
+
+)";
+
+    std::string buffer(2000, '\0');
+    int len = snprintf(
+            &buffer[0],
+            buffer.size(),
+            format,
+            optionalInclude,
+            variantInclude,
+            upperNamespaceName.c_str(),
+            upperNamespaceName.c_str(),
+            namespaceName.c_str(),
+            namespaceName.c_str(),
+            namespaceName.c_str());
+    buffer.resize(len);
+    return buffer;
+}
+
+static std::string useAlgebraicTypes(AlgebraicNamespace algebraicNamespace, size_t indentation) {
+    std::string generated;
+    for (auto const name : {"optional", "variant", "monostate", "visit"}) {
+        generated += indent(indentation) + "using " + algrebraicNamespaceName(algebraicNamespace) + "::" + name + ";\n";
+    }
+    return generated + "\n";
+}
+
+// The aliases and Operation at the start of a generated namespace or the runtime header.
+static std::string generateRuntimeDeclarations(
+        AlgebraicNamespace algebraicNamespace, bool shouldDeclareId, size_t indentation) {
+    std::string generated;
+    generated += indent(indentation) + "using " + cppJsonTypeName + " = nlohmann::json;\n";
+    if (shouldDeclareId) {
+        generated += indent(indentation) + "using " + cppIdTypeName + " = std::string;\n";
+    }
+    generated += useAlgebraicTypes(algebraicNamespace, indentation);
+    generated += indent(indentation) + "enum class Operation { Query, Mutation, Subscription };\n\n";
+    return generated;
+}
+
+// Brings the declarations of the runtime header into a generated namespace.
+static std::string generateRuntimeUsingDeclarations(
+        AlgebraicNamespace algebraicNamespace, bool shouldDeclareId, size_t indentation) {
+    auto useRuntime = [&](std::string const & name) {
+        return indent(indentation) + "using ::caffql::runtime::" + name + ";\n";
+    };
+
+    std::string generated;
+    generated += useRuntime(cppJsonTypeName);
+    if (shouldDeclareId) {
+        generated += useRuntime(cppIdTypeName);
+    }
+    generated += useAlgebraicTypes(algebraicNamespace, indentation);
+    generated += useRuntime("Operation");
+    generated += useRuntime(grapqlErrorTypeName);
+    generated += useRuntime("GraphqlResponse") + "\n";
+    return generated;
+}
+
+std::string generateRuntimeHeader(AlgebraicNamespace algebraicNamespace) {
+    std::string source;
+
+    source += R"(// This file was automatically generated and should not be edited.
+// The prelude shared by headers caffql generated with --runtime-header.
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "nlohmann/json.hpp")";
+    source += generateOptionalSerialization(algebraicNamespace);
+
+    source += "#define CAFFQL_RUNTIME_VERSION " + std::to_string(runtimeHeaderVersion) + "\n";
+    source += "#define CAFFQL_RUNTIME_ABSL " + std::to_string(algebraicNamespace == AlgebraicNamespace::Absl) + "\n\n";
+
+    source += "namespace caffql::runtime {\n\n";
+    source += generateRuntimeDeclarations(algebraicNamespace, true, 1);
+    source += generateGraphqlErrorType(1);
+    source += defineFunctionsInline(generateGraphqlErrorDeserialization(1));
+    source += "} // namespace caffql::runtime\n";
+
+    return source;
+}
+
+size_t selectionDepth(std::string const & query) {
+    size_t depth = 0;
+    size_t maximumDepth = 0;
+
+    for (auto const character : query) {
+        if (character == '{') {
+            maximumDepth = std::max(maximumDepth, ++depth);
+        } else if (character == '}' && depth > 0) {
+            --depth;
+        }
+    }
+
+    // The outermost braces belong to the operation rather than a field.
+    return maximumDepth > 0 ? maximumDepth - 1 : 0;
+}
+
+void GenerationStatistics::addPhase(std::string const & phase, double milliseconds) {
+    auto it = std::find_if(phaseMilliseconds.begin(), phaseMilliseconds.end(), [&](auto const & pair) {
+        return pair.first == phase;
+    });
+
+    if (it != phaseMilliseconds.end()) {
+        it->second += milliseconds;
+    } else {
+        phaseMilliseconds.emplace_back(phase, milliseconds);
+    }
+}
+
+static std::string emissionPhaseName(TypeKind kind) {
+    switch (kind) {
+    case TypeKind::Object:
+        return "object emission";
+    case TypeKind::Interface:
+        return "interface emission";
+    case TypeKind::Union:
+        return "union emission";
+    case TypeKind::Enum:
+        return "enum emission";
+    case TypeKind::InputObject:
+        return "input object emission";
+    case TypeKind::Scalar:
+    case TypeKind::List:
+    case TypeKind::NonNull:
+        break;
+    }
+
+    throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(kind))};
+}
+
+std::set<std::string> reachableTypeNames(Type const & type, TypeMap const & typeMap) {
+    std::set<std::string> names;
+    std::vector<std::string> pending{type.name};
+
+    auto reach = [&](TypeRef const & typeRef) {
+        auto const & name = typeRef.underlyingType().name;
+        if (name && *name != type.name && names.insert(*name).second) {
+            pending.push_back(*name);
+        }
+    };
+
+    while (!pending.empty()) {
+        auto const it = typeMap.find(pending.back());
+        pending.pop_back();
+        if (it == typeMap.end()) {
+            continue;
+        }
+
+        for (auto const & field : it->second.fields) {
+            reach(field.type);
+            for (auto const & arg : field.args) {
+                reach(arg.type);
+            }
+        }
+        for (auto const & inputField : it->second.inputFields) {
+            reach(inputField.type);
+        }
+        for (auto const & possibleType : it->second.possibleTypes) {
+            reach(possibleType);
+        }
+    }
+
+    return names;
+}
+
+static bool isSchemaOperationType(Type const & type, std::optional<Schema::OperationType> const & operationType) {
+    return operationType && operationType->name == type.name;
+}
+
+// Marks the fields that options defer or stream. Marking a field of an interface also marks it in the interface's
+// implementations, since it is selected on the interface rather than in their fragments.
+static Schema withIncrementalDelivery(Schema schema, GenerationOptions const & options) {
+    auto findField = [&](std::string const & typeName, std::string const & fieldName) -> std::pair<Type &, Field &> {
+        auto type = std::find_if(schema.types.begin(), schema.types.end(), [&](Type const & type) {
+            return type.name == typeName;
+        });
+        if (type != schema.types.end()) {
+            auto field = std::find_if(type->fields.begin(), type->fields.end(), [&](Field const & field) {
+                return field.name == fieldName;
+            });
+            if (field != type->fields.end()) {
+                return {*type, *field};
+            }
+        }
+        throw std::invalid_argument{"Unknown field " + typeName + "." + fieldName + ", expected Type.field"};
+    };
+
+    auto mark = [&](std::string const & name, IncrementalDelivery delivery) {
+        auto const separator = name.find('.');
+        auto const fieldName = separator == std::string::npos ? "" : name.substr(separator + 1);
+        auto const typeAndField = findField(name.substr(0, separator), fieldName);
+        auto & field = typeAndField.second;
+
+        if (field.delivery != IncrementalDelivery::None) {
+            throw std::invalid_argument{name + " can't be both deferred and streamed"};
+        }
+        auto const & type = field.type.kind == TypeKind::NonNull ? *field.type.ofType : field.type;
+        if (delivery == IncrementalDelivery::Streamed && type.kind != TypeKind::List) {
+            throw std::invalid_argument{"Only lists can be streamed, " + name + " isn't one"};
+        }
+
+        field.delivery = delivery;
+        for (auto const & possibleType : typeAndField.first.possibleTypes) {
+            findField(possibleType.name.value(), fieldName).second.delivery = delivery;
+        }
+    };
+
+    for (auto const & name : options.deferredFields) {
+        mark(name, IncrementalDelivery::Deferred);
+    }
+    for (auto const & name : options.streamedFields) {
+        mark(name, IncrementalDelivery::Streamed);
+    }
+
+    return schema;
+}
+
+// Declarations of the free functions of code, which stay inline.
+static std::string generateInlineFunctionDeclarations(GeneratedCode const & code) {
+    std::string declarations;
+    for (auto const & part : code.parts) {
+        if (auto const & function = part.function) {
+            declarations += indent(function->indentation) + "inline " + function->returnType + " " +
+                            function->declarator + ";\n";
+        }
+    }
+    return declarations;
+}
+
+static bool isOperationTypeField(Field const & field, Schema const & schema) {
+    auto const & name = field.type.underlyingType().name;
+    auto isNamed = [&](std::optional<Schema::OperationType> const & operationType) {
+        return name && operationType && operationType->name == *name;
+    };
+    return isNamed(schema.queryType) || isNamed(schema.mutationType) || isNamed(schema.subscriptionType);
+}
+
+static bool hasOperationTypeFields(Schema const & schema) {
+    return std::any_of(schema.types.begin(), schema.types.end(), [&](Type const & type) {
+        return std::any_of(type.fields.begin(), type.fields.end(), [&](Field const & field) {
+            return isOperationTypeField(field, schema);
+        });
+    });
+}
+
+// Operation types generate namespaces of operations rather than structs, so fields of other types that select them,
+// like the query fields of Relay mutation payloads, are left out.
+static void removeOperationTypeFields(Schema & schema) {
+    for (auto & type : schema.types) {
+        type.fields.erase(std::remove_if(type.fields.begin(),
+                                         type.fields.end(),
+                                         [&](Field const & field) { return isOperationTypeField(field, schema); }),
+                          type.fields.end());
+    }
+}
+
+// Leaves out the deprecated fields that options don't keep. Selected operations are kept, and so are the fields of
+// objects that their interfaces keep, since the interfaces' accessors read them from their implementations.
+static void removeDeprecatedFields(Schema & schema, GenerationOptions const & options) {
+    for (auto const & name : options.keptDeprecatedFields) {
+        auto const separator = name.find('.');
+        auto const type = std::find_if(schema.types.begin(), schema.types.end(), [&](Type const & type) {
+            return type.name == name.substr(0, separator);
+        });
+        auto const fieldName = separator == std::string::npos ? "" : name.substr(separator + 1);
+        if (type == schema.types.end() ||
+            std::none_of(type->fields.begin(), type->fields.end(), [&](Field const & field) {
+                return field.name == fieldName;
+            })) {
+            throw std::invalid_argument{"Unknown field " + name + ", expected Type.field"};
+        }
+    }
+
+    auto keptFields = options.keptDeprecatedFields;
+    keptFields.insert(options.operations.begin(), options.operations.end());
+
+    auto isRemoved = [&](Type const & type, Field const & field) {
+        return field.isDeprecated && keptFields.count(type.name + "." + field.name) == 0;
+    };
+
+    for (auto const & type : schema.types) {
+        if (type.kind != TypeKind::Interface) {
+            continue;
+        }
+        for (auto const & field : type.fields) {
+            if (!isRemoved(type, field)) {
+                for (auto const & possibleType : type.possibleTypes) {
+                    keptFields.insert(possibleType.name.value() + "." + field.name);
+                }
+            }
+        }
+    }
+
+    for (auto & type : schema.types) {
+        type.fields.erase(std::remove_if(type.fields.begin(),
+                                         type.fields.end(),
+                                         [&](Field const & field) { return isRemoved(type, field); }),
+                          type.fields.end());
+    }
+}
+
+// Keeps the operations that options select and the types they reach, leaving out operation types that have none of
+// them.
+static void keepSelectedOperations(Schema & schema, std::set<std::string> const & operations) {
+    auto isOperationType = [&](Type const & type) {
+        return isSchemaOperationType(type, schema.queryType) || isSchemaOperationType(type, schema.mutationType) ||
+               isSchemaOperationType(type, schema.subscriptionType);
+    };
+
+    std::set<std::string> unknownOperations = operations;
+    for (auto & type : schema.types) {
+        if (!isOperationType(type)) {
+            continue;
+        }
+        type.fields.erase(std::remove_if(type.fields.begin(),
+                                         type.fields.end(),
+                                         [&](Field const & field) {
+                                             return unknownOperations.erase(type.name + "." + field.name) == 0;
+                                         }),
+                          type.fields.end());
+    }
+
+    if (!unknownOperations.empty()) {
+        throw std::invalid_argument{"Unknown operation " + *unknownOperations.begin() + ", expected a field of an "
+                                   "operation type like Query.field"};
+    }
+
+    TypeMap typeMap;
+    for (auto const & type : schema.types) {
+        typeMap[type.name] = type;
+    }
+
+    std::set<std::string> reachedNames;
+    for (auto const & type : schema.types) {
+        if (isOperationType(type) && !type.fields.empty()) {
+            reachedNames.insert(type.name);
+            reachedNames.merge(reachableTypeNames(type, typeMap));
+        }
+    }
+
+    schema.types.erase(std::remove_if(schema.types.begin(),
+                                      schema.types.end(),
+                                      [&](Type const & type) {
+                                          auto const isBuiltin =
+                                                  type.kind == TypeKind::Scalar && isBuiltinScalar(type.name);
+                                          return !isBuiltin && reachedNames.count(type.name) == 0;
+                                      }),
+                       schema.types.end());
+}
+
+static bool hasFieldRecursion(Type const & type, FieldRecursions const & recursions, bool isBoxed) {
+    auto const matches = [&](auto const & field) {
+        auto const recursion = fieldRecursion(recursions, type.name, field.name);
+        return isBoxed ? recursion == FieldRecursion::Boxed : recursion != FieldRecursion::None;
+    };
+    return std::any_of(type.fields.begin(), type.fields.end(), matches) ||
+           std::any_of(type.inputFields.begin(), type.inputFields.end(), matches);
+}
+
+// Whether the types of a component refer to each other or, for a single type, to itself.
+static bool isCycle(std::vector<Type> const & component, FieldRecursions const & recursions) {
+    return component.size() > 1 || hasFieldRecursion(component.front(), recursions, false);
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Throws std::invalid_argument for options that can't be generated together.
+static void checkOptionCombinations(GenerationOptions const & options) {
+    auto const isOnDemand = options.jsonBackend == JsonBackend::Simdjson;
+    auto const hasIncrementalDelivery = !options.deferredFields.empty() || !options.streamedFields.empty();
+
+    if (isOnDemand && options.lazyDecoding) {
+        throw std::invalid_argument{
+                "Lazy decoding keeps responses as json documents, it can't use the simdjson backend"};
+    }
+
+    if (options.checkedDecoding && options.lazyDecoding) {
+        throw std::invalid_argument{"Lazy decoding decodes fields on access, it can't report decode errors up front"};
+    }
+
+    if (hasIncrementalDelivery && options.lazyDecoding) {
+        throw std::invalid_argument{
+                "Lazy decoding keeps responses as json documents, incremental payloads can't be applied to them"};
     }
 
+    if (options.tableDecoding && options.lazyDecoding) {
+        throw std::invalid_argument{"Lazy decoding decodes fields on access, it has no tables of fields to decode"};
+    }
 
-    auto format = R"(
-#include %s
-#include %s
+    if (options.entityCache && options.lazyDecoding) {
+        throw std::invalid_argument{"Lazy decoding memoizes fields on access without locking, so lazily decoded "
+                                    "entities can't be shared between the readers of an entity cache"};
+    }
 
-// optional serialization
-namespace nlohmann {
-    template <typename T>
-    struct adl_serializer<%s::optional<T>> {
-        static void to_json(json & json, %s::optional<T> const & opt) {
-            if (opt.has_value()) {
-                json = *opt;
-            } else {
-                json = nullptr;
-            }
+    if (options.moveOnlyBoxes && options.lazyDecoding) {
+        throw std::invalid_argument{
+                "Lazily decoded objects copy their undecoded fields, so their boxes can't be move-only"};
+    }
+
+    if (options.tableDecoding && options.compactLayout) {
+        throw std::invalid_argument{
+                "Compact layout tracks nullable scalars in presence bits, which table decoding can't address"};
+    }
+}
+
+// The includes of a header, which depend on the options and on whether its types have boxed fields.
+static std::string generateIncludes(GenerationOptions const & options, bool hasBoxedFields) {
+    auto const isOnDemand = options.jsonBackend == JsonBackend::Simdjson;
+    auto const usesRuntimeHeader = !options.runtimeHeader.empty();
+
+    std::string includes;
+
+    if (usesRuntimeHeader) {
+        includes += "#include \"" + options.runtimeHeader + "\"";
+    } else {
+        includes += R"(#include <memory>
+#include <vector>
+#include "nlohmann/json.hpp")";
+    }
+    if (isOnDemand || options.checkedDecoding || options.internedIds) {
+        // For parseResponse, tryParseResponse and Id
+        includes += "\n#include <string_view>";
+    }
+
+    if (isOnDemand) {
+        includes += "\n#include \"simdjson.h\"";
+    }
+
+    if (options.tableDecoding) {
+        // For offsetof
+        includes += "\n#include <cstddef>";
+    }
+
+    if (hasBoxedFields) {
+        // For std::exchange
+        includes += "\n#include <utility>";
+        if (options.boxAllocator == BoxAllocator::Arena) {
+            includes += "\n#include <stdexcept>";
         }
+    }
 
-        static void from_json(const json & json, %s::optional<T> & opt) {
-            if (json.is_null()) {
-                opt.reset();
-            } else {
-                opt = json.get<T>();
-            }
+    if (options.asyncOperations) {
+        includes += R"(
+#include <coroutine>
+#include <deque>
+#include <exception>)";
+    }
+
+    if (options.asyncOperations || options.coalescedRequests) {
+        includes += "\n#include <functional>";
+    }
+
+    if (options.coalescedRequests) {
+        includes += "\n#include <future>";
+    }
+
+    if (hasCacheKeys(options)) {
+        // For memcpy
+        includes += "\n#include <cstring>";
+    }
+
+    if (options.resultCache) {
+        includes += R"(
+#include <chrono>
+#include <list>)";
+    }
+
+    if (options.entityCache || options.internedIds || options.coalescedRequests || options.resultCache) {
+        includes += R"(
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>)";
+    }
+
+    if (options.entityCache) {
+        includes += "\n#include <type_traits>";
+    }
+
+    if (options.internedIds) {
+        includes += "\n#include <atomic>";
+    }
+
+    for (auto const & scalarMapping : options.scalarMappings) {
+        if (auto const & include = scalarMapping.second.include) {
+            auto const isDelimited = !include->empty() && (include->front() == '<' || include->front() == '"');
+            includes += "\n#include " + (isDelimited ? *include : "\"" + *include + "\"");
+        }
+    }
+
+    return includes;
+}
+
+// What precedes the generated namespace: a check that the runtime header matches, or the serialization of optional
+// that it would declare, and the interned Id.
+static std::string generatePrelude(GenerationOptions const & options, std::string const & generatedNamespace) {
+    std::string prelude;
+
+    if (!options.runtimeHeader.empty()) {
+        prelude += "\n\n#if !defined(CAFFQL_RUNTIME_VERSION) || CAFFQL_RUNTIME_VERSION != " +
+                   std::to_string(runtimeHeaderVersion) + " || CAFFQL_RUNTIME_ABSL != " +
+                   std::to_string(options.algebraicNamespace == AlgebraicNamespace::Absl) + "\n";
+        prelude += "#error \"" + options.runtimeHeader + " doesn't match this header, generate it again with caffql "
+                   "--emit-runtime\"\n#endif\n\n";
+    } else {
+        prelude += generateOptionalSerialization(options.algebraicNamespace);
+    }
+
+    if (options.internedIds) {
+        prelude += generateInternedId(generatedNamespace);
+    }
+
+    return prelude;
+}
+
+// The types and functions that the generated types and operations use with the options.
+static std::string generateSupport(GenerationOptions const & options, bool hasBoxedFields, size_t indentation) {
+    auto const isOnDemand = options.jsonBackend == JsonBackend::Simdjson;
+    auto const hasIncrementalDelivery = !options.deferredFields.empty() || !options.streamedFields.empty();
+
+    std::string support;
+
+    if (options.lazyDecoding) {
+        support += generateLazyDecodingSupport(indentation);
+    } else if (options.compactLayout) {
+        support += generatePresenceBits(indentation);
+    }
+
+    if (isOnDemand) {
+        support += generateOnDemandDecodingSupport(options, indentation);
+    }
+
+    if (options.checkedDecoding) {
+        support += generateCheckedDecodingSupport(options, indentation);
+    }
+
+    if (options.tableDecoding) {
+        support += generateTableDecodingSupport(indentation);
+    }
+
+    if (hasIncrementalDelivery) {
+        support += generateIncrementalDeliverySupport(indentation);
+    }
+
+    if (options.asyncOperations) {
+        support += generateAsyncSupport(indentation);
+    }
+
+    if (hasCacheKeys(options)) {
+        support += generateCacheKeySupport(options, indentation);
+    }
+
+    if (options.coalescedRequests) {
+        support += generateCoalescingSupport(indentation);
+    }
+
+    if (options.resultCache) {
+        support += generateResultCacheSupport(indentation);
+    }
+
+    if (hasBoxedFields) {
+        support += generateBoxedSupport(options, indentation);
+    }
+
+    return support;
+}
+
+// Adds the declarations of a type to typeSource, and passes the functions it needs with the scope they are declared
+// in to addDefinitions, which defines them inline or moves them to implementation files.
+template <typename AddDefinitions>
+static void generateType(
+        Type const & type,
+        Schema const & schema,
+        TypeMap const & typeMap,
+        GenerationOptions const & options,
+        FieldRecursions const & recursions,
+        bool isInCycle,
+        bool isHeaderOnly,
+        size_t indentation,
+        std::string & typeSource,
+        AddDefinitions const & addDefinitions) {
+    auto const isOnDemand = options.jsonBackend == JsonBackend::Simdjson;
+    auto const hasIncrementalDelivery = !options.deferredFields.empty() || !options.streamedFields.empty();
+
+    auto isOperationType = [&](std::optional<Schema::OperationType> const & special) {
+        return isSchemaOperationType(type, special);
+    };
+
+    auto const isOperation = isOperationType(schema.queryType) || isOperationType(schema.mutationType) ||
+                             isOperationType(schema.subscriptionType);
+
+    auto addOperationTypes = [&](Operation operation) {
+        if (isHeaderOnly) {
+            typeSource += defineFunctionsInline(
+                    generateOperationTypes(type, operation, typeMap, options, indentation, recursions));
+            return;
+        }
+
+        // Split operations individually so they can be spread across implementation files.
+        typeSource += indent(indentation) + "namespace " + type.name + " {\n\n";
+        for (auto const & field : type.fields) {
+            addDefinitions(
+                    generateOperationType(field, operation, typeMap, options, indentation + 1, recursions),
+                    type.name + "::");
         }
+        typeSource += indent(indentation) + "} // namespace " + type.name + "\n\n";
     };
+
+    switch (type.kind) {
+    case TypeKind::Object:
+        if (isOperationType(schema.queryType)) {
+            addOperationTypes(Operation::Query);
+        } else if (isOperationType(schema.mutationType)) {
+            addOperationTypes(Operation::Mutation);
+        } else if (isOperationType(schema.subscriptionType)) {
+            addOperationTypes(Operation::Subscription);
+        } else if (options.lazyDecoding) {
+            typeSource += generateLazyObject(type, indentation, recursions);
+            addDefinitions(generateLazyObjectDeserialization(type, indentation));
+        } else if (options.compactLayout) {
+            typeSource += generateCompactObject(type, indentation, recursions);
+            addDefinitions(generateCompactObjectDeserialization(type, indentation, recursions));
+        } else if (options.tableDecoding) {
+            typeSource += generateObject(type, indentation, recursions);
+            addDefinitions(generateTableDeserialization(type.name, type, indentation, recursions));
+        } else {
+            typeSource += generateObject(type, indentation, recursions);
+            addDefinitions(generateObjectDeserialization(type, indentation, recursions));
+        }
+        if (isOnDemand && !isOperation) {
+            addDefinitions(
+                    generateOnDemandObjectDecoding(type, options.compactLayout, indentation, recursions));
+        }
+        if (options.checkedDecoding && !isOperation) {
+            addDefinitions(
+                    generateCheckedObjectDecoding(type, options.compactLayout, indentation, recursions));
+        }
+        if (hasIncrementalDelivery && !isOperation) {
+            addDefinitions(
+                    generateIncrementalObjectDecoding(type, options.compactLayout, indentation, recursions));
+        }
+        break;
+
+    case TypeKind::Interface:
+        if (options.lazyDecoding) {
+            typeSource += generateLazyInterface(type, indentation, recursions);
+            addDefinitions(generateLazyInterfaceDeserialization(type, indentation));
+        } else if (options.tableDecoding) {
+            typeSource += generateInterface(type, indentation, recursions);
+            addDefinitions(
+                    generateTableDeserialization(unknownCaseName + type.name, type, indentation, recursions) +
+                    generateVariantDeserialization(type, unknownCaseName + type.name + "(json)", indentation));
+        } else {
+            typeSource += generateInterface(type, indentation, recursions);
+            addDefinitions(generateInterfaceDeserialization(type, indentation, recursions));
+        }
+        if (isOnDemand) {
+            addDefinitions(generateOnDemandInterfaceDecoding(type, indentation, recursions));
+        }
+        if (options.checkedDecoding) {
+            addDefinitions(generateCheckedInterfaceDecoding(type, indentation, recursions));
+        }
+        if (hasIncrementalDelivery) {
+            addDefinitions(generateIncrementalInterfaceDecoding(type, indentation, recursions));
+        }
+        break;
+
+    case TypeKind::Union:
+        if (!isInCycle) {
+            typeSource += generateUnion(type, indentation);
+        }
+        if (options.lazyDecoding) {
+            addDefinitions(generateLazyUnionDeserialization(type, indentation));
+        } else {
+            addDefinitions(generateUnionDeserialization(type, indentation));
+        }
+        if (isOnDemand) {
+            addDefinitions(generateOnDemandUnionDecoding(type, indentation));
+        }
+        if (options.checkedDecoding) {
+            addDefinitions(generateCheckedUnionDecoding(type, indentation));
+        }
+        if (hasIncrementalDelivery) {
+            addDefinitions(generateIncrementalUnionDecoding(type, indentation));
+        }
+        break;
+
+    case TypeKind::Enum:
+        typeSource += generateEnum(type, indentation);
+        if (isHeaderOnly) {
+            typeSource += generateEnumSerialization(type, indentation);
+        } else {
+            addDefinitions(generateEnumSerializationFunctions(type, indentation));
+        }
+        if (isOnDemand) {
+            addDefinitions(generateOnDemandEnumDecoding(type, indentation));
+        }
+        if (options.checkedDecoding) {
+            addDefinitions(generateCheckedEnumDecoding(type, indentation));
+        }
+        break;
+
+    case TypeKind::InputObject:
+        typeSource += generateInputObject(type, indentation, recursions);
+        addDefinitions(generateInputObjectSerialization(type, indentation));
+        if (hasCacheKeys(options)) {
+            addDefinitions(generateInputObjectCacheKeyEncoding(type, indentation));
+        }
+        break;
+
+    case TypeKind::Scalar:
+    case TypeKind::List:
+    case TypeKind::NonNull:
+        break;
+    }
 }
 
-)";
+// The entity cache and layout report, which are generated for the types of the schema other than its operation types.
+static std::string generateDataTypeSupport(
+        std::vector<Type> const & sortedTypes,
+        Schema const & schema,
+        GenerationOptions const & options,
+        FieldRecursions const & recursions,
+        size_t indentation,
+        GenerationStatistics * statistics) {
+    using Clock = std::chrono::steady_clock;
 
-    std::string buffer(1000, '\0');
-    int len = snprintf(
-            &buffer[0],
-            buffer.size(),
-            format,
-            optionalInclude,
-            variantInclude,
-            namespaceName.c_str(),
-            namespaceName.c_str(),
-            namespaceName.c_str());
-    buffer.resize(len);
-    return buffer;
+    std::string support;
+
+    std::vector<Type> dataTypes;
+    std::copy_if(sortedTypes.begin(), sortedTypes.end(), std::back_inserter(dataTypes), [&](Type const & type) {
+        return !isSchemaOperationType(type, schema.queryType) && !isSchemaOperationType(type, schema.mutationType) &&
+               !isSchemaOperationType(type, schema.subscriptionType);
+    });
+
+    if (options.entityCache) {
+        auto const entityCacheStart = Clock::now();
+
+        support += generateEntityCache(dataTypes, options, indentation, recursions);
+
+        if (statistics) {
+            statistics->addPhase("entity cache emission", millisecondsSince(entityCacheStart));
+        }
+    }
+
+    if (options.layoutReport) {
+        support += generateLayoutReport(dataTypes, options, indentation);
+    }
+
+    return support;
 }
 
-std::string generateTypes(
-        Schema const & schema, std::string const & generatedNamespace, AlgebraicNamespace algebraicNamespace) {
-    auto const sortedTypes = sortCustomTypesByDependencyOrder(schema.types);
+GeneratedSources generateSources(
+        Schema const & inputSchema,
+        std::string const & generatedNamespace,
+        std::string const & headerInclude,
+        GenerationOptions const & options,
+        GenerationStatistics * statistics,
+        GenerationCache * cache) {
+    using Clock = std::chrono::steady_clock;
+
+    auto const algebraicNamespace = options.algebraicNamespace;
+    auto const hasIncrementalDelivery = !options.deferredFields.empty() || !options.streamedFields.empty();
+
+    auto const selectsOperationTypes = hasOperationTypeFields(inputSchema);
+    auto const hasSelectedOperations = !options.operations.empty();
+    auto const copiesSchema =
+            hasIncrementalDelivery || selectsOperationTypes || options.excludeDeprecated || hasSelectedOperations;
+
+    // Only copied when there are fields to mark or leave out
+    auto copiedSchema = hasIncrementalDelivery ? withIncrementalDelivery(inputSchema, options)
+                                               : copiesSchema ? inputSchema : Schema{};
+    if (selectsOperationTypes) {
+        removeOperationTypeFields(copiedSchema);
+    }
+    if (options.excludeDeprecated) {
+        removeDeprecatedFields(copiedSchema, options);
+    }
+    if (hasSelectedOperations) {
+        keepSelectedOperations(copiedSchema, options.operations);
+    }
+    auto const & schema = copiesSchema ? copiedSchema : inputSchema;
+
+    checkOptionCombinations(options);
+
+    auto const sortStart = Clock::now();
+    auto const components = sortCustomTypeComponents(schema.types);
+    auto const recursions = findFieldRecursions(components);
+
+    std::vector<Type> sortedTypes;
+    // Components of types in cycles by the name of their first type, which their forward declarations precede
+    std::unordered_map<std::string, std::vector<Type> const *> cyclesByFirstType;
+    std::unordered_set<std::string> typesInCycles;
+    auto hasBoxedFields = false;
+
+    for (auto const & component : components) {
+        if (isCycle(component, recursions)) {
+            cyclesByFirstType[component.front().name] = &component;
+            for (auto const & type : component) {
+                typesInCycles.insert(type.name);
+                hasBoxedFields |= hasFieldRecursion(type, recursions, true);
+            }
+        }
+        sortedTypes.insert(sortedTypes.end(), component.begin(), component.end());
+    }
+
+    if (statistics) {
+        statistics->addPhase("sort", millisecondsSince(sortStart));
+
+        for (auto const & type : schema.types) {
+            ++statistics->typeKindCounts[type.kind];
+        }
+    }
 
     TypeMap typeMap;
 
@@ -914,89 +5722,233 @@ std::string generateTypes(
     }
 
     std::string source;
+    auto const usesRuntimeHeader = !options.runtimeHeader.empty();
 
-    source +=
-            R"(// This file was automatically generated and should not be edited.
-#pragma once
-
-#include <memory>
-#include <vector>
-#include "nlohmann/json.hpp")";
+    source += "// This file was automatically generated and should not be edited.\n#pragma once\n\n";
+    if (options.asyncOperations) {
+        source += "#if !defined(__cpp_impl_coroutine)\n#error \"Headers generated with --async need c++20 "
+                  "coroutines\"\n#endif\n\n";
+    }
+    source += generateIncludes(options, hasBoxedFields);
 
-    source += generateOptionalSerialization(algebraicNamespace);
+    source += generatePrelude(options, generatedNamespace);
 
     source += "namespace " + generatedNamespace + " {\n\n";
 
+    if (cache) {
+        if (cache->options != options) {
+            cache->renderedTypes.clear();
+            cache->options = options;
+        }
+        cache->reusedTypeCount = 0;
+        cache->renderedTypeCount = 0;
+    }
+
     size_t typeIndentation = 1;
 
-    source += indent(typeIndentation) + "using " + cppJsonTypeName + " = nlohmann::json;\n";
-    source += indent(typeIndentation) + "using " + cppIdTypeName + " = std::string;\n";
+    if (usesRuntimeHeader) {
+        source += generateRuntimeUsingDeclarations(algebraicNamespace, !options.internedIds, typeIndentation);
+    } else {
+        source += generateRuntimeDeclarations(algebraicNamespace, !options.internedIds, typeIndentation);
+    }
+
+    std::vector<std::string> implementations(options.implementationFiles);
 
-    auto useAlgebraic = [&](char const * name) {
-        source +=
-                indent(typeIndentation) + "using " + algrebraicNamespaceName(algebraicNamespace) + "::" + name + ";\n";
+    // Function definitions go to the smallest implementation file so that they compile in similar amounts of time.
+    auto distributeDefinitions = [&](std::string const & outOfLineDefinitions) {
+        auto implementation = std::min_element(
+                implementations.begin(), implementations.end(), [](auto const & lhs, auto const & rhs) {
+                    return lhs.size() < rhs.size();
+                });
+        *implementation += outOfLineDefinitions;
     };
 
-    useAlgebraic("optional");
-    useAlgebraic("variant");
-    useAlgebraic("monostate");
-    useAlgebraic("visit");
-    source += "\n";
+    // Adds definitions to the header, or declarations to the header and definitions to rendered.definitions.
+    auto addDefinitionsTo = [&](GenerationCache::RenderedType & rendered,
+                                GeneratedCode const & definitions,
+                                std::string const & scope = "") {
+        if (implementations.empty()) {
+            rendered.source += defineFunctionsInline(definitions);
+        } else {
+            rendered.definitions.push_back(
+                    moveFunctionsOutOfLine(definitions, scope, typeIndentation, rendered.source));
+        }
+    };
+
+    auto addRendered = [&](GenerationCache::RenderedType const & rendered) {
+        source += rendered.source;
+        for (auto const & definitions : rendered.definitions) {
+            distributeDefinitions(definitions);
+        }
+    };
+
+    auto generatedSize = [&] {
+        auto size = source.size();
+        for (auto const & implementation : implementations) {
+            size += implementation.size();
+        }
+        return size;
+    };
+
+    if (!usesRuntimeHeader) {
+        source += generateGraphqlErrorType(typeIndentation);
+        GenerationCache::RenderedType graphqlError;
+        addDefinitionsTo(graphqlError, generateGraphqlErrorDeserialization(typeIndentation));
+        addRendered(graphqlError);
+    }
+
+    for (auto const & type : schema.types) {
+        if (type.kind != TypeKind::Scalar || isBuiltinScalar(type.name)) {
+            continue;
+        }
+
+        auto const mapping = options.scalarMappings.find(type.name);
+        auto const scalarMapping = mapping != options.scalarMappings.end()
+                                           ? std::optional<ScalarMapping>(mapping->second)
+                                           : std::nullopt;
 
-    source += indent(typeIndentation) + "enum class Operation { Query, Mutation, Subscription };\n\n";
+        GenerationCache::RenderedType customScalar;
+        customScalar.source += generateCustomScalar(type, scalarMapping, typeIndentation);
+        addDefinitionsTo(customScalar, generateCustomScalarSerialization(type, scalarMapping, typeIndentation));
+        addRendered(customScalar);
+    }
+
+    source += generateSupport(options, hasBoxedFields, typeIndentation);
 
-    source += generateGraphqlErrorType(typeIndentation);
-    source += generateGraphqlErrorDeserialization(typeIndentation);
+    // Functions of types in a cycle are defined in the header after all of the cycle's types, once they are complete.
+    GeneratedCode cycleDefinitions;
+    size_t remainingCycleTypeCount = 0;
 
     for (auto const & type : sortedTypes) {
         auto isOperationType = [&](std::optional<Schema::OperationType> const & special) {
-            return special && special->name == type.name;
+            return isSchemaOperationType(type, special);
         };
 
-        switch (type.kind) {
-        case TypeKind::Object:
-            if (isOperationType(schema.queryType)) {
-                source += generateOperationTypes(type, Operation::Query, typeMap, typeIndentation);
-            } else if (isOperationType(schema.mutationType)) {
-                source += generateOperationTypes(type, Operation::Mutation, typeMap, typeIndentation);
-            } else if (isOperationType(schema.subscriptionType)) {
-                source += generateOperationTypes(type, Operation::Subscription, typeMap, typeIndentation);
-            } else {
-                source += generateObject(type, typeIndentation);
-                source += generateObjectDeserialization(type, typeIndentation);
+        auto const isOperation = isOperationType(schema.queryType) || isOperationType(schema.mutationType) ||
+                                 isOperationType(schema.subscriptionType);
+
+        auto const typeStart = Clock::now();
+        auto const generatedSizeBefore = generatedSize();
+
+        auto const cycle = cyclesByFirstType.find(type.name);
+        if (cycle != cyclesByFirstType.end()) {
+            source += generateForwardDeclarations(*cycle->second, typeIndentation);
+            remainingCycleTypeCount = cycle->second->size();
+        }
+
+        // Unions in cycles are declared with the forward declarations, so how types in cycles are rendered depends on
+        // the other types in their cycle, which isn't cached.
+        auto const isInCycle = typesInCycles.count(type.name) > 0;
+
+        auto recordStatistics = [&] {
+            if (!statistics) {
+                return;
             }
-            break;
 
-        case TypeKind::Interface:
-            source += generateInterface(type, typeIndentation);
-            source += generateInterfaceDeserialization(type, typeIndentation);
-            break;
+            auto const phase = isOperation ? "operation emission" : emissionPhaseName(type.kind);
+            statistics->addPhase(phase, millisecondsSince(typeStart));
+            statistics->typeBytes[type.name] = generatedSize() - generatedSizeBefore;
+
+            if (isOperation) {
+                auto const operation = isOperationType(schema.queryType)
+                                               ? Operation::Query
+                                               : isOperationType(schema.mutationType) ? Operation::Mutation
+                                                                                      : Operation::Subscription;
+                for (auto const & field : type.fields) {
+                    auto const document =
+                            generateQueryDocument(field, operation, typeMap, 0, options.recursionDepth, recursions);
+                    statistics->operations.push_back({type.name + "." + field.name,
+                                                      document.query.size(),
+                                                      document.variables.size(),
+                                                      selectionDepth(document.query)});
+                }
+            }
+        };
 
-        case TypeKind::Union:
-            source += generateUnion(type, typeIndentation);
-            source += generateUnionDeserialization(type, typeIndentation);
-            break;
+        std::vector<Type> dependencies;
+        if (cache && isOperation) {
+            for (auto const & name : reachableTypeNames(type, typeMap)) {
+                auto const dependency = typeMap.find(name);
+                if (dependency != typeMap.end()) {
+                    dependencies.push_back(dependency->second);
+                }
+            }
+        }
 
-        case TypeKind::Enum:
-            source += generateEnum(type, typeIndentation);
-            source += generateEnumSerialization(type, typeIndentation);
-            break;
+        if (cache && !isInCycle) {
+            auto const cached = cache->renderedTypes.find(type.name);
+            if (cached != cache->renderedTypes.end() && cached->second.type == type &&
+                cached->second.dependencies == dependencies) {
+                addRendered(cached->second);
+                ++cache->reusedTypeCount;
+                recordStatistics();
+                continue;
+            }
+        }
 
-        case TypeKind::InputObject:
-            source += generateInputObject(type, typeIndentation);
-            source += generateInputObjectSerialization(type, typeIndentation);
-            break;
+        GenerationCache::RenderedType rendered{type, std::move(dependencies)};
+        auto & typeSource = rendered.source;
 
-        case TypeKind::Scalar:
-        case TypeKind::List:
-        case TypeKind::NonNull:
-            break;
+        auto addDefinitions = [&](GeneratedCode const & definitions, std::string const & scope = "") {
+            if (isInCycle && implementations.empty()) {
+                cycleDefinitions += definitions;
+            } else {
+                addDefinitionsTo(rendered, definitions, scope);
+            }
+        };
+
+        generateType(type,
+                     schema,
+                     typeMap,
+                     options,
+                     recursions,
+                     isInCycle,
+                     implementations.empty(),
+                     typeIndentation,
+                     typeSource,
+                     addDefinitions);
+
+        addRendered(rendered);
+
+        if (isInCycle && --remainingCycleTypeCount == 0) {
+            source += generateInlineFunctionDeclarations(cycleDefinitions) + "\n" +
+                      defineFunctionsInline(cycleDefinitions);
+            cycleDefinitions = {};
+        }
+
+        if (cache && !isInCycle) {
+            cache->renderedTypes[type.name] = std::move(rendered);
+            ++cache->renderedTypeCount;
+        }
+
+        recordStatistics();
+    }
+
+    if (cache) {
+        // Forget types that were removed from the schema.
+        for (auto it = cache->renderedTypes.begin(); it != cache->renderedTypes.end();) {
+            it = typeMap.count(it->first) > 0 ? std::next(it) : cache->renderedTypes.erase(it);
         }
     }
 
+    source += generateDataTypeSupport(sortedTypes, schema, options, recursions, typeIndentation, statistics);
+
     source += "} // namespace " + generatedNamespace + "\n";
 
-    return source;
+    for (auto & implementation : implementations) {
+        implementation = "// This file was automatically generated and should not be edited.\n#include \"" +
+                         headerInclude + "\"\n\nnamespace " + generatedNamespace + " {\n\n" + implementation +
+                         "} // namespace " + generatedNamespace + "\n";
+    }
+
+    return {std::move(source), std::move(implementations)};
+}
+
+std::string generateTypes(
+        Schema const & schema, std::string const & generatedNamespace, GenerationOptions const & options) {
+    auto headerOnlyOptions = options;
+    headerOnlyOptions.implementationFiles = 0;
+    return generateSources(schema, generatedNamespace, "", headerOnlyOptions).header;
 }
 
 } // namespace caffql
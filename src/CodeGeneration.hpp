@@ -1,4 +1,6 @@
 #pragma once
+#include <map>
+#include <set>
 #include <unordered_set>
 #include "BoxedOptional.hpp"
 
@@ -25,7 +27,7 @@ struct TypeRef {
     TypeKind kind;
     std::optional<std::string> name;
     // NonNull and List only
-    BoxedOptional<TypeRef> ofType;
+    BoxedOptional<TypeRef, BoxPool<TypeRef>> ofType;
 
     TypeRef const & underlyingType() const {
         if (ofType) {
@@ -47,25 +49,36 @@ struct InputValue {
 CAFFQL_DEFINE_EQUALS(InputValue,
                      return lhs.type == rhs.type && lhs.name == rhs.name && lhs.description == rhs.description;)
 
+// How a field is selected with incremental delivery: in a deferred fragment, which the server sends in a later
+// payload, or, for lists, streamed with their items sent in later payloads.
+enum class IncrementalDelivery { None, Deferred, Streamed };
+
 struct Field {
     TypeRef type;
     std::string name;
     std::optional<std::string> description;
     std::vector<InputValue> args;
-    // TODO: Deprecation
+    bool isDeprecated = false;
+    std::optional<std::string> deprecationReason;
+    // Chosen by GenerationOptions, not the schema
+    IncrementalDelivery delivery = IncrementalDelivery::None;
 };
 
 CAFFQL_DEFINE_EQUALS(Field,
                      return lhs.type == rhs.type && lhs.name == rhs.name && lhs.description == rhs.description &&
-                            lhs.args == rhs.args;)
+                            lhs.args == rhs.args && lhs.isDeprecated == rhs.isDeprecated &&
+                            lhs.deprecationReason == rhs.deprecationReason && lhs.delivery == rhs.delivery;)
 
 struct EnumValue {
     std::string name;
     std::optional<std::string> description;
-    // TODO: Deprecation
+    bool isDeprecated = false;
+    std::optional<std::string> deprecationReason;
 };
 
-CAFFQL_DEFINE_EQUALS(EnumValue, return lhs.name == rhs.name && lhs.description == rhs.description;)
+CAFFQL_DEFINE_EQUALS(EnumValue,
+                     return lhs.name == rhs.name && lhs.description == rhs.description &&
+                            lhs.isDeprecated == rhs.isDeprecated && lhs.deprecationReason == rhs.deprecationReason;)
 
 struct Type {
     TypeKind kind;
@@ -133,18 +146,210 @@ void from_json(Json const & json, Schema::OperationType & operationType);
 
 void from_json(Json const & json, Schema & schema);
 
-// Sorts dependent types before their dependencies so types can be declared in the proper compilation order.
-// Subsorts alphabetically so that sorting is deterministic.
+// Types parsed by earlier parseSchema calls, keyed by the hash of their json text.
+struct SchemaParseCache {
+    struct ParsedType {
+        std::string text;
+        Type type;
+    };
+
+    std::unordered_map<size_t, ParsedType> types;
+};
+
+// Parses the schema in an introspection query response. If cache isn't null, only the types whose json text isn't in
+// the cache are parsed, and the cache is replaced with the types of this schema.
+Schema parseSchema(std::string const & text, SchemaParseCache * cache = nullptr);
+
+// Groups types that depend on each other, directly or through other types, into components, and sorts the
+// components after the ones they depend on so types can be declared in the proper compilation order. Subsorts
+// alphabetically so that sorting is deterministic. Types in a cycle are ordered so that as many of them as possible
+// are complete where they are used.
+std::vector<std::vector<Type>> sortCustomTypeComponents(std::vector<Type> const & types);
+
+// The types of sortCustomTypeComponents, one component after another.
 std::vector<Type> sortCustomTypesByDependencyOrder(std::vector<Type> const & types);
 
+// How a field refers to a type in a cycle with the field's own type, which follows from sorting rather than the
+// schema. Queries only select recursive fields to a limited depth, so they are optional even where the schema makes
+// them non null. Boxed fields are recursive fields that aren't lists and whose type isn't complete where their own
+// type is declared, so their value is allocated separately.
+enum class FieldRecursion { None, Recursive, Boxed };
+
+// Fields and input fields, named like Type.field, that refer to a type in a cycle with their own type. Other fields
+// have no recursion.
+using FieldRecursions = std::unordered_map<std::string, FieldRecursion>;
+
+// The recursions of the fields of components sorted by sortCustomTypeComponents. Fields of interfaces have the same
+// recursion as the fields of their implementations.
+FieldRecursions findFieldRecursions(std::vector<std::vector<Type>> const & components);
+
+FieldRecursion fieldRecursion(
+        FieldRecursions const & recursions, std::string const & typeName, std::string const & fieldName);
+
 constexpr size_t spacesPerIndent = 4;
 constexpr auto unknownCaseName = "Unknown";
 constexpr auto cppJsonTypeName = "Json";
 constexpr auto cppIdTypeName = "Id";
 constexpr auto grapqlErrorTypeName = "GraphqlError";
+constexpr auto boxedTypeName = "BoxedOptional";
+// Times a query selects a recursive field within its own selection
+constexpr size_t defaultRecursionDepth = 2;
+
+enum class AlgebraicNamespace { Std, Absl };
+
+// Parser that generated deserializers read responses with. Generated types and functions are the same for every
+// backend, only how parseResponse decodes text differs.
+enum class JsonBackend { Nlohmann, Simdjson };
+
+std::string jsonBackendName(JsonBackend backend);
+
+// Throws std::invalid_argument for names that aren't a backend.
+JsonBackend jsonBackendNamed(std::string const & name);
+
+// How the values of boxed recursive fields are allocated: with new, from a free list per thread that reuses freed
+// boxes, or in the BoxArena whose scope is active on the thread, which frees all of them at once.
+enum class BoxAllocator { Heap, Pool, Arena };
+
+std::string boxAllocatorName(BoxAllocator allocator);
+
+// Throws std::invalid_argument for names that aren't an allocator.
+BoxAllocator boxAllocatorNamed(std::string const & name);
+
+// The c++ type that a custom scalar is decoded into.
+struct ScalarMapping {
+    std::string cppType;
+    // Functions converting between json and cppType, `cppType decode(Json const &)` and `Json encode(cppType const &)`.
+    // Without them cppType is serialized with its own to_json and from_json.
+    std::optional<std::string> decode;
+    std::optional<std::string> encode;
+    // Header declaring cppType and its codec, either <header> or "header"
+    std::optional<std::string> include;
+};
+
+CAFFQL_DEFINE_EQUALS(ScalarMapping,
+                     return lhs.cppType == rhs.cppType && lhs.decode == rhs.decode && lhs.encode == rhs.encode &&
+                            lhs.include == rhs.include;)
+
+// Reads a mapping like {"type": "int64_t", "decode": "parseDateTime", "encode": "formatDateTime", "include":
+// "<DateTime.hpp>"}.
+void from_json(Json const & json, ScalarMapping & mapping);
+
+void to_json(Json & json, ScalarMapping const & mapping);
+
+std::string algrebraicNamespaceName(AlgebraicNamespace algebraicNamespace);
+
+struct GenerationOptions {
+    AlgebraicNamespace algebraicNamespace = AlgebraicNamespace::Std;
+    bool entityCache = false;
+    // Objects keep a reference to their json and decode each field on first access
+    bool lazyDecoding = false;
+    // Number of implementation files to define serialization and operation functions in, or 0 to define them inline
+    // in the header.
+    size_t implementationFiles = 0;
+    // Objects order members by alignment and track nullable scalars in a presence bitfield instead of optional
+    bool compactLayout = false;
+    // Generate a function reporting the size and padding of each object
+    bool layoutReport = false;
+    // Generate Id as a handle to a string in a shared intern table instead of as a string
+    bool internedIds = false;
+    // Custom scalars by name. Custom scalars without a mapping are kept as json.
+    std::map<std::string, ScalarMapping> scalarMappings;
+    // Responses decoded by parseResponse are read with simdjson's on demand parser instead of parsed into Json first
+    JsonBackend jsonBackend = JsonBackend::Nlohmann;
+    // Operations also get tryResponse functions that report malformed responses as decode errors without throwing
+    bool checkedDecoding = false;
+    // Fields, named like Type.field, that operations select in deferred fragments or stream the items of
+    std::set<std::string> deferredFields;
+    std::set<std::string> streamedFields;
+    // Operations also get coroutines that execute them over a transport, which need c++20
+    bool asyncOperations = false;
+    // Queries also get fetch functions that share concurrent requests with the same variables
+    bool coalescedRequests = false;
+    // Queries also get cacheKey functions identifying their arguments, for a result cache that is generated with them
+    bool resultCache = false;
+    // Include path of a runtime header from generateRuntimeHeader to use instead of repeating its prelude, or empty
+    std::string runtimeHeader;
+    // Times a query selects a recursive field within its own selection, after which the field is left out
+    size_t recursionDepth = defaultRecursionDepth;
+    // Allocator of the values of boxed recursive fields
+    BoxAllocator boxAllocator = BoxAllocator::Heap;
+    // Boxed recursive fields, and so the types containing them, are moved but not copied
+    bool moveOnlyBoxes = false;
+    // Objects are decoded by a single function interpreting a constexpr table of their fields, instead of each having
+    // a from_json of its own decoding every field
+    bool tableDecoding = false;
+    // Operations, named like Query.user, to generate along with only the types they reach, or empty for all of them
+    std::set<std::string> operations;
+    // Deprecated fields are left out of types and queries, except for the ones named like Type.field in
+    // keptDeprecatedFields and selected operations
+    bool excludeDeprecated = false;
+    std::set<std::string> keptDeprecatedFields;
+};
+
+CAFFQL_DEFINE_EQUALS(GenerationOptions,
+                     return lhs.algebraicNamespace == rhs.algebraicNamespace && lhs.entityCache == rhs.entityCache &&
+                            lhs.lazyDecoding == rhs.lazyDecoding &&
+                            lhs.implementationFiles == rhs.implementationFiles &&
+                            lhs.compactLayout == rhs.compactLayout && lhs.layoutReport == rhs.layoutReport &&
+                            lhs.internedIds == rhs.internedIds && lhs.scalarMappings == rhs.scalarMappings &&
+                            lhs.runtimeHeader == rhs.runtimeHeader && lhs.jsonBackend == rhs.jsonBackend &&
+                            lhs.checkedDecoding == rhs.checkedDecoding && lhs.deferredFields == rhs.deferredFields &&
+                            lhs.streamedFields == rhs.streamedFields && lhs.asyncOperations == rhs.asyncOperations &&
+                            lhs.coalescedRequests == rhs.coalescedRequests && lhs.resultCache == rhs.resultCache &&
+                            lhs.recursionDepth == rhs.recursionDepth && lhs.boxAllocator == rhs.boxAllocator &&
+                            lhs.moveOnlyBoxes == rhs.moveOnlyBoxes && lhs.tableDecoding == rhs.tableDecoding &&
+                            lhs.operations == rhs.operations && lhs.excludeDeprecated == rhs.excludeDeprecated &&
+                            lhs.keptDeprecatedFields == rhs.keptDeprecatedFields;)
 
 std::string indent(size_t indentation);
 
+// A function of generated code, which the header defines inline, or declares when an implementation file defines it.
+struct GeneratedFunction {
+    std::string returnType;
+    // The function's name and parameters, like from_json(Json const & json, User & value)
+    std::string declarator;
+    // The statements of the body, indented one level deeper than the function
+    std::string body;
+    size_t indentation = 0;
+    // For static member functions, the structs enclosing the function that its definition is qualified by, like
+    // UserField::. Free functions have none, and are declared inline.
+    std::optional<std::string> memberScope;
+};
+
+// Generated code that keeps its functions apart from the text around them, so that they can be defined in place or
+// moved out of line without parsing the text.
+struct GeneratedCode {
+    struct Part {
+        std::string text;
+        // Function following the text, if any
+        std::optional<GeneratedFunction> function;
+    };
+
+    std::vector<Part> parts;
+
+    GeneratedCode() = default;
+    GeneratedCode(GeneratedFunction function);
+
+    GeneratedCode & operator+=(std::string const & text);
+    GeneratedCode & operator+=(GeneratedFunction function);
+    GeneratedCode & operator+=(GeneratedCode const & code);
+};
+
+GeneratedCode operator+(GeneratedCode lhs, GeneratedCode const & rhs);
+
+// The text of code with its functions defined where they are.
+std::string defineFunctionsInline(GeneratedCode const & code);
+
+// Splits code into declarations and out of line definitions. The text of code and the declarations of its functions
+// are appended to declarations, and the definitions of its functions, indented at definitionIndentation, returned.
+// Free functions are defined in the namespace they are declared in, and static member functions are qualified by
+// scope, the namespaces enclosing code, followed by their member scope.
+std::string moveFunctionsOutOfLine(
+        GeneratedCode const & code,
+        std::string const & scope,
+        size_t definitionIndentation,
+        std::string & declarations);
+
 std::string generateDescription(std::optional<std::string> const & description, size_t indentation);
 
 std::string screamingSnakeCaseToPascalCase(std::string const & snake);
@@ -157,42 +362,78 @@ std::string generateEnum(Type const & type, size_t indentation);
 
 std::string generateEnumSerialization(Type const & type, size_t indentation);
 
+// Non template enum serialization functions that, unlike NLOHMANN_JSON_SERIALIZE_ENUM, can be defined out of line.
+GeneratedCode generateEnumSerializationFunctions(Type const & type, size_t indentation);
+
+// Whether name is one of the scalars every GraphQL schema has, rather than a custom scalar.
+bool isBuiltinScalar(std::string const & name);
+
 Scalar scalarType(std::string const & name);
 
 std::string cppScalarName(Scalar scalar);
 
 std::string cppTypeName(TypeRef const & type, bool shouldCheckNullability = true);
 
+// The c++ type of a field's member, which for boxed fields is a BoxedOptional and for other recursive fields is
+// optional.
+std::string cppFieldTypeName(Field const & field, FieldRecursion recursion = FieldRecursion::None);
+
+std::string cppFieldTypeName(InputValue const & field, FieldRecursion recursion = FieldRecursion::None);
+
 std::string graphqlTypeName(TypeRef const & type);
 
 std::string cppVariant(std::vector<TypeRef> const & possibleTypes, std::string const & unknownTypeName);
 
-std::string generateDeserializationFunctionDeclaration(std::string const & typeName, size_t indentation);
+// An inline from_json for typeName, whose body decodes json into value.
+GeneratedFunction deserializationFunction(std::string const & typeName, size_t indentation);
+
+// Whether decoding fails without field: non null fields that aren't deferred to a later payload or recursive, since
+// queries leave recursive fields out past their recursion depth.
+bool isRequiredField(Field const & field, FieldRecursion recursion = FieldRecursion::None);
 
-std::string generateFieldDeserialization(Field const & field, size_t indentation);
+std::string generateFieldDeserialization(
+        Field const & field, size_t indentation, FieldRecursion recursion = FieldRecursion::None);
 
-std::string generateVariantDeserialization(Type const & type, std::string const & constructUnknown, size_t indentation);
+GeneratedCode generateVariantDeserialization(
+        Type const & type, std::string const & constructUnknown, size_t indentation);
 
-std::string generateInterface(Type const & type, size_t indentation);
+std::string generateInterface(Type const & type, size_t indentation, FieldRecursions const & recursions = {});
 
-std::string generateInterfaceUnknownCaseDeserialization(Type const & type, size_t indentation);
+GeneratedCode generateInterfaceUnknownCaseDeserialization(
+        Type const & type, size_t indentation, FieldRecursions const & recursions = {});
 
-std::string generateInterfaceDeserialization(Type const & type, size_t indentation);
+GeneratedCode generateInterfaceDeserialization(
+        Type const & type, size_t indentation, FieldRecursions const & recursions = {});
 
 std::string generateUnion(Type const & type, size_t indentation);
 
-std::string generateUnionDeserialization(Type const & type, size_t indentation);
+GeneratedCode generateUnionDeserialization(Type const & type, size_t indentation);
 
-std::string generateObject(Type const & type, size_t indentation);
+std::string generateObject(Type const & type, size_t indentation, FieldRecursions const & recursions = {});
 
-std::string generateObjectDeserialization(Type const & type, size_t indentation);
+GeneratedCode generateObjectDeserialization(
+        Type const & type, size_t indentation, FieldRecursions const & recursions = {});
 
-std::string generateInputObject(Type const & type, size_t indentation);
+// An alias or, for a mapping with a codec, a wrapper of the mapped c++ type named after the custom scalar.
+std::string generateCustomScalar(
+        Type const & type, std::optional<ScalarMapping> const & mapping, size_t indentation);
 
-std::string generateInputObjectSerialization(Type const & type, size_t indentation);
+// Serialization through the codec of mapping, or nothing for mappings without a codec.
+GeneratedCode generateCustomScalarSerialization(
+        Type const & type, std::optional<ScalarMapping> const & mapping, size_t indentation);
+
+std::string generateInputObject(Type const & type, size_t indentation, FieldRecursions const & recursions = {});
+
+GeneratedCode generateInputObjectSerialization(Type const & type, size_t indentation);
+
+// An encodeCacheArgument function encoding the fields of an input object one after another, for cache keys.
+GeneratedCode generateInputObjectCacheKeyEncoding(Type const & type, size_t indentation);
 
 std::string operationQueryName(Operation operation);
 
+// The name of the operation selecting field, like query User.
+std::string operationName(Field const & field, Operation operation);
+
 struct QueryVariable {
     std::string name;
     TypeRef type;
@@ -202,20 +443,26 @@ CAFFQL_DEFINE_EQUALS(QueryVariable, return lhs.name == rhs.name && lhs.type == r
 
 std::string appendNameToVariablePrefix(std::string const & variablePrefix, std::string const & name);
 
+// Selects the fields of type, leaving out its recursive fields when recursionDepth is 0.
 std::string generateQueryFields(
         Type const & type,
         TypeMap const & typeMap,
         std::string const & variablePrefix,
         std::vector<QueryVariable> & variables,
         std::vector<Field> const & ignoredFields,
-        size_t indentation);
+        size_t indentation,
+        size_t recursionDepth = defaultRecursionDepth,
+        FieldRecursions const & recursions = {});
 
+// Selects field, whose selection set selects recursive fields recursionDepth more times.
 std::string generateQueryField(
         Field const & field,
         TypeMap const & typeMap,
         std::string const & variablePrefix,
         std::vector<QueryVariable> & variables,
-        size_t indentation);
+        size_t indentation,
+        size_t recursionDepth = defaultRecursionDepth,
+        FieldRecursions const & recursions = {});
 
 struct QueryDocument {
     std::string query;
@@ -223,29 +470,260 @@ struct QueryDocument {
 };
 
 QueryDocument generateQueryDocument(
-        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation);
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        size_t indentation,
+        size_t recursionDepth = defaultRecursionDepth,
+        FieldRecursions const & recursions = {});
 
 bool shouldPassByReferenceToRequestFunction(TypeRef const & type);
 
-std::string generateOperationRequestFunction(
-        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation);
+GeneratedCode generateOperationRequestFunction(
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        size_t indentation,
+        size_t recursionDepth = defaultRecursionDepth,
+        FieldRecursions const & recursions = {});
+
+GeneratedCode generateOperationResponseFunction(Field const & field, size_t indentation);
+
+GeneratedCode generateLazyOperationResponseFunction(Field const & field, size_t indentation);
+
+// A parseResponse function decoding response text in a single pass with the simdjson backend. Operations only have
+// one with that backend, with nlohmann json the text is parsed into the json that response takes.
+GeneratedCode generateOperationParseResponseFunction(Field const & field, size_t indentation);
 
-std::string generateOperationResponseFunction(Field const & field, size_t indentation);
+// tryResponse and tryParseResponse functions returning a DecodeResult instead of throwing.
+GeneratedCode generateOperationTryResponseFunctions(Field const & field, size_t indentation);
 
-std::string generateOperationType(
-        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation);
+// An applyPayload function applying subsequent payloads of incremental delivery to decoded data.
+GeneratedCode generateOperationApplyPayloadFunction(Field const & field, size_t indentation);
 
-std::string generateOperationTypes(Type const & type, Operation operation, TypeMap const & typeMap, size_t indentation);
+// An execute coroutine that sends the operation's request over a transport and decodes the response.
+GeneratedCode generateOperationExecuteFunction(std::vector<QueryVariable> const & variables, size_t indentation);
+
+// A fetch function that makes the operation's request through a GraphqlRequestCoalescer, sharing it with concurrent
+// fetches with the same arguments.
+GeneratedCode generateOperationFetchFunction(
+        Field const & field, Operation operation, std::vector<QueryVariable> const & variables, size_t indentation);
+
+// A cacheKey function making the key of the operation's name and arguments.
+GeneratedCode generateOperationCacheKeyFunction(
+        Field const & field, Operation operation, std::vector<QueryVariable> const & variables, size_t indentation);
+
+GeneratedCode generateOperationType(
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        GenerationOptions const & options,
+        size_t indentation,
+        FieldRecursions const & recursions = {});
+
+GeneratedCode generateOperationTypes(
+        Type const & type,
+        Operation operation,
+        TypeMap const & typeMap,
+        GenerationOptions const & options,
+        size_t indentation,
+        FieldRecursions const & recursions = {});
 
 std::string generateGraphqlErrorType(size_t indentation);
 
-std::string generateGraphqlErrorDeserialization(size_t indentation);
+GeneratedCode generateGraphqlErrorDeserialization(size_t indentation);
 
-enum class AlgebraicNamespace { Std, Absl };
+// Entities are objects with a non null `id` field of type ID.
+bool isEntityType(Type const & type);
 
-std::string algrebraicNamespaceName(AlgebraicNamespace algebraicNamespace);
+std::string generateEntityCache(
+        std::vector<Type> const & types,
+        GenerationOptions const & options,
+        size_t indentation,
+        FieldRecursions const & recursions = {});
+
+std::string generateLazyDecodingSupport(size_t indentation);
+
+// An Id class in generatedNamespace that interns its string, and the std::hash specialization for it.
+std::string generateInternedId(std::string const & generatedNamespace);
+
+std::string generateLazyObject(Type const & type, size_t indentation, FieldRecursions const & recursions = {});
+
+GeneratedCode generateLazyObjectDeserialization(Type const & type, size_t indentation);
+
+std::string generateLazyInterface(Type const & type, size_t indentation, FieldRecursions const & recursions = {});
+
+GeneratedCode generateLazyInterfaceDeserialization(Type const & type, size_t indentation);
+
+GeneratedCode generateLazyUnionDeserialization(Type const & type, size_t indentation);
+
+// Whether a compact object stores field without optional, tracking whether it is null in its presence bitfield.
+bool isPresenceTracked(Field const & field);
+
+// Estimated alignment in bytes of the member generated for type, used to order compact object members so that they
+// need little padding.
+size_t estimatedAlignment(TypeRef const & type);
+
+std::string generatePresenceBits(size_t indentation);
+
+std::string generateCompactObject(Type const & type, size_t indentation, FieldRecursions const & recursions = {});
+
+GeneratedCode generateCompactObjectDeserialization(
+        Type const & type, size_t indentation, FieldRecursions const & recursions = {});
+
+// Overloads of decodeOnDemand that read builtin scalars, optionals and lists from simdjson on demand values, and
+// parseOnDemandResponse, which decodes a response's data or errors. Values without an overload of their own are
+// parsed from their json text with nlohmann.
+std::string generateOnDemandDecodingSupport(GenerationOptions const & options, size_t indentation);
+
+GeneratedCode generateOnDemandEnumDecoding(Type const & type, size_t indentation);
+
+// Objects are decoded in a single pass over their fields, in the order the response has them.
+GeneratedCode generateOnDemandObjectDecoding(
+        Type const & type, bool isCompact, size_t indentation, FieldRecursions const & recursions = {});
+
+// Reads __typename out of order, then rewinds the object and decodes the implementation it names.
+GeneratedCode generateOnDemandInterfaceDecoding(
+        Type const & type, size_t indentation, FieldRecursions const & recursions = {});
+
+GeneratedCode generateOnDemandUnionDecoding(Type const & type, size_t indentation);
+
+// DecodeError and DecodeResult, and overloads of tryDecode that decode builtin scalars, optionals, lists and errors
+// into default constructed values, returning false and filling in a DecodeError with the path of the value instead of
+// throwing. Values without an overload of their own are decoded with their from_json.
+std::string generateCheckedDecodingSupport(GenerationOptions const & options, size_t indentation);
+
+GeneratedCode generateCheckedEnumDecoding(Type const & type, size_t indentation);
+
+// tryDecodeFields, decoding the fields of a value that is known to be an object, and tryDecode.
+GeneratedCode generateCheckedObjectDecoding(
+        Type const & type, bool isCompact, size_t indentation, FieldRecursions const & recursions = {});
+
+GeneratedCode generateCheckedInterfaceDecoding(
+        Type const & type, size_t indentation, FieldRecursions const & recursions = {});
+
+GeneratedCode generateCheckedUnionDecoding(Type const & type, size_t indentation);
 
+// FieldKind, FieldDescriptor and decodeFields, which decodes the fields of any object from a table describing them.
+// Fields that aren't builtin scalars are decoded through a function shared by all fields of the same c++ type.
+std::string generateTableDecodingSupport(size_t indentation);
+
+// A from_json for typeName, which is type or the unknown implementation of an interface, that decodes type's fields
+// with decodeFields from a constexpr table of their names, offsets, kinds and nullability.
+GeneratedCode generateTableDeserialization(
+        std::string const & typeName,
+        Type const & type,
+        size_t indentation,
+        FieldRecursions const & recursions = {});
+
+// IncrementalPayload and the overloads of applyIncremental that apply an entry of a subsequent payload at its path,
+// merging the data of deferred fragments into objects and inserting the items of streamed lists into vectors.
+std::string generateIncrementalDeliverySupport(size_t indentation);
+
+GeneratedCode generateIncrementalObjectDecoding(
+        Type const & type, bool isCompact, size_t indentation, FieldRecursions const & recursions = {});
+
+GeneratedCode generateIncrementalInterfaceDecoding(
+        Type const & type, size_t indentation, FieldRecursions const & recursions = {});
+
+GeneratedCode generateIncrementalUnionDecoding(Type const & type, size_t indentation);
+
+// GraphqlTask, the coroutine type of execute functions, the GraphqlTransport concept they send requests with, spawn,
+// which starts a task from code that isn't a coroutine, and LocalGraphqlTransport, a transport for tests.
+std::string generateAsyncSupport(size_t indentation);
+
+// GraphqlRequestCoalescer, which fetch functions share requests that are in flight through.
+std::string generateCoalescingSupport(size_t indentation);
+
+// GraphqlCacheKey, which cacheKey functions make from an operation's arguments, and the encodeCacheArgument functions
+// that encode them.
+std::string generateCacheKeySupport(GenerationOptions const & options, size_t indentation);
+
+// GraphqlResultCache, a bounded least recently used cache of decoded results that expire.
+std::string generateResultCacheSupport(size_t indentation);
+
+// BoxedOptional, the type of boxed fields, allocated with options.boxAllocator and copied unless
+// options.moveOnlyBoxes, and its serialization and overloads for the decoders that options use.
+std::string generateBoxedSupport(GenerationOptions const & options, size_t indentation);
+
+// Declarations of the objects, input objects and interfaces of a component of types in a cycle, and its unions, so
+// that its types can refer to the ones declared after them.
+std::string generateForwardDeclarations(std::vector<Type> const & component, size_t indentation);
+
+// A layoutReport function returning the size of each object in types and the padding between its members.
+std::string generateLayoutReport(
+        std::vector<Type> const & types, GenerationOptions const & options, size_t indentation);
+
+// Maximum nesting of selection sets in a query document, where the operation's root field is at depth 1.
+size_t selectionDepth(std::string const & query);
+
+struct OperationStatistics {
+    // Operation type and field name, such as Query.user
+    std::string name;
+    size_t queryBytes = 0;
+    size_t variableCount = 0;
+    size_t selectionDepth = 0;
+};
+
+struct GenerationStatistics {
+    // Wall time of each phase in the order they first ran
+    std::vector<std::pair<std::string, double>> phaseMilliseconds;
+    std::map<TypeKind, size_t> typeKindCounts;
+    // Bytes of header and implementation code generated for each type
+    std::unordered_map<std::string, size_t> typeBytes;
+    std::vector<OperationStatistics> operations;
+
+    void addPhase(std::string const & phase, double milliseconds);
+};
+
+struct GeneratedSources {
+    std::string header;
+    std::vector<std::string> implementations;
+};
+
+// Code generated for each type by earlier generateSources calls, so that regenerating a changed schema only renders
+// the types that changed again.
+struct GenerationCache {
+    struct RenderedType {
+        Type type;
+        // Operation types only, the types their query documents select from
+        std::vector<Type> dependencies;
+        std::string source;
+        // Out of line definitions when generating implementation files
+        std::vector<std::string> definitions;
+    };
+
+    GenerationOptions options;
+    std::unordered_map<std::string, RenderedType> renderedTypes;
+    // Of the last generation
+    size_t reusedTypeCount = 0;
+    size_t renderedTypeCount = 0;
+};
+
+// Names of the types that selecting type can reach through fields, arguments and possible types, excluding type.
+std::set<std::string> reachableTypeNames(Type const & type, TypeMap const & typeMap);
+
+// Generates a header and options.implementationFiles implementation files that include it as headerInclude.
+// If statistics isn't null, it is filled in with timing and size statistics about the generated code. If cache isn't
+// null, types that are unchanged since the cached generation are reused instead of rendered.
+GeneratedSources generateSources(
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        std::string const & headerInclude,
+        GenerationOptions const & options,
+        GenerationStatistics * statistics = nullptr,
+        GenerationCache * cache = nullptr);
+
+// Generates a single header with all functions defined inline.
 std::string generateTypes(
-        Schema const & schema, std::string const & generatedNamespace, AlgebraicNamespace algebraicNamespace);
+        Schema const & schema, std::string const & generatedNamespace, GenerationOptions const & options);
+
+// Version of the runtime header, changed whenever its declarations change.
+constexpr int runtimeHeaderVersion = 1;
+
+// Generates a header with the prelude every generated header otherwise repeats: optional serialization, the Json and
+// Id aliases, Operation, GraphqlError and GraphqlResponse, declared in namespace caffql::runtime. Headers generated
+// with GenerationOptions::runtimeHeader include it instead, so it can be precompiled once for all of them.
+std::string generateRuntimeHeader(AlgebraicNamespace algebraicNamespace);
 
 } // namespace caffql
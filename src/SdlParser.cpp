@@ -0,0 +1,921 @@
+#include "SdlParser.hpp"
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+
+namespace caffql {
+
+bool isSdlSchema(std::string const & text) {
+    auto const start = text.find_first_not_of(" \t\r\n");
+    return start != std::string::npos && text[start] != '{';
+}
+
+enum class SdlTokenKind { End, Punctuator, Name, Int, Float, String, BlockString };
+
+struct SdlToken {
+    SdlTokenKind kind = SdlTokenKind::End;
+    // Source text of the token, including the quotes of strings
+    std::string_view text;
+    size_t line = 0;
+    size_t column = 0;
+};
+
+static bool isDigit(char character) {
+    return character >= '0' && character <= '9';
+}
+
+static bool isNameStart(char character) {
+    return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') || character == '_';
+}
+
+static bool isNameContinue(char character) {
+    return isNameStart(character) || isDigit(character);
+}
+
+static void appendUtf8(std::string & string, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        string += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        string += static_cast<char>(0xC0 | (codePoint >> 6));
+        string += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        string += static_cast<char>(0xE0 | (codePoint >> 12));
+        string += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        string += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        string += static_cast<char>(0xF0 | (codePoint >> 18));
+        string += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        string += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        string += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// Splits a schema document into tokens, skipping whitespace, commas and comments. Tokens refer to the source text
+// and are only decoded when their value is needed.
+class SdlLexer {
+public:
+    explicit SdlLexer(SchemaSource const & source): source(source), text(source.text) {}
+
+    SdlToken next() {
+        skipIgnored();
+
+        SdlToken token;
+        token.line = line;
+        token.column = position - lineStart + 1;
+
+        if (position == text.size()) {
+            return token;
+        }
+
+        auto const start = position;
+        auto const character = text[position];
+
+        if (text.compare(position, 3, "...") == 0) {
+            position += 3;
+            token.kind = SdlTokenKind::Punctuator;
+        } else if (std::string_view("!$&():=@[]{|}").find(character) != std::string_view::npos) {
+            ++position;
+            token.kind = SdlTokenKind::Punctuator;
+        } else if (isNameStart(character)) {
+            while (position < text.size() && isNameContinue(text[position])) {
+                ++position;
+            }
+            token.kind = SdlTokenKind::Name;
+        } else if (character == '-' || isDigit(character)) {
+            token.kind = readNumber(token);
+        } else if (text.compare(position, 3, R"(""")") == 0) {
+            readBlockString(token);
+            token.kind = SdlTokenKind::BlockString;
+        } else if (character == '"') {
+            readString(token);
+            token.kind = SdlTokenKind::String;
+        } else {
+            throw error(token, "Unexpected character '" + std::string(1, character) + "'");
+        }
+
+        token.text = text.substr(start, position - start);
+        return token;
+    }
+
+    std::string where(SdlToken const & token) const {
+        return source.name + ":" + std::to_string(token.line) + ":" + std::to_string(token.column);
+    }
+
+    std::invalid_argument error(SdlToken const & token, std::string const & message) const {
+        return std::invalid_argument{where(token) + ": " + message};
+    }
+
+    // The value of a string token, with escape sequences replaced.
+    std::string stringValue(SdlToken const & token) const {
+        auto const body = token.text.substr(1, token.text.size() - 2);
+
+        std::string value;
+        value.reserve(body.size());
+
+        for (size_t i = 0; i < body.size(); ++i) {
+            if (body[i] != '\\') {
+                value += body[i];
+                continue;
+            }
+
+            switch (body[++i]) {
+            case '"':
+                value += '"';
+                break;
+            case '\\':
+                value += '\\';
+                break;
+            case '/':
+                value += '/';
+                break;
+            case 'b':
+                value += '\b';
+                break;
+            case 'f':
+                value += '\f';
+                break;
+            case 'n':
+                value += '\n';
+                break;
+            case 'r':
+                value += '\r';
+                break;
+            case 't':
+                value += '\t';
+                break;
+            case 'u': {
+                auto codePoint = hexCodePoint(token, body, i + 1);
+                i += 4;
+                // Characters outside the basic multilingual plane are escaped as surrogate pairs.
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF && body.compare(i + 1, 2, "\\u") == 0) {
+                    auto const low = hexCodePoint(token, body, i + 3);
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                appendUtf8(value, codePoint);
+                break;
+            }
+            default:
+                throw error(token, "Invalid escape sequence \\" + std::string(1, body[i]));
+            }
+        }
+
+        return value;
+    }
+
+    // The value of a block string token, without the indentation common to its lines and without leading and
+    // trailing blank lines.
+    std::string blockStringValue(SdlToken const & token) const {
+        auto const raw = token.text.substr(3, token.text.size() - 6);
+
+        std::vector<std::string> lines(1);
+        for (size_t i = 0; i < raw.size(); ++i) {
+            if (raw.compare(i, 4, R"(\""")") == 0) {
+                lines.back() += R"(""")";
+                i += 3;
+            } else if (raw[i] == '\r' || raw[i] == '\n') {
+                if (raw[i] == '\r' && i + 1 < raw.size() && raw[i + 1] == '\n') {
+                    ++i;
+                }
+                lines.emplace_back();
+            } else {
+                lines.back() += raw[i];
+            }
+        }
+
+        auto indentation = [](std::string const & line) { return line.find_first_not_of(" \t"); };
+
+        auto commonIndentation = std::string::npos;
+        for (size_t i = 1; i < lines.size(); ++i) {
+            commonIndentation = std::min(commonIndentation, indentation(lines[i]));
+        }
+        if (commonIndentation != std::string::npos) {
+            for (size_t i = 1; i < lines.size(); ++i) {
+                lines[i].erase(0, commonIndentation);
+            }
+        }
+
+        auto const isBlank = [&](std::string const & line) { return indentation(line) == std::string::npos; };
+        auto const first = std::find_if_not(lines.begin(), lines.end(), isBlank);
+        auto const last = std::find_if_not(lines.rbegin(), std::make_reverse_iterator(first), isBlank).base();
+
+        std::string value;
+        for (auto line = first; line != last; ++line) {
+            value += (line == first ? "" : "\n") + *line;
+        }
+        return value;
+    }
+
+private:
+    SchemaSource const & source;
+    std::string_view text;
+    size_t position = 0;
+    size_t line = 1;
+    size_t lineStart = 0;
+
+    void skipIgnored() {
+        while (position < text.size()) {
+            auto const character = text[position];
+            if (character == ' ' || character == '\t' || character == ',') {
+                ++position;
+            } else if (character == '\n' || character == '\r') {
+                skipLineTerminator();
+            } else if (character == '#') {
+                while (position < text.size() && text[position] != '\n' && text[position] != '\r') {
+                    ++position;
+                }
+            } else if (text.compare(position, 3, "\xEF\xBB\xBF") == 0) {
+                // Byte order mark
+                position += 3;
+            } else {
+                return;
+            }
+        }
+    }
+
+    void skipLineTerminator() {
+        if (text[position] == '\r' && position + 1 < text.size() && text[position + 1] == '\n') {
+            ++position;
+        }
+        ++position;
+        ++line;
+        lineStart = position;
+    }
+
+    void readDigits(SdlToken const & token) {
+        if (position == text.size() || !isDigit(text[position])) {
+            throw error(token, "Invalid number");
+        }
+        while (position < text.size() && isDigit(text[position])) {
+            ++position;
+        }
+    }
+
+    SdlTokenKind readNumber(SdlToken const & token) {
+        auto kind = SdlTokenKind::Int;
+
+        if (text[position] == '-') {
+            ++position;
+        }
+        if (position < text.size() && text[position] == '0') {
+            ++position;
+        } else {
+            readDigits(token);
+        }
+
+        if (position < text.size() && text[position] == '.') {
+            ++position;
+            readDigits(token);
+            kind = SdlTokenKind::Float;
+        }
+
+        if (position < text.size() && (text[position] == 'e' || text[position] == 'E')) {
+            ++position;
+            if (position < text.size() && (text[position] == '+' || text[position] == '-')) {
+                ++position;
+            }
+            readDigits(token);
+            kind = SdlTokenKind::Float;
+        }
+
+        if (position < text.size() && (isNameContinue(text[position]) || text[position] == '.')) {
+            throw error(token, "Invalid number");
+        }
+
+        return kind;
+    }
+
+    void readString(SdlToken const & token) {
+        ++position;
+        while (position < text.size() && text[position] != '\n' && text[position] != '\r') {
+            if (text[position] == '"') {
+                ++position;
+                return;
+            }
+            position += text[position] == '\\' ? 2 : 1;
+        }
+        throw error(token, "Unterminated string");
+    }
+
+    void readBlockString(SdlToken const & token) {
+        position += 3;
+        while (position < text.size()) {
+            if (text.compare(position, 3, R"(""")") == 0) {
+                position += 3;
+                return;
+            } else if (text.compare(position, 4, R"(\""")") == 0) {
+                position += 4;
+            } else if (text[position] == '\n' || text[position] == '\r') {
+                skipLineTerminator();
+            } else {
+                ++position;
+            }
+        }
+        throw error(token, "Unterminated block string");
+    }
+
+    uint32_t hexCodePoint(SdlToken const & token, std::string_view body, size_t start) const {
+        if (start + 4 > body.size()) {
+            throw error(token, "Invalid unicode escape sequence");
+        }
+
+        uint32_t codePoint = 0;
+        for (auto const character : body.substr(start, 4)) {
+            codePoint <<= 4;
+            if (isDigit(character)) {
+                codePoint |= character - '0';
+            } else if (character >= 'a' && character <= 'f') {
+                codePoint |= character - 'a' + 10;
+            } else if (character >= 'A' && character <= 'F') {
+                codePoint |= character - 'A' + 10;
+            } else {
+                throw error(token, "Invalid unicode escape sequence");
+            }
+        }
+        return codePoint;
+    }
+};
+
+struct SdlNamedReference {
+    std::string name;
+    std::string location;
+};
+
+// The definitions and extensions of every document of a schema, before types are resolved.
+struct SdlDefinitions {
+    std::vector<Type> types;
+    std::unordered_map<std::string, size_t> typeIndices;
+    // Extensions and where they are, applied once every type is defined
+    std::vector<std::pair<Type, std::string>> extensions;
+    bool hasSchemaDefinition = false;
+    std::vector<std::pair<Operation, SdlNamedReference>> operationTypes;
+    // Where each type is first referenced, for reporting references to undefined types
+    std::unordered_map<std::string, std::string> referenceLocations;
+};
+
+// Marks a field or enum value that directives deprecate, with the reason that @deprecated defaults to when it isn't
+// given one.
+template <typename T>
+static void applyDeprecation(std::vector<Directive> const & directives, T & member) {
+    for (auto const & directive : directives) {
+        if (directive.name == "deprecated") {
+            auto const reason = directive.arguments.find("reason");
+            member.isDeprecated = true;
+            member.deprecationReason = reason != directive.arguments.end() && reason->second.is_string()
+                                               ? reason->second.get<std::string>()
+                                               : "No longer supported";
+        }
+    }
+}
+
+// Parses the type system definitions of a document. Named types are parsed as scalars and get their kind once every
+// document has been parsed.
+class SdlParser {
+public:
+    SdlParser(SchemaSource const & source, SdlDefinitions & definitions): lexer(source), definitions(definitions) {
+        advance();
+    }
+
+    void parseDocument() {
+        while (current.kind != SdlTokenKind::End) {
+            parseDefinition();
+        }
+    }
+
+private:
+    SdlLexer lexer;
+    SdlDefinitions & definitions;
+    SdlToken current;
+
+    void advance() { current = lexer.next(); }
+
+    bool isPunctuator(std::string_view punctuator) const {
+        return current.kind == SdlTokenKind::Punctuator && current.text == punctuator;
+    }
+
+    bool isKeyword(std::string_view keyword) const {
+        return current.kind == SdlTokenKind::Name && current.text == keyword;
+    }
+
+    bool consumePunctuator(std::string_view punctuator) {
+        if (!isPunctuator(punctuator)) {
+            return false;
+        }
+        advance();
+        return true;
+    }
+
+    std::invalid_argument unexpected(std::string const & expected) const {
+        auto const found = current.kind == SdlTokenKind::End ? "end of file" : "'" + std::string(current.text) + "'";
+        return lexer.error(current, "Expected " + expected + ", found " + found);
+    }
+
+    void expectPunctuator(std::string_view punctuator) {
+        if (!consumePunctuator(punctuator)) {
+            throw unexpected("'" + std::string(punctuator) + "'");
+        }
+    }
+
+    std::string parseName() {
+        if (current.kind != SdlTokenKind::Name) {
+            throw unexpected("a name");
+        }
+        std::string name(current.text);
+        advance();
+        return name;
+    }
+
+    std::optional<std::string> parseDescription() {
+        std::optional<std::string> description;
+        if (current.kind == SdlTokenKind::String) {
+            description = lexer.stringValue(current);
+            advance();
+        } else if (current.kind == SdlTokenKind::BlockString) {
+            description = lexer.blockStringValue(current);
+            advance();
+        }
+        return description;
+    }
+
+    void parseDefinition() {
+        auto const description = parseDescription();
+        auto const start = current;
+
+        if (isKeyword("extend")) {
+            if (description) {
+                throw lexer.error(start, "Extensions can't have descriptions");
+            }
+            advance();
+            parseExtension();
+        } else if (isKeyword("schema")) {
+            advance();
+            parseSchemaDefinition(start, false);
+        } else if (isKeyword("directive")) {
+            advance();
+            parseDirectiveDefinition();
+        } else if (isKeyword("query") || isKeyword("mutation") || isKeyword("subscription") ||
+                   isKeyword("fragment") || isPunctuator("{")) {
+            throw lexer.error(start, "Executable definitions are not supported in a schema");
+        } else {
+            auto type = parseTypeDefinition();
+            type.description = description;
+            if (!definitions.typeIndices.emplace(type.name, definitions.types.size()).second) {
+                throw lexer.error(start, "Type " + type.name + " is already defined");
+            }
+            definitions.types.push_back(std::move(type));
+        }
+    }
+
+    void parseExtension() {
+        auto const start = current;
+        if (isKeyword("schema")) {
+            advance();
+            parseSchemaDefinition(start, true);
+        } else {
+            definitions.extensions.emplace_back(parseTypeDefinition(), lexer.where(start));
+        }
+    }
+
+    void parseSchemaDefinition(SdlToken const & start, bool isExtension) {
+        if (!isExtension) {
+            if (definitions.hasSchemaDefinition) {
+                throw lexer.error(start, "The schema is already defined");
+            }
+            definitions.hasSchemaDefinition = true;
+        }
+
+        parseDirectives();
+
+        if (isExtension && !isPunctuator("{")) {
+            return;
+        }
+
+        expectPunctuator("{");
+        do {
+            auto const token = current;
+            Operation operation;
+            if (isKeyword("query")) {
+                operation = Operation::Query;
+            } else if (isKeyword("mutation")) {
+                operation = Operation::Mutation;
+            } else if (isKeyword("subscription")) {
+                operation = Operation::Subscription;
+            } else {
+                throw unexpected("query, mutation or subscription");
+            }
+            advance();
+            expectPunctuator(":");
+            definitions.operationTypes.push_back({operation, {parseName(), lexer.where(token)}});
+        } while (!consumePunctuator("}"));
+    }
+
+    // Directive definitions don't affect generated code, so they are only checked.
+    void parseDirectiveDefinition() {
+        expectPunctuator("@");
+        parseName();
+        if (consumePunctuator("(")) {
+            do {
+                parseInputValueDefinition();
+            } while (!consumePunctuator(")"));
+        }
+        if (isKeyword("repeatable")) {
+            advance();
+        }
+        if (!isKeyword("on")) {
+            throw unexpected("'on'");
+        }
+        advance();
+        consumePunctuator("|");
+        do {
+            parseName();
+        } while (consumePunctuator("|"));
+    }
+
+    Type parseTypeDefinition() {
+        Type type;
+
+        if (isKeyword("scalar")) {
+            type.kind = TypeKind::Scalar;
+            advance();
+            type.name = parseName();
+            parseDirectives();
+        } else if (isKeyword("type") || isKeyword("interface")) {
+            type.kind = isKeyword("type") ? TypeKind::Object : TypeKind::Interface;
+            advance();
+            type.name = parseName();
+            type.interfaces = parseImplementsInterfaces();
+            parseDirectives();
+            if (consumePunctuator("{")) {
+                do {
+                    type.fields.push_back(parseFieldDefinition());
+                } while (!consumePunctuator("}"));
+            }
+        } else if (isKeyword("union")) {
+            type.kind = TypeKind::Union;
+            advance();
+            type.name = parseName();
+            parseDirectives();
+            if (consumePunctuator("=")) {
+                consumePunctuator("|");
+                do {
+                    type.possibleTypes.push_back(parseNamedType());
+                } while (consumePunctuator("|"));
+            }
+        } else if (isKeyword("enum")) {
+            type.kind = TypeKind::Enum;
+            advance();
+            type.name = parseName();
+            parseDirectives();
+            if (consumePunctuator("{")) {
+                do {
+                    type.enumValues.push_back(parseEnumValueDefinition());
+                } while (!consumePunctuator("}"));
+            }
+        } else if (isKeyword("input")) {
+            type.kind = TypeKind::InputObject;
+            advance();
+            type.name = parseName();
+            parseDirectives();
+            if (consumePunctuator("{")) {
+                do {
+                    type.inputFields.push_back(parseInputValueDefinition());
+                } while (!consumePunctuator("}"));
+            }
+        } else {
+            throw unexpected("a definition");
+        }
+
+        return type;
+    }
+
+    std::vector<TypeRef> parseImplementsInterfaces() {
+        std::vector<TypeRef> interfaces;
+        if (isKeyword("implements")) {
+            advance();
+            consumePunctuator("&");
+            do {
+                interfaces.push_back(parseNamedType());
+            } while (consumePunctuator("&"));
+        }
+        return interfaces;
+    }
+
+    Field parseFieldDefinition() {
+        Field field;
+        field.description = parseDescription();
+        field.name = parseName();
+        if (consumePunctuator("(")) {
+            do {
+                field.args.push_back(parseInputValueDefinition());
+            } while (!consumePunctuator(")"));
+        }
+        expectPunctuator(":");
+        field.type = parseTypeReference();
+        applyDeprecation(parseDirectives(), field);
+        return field;
+    }
+
+    InputValue parseInputValueDefinition() {
+        InputValue input;
+        input.description = parseDescription();
+        input.name = parseName();
+        expectPunctuator(":");
+        input.type = parseTypeReference();
+        if (consumePunctuator("=")) {
+            parseValue();
+        }
+        parseDirectives();
+        return input;
+    }
+
+    EnumValue parseEnumValueDefinition() {
+        EnumValue value;
+        value.description = parseDescription();
+        value.name = parseName();
+        applyDeprecation(parseDirectives(), value);
+        return value;
+    }
+
+    TypeRef parseNamedType() {
+        auto const token = current;
+        auto name = parseName();
+        definitions.referenceLocations.emplace(name, lexer.where(token));
+        return TypeRef{TypeKind::Scalar, std::move(name)};
+    }
+
+    TypeRef parseListType() {
+        auto ofType = parseTypeReference();
+        expectPunctuator("]");
+        return TypeRef{TypeKind::List, std::nullopt, std::move(ofType)};
+    }
+
+    TypeRef parseTypeReference() {
+        auto type = consumePunctuator("[") ? parseListType() : parseNamedType();
+        if (consumePunctuator("!")) {
+            return TypeRef{TypeKind::NonNull, std::nullopt, std::move(type)};
+        }
+        return type;
+    }
+
+    std::vector<Directive> parseDirectives() {
+        std::vector<Directive> directives;
+        while (consumePunctuator("@")) {
+            Directive directive;
+            directive.name = parseName();
+            if (consumePunctuator("(")) {
+                do {
+                    auto name = parseName();
+                    expectPunctuator(":");
+                    directive.arguments[name] = parseValue();
+                } while (!consumePunctuator(")"));
+            }
+            directives.push_back(std::move(directive));
+        }
+        return directives;
+    }
+
+    // Parses a constant value, as values in a schema can't refer to variables.
+    Json parseValue() {
+        auto const token = current;
+
+        switch (token.kind) {
+        case SdlTokenKind::Int:
+        case SdlTokenKind::Float:
+            advance();
+            return Json::parse(token.text.begin(), token.text.end());
+
+        case SdlTokenKind::String:
+            advance();
+            return lexer.stringValue(token);
+
+        case SdlTokenKind::BlockString:
+            advance();
+            return lexer.blockStringValue(token);
+
+        case SdlTokenKind::Name:
+            advance();
+            if (token.text == "true" || token.text == "false") {
+                return token.text == "true";
+            } else if (token.text == "null") {
+                return nullptr;
+            }
+            return std::string(token.text);
+
+        case SdlTokenKind::Punctuator:
+            if (consumePunctuator("[")) {
+                auto list = Json::array();
+                while (!consumePunctuator("]")) {
+                    list.push_back(parseValue());
+                }
+                return list;
+            } else if (consumePunctuator("{")) {
+                auto object = Json::object();
+                while (!consumePunctuator("}")) {
+                    auto name = parseName();
+                    expectPunctuator(":");
+                    object[name] = parseValue();
+                }
+                return object;
+            } else if (isPunctuator("$")) {
+                throw lexer.error(token, "Variables are not allowed in a schema");
+            }
+            break;
+
+        case SdlTokenKind::End:
+            break;
+        }
+
+        throw unexpected("a value");
+    }
+};
+
+static std::invalid_argument errorAt(std::string const & location, std::string const & message) {
+    return std::invalid_argument{location + ": " + message};
+}
+
+static std::string describeKind(TypeKind kind) {
+    switch (kind) {
+    case TypeKind::Scalar:
+        return "a scalar";
+    case TypeKind::Object:
+        return "an object type";
+    case TypeKind::Interface:
+        return "an interface";
+    case TypeKind::Union:
+        return "a union";
+    case TypeKind::Enum:
+        return "an enum";
+    case TypeKind::InputObject:
+        return "an input object";
+    case TypeKind::List:
+    case TypeKind::NonNull:
+        break;
+    }
+
+    throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(kind))};
+}
+
+// Appends the members an extension adds to a type, rejecting members the type already has.
+template <typename Member, typename Name>
+static void extendMembers(
+        std::vector<Member> & members,
+        std::vector<Member> & addedMembers,
+        Name name,
+        std::string const & memberKind,
+        Type const & type,
+        std::string const & location) {
+    for (auto & addedMember : addedMembers) {
+        auto const isDuplicate = std::any_of(members.begin(), members.end(), [&](Member const & member) {
+            return name(member) == name(addedMember);
+        });
+        if (isDuplicate) {
+            throw errorAt(location, type.name + " already has " + memberKind + " " + name(addedMember));
+        }
+        members.push_back(std::move(addedMember));
+    }
+}
+
+static void resolveTypeRef(TypeRef & type, SdlDefinitions const & definitions) {
+    if (type.ofType) {
+        resolveTypeRef(*type.ofType, definitions);
+        return;
+    }
+
+    auto const index = definitions.typeIndices.find(type.name.value());
+    if (index == definitions.typeIndices.end()) {
+        throw errorAt(definitions.referenceLocations.at(type.name.value()), "Unknown type " + type.name.value());
+    }
+    type.kind = definitions.types[index->second].kind;
+}
+
+static Schema buildSchema(SdlDefinitions definitions) {
+    auto & types = definitions.types;
+
+    // Built in scalars are defined implicitly.
+    for (auto const name : {"Int", "Float", "String", "Boolean", "ID"}) {
+        if (definitions.typeIndices.emplace(name, types.size()).second) {
+            types.push_back(Type{TypeKind::Scalar, name});
+        }
+    }
+
+    for (auto & [extension, location] : definitions.extensions) {
+        auto const index = definitions.typeIndices.find(extension.name);
+        if (index == definitions.typeIndices.end()) {
+            throw errorAt(location, "Cannot extend undefined type " + extension.name);
+        }
+
+        auto & type = types[index->second];
+        if (type.kind != extension.kind) {
+            throw errorAt(location, "Cannot extend " + type.name + " as " + describeKind(extension.kind));
+        }
+
+        auto fieldName = [](auto const & field) { return field.name; };
+        auto typeRefName = [](TypeRef const & typeRef) { return typeRef.name.value(); };
+
+        extendMembers(type.fields, extension.fields, fieldName, "field", type, location);
+        extendMembers(type.inputFields, extension.inputFields, fieldName, "field", type, location);
+        extendMembers(type.enumValues, extension.enumValues, fieldName, "value", type, location);
+        extendMembers(type.interfaces, extension.interfaces, typeRefName, "interface", type, location);
+        extendMembers(type.possibleTypes, extension.possibleTypes, typeRefName, "member", type, location);
+    }
+
+    auto requireKind = [&](TypeRef const & typeRef, TypeKind kind, std::string const & role) {
+        if (typeRef.kind != kind) {
+            throw errorAt(definitions.referenceLocations.at(typeRef.name.value()),
+                          role + " " + typeRef.name.value() + " is not " + describeKind(kind));
+        }
+    };
+
+    for (auto & type : types) {
+        for (auto & field : type.fields) {
+            resolveTypeRef(field.type, definitions);
+            for (auto & argument : field.args) {
+                resolveTypeRef(argument.type, definitions);
+            }
+        }
+        for (auto & inputField : type.inputFields) {
+            resolveTypeRef(inputField.type, definitions);
+        }
+        for (auto & interface : type.interfaces) {
+            resolveTypeRef(interface, definitions);
+            requireKind(interface, TypeKind::Interface, "Implemented interface");
+        }
+        for (auto & possibleType : type.possibleTypes) {
+            resolveTypeRef(possibleType, definitions);
+            requireKind(possibleType, TypeKind::Object, "Union member");
+        }
+    }
+
+    // The possible types of an interface are the object types that implement it.
+    for (auto const & type : types) {
+        if (type.kind != TypeKind::Object) {
+            continue;
+        }
+        for (auto const & interface : type.interfaces) {
+            types[definitions.typeIndices.at(interface.name.value())].possibleTypes.push_back(type);
+        }
+    }
+
+    Schema schema;
+
+    if (definitions.hasSchemaDefinition || !definitions.operationTypes.empty()) {
+        for (auto const & [operation, reference] : definitions.operationTypes) {
+            auto & operationType = operation == Operation::Query      ? schema.queryType
+                                   : operation == Operation::Mutation ? schema.mutationType
+                                                                      : schema.subscriptionType;
+            if (operationType) {
+                throw errorAt(reference.location, "The " + operationQueryName(operation) + " type is already defined");
+            }
+
+            auto const index = definitions.typeIndices.find(reference.name);
+            if (index == definitions.typeIndices.end()) {
+                throw errorAt(reference.location, "Unknown type " + reference.name);
+            } else if (types[index->second].kind != TypeKind::Object) {
+                throw errorAt(reference.location, reference.name + " is not " + describeKind(TypeKind::Object));
+            }
+
+            operationType = Schema::OperationType{reference.name};
+        }
+    } else {
+        // Without a schema definition, operation types have their default names.
+        auto setDefault = [&](std::optional<Schema::OperationType> & operationType, std::string const & name) {
+            auto const index = definitions.typeIndices.find(name);
+            if (index != definitions.typeIndices.end() && types[index->second].kind == TypeKind::Object) {
+                operationType = Schema::OperationType{name};
+            }
+        };
+        setDefault(schema.queryType, "Query");
+        setDefault(schema.mutationType, "Mutation");
+        setDefault(schema.subscriptionType, "Subscription");
+    }
+
+    schema.types = std::move(types);
+    return schema;
+}
+
+Schema parseSdlSchema(std::vector<SchemaSource> const & sources) {
+    SdlDefinitions definitions;
+    for (auto const & source : sources) {
+        SdlParser(source, definitions).parseDocument();
+    }
+    return buildSchema(std::move(definitions));
+}
+
+Schema parseSchemaSources(std::vector<SchemaSource> const & sources, SchemaParseCache * cache) {
+    if (sources.size() == 1 && !isSdlSchema(sources.front().text)) {
+        return parseSchema(sources.front().text, cache);
+    }
+
+    for (auto const & source : sources) {
+        if (!isSdlSchema(source.text)) {
+            throw std::invalid_argument{source.name +
+                                        ": Only schema definition language schemas can be split across files"};
+        }
+    }
+
+    return parseSdlSchema(sources);
+}
+
+} // namespace caffql
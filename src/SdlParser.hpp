@@ -0,0 +1,30 @@
+#pragma once
+#include "CodeGeneration.hpp"
+
+namespace caffql {
+
+// A schema document and the name of the file it was read from, which errors refer to.
+struct SchemaSource {
+    std::string name;
+    std::string text;
+};
+
+// A directive applied to a definition in a schema, e.g. @deprecated(reason: "Use name").
+struct Directive {
+    std::string name;
+    // Argument values as json, with enum values as strings
+    std::map<std::string, Json> arguments;
+};
+
+// Whether text is a schema definition language document rather than an introspection query response.
+bool isSdlSchema(std::string const & text);
+
+// Parses schema definition language documents, which may extend types defined in any of them, into a schema. Throws
+// std::invalid_argument naming the source, line and column of invalid input.
+Schema parseSdlSchema(std::vector<SchemaSource> const & sources);
+
+// Parses an introspection query response, or one or more schema definition language documents. The cache is only
+// used for introspection query responses, see parseSchema.
+Schema parseSchemaSources(std::vector<SchemaSource> const & sources, SchemaParseCache * cache = nullptr);
+
+} // namespace caffql
@@ -1,26 +1,144 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <string_view>
+#include <thread>
 #include "CodeGeneration.hpp"
+#include "SdlParser.hpp"
 #include "cxxopts.hpp"
 
+#if defined(__linux__)
+#    include <poll.h>
+#    include <sys/inotify.h>
+#    include <unistd.h>
+#endif
+
 namespace caffql {
 
 struct ProgramInputs {
-    std::string schemaFile;
+    // An introspection query response, or schema definition language documents
+    std::vector<std::string> schemaFiles;
     std::string outputFile;
+    // Also write the runtime header here, for generationOptions.algebraicNamespace
+    std::string runtimeOutputFile;
     std::string generatedNamespace;
-    AlgebraicNamespace algebraicNamespace;
+    GenerationOptions generationOptions;
+    // Empty, text, or json
+    std::string statisticsFormat;
+    bool watch;
+    // Generate the entries of this manifest instead
+    std::string manifestFile;
+    // Worker threads for a manifest, or 0 for one per core
+    size_t jobs;
 };
 
+// Reads a json object of scalar mappings keyed by scalar name.
+static std::map<std::string, ScalarMapping> readScalarMappings(std::string const & file) {
+    std::ifstream stream(file);
+    if (!stream) {
+        throw std::runtime_error("Unable to read scalar mappings " + file);
+    }
+    return Json::parse(stream);
+}
+
+// Reads operation names from a file with one on each line, ignoring blank lines and lines starting with #.
+static std::set<std::string> readOperations(std::string const & file) {
+    std::ifstream stream(file);
+    if (!stream) {
+        throw std::runtime_error("Unable to read operations " + file);
+    }
+    std::set<std::string> operations;
+    for (std::string line; std::getline(stream, line);) {
+        auto const begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#') {
+            continue;
+        }
+        operations.insert(line.substr(begin, line.find_last_not_of(" \t\r") + 1 - begin));
+    }
+    return operations;
+}
+
 ProgramInputs parseCommandLine(int argc, char * argv[]) {
     try {
         cxxopts::Options options(
                 "caffql",
                 "Generate c++ types and GraphQL request and response serialization from a GraphQL json schema "
-                "file.");
-        options.add_options()("s,schema", "input json schema file", cxxopts::value<std::string>())(
+                "file or schema definition language files.");
+        options.add_options()(
+                "s,schema",
+                "input json schema file, or schema definition language files",
+                cxxopts::value<std::vector<std::string>>())(
                 "o,output", "output generated header file", cxxopts::value<std::string>())(
                 "n,namespace", "generated namespace", cxxopts::value<std::string>()->default_value("caffql"))(
-                "a,absl", "use absl optional and variant instead of std")("h,help", "help");
+                "a,absl", "use absl optional and variant instead of std")(
+                "json-backend",
+                "parser responses are decoded with, nlohmann or simdjson, which generates parseResponse functions",
+                cxxopts::value<std::string>()->default_value("nlohmann"))(
+                "entity-cache", "generate a normalized cache of entities keyed by typename and id")(
+                "lazy", "decode object fields on first access instead of up front")(
+                "checked-decoding",
+                "generate tryResponse functions that return decode errors with the json path of the failure instead "
+                "of throwing")(
+                "table-decoding",
+                "decode objects with one function interpreting constexpr tables of their fields instead of a from_json "
+                "of their own")(
+                "defer",
+                "select this field, named like Type.field, in a deferred fragment",
+                cxxopts::value<std::vector<std::string>>())(
+                "stream",
+                "stream the items of this list field, named like Type.field",
+                cxxopts::value<std::vector<std::string>>())(
+                "async", "generate c++20 coroutines that execute operations over a transport")(
+                "coalesce", "generate query fetch functions that share concurrent requests with the same variables")(
+                "result-cache", "generate cache keys of query arguments and a result cache")(
+                "operation",
+                "generate only this operation, named like Query.field, and the types it needs",
+                cxxopts::value<std::vector<std::string>>())(
+                "operations-file",
+                "generate only the operations listed on the lines of this file and the types they need",
+                cxxopts::value<std::string>())(
+                "exclude-deprecated", "leave deprecated fields out of types and queries")(
+                "keep-deprecated",
+                "keep this deprecated field, named like Type.field, with --exclude-deprecated",
+                cxxopts::value<std::vector<std::string>>())(
+                "recursion-depth",
+                "times queries select a field of a recursive type within its own selection",
+                cxxopts::value<size_t>()->default_value(std::to_string(defaultRecursionDepth)))(
+                "box-allocator",
+                "allocator of the values of boxed recursive fields, heap, pool or arena",
+                cxxopts::value<std::string>()->default_value("heap"))(
+                "move-only-boxes", "make boxed recursive fields, and the types containing them, move only")(
+                "compact",
+                "order object members by alignment and track nullable scalars in a bitfield instead of optional")(
+                "layout-report", "generate a layoutReport function listing the size and padding of each object")(
+                "interned-ids", "generate Id as a handle to a string in a shared intern table")(
+                "scalars",
+                "json file mapping custom scalars to c++ types and the functions that decode and encode them",
+                cxxopts::value<std::string>())(
+                "runtime-header",
+                "include this runtime header instead of repeating its prelude in the generated header",
+                cxxopts::value<std::string>())(
+                "emit-runtime",
+                "write the runtime header shared by headers generated with --runtime-header to this file",
+                cxxopts::value<std::string>())(
+                "implementation-files",
+                "define serialization and operation functions out of line in this many .cpp files next to the output "
+                "header",
+                cxxopts::value<size_t>()->default_value("0"))(
+                "stats",
+                "print timing and size statistics as text or json",
+                cxxopts::value<std::string>()->implicit_value("text"))(
+                "w,watch", "keep running and regenerate whenever a schema file changes")(
+                "m,manifest",
+                "generate every entry of this json manifest instead of a single schema",
+                cxxopts::value<std::string>())(
+                "j,jobs",
+                "worker threads for a manifest, 0 for one per core",
+                cxxopts::value<size_t>()->default_value("0"))("h,help", "help");
 
         auto result = options.parse(argc, argv);
 
@@ -29,26 +147,687 @@ ProgramInputs parseCommandLine(int argc, char * argv[]) {
             exit(0);
         }
 
-        if (!result.count("schema")) {
+        if (result.count("manifest")) {
+            // Every entry of a manifest has options of its own, so other flags would be silently ignored.
+            for (auto const & argument : result.arguments()) {
+                if (argument.key() != "manifest" && argument.key() != "jobs") {
+                    printf("--%s can't be combined with --manifest, set it in the manifest entries instead\n",
+                           argument.key().c_str());
+                    exit(1);
+                }
+            }
+            ProgramInputs inputs{};
+            inputs.manifestFile = result["manifest"].as<std::string>();
+            inputs.jobs = result["jobs"].as<size_t>();
+            return inputs;
+        }
+
+        auto const isOnlyRuntime = result.count("emit-runtime") && !result.count("schema");
+
+        if (!result.count("schema") && !isOnlyRuntime) {
             printf("input schema is required\n");
             exit(1);
         }
 
-        if (!result.count("output")) {
+        if (!result.count("output") && !isOnlyRuntime) {
             printf("output file is required\n");
             exit(1);
         }
 
-        return {result["schema"].as<std::string>(),
-                result["output"].as<std::string>(),
+        GenerationOptions generationOptions;
+        generationOptions.algebraicNamespace =
+                result.count("absl") ? AlgebraicNamespace::Absl : AlgebraicNamespace::Std;
+        try {
+            generationOptions.jsonBackend = jsonBackendNamed(result["json-backend"].as<std::string>());
+        } catch (std::invalid_argument const & e) {
+            printf("%s\n", e.what());
+            exit(1);
+        }
+        generationOptions.entityCache = result.count("entity-cache") > 0;
+        generationOptions.lazyDecoding = result.count("lazy") > 0;
+        generationOptions.checkedDecoding = result.count("checked-decoding") > 0;
+        generationOptions.tableDecoding = result.count("table-decoding") > 0;
+        if (result.count("defer")) {
+            auto const & deferredFields = result["defer"].as<std::vector<std::string>>();
+            generationOptions.deferredFields = {deferredFields.begin(), deferredFields.end()};
+        }
+        if (result.count("stream")) {
+            auto const & streamedFields = result["stream"].as<std::vector<std::string>>();
+            generationOptions.streamedFields = {streamedFields.begin(), streamedFields.end()};
+        }
+        generationOptions.asyncOperations = result.count("async") > 0;
+        generationOptions.coalescedRequests = result.count("coalesce") > 0;
+        generationOptions.resultCache = result.count("result-cache") > 0;
+        if (result.count("operation")) {
+            auto const & operations = result["operation"].as<std::vector<std::string>>();
+            generationOptions.operations = {operations.begin(), operations.end()};
+        }
+        if (result.count("operations-file")) {
+            generationOptions.operations.merge(readOperations(result["operations-file"].as<std::string>()));
+        }
+        generationOptions.excludeDeprecated = result.count("exclude-deprecated") > 0;
+        if (result.count("keep-deprecated")) {
+            auto const & keptDeprecatedFields = result["keep-deprecated"].as<std::vector<std::string>>();
+            generationOptions.keptDeprecatedFields = {keptDeprecatedFields.begin(), keptDeprecatedFields.end()};
+        }
+        generationOptions.recursionDepth = result["recursion-depth"].as<size_t>();
+        try {
+            generationOptions.boxAllocator = boxAllocatorNamed(result["box-allocator"].as<std::string>());
+        } catch (std::invalid_argument const & e) {
+            printf("%s\n", e.what());
+            exit(1);
+        }
+        generationOptions.moveOnlyBoxes = result.count("move-only-boxes") > 0;
+        generationOptions.compactLayout = result.count("compact") > 0;
+        generationOptions.layoutReport = result.count("layout-report") > 0;
+        generationOptions.internedIds = result.count("interned-ids") > 0;
+        if (result.count("scalars")) {
+            generationOptions.scalarMappings = readScalarMappings(result["scalars"].as<std::string>());
+        }
+        if (result.count("runtime-header")) {
+            generationOptions.runtimeHeader = result["runtime-header"].as<std::string>();
+        }
+        generationOptions.implementationFiles = result["implementation-files"].as<size_t>();
+
+        std::string statisticsFormat;
+        if (result.count("stats")) {
+            statisticsFormat = result["stats"].as<std::string>();
+            if (statisticsFormat != "text" && statisticsFormat != "json") {
+                printf("stats format must be text or json\n");
+                exit(1);
+            }
+        }
+
+        return {isOnlyRuntime ? std::vector<std::string>() : result["schema"].as<std::vector<std::string>>(),
+                isOnlyRuntime ? "" : result["output"].as<std::string>(),
+                result.count("emit-runtime") ? result["emit-runtime"].as<std::string>() : "",
                 result["namespace"].as<std::string>(),
-                result.count("absl") ? AlgebraicNamespace::Absl : AlgebraicNamespace::Std};
+                generationOptions,
+                statisticsFormat,
+                result.count("watch") > 0,
+                "",
+                0};
     } catch (cxxopts::OptionException const & e) {
         printf("Error parsing options: %s\n", e.what());
         exit(1);
+    } catch (std::exception const & e) {
+        printf("Error reading scalar mappings or operations: %s\n", e.what());
+        exit(1);
+    }
+}
+
+static Json statisticsToJson(GenerationStatistics const & statistics) {
+    Json json;
+
+    json["phases"] = Json::array();
+    for (auto const & phase : statistics.phaseMilliseconds) {
+        json["phases"].push_back({{"name", phase.first}, {"milliseconds", phase.second}});
+    }
+
+    json["typeKinds"] = Json::object();
+    for (auto const & count : statistics.typeKindCounts) {
+        json["typeKinds"][Json(count.first).get<std::string>()] = count.second;
+    }
+
+    json["typeBytes"] = statistics.typeBytes;
+
+    size_t maximumSelectionDepth = 0;
+    json["operations"] = Json::array();
+    for (auto const & operation : statistics.operations) {
+        json["operations"].push_back({{"name", operation.name},
+                                      {"queryBytes", operation.queryBytes},
+                                      {"variableCount", operation.variableCount},
+                                      {"selectionDepth", operation.selectionDepth}});
+        maximumSelectionDepth = std::max(maximumSelectionDepth, operation.selectionDepth);
+    }
+    json["maximumSelectionDepth"] = maximumSelectionDepth;
+
+    return json;
+}
+
+static void printStatisticsText(GenerationStatistics const & statistics) {
+    constexpr size_t largestCount = 10;
+
+    printf("\nPhases:\n");
+    for (auto const & phase : statistics.phaseMilliseconds) {
+        printf("  %-24s %10.2f ms\n", phase.first.c_str(), phase.second);
+    }
+
+    printf("\nTypes:\n");
+    for (auto const & count : statistics.typeKindCounts) {
+        printf("  %-24s %10zu\n", Json(count.first).get<std::string>().c_str(), count.second);
+    }
+
+    std::vector<std::pair<std::string, size_t>> typeBytes(
+            statistics.typeBytes.begin(), statistics.typeBytes.end());
+    std::sort(typeBytes.begin(), typeBytes.end(), [](auto const & lhs, auto const & rhs) {
+        return lhs.second > rhs.second;
+    });
+
+    printf("\nLargest generated types:\n");
+    for (size_t i = 0; i < std::min(largestCount, typeBytes.size()); ++i) {
+        printf("  %-40s %10zu bytes\n", typeBytes[i].first.c_str(), typeBytes[i].second);
+    }
+
+    auto operations = statistics.operations;
+    std::sort(operations.begin(), operations.end(), [](auto const & lhs, auto const & rhs) {
+        return lhs.queryBytes > rhs.queryBytes;
+    });
+
+    size_t maximumSelectionDepth = 0;
+    for (auto const & operation : operations) {
+        maximumSelectionDepth = std::max(maximumSelectionDepth, operation.selectionDepth);
+    }
+
+    printf("\nLargest query documents:\n");
+    for (size_t i = 0; i < std::min(largestCount, operations.size()); ++i) {
+        printf("  %-40s %10zu bytes %6zu variables %4zu deep\n",
+               operations[i].name.c_str(),
+               operations[i].queryBytes,
+               operations[i].variableCount,
+               operations[i].selectionDepth);
+    }
+
+    printf("\nMaximum selection depth: %zu\n", maximumSelectionDepth);
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Writes to a temporary file next to path and renames it over path, so that builds never see a partial file.
+static void writeFileAtomically(std::string const & path, std::string const & contents) {
+    auto const temporaryPath = path + ".tmp";
+    std::ofstream out(temporaryPath, std::ios::binary);
+    out << contents;
+    out.close();
+    if (!out) {
+        throw std::ios_base::failure("Could not write " + temporaryPath);
+    }
+    std::filesystem::rename(temporaryPath, path);
+}
+
+// The header followed by the implementation files to write for sources.
+static std::vector<std::pair<std::string, std::string>> outputFiles(
+        ProgramInputs const & inputs, GeneratedSources const & sources) {
+    std::vector<std::pair<std::string, std::string>> files{{inputs.outputFile, sources.header}};
+
+    auto const outputDirectoryEnd = inputs.outputFile.find_last_of("/\\");
+    auto const extensionStart = inputs.outputFile.find_last_of('.');
+    auto const outputStem =
+            extensionStart == std::string::npos ||
+                            (outputDirectoryEnd != std::string::npos && extensionStart < outputDirectoryEnd)
+                    ? inputs.outputFile
+                    : inputs.outputFile.substr(0, extensionStart);
+
+    for (size_t i = 0; i < sources.implementations.size(); ++i) {
+        auto const implementationFile = sources.implementations.size() == 1
+                                                ? outputStem + ".cpp"
+                                                : outputStem + std::to_string(i + 1) + ".cpp";
+        files.emplace_back(implementationFile, sources.implementations[i]);
+    }
+
+    return files;
+}
+
+// Schema and generated code kept between generations in watch mode.
+struct WatchState {
+    SchemaParseCache parseCache;
+    GenerationCache generationCache;
+    // Contents last written to each output file
+    std::unordered_map<std::string, std::string> writtenFiles;
+};
+
+static std::string readFile(std::string const & path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::ios_base::failure("Could not open " + path);
+    }
+    std::string text(std::filesystem::file_size(path), '\0');
+    file.read(text.data(), text.size());
+    text.resize(file.gcount());
+    return text;
+}
+
+// The output file name, for implementation files to include.
+static std::string headerInclude(ProgramInputs const & inputs) {
+    auto const outputDirectoryEnd = inputs.outputFile.find_last_of("/\\");
+    return outputDirectoryEnd == std::string::npos ? inputs.outputFile
+                                                   : inputs.outputFile.substr(outputDirectoryEnd + 1);
+}
+
+static std::string schemaFileNames(ProgramInputs const & inputs) {
+    std::string names;
+    for (auto const & schemaFile : inputs.schemaFiles) {
+        names += (names.empty() ? "" : ", ") + schemaFile;
+    }
+    return names;
+}
+
+static GeneratedSources generateFromSchemaFile(
+        ProgramInputs const & inputs, GenerationStatistics * statistics, WatchState * state) {
+    auto const readStart = Clock::now();
+    std::vector<SchemaSource> sources;
+    for (auto const & schemaFile : inputs.schemaFiles) {
+        sources.push_back({schemaFile, readFile(schemaFile)});
+    }
+    if (statistics) {
+        statistics->addPhase("read", millisecondsSince(readStart));
+    }
+
+    // Json parsing and schema deserialization happen together so that unchanged types can skip both.
+    auto const parseStart = Clock::now();
+    auto const schema = parseSchemaSources(sources, state ? &state->parseCache : nullptr);
+    if (statistics) {
+        statistics->addPhase("parse", millisecondsSince(parseStart));
+    }
+
+    return generateSources(
+            schema,
+            inputs.generatedNamespace,
+            headerInclude(inputs),
+            inputs.generationOptions,
+            statistics,
+            state ? &state->generationCache : nullptr);
+}
+
+// Describes the error thrown by run, or returns an empty string if it succeeded.
+static std::string describeErrors(std::function<void()> const & run) {
+    try {
+        run();
+        return "";
+    } catch (std::ios_base::failure const & e) {
+        return std::string("File error: ") + e.what();
+    } catch (std::filesystem::filesystem_error const & e) {
+        return std::string("File error: ") + e.what();
+    } catch (Json::parse_error const & e) {
+        return std::string("Error parsing schema file: ") + e.what();
+    } catch (Json::exception const & e) {
+        return std::string("Error deserializing schema file: ") + e.what();
+    } catch (std::exception const & e) {
+        return std::string("Error occurred: ") + e.what();
+    } catch (...) {
+        return "Unknown error occurred";
     }
 }
 
+// Prints errors thrown by run, returning whether it succeeded.
+static bool reportErrors(std::function<void()> const & run) {
+    auto const error = describeErrors(run);
+    if (!error.empty()) {
+        printf("%s\n", error.c_str());
+    }
+    return error.empty();
+}
+
+// Blocks until one of a set of files changes. Uses inotify on Linux, watching the directories of the files so that
+// editors that save by replacing a file are noticed, and polls the modification times elsewhere.
+class FileWatcher {
+public:
+    explicit FileWatcher(std::vector<std::string> const & paths): paths(paths.begin(), paths.end()) {
+#if defined(__linux__)
+        inotifyDescriptor = inotify_init1(IN_CLOEXEC);
+        if (inotifyDescriptor < 0) {
+            throw std::ios_base::failure("Could not watch files");
+        }
+        for (auto const & path : this->paths) {
+            auto const directory = path.parent_path().empty() ? std::filesystem::path(".") : path.parent_path();
+            // Watching a directory again returns the descriptor of the existing watch.
+            auto const watchDescriptor =
+                    inotify_add_watch(inotifyDescriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            if (watchDescriptor < 0) {
+                throw std::ios_base::failure("Could not watch " + directory.string());
+            }
+            watchedFiles.emplace_back(watchDescriptor, path.filename());
+        }
+#else
+        lastWriteTimes = currentWriteTimes();
+#endif
+    }
+
+    FileWatcher(FileWatcher const &) = delete;
+    FileWatcher & operator=(FileWatcher const &) = delete;
+
+    ~FileWatcher() {
+#if defined(__linux__)
+        if (inotifyDescriptor >= 0) {
+            close(inotifyDescriptor);
+        }
+#endif
+    }
+
+    void waitForChange() {
+#if defined(__linux__)
+        while (!readEvents(-1)) {
+        }
+        // Saving often takes several events, wait for them to settle so they cause a single regeneration.
+        while (readEvents(settleMilliseconds)) {
+        }
+#else
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(pollMilliseconds));
+            auto writeTimes = currentWriteTimes();
+            if (writeTimes != lastWriteTimes) {
+                lastWriteTimes = std::move(writeTimes);
+                return;
+            }
+        }
+#endif
+    }
+
+private:
+    std::vector<std::filesystem::path> paths;
+
+#if defined(__linux__)
+    static constexpr int settleMilliseconds = 20;
+    int inotifyDescriptor = -1;
+    // Watch descriptor of the directory of each file, and the name of the file in it
+    std::vector<std::pair<int, std::filesystem::path>> watchedFiles;
+
+    // Reads the events available within timeout milliseconds, returning whether any were for a watched file.
+    bool readEvents(int timeout) {
+        pollfd descriptor{inotifyDescriptor, POLLIN, 0};
+        if (poll(&descriptor, 1, timeout) <= 0) {
+            return false;
+        }
+
+        alignas(inotify_event) char buffer[4096];
+        auto const length = read(inotifyDescriptor, buffer, sizeof(buffer));
+
+        bool changed = false;
+        for (ssize_t offset = 0; offset < length;) {
+            auto const event = reinterpret_cast<inotify_event const *>(buffer + offset);
+            if (event->len > 0) {
+                for (auto const & watchedFile : watchedFiles) {
+                    changed = changed || (watchedFile.first == event->wd && watchedFile.second == event->name);
+                }
+            }
+            offset += sizeof(inotify_event) + event->len;
+        }
+        return changed;
+    }
+#else
+    static constexpr int pollMilliseconds = 100;
+    std::vector<std::filesystem::file_time_type> lastWriteTimes;
+
+    std::vector<std::filesystem::file_time_type> currentWriteTimes() const {
+        std::vector<std::filesystem::file_time_type> writeTimes;
+        for (auto const & path : paths) {
+            std::error_code error;
+            writeTimes.push_back(std::filesystem::last_write_time(path, error));
+        }
+        return writeTimes;
+    }
+#endif
+};
+
+// Regenerates whenever a schema file changes, reusing the parsed types and code of types that didn't change and
+// only replacing output files whose contents changed.
+[[noreturn]] static void watchSchemaFile(ProgramInputs const & inputs, WatchState & state) {
+    FileWatcher watcher(inputs.schemaFiles);
+    printf("Watching %s for changes\n", schemaFileNames(inputs).c_str());
+    fflush(stdout);
+
+    while (true) {
+        watcher.waitForChange();
+
+        auto const start = Clock::now();
+        reportErrors([&] {
+            GenerationStatistics statistics;
+            auto const sources = generateFromSchemaFile(
+                    inputs, inputs.statisticsFormat.empty() ? nullptr : &statistics, &state);
+
+            size_t replacedCount = 0;
+            for (auto const & file : outputFiles(inputs, sources)) {
+                auto & previous = state.writtenFiles[file.first];
+                if (previous != file.second) {
+                    writeFileAtomically(file.first, file.second);
+                    previous = file.second;
+                    ++replacedCount;
+                }
+            }
+
+            printf("Regenerated in %.1f ms, rendered %zu and reused %zu types, replaced %zu files\n",
+                   millisecondsSince(start),
+                   state.generationCache.renderedTypeCount,
+                   state.generationCache.reusedTypeCount,
+                   replacedCount);
+
+            if (inputs.statisticsFormat == "json") {
+                printf("%s\n", statisticsToJson(statistics).dump(2).c_str());
+            } else if (inputs.statisticsFormat == "text") {
+                printStatisticsText(statistics);
+            }
+        });
+        fflush(stdout);
+    }
+}
+
+// Calls work with every index below count on up to jobs threads.
+static void forEachConcurrently(size_t count, size_t jobs, std::function<void(size_t)> const & work) {
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (auto index = next++; index < count; index = next++) {
+            work(index);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(jobs, count); ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto & thread : threads) {
+        thread.join();
+    }
+}
+
+// Reads a manifest, a json array of entries like
+// {"schema": "a.json", "output": "A.hpp", "namespace": "a", "absl": false, "jsonBackend": "nlohmann",
+// "entityCache": false, "lazy": false, "checkedDecoding": false, "tableDecoding": false, "defer": [], "stream": [],
+// "async": false, "coalesce": false, "resultCache": false, "operations": [], "operationsFile": "operations.txt",
+// "excludeDeprecated": false, "keepDeprecated": [], "recursionDepth": 2, "boxAllocator": "heap",
+// "moveOnlyBoxes": false, "compactLayout": false, "layoutReport": false, "internedIds": false,
+// "scalars": "scalars.json", "runtimeHeader": "", "implementationFiles": 0} where paths other than runtimeHeader,
+// an include path, are relative to the manifest.
+// "schema" may also be an array of schema definition language files.
+static std::vector<ProgramInputs> parseManifest(std::string const & manifestFile) {
+    auto const directory = std::filesystem::path(manifestFile).parent_path();
+    auto const json = Json::parse(readFile(manifestFile));
+
+    std::vector<ProgramInputs> entries;
+    for (auto const & entry : json) {
+        ProgramInputs inputs{};
+        auto const & schema = entry.at("schema");
+        for (auto const & schemaFile : schema.is_array() ? schema : Json::array({schema})) {
+            inputs.schemaFiles.push_back((directory / schemaFile.get<std::string>()).lexically_normal().string());
+        }
+        inputs.outputFile = (directory / entry.at("output").get<std::string>()).lexically_normal().string();
+        inputs.generatedNamespace = entry.value("namespace", "caffql");
+        inputs.generationOptions.algebraicNamespace =
+                entry.value("absl", false) ? AlgebraicNamespace::Absl : AlgebraicNamespace::Std;
+        inputs.generationOptions.jsonBackend = jsonBackendNamed(entry.value("jsonBackend", "nlohmann"));
+        inputs.generationOptions.entityCache = entry.value("entityCache", false);
+        inputs.generationOptions.lazyDecoding = entry.value("lazy", false);
+        inputs.generationOptions.checkedDecoding = entry.value("checkedDecoding", false);
+        inputs.generationOptions.tableDecoding = entry.value("tableDecoding", false);
+        inputs.generationOptions.deferredFields = entry.value("defer", std::set<std::string>());
+        inputs.generationOptions.streamedFields = entry.value("stream", std::set<std::string>());
+        inputs.generationOptions.asyncOperations = entry.value("async", false);
+        inputs.generationOptions.coalescedRequests = entry.value("coalesce", false);
+        inputs.generationOptions.resultCache = entry.value("resultCache", false);
+        inputs.generationOptions.operations = entry.value("operations", std::set<std::string>());
+        if (entry.count("operationsFile")) {
+            inputs.generationOptions.operations.merge(
+                    readOperations((directory / entry.at("operationsFile").get<std::string>()).string()));
+        }
+        inputs.generationOptions.excludeDeprecated = entry.value("excludeDeprecated", false);
+        inputs.generationOptions.keptDeprecatedFields = entry.value("keepDeprecated", std::set<std::string>());
+        inputs.generationOptions.recursionDepth = entry.value("recursionDepth", defaultRecursionDepth);
+        inputs.generationOptions.boxAllocator = boxAllocatorNamed(entry.value("boxAllocator", "heap"));
+        inputs.generationOptions.moveOnlyBoxes = entry.value("moveOnlyBoxes", false);
+        inputs.generationOptions.compactLayout = entry.value("compactLayout", false);
+        inputs.generationOptions.layoutReport = entry.value("layoutReport", false);
+        inputs.generationOptions.internedIds = entry.value("internedIds", false);
+        if (entry.count("scalars")) {
+            inputs.generationOptions.scalarMappings =
+                    readScalarMappings((directory / entry.at("scalars").get<std::string>()).string());
+        }
+        inputs.generationOptions.runtimeHeader = entry.value("runtimeHeader", "");
+        inputs.generationOptions.implementationFiles = entry.value("implementationFiles", size_t(0));
+        entries.push_back(std::move(inputs));
+    }
+    return entries;
+}
+
+// Generates every entry of a manifest on a pool of jobs threads. Each distinct schema is parsed once, even when read
+// from different files, and entries that would generate the same code share a single generation.
+static bool generateManifest(std::string const & manifestFile, size_t jobs) {
+    std::vector<ProgramInputs> entries;
+    if (!reportErrors([&] { entries = parseManifest(manifestFile); })) {
+        return false;
+    }
+
+    jobs = jobs > 0 ? jobs : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    std::vector<std::string> errors(entries.size());
+
+    // Schema files, read once per path.
+    std::vector<std::string> schemaFiles;
+    std::vector<std::vector<size_t>> schemaFilesOfEntry;
+    {
+        std::unordered_map<std::string, size_t> indices;
+        for (auto const & entry : entries) {
+            auto & files = schemaFilesOfEntry.emplace_back();
+            for (auto const & schemaFile : entry.schemaFiles) {
+                auto const inserted = indices.emplace(schemaFile, schemaFiles.size());
+                if (inserted.second) {
+                    schemaFiles.push_back(schemaFile);
+                }
+                files.push_back(inserted.first->second);
+            }
+        }
+    }
+
+    std::vector<std::string> texts(schemaFiles.size());
+    std::vector<std::string> readErrors(schemaFiles.size());
+    forEachConcurrently(schemaFiles.size(), jobs, [&](size_t i) {
+        readErrors[i] = describeErrors([&] { texts[i] = readFile(schemaFiles[i]); });
+    });
+
+    // Schemas, parsed once per distinct contents of the schema files of an entry.
+    std::vector<size_t> schemaOfEntry;
+    std::vector<std::string> entryReadErrors(entries.size());
+    std::vector<std::vector<size_t> const *> schemaFileSets;
+    {
+        std::map<std::vector<std::string_view>, size_t> indices;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            std::vector<std::string_view> contents;
+            for (auto const file : schemaFilesOfEntry[i]) {
+                if (entryReadErrors[i].empty()) {
+                    entryReadErrors[i] = readErrors[file];
+                }
+                contents.push_back(texts[file]);
+            }
+            if (!entryReadErrors[i].empty()) {
+                schemaOfEntry.push_back(0);
+                continue;
+            }
+            auto const inserted = indices.emplace(std::move(contents), schemaFileSets.size());
+            if (inserted.second) {
+                schemaFileSets.push_back(&schemaFilesOfEntry[i]);
+            }
+            schemaOfEntry.push_back(inserted.first->second);
+        }
+    }
+
+    std::vector<Schema> schemas(schemaFileSets.size());
+    std::vector<std::string> parseErrors(schemaFileSets.size());
+    forEachConcurrently(schemaFileSets.size(), jobs, [&](size_t i) {
+        parseErrors[i] = describeErrors([&] {
+            std::vector<SchemaSource> sources;
+            for (auto const file : *schemaFileSets[i]) {
+                sources.push_back({schemaFiles[file], texts[file]});
+            }
+            schemas[i] = parseSchemaSources(sources);
+        });
+    });
+
+    // Generations, one per distinct schema, namespace, options and, for implementation files, header include.
+    // Manifests are small, so each entry is compared with the first entry of every generation so far.
+    std::vector<std::vector<size_t>> entriesOfGeneration;
+    {
+        auto const generateSameCode = [&](size_t lhs, size_t rhs) {
+            auto const & left = entries[lhs];
+            auto const & right = entries[rhs];
+            auto const isRead = entryReadErrors[lhs].empty();
+            if (isRead != entryReadErrors[rhs].empty() ||
+                (isRead ? schemaOfEntry[lhs] != schemaOfEntry[rhs] : left.schemaFiles != right.schemaFiles)) {
+                return false;
+            }
+            return left.generatedNamespace == right.generatedNamespace &&
+                   left.generationOptions == right.generationOptions &&
+                   (left.generationOptions.implementationFiles == 0 || headerInclude(left) == headerInclude(right));
+        };
+        for (size_t i = 0; i < entries.size(); ++i) {
+            auto const generation =
+                    std::find_if(entriesOfGeneration.begin(), entriesOfGeneration.end(), [&](auto const & generation) {
+                        return generateSameCode(generation.front(), i);
+                    });
+            if (generation == entriesOfGeneration.end()) {
+                entriesOfGeneration.push_back({i});
+            } else {
+                generation->push_back(i);
+            }
+        }
+    }
+
+    forEachConcurrently(entriesOfGeneration.size(), jobs, [&](size_t generation) {
+        auto const & generationEntries = entriesOfGeneration[generation];
+        auto const & first = entries[generationEntries.front()];
+        auto const schema = schemaOfEntry[generationEntries.front()];
+        auto const & readError = entryReadErrors[generationEntries.front()];
+
+        auto error = !readError.empty() ? readError : parseErrors[schema];
+        if (error.empty()) {
+            error = describeErrors([&] {
+                auto const sources = generateSources(
+                        schemas[schema], first.generatedNamespace, headerInclude(first), first.generationOptions);
+                for (auto const entry : generationEntries) {
+                    for (auto const & output : outputFiles(entries[entry], sources)) {
+                        writeFileAtomically(output.first, output.second);
+                    }
+                }
+            });
+        }
+
+        for (auto const entry : generationEntries) {
+            errors[entry] = error;
+        }
+    });
+
+    bool succeeded = true;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (errors[i].empty()) {
+            printf("Generated %s with namespace %s from %s\n",
+                   entries[i].outputFile.c_str(),
+                   entries[i].generatedNamespace.c_str(),
+                   schemaFileNames(entries[i]).c_str());
+        } else {
+            printf("Failed to generate %s: %s\n", entries[i].outputFile.c_str(), errors[i].c_str());
+            succeeded = false;
+        }
+    }
+
+    printf("Generated %zu entries from %zu distinct schemas in %zu generations\n",
+           entries.size(),
+           schemas.size(),
+           entriesOfGeneration.size());
+
+    return succeeded;
+}
+
 } // namespace caffql
 
 int main(int argc, char * argv[]) {
@@ -56,34 +835,63 @@ int main(int argc, char * argv[]) {
 
     auto const inputs = parseCommandLine(argc, argv);
 
-    try {
-        std::ifstream file(inputs.schemaFile);
-        auto const json = Json::parse(file);
-        Schema schema = json.at("data").at("__schema");
+    if (!inputs.manifestFile.empty()) {
+        return generateManifest(inputs.manifestFile, inputs.jobs) ? 0 : 1;
+    }
+
+    if (!inputs.runtimeOutputFile.empty()) {
+        auto const algebraicNamespace = inputs.generationOptions.algebraicNamespace;
+        auto const written = reportErrors([&] {
+            writeFileAtomically(inputs.runtimeOutputFile, generateRuntimeHeader(algebraicNamespace));
+        });
+        if (!written) {
+            return 1;
+        }
+        printf("Generated %s using %s optional and variant\n",
+               inputs.runtimeOutputFile.c_str(),
+               algrebraicNamespaceName(algebraicNamespace).c_str());
+        if (inputs.schemaFiles.empty()) {
+            return 0;
+        }
+    }
 
-        auto const source = generateTypes(schema, inputs.generatedNamespace, inputs.algebraicNamespace);
-        std::ofstream out(inputs.outputFile);
-        out << source;
-        out.close();
+    GenerationStatistics statistics;
+    auto const shouldCollectStatistics = !inputs.statisticsFormat.empty();
+
+    WatchState state;
+
+    auto const succeeded = reportErrors([&] {
+        auto const sources = generateFromSchemaFile(
+                inputs, shouldCollectStatistics ? &statistics : nullptr, inputs.watch ? &state : nullptr);
+
+        auto const files = outputFiles(inputs, sources);
+        for (size_t i = 0; i < files.size(); ++i) {
+            writeFileAtomically(files[i].first, files[i].second);
+            if (inputs.watch) {
+                state.writtenFiles[files[i].first] = files[i].second;
+            }
+            if (i > 0) {
+                printf("Generated %s\n", files[i].first.c_str());
+            }
+        }
 
         printf("Generated %s with namespace %s from %s using %s optional and variant\n",
                inputs.outputFile.c_str(),
                inputs.generatedNamespace.c_str(),
-               inputs.schemaFile.c_str(),
-               algrebraicNamespaceName(inputs.algebraicNamespace).c_str());
+               schemaFileNames(inputs).c_str(),
+               algrebraicNamespaceName(inputs.generationOptions.algebraicNamespace).c_str());
 
-        return 0;
-    } catch (std::ios_base::failure const & e) {
-        printf("File error: %s\n", e.what());
-    } catch (Json::parse_error const & e) {
-        printf("Error parsing schema file: %s\n", e.what());
-    } catch (Json::exception const & e) {
-        printf("Error deserializing schema file: %s\n", e.what());
-    } catch (std::exception const & e) {
-        printf("Error occurred: %s\n", e.what());
-    } catch (...) {
-        printf("Unknown error occurred\n");
+        if (inputs.statisticsFormat == "json") {
+            printf("%s\n", statisticsToJson(statistics).dump(2).c_str());
+        } else if (inputs.statisticsFormat == "text") {
+            printStatisticsText(statistics);
+        }
+    });
+
+    if (inputs.watch) {
+        // Keep watching after a failure, the next change may fix the schema.
+        reportErrors([&] { watchSchemaFile(inputs, state); });
     }
 
-    return 1;
+    return succeeded ? 0 : 1;
 }
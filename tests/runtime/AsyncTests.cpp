@@ -0,0 +1,75 @@
+#include "Generated.hpp"
+#include "doctest.h"
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+static Json userResponse(Json const & request) {
+    auto const id = request.at("variables").at("id").get<std::string>();
+    return {{"data",
+             {{"user",
+               {{"id", id},
+                {"name", "User " + id},
+                {"score", nullptr},
+                {"active", true},
+                {"age", nullptr},
+                {"friends", Json::array()},
+                {"bestFriend", nullptr},
+                {"posts", Json::array()}}}}}};
+}
+
+TEST_CASE("async operations") {
+    std::vector<Json> requests;
+    LocalGraphqlTransport transport{[&](Json const & request) {
+        requests.push_back(request);
+        return userResponse(request);
+    }};
+
+    SUBCASE("operations wait for the transport without blocking each other") {
+        std::vector<std::string> names;
+        auto const onResult = [&](GraphqlResponse<Query::UserField::ResponseData> response) {
+            names.push_back(*std::get<0>(response)->name);
+        };
+        spawn(Query::UserField::execute(transport, "1"), onResult);
+        spawn(Query::UserField::execute(transport, "2"), onResult);
+
+        // Nothing is answered until the transport runs
+        CHECK(names.empty());
+        CHECK(transport.run() == 2);
+        CHECK(names == std::vector<std::string>{"User 1", "User 2"});
+        CHECK(requests.at(1).at("variables").at("id") == "2");
+    }
+
+    SUBCASE("tasks await other tasks") {
+        auto const names = [&]() -> GraphqlTask<std::string> {
+            auto const first = co_await Query::UserField::execute(transport, "1");
+            auto const second = co_await Query::UserField::execute(transport, *std::get<0>(first)->name + "0");
+            co_return *std::get<0>(second)->name;
+        };
+
+        std::string result;
+        spawn(names(), [&](std::string name) { result = std::move(name); });
+        CHECK(transport.run() == 2);
+        CHECK(result == "User User 10");
+    }
+
+    SUBCASE("exceptions are thrown to the awaiter") {
+        LocalGraphqlTransport failing{[](Json const &) { return Json{{"data", {{"user", {{"id", 1}}}}}}; }};
+        auto const attempt = [&]() -> GraphqlTask<bool> {
+            try {
+                co_await Query::UserField::execute(failing, "1");
+            } catch (Json::exception const &) {
+                co_return true;
+            }
+            co_return false;
+        };
+
+        auto threw = false;
+        spawn(attempt(), [&](bool result) { threw = result; });
+        failing.run();
+        CHECK(threw);
+    }
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,49 @@
+#include "Generated.hpp"
+#include "doctest.h"
+
+#include <type_traits>
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+TEST_CASE("pooled move-only boxes") {
+    auto const json = Json::parse(R"({"data": {"user": {
+        "id": "1", "active": true, "friends": [], "posts": [],
+        "bestFriend": {"id": "2", "active": false, "friends": [], "posts": [], "bestFriend": null}
+    }}})");
+
+    SUBCASE("types containing boxed fields can only be moved") {
+        static_assert(!std::is_copy_constructible_v<User>);
+        static_assert(!std::is_copy_assignable_v<User>);
+        static_assert(std::is_nothrow_move_constructible_v<BoxedOptional<User>>);
+    }
+
+    SUBCASE("recursive responses decode into them") {
+        auto response = Query::UserField::response(json);
+        auto & user = std::get<0>(response);
+        REQUIRE(user);
+        REQUIRE(user->bestFriend);
+        CHECK(user->bestFriend->id == "2");
+        CHECK(!user->bestFriend->bestFriend);
+
+        auto const moved = std::move(*user);
+        REQUIRE(moved.bestFriend);
+        CHECK(moved.bestFriend->id == "2");
+        CHECK(!user->bestFriend);
+    }
+
+    SUBCASE("freed boxes are reused by the next ones allocated on the thread") {
+        size_t freeCount = 0;
+        {
+            auto const response = Query::UserField::response(json);
+            freeCount = BoxPool<User>::freeCount();
+        }
+        REQUIRE(BoxPool<User>::freeCount() == freeCount + 1);
+
+        auto const response = Query::UserField::response(json);
+        CHECK(BoxPool<User>::freeCount() == freeCount);
+    }
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,125 @@
+#include "Generated.hpp"
+#include "doctest.h"
+#include <atomic>
+#include <thread>
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+template <typename Operation, typename = void>
+struct HasFetch : std::false_type {};
+
+template <typename Operation>
+struct HasFetch<Operation, std::void_t<decltype(&Operation::fetch)>> : std::true_type {};
+
+static_assert(HasFetch<Query::UserField>::value);
+static_assert(!HasFetch<Mutation::CreatePostField>::value, "Merging identical mutations would lose one");
+static_assert(!HasFetch<Subscription::PostAddedField>::value);
+
+static Json userResponse(Json const & request) {
+    auto const id = request.at("variables").at("id").get<std::string>();
+    return {{"data",
+             {{"user",
+               {{"id", id},
+                {"name", "User " + id},
+                {"active", true},
+                {"friends", Json::array()},
+                {"posts", Json::array()}}}}}};
+}
+
+TEST_CASE("request coalescing") {
+    std::atomic<size_t> requests{0};
+    std::promise<void> started;
+    std::promise<void> release;
+    auto const releasing = release.get_future().share();
+
+    GraphqlRequestCoalescer coalescer{[&](Json const & request) {
+        if (requests++ == 0) {
+            started.set_value();
+            releasing.wait();
+        }
+        return userResponse(request);
+    }};
+
+    SUBCASE("concurrent fetches of the same query share a request") {
+        std::shared_ptr<GraphqlResponse<Query::UserField::ResponseData> const> first;
+        std::thread firstFetch{[&] { first = Query::UserField::fetch(coalescer, "1"); }};
+        started.get_future().wait();
+        CHECK(coalescer.size() == 1);
+
+        std::shared_ptr<GraphqlResponse<Query::UserField::ResponseData> const> second;
+        std::thread secondFetch{[&] { second = Query::UserField::fetch(coalescer, "1"); }};
+        // Gives the second fetch time to find the request in flight
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        release.set_value();
+        firstFetch.join();
+        secondFetch.join();
+
+        CHECK(requests == 1);
+        CHECK(first == second);
+        CHECK(std::get<0>(*first)->name == "User 1");
+        CHECK(coalescer.size() == 0);
+    }
+
+    SUBCASE("fetches with other variables or after a request finishes make their own") {
+        release.set_value();
+        auto const first = Query::UserField::fetch(coalescer, "1");
+        auto const again = Query::UserField::fetch(coalescer, "1");
+        auto const other = Query::UserField::fetch(coalescer, "2");
+        CHECK(requests == 3);
+        CHECK(first != again);
+        CHECK(std::get<0>(*other)->name == "User 2");
+    }
+
+    SUBCASE("requests are shared by arguments that are equal in value") {
+        GraphqlRequestCoalescer searching{[&](Json const &) -> Json {
+            if (requests++ == 0) {
+                started.set_value();
+                releasing.wait();
+            }
+            return {{"data", {{"search", Json::array()}}}};
+        }};
+
+        std::thread firstFetch{[&] { Query::SearchField::fetch(searching, "graphql", std::nullopt, -0.0); }};
+        started.get_future().wait();
+        std::thread secondFetch{[&] { Query::SearchField::fetch(searching, "graphql", std::nullopt, 0.0); }};
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        release.set_value();
+        firstFetch.join();
+        secondFetch.join();
+
+        CHECK(requests == 1);
+    }
+
+    SUBCASE("exceptions are thrown to every caller sharing the request") {
+        GraphqlRequestCoalescer failing{[&](Json const &) -> Json {
+            ++requests;
+            started.set_value();
+            releasing.wait();
+            throw std::runtime_error("unreachable");
+        }};
+
+        std::atomic<size_t> failures{0};
+        auto const fetch = [&] {
+            try {
+                Query::UserField::fetch(failing, "1");
+            } catch (std::runtime_error const &) {
+                ++failures;
+            }
+        };
+        std::thread firstFetch{fetch};
+        started.get_future().wait();
+        std::thread secondFetch{fetch};
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        release.set_value();
+        firstFetch.join();
+        secondFetch.join();
+
+        CHECK(requests == 1);
+        CHECK(failures == 2);
+        CHECK(failing.size() == 0);
+    }
+}
+
+TEST_SUITE_END;
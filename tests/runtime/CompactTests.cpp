@@ -0,0 +1,58 @@
+#include <algorithm>
+#include "Generated.hpp"
+#include "doctest.h"
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+TEST_CASE("compact layout") {
+    SUBCASE("members only leave padding at the end of objects") {
+        for (auto const & layout : layoutReport()) {
+            CAPTURE(layout.name);
+            CHECK(layout.padding < alignof(std::max_align_t));
+        }
+    }
+
+    SUBCASE("objects are smaller than with optional members") {
+        struct DefaultUser {
+            Id id;
+            optional<std::string> name;
+            optional<double> score;
+            bool active;
+            optional<int32_t> age;
+            optional<std::vector<User>> friends;
+            BoxedOptional<User> bestFriend;
+            optional<std::vector<Post>> posts;
+        };
+        auto const defaultPadding =
+                sizeof(DefaultUser) - (sizeof(Id) + sizeof(optional<std::string>) + sizeof(optional<double>) +
+                                       sizeof(bool) + sizeof(optional<int32_t>) +
+                                       2 * sizeof(optional<std::vector<User>>) + sizeof(BoxedOptional<User>));
+        CHECK(sizeof(User) < sizeof(DefaultUser));
+
+        auto const layouts = layoutReport();
+        auto const user = std::find_if(layouts.begin(), layouts.end(), [](TypeLayout const & layout) {
+            return std::string(layout.name) == "User";
+        });
+        REQUIRE(user != layouts.end());
+        CHECK(user->size == sizeof(User));
+        CHECK(user->padding < defaultPadding);
+    }
+
+    SUBCASE("nullable scalars are tracked in presence bits") {
+        User user{};
+        CHECK(!user.age());
+        user.setAge(30);
+        CHECK(user.age() == 30);
+        user.setAge(std::nullopt);
+        CHECK(!user.age());
+
+        Json const json = {{"id", "1"}, {"score", 2.5}, {"active", true}, {"age", nullptr}};
+        auto const decoded = json.get<User>();
+        CHECK(decoded.score() == 2.5);
+        CHECK(!decoded.age());
+    }
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,139 @@
+#include <thread>
+#include "Generated.hpp"
+#include "doctest.h"
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+namespace {
+
+Json user(char const * id, char const * name) {
+    return Json{{"__typename", "User"}, {"id", id}, {"name", name}, {"active", true}};
+}
+
+template <typename Operation>
+typename Operation::ResponseData responseData(Json data) {
+    auto response = Operation::response(Json{{"data", std::move(data)}});
+    return std::get<0>(std::move(response));
+}
+
+} // namespace
+
+TEST_CASE("entity cache") {
+    // Selected to the default recursion depth of 2, so Ann's friend Bob lists Ann without her friends
+    auto ann = user("1", "Ann");
+    auto bob = user("2", "Bob");
+    bob["friends"] = {user("1", "Ann")};
+    bob["bestFriend"] = user("1", "Ann");
+    bob["posts"] = Json::array();
+    ann["friends"] = {bob};
+    ann["bestFriend"] = bob;
+    ann["posts"] = {{{"id", "3"},
+                     {"title", "Hello"},
+                     {"author", user("1", "Ann")},
+                     {"comments", {{{"text", "Hi"}}}}}};
+
+    EntityCache cache;
+    cache.write(responseData<Query::UserField>({{"user", ann}}));
+    REQUIRE(cache.size() == 3);
+
+    SUBCASE("entities are rebuilt from their references") {
+        auto const found = cache.find<User>("1");
+        REQUIRE(found);
+        CHECK(*found->name == "Ann");
+        REQUIRE(found->friends);
+        REQUIRE(found->friends->size() == 1);
+        auto const & friendOfAnn = (*found->friends)[0];
+        CHECK(*friendOfAnn.name == "Bob");
+        REQUIRE(found->bestFriend);
+        CHECK(found->bestFriend->id == "2");
+        REQUIRE(found->posts);
+        REQUIRE(found->posts->size() == 1);
+        CHECK((*found->posts)[0].title == "Hello");
+    }
+
+    SUBCASE("nested copies selected to a lower depth don't overwrite the fields they leave out") {
+        // Bob's Ann came last, without friends, best friend or posts
+        auto const found = cache.find<User>("1");
+        REQUIRE(found);
+        CHECK(found->friends);
+        CHECK(found->bestFriend);
+        CHECK(found->posts);
+
+        auto const bobFound = cache.find<User>("2");
+        REQUIRE(bobFound);
+        REQUIRE(bobFound->friends);
+        REQUIRE(bobFound->friends->size() == 1);
+        // Rebuilt to the recursion depth
+        auto const & annOfBob = (*bobFound->friends)[0];
+        REQUIRE(annOfBob.friends);
+        CHECK(!(*annOfBob.friends)[0].friends);
+    }
+
+    SUBCASE("writes merge into entities that other entities refer to") {
+        cache.write(responseData<Query::UserField>({{"user", user("2", "Robert")}}), 0);
+
+        auto const found = cache.find<User>("1");
+        REQUIRE(found);
+        CHECK(*(*found->friends)[0].name == "Robert");
+        CHECK(*found->bestFriend->name == "Robert");
+        auto const post = cache.find<Post>("3");
+        REQUIRE(post);
+        REQUIRE(post->author);
+        REQUIRE(post->author->friends);
+        CHECK(*(*post->author->friends)[0].name == "Robert");
+
+        // Fields that weren't selected at depth 0 are kept
+        auto const robert = cache.find<User>("2");
+        REQUIRE(robert);
+        REQUIRE(robert->friends);
+        CHECK(robert->friends->size() == 1);
+        CHECK(cache.size() == 3);
+    }
+
+    SUBCASE("interfaces and unions store their entities") {
+        auto carl = user("4", "Carl");
+        carl["friends"] = Json::array();
+        carl["posts"] = Json::array();
+        cache.write(responseData<Query::NodeField>({{"node", carl}}));
+        auto dave = user("5", "Dave");
+        dave["friends"] = Json::array();
+        dave["posts"] = Json::array();
+        cache.write(responseData<Query::SearchField>({{"search", {dave}}}));
+
+        CHECK(cache.size() == 5);
+        REQUIRE(cache.find<User>("4"));
+        CHECK(*cache.find<User>("4")->name == "Carl");
+        REQUIRE(cache.find<User>("5"));
+        CHECK(*cache.find<User>("5")->name == "Dave");
+    }
+
+    SUBCASE("missing entities aren't found") {
+        CHECK(!cache.find<User>("9"));
+        cache.clear();
+        CHECK(!cache.find<User>("1"));
+        CHECK(cache.size() == 0);
+    }
+
+    SUBCASE("entities are found while others are written") {
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 4; ++i) {
+            readers.emplace_back([&] {
+                for (int j = 0; j < 200; ++j) {
+                    auto const found = cache.find<User>("1");
+                    CHECK(found);
+                }
+            });
+        }
+        for (int j = 0; j < 200; ++j) {
+            cache.write(responseData<Query::UserField>({{"user", ann}}));
+        }
+        for (auto & reader : readers) {
+            reader.join();
+        }
+        CHECK(cache.size() == 3);
+    }
+}
+
+TEST_SUITE_END;
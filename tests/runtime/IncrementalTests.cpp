@@ -0,0 +1,61 @@
+#include "Generated.hpp"
+#include "doctest.h"
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+TEST_CASE("incremental delivery") {
+    auto response = Query::UserField::response(Json::parse(R"({"data": {"user": {
+        "id": "1", "score": null, "active": true, "age": null, "friends": [], "bestFriend": null, "posts": []
+    }}})"));
+    auto & data = std::get<0>(response);
+    REQUIRE(data);
+
+    auto const post = [](char const * id) {
+        return Json{{"id", id},
+                    {"title", std::string("Post ") + id},
+                    {"author", {{"id", "1"}, {"active", true}, {"friends", Json::array()}, {"posts", Json::array()}}},
+                    {"comments", Json::array()}};
+    };
+
+    SUBCASE("deferred fields are merged into their object") {
+        CHECK(!data->name);
+        auto const applied = Query::UserField::applyPayload(
+                {{"incremental", {{{"data", {{"name", "Ann"}}}, {"path", {"user"}}}}}, {"hasNext", false}}, data);
+        CHECK(!applied.hasNext);
+        CHECK(data->name == "Ann");
+    }
+
+    SUBCASE("streamed items are appended to their list") {
+        auto applied = Query::UserField::applyPayload(
+                {{"incremental", {{{"items", {post("1"), post("2")}}, {"path", {"user", "posts", 0}}}}},
+                 {"hasNext", true}},
+                data);
+        CHECK(applied.hasNext);
+        applied = Query::UserField::applyPayload(
+                {{"incremental", {{{"items", {post("3")}}, {"path", {"user", "posts", 2}}}}}, {"hasNext", false}},
+                data);
+        REQUIRE(data->posts);
+        REQUIRE(data->posts->size() == 3);
+        CHECK((*data->posts)[2].title == "Post 3");
+    }
+
+    SUBCASE("items can't start past the end of their list") {
+        CHECK_THROWS_AS(Query::UserField::applyPayload(
+                                {{"incremental", {{{"items", {post("9")}}, {"path", {"user", "posts", 9}}}}}}, data),
+                        std::out_of_range);
+        REQUIRE(data->posts);
+        CHECK(data->posts->empty());
+    }
+
+    SUBCASE("paths into objects without incremental fields are invalid") {
+        CHECK_THROWS_AS(
+                Query::UserField::applyPayload(
+                        {{"incremental", {{{"data", {{"text", "x"}}}, {"path", {"user", "posts", 0, "title"}}}}}},
+                        data),
+                std::out_of_range);
+    }
+}
+
+TEST_SUITE_END;
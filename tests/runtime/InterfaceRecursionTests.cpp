@@ -0,0 +1,35 @@
+#include "Generated.hpp"
+#include "doctest.h"
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+TEST_CASE("interface fields of recursive implementations") {
+    auto const json = Json::parse(R"({"data": {"user": {
+        "author": {"author": null, "post": null, "node": null},
+        "post": {"author": null},
+        "node": {"__typename": "Post", "author": {"__typename": "User"}}
+    }}})");
+
+    auto const response = Query::UserField::response(json);
+    auto const & user = std::get<0>(response);
+    REQUIRE(user);
+
+    SUBCASE("are returned as their implementations store them") {
+        REQUIRE(user->node);
+        REQUIRE(std::holds_alternative<Post>(user->node->implementation));
+        BoxedOptional<User> const & author = user->node->author();
+        CHECK(author);
+        CHECK(&author == &std::get<Post>(user->node->implementation).author);
+    }
+
+    SUBCASE("decode in every implementation") {
+        REQUIRE(user->author);
+        CHECK(!user->author->author);
+        REQUIRE(user->post);
+        CHECK(!user->post->author);
+    }
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,87 @@
+#include <thread>
+#include "Generated.hpp"
+#include "doctest.h"
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+TEST_CASE("interned ids") {
+    auto const interned = Id::internedCount();
+
+    SUBCASE("equal strings share one entry") {
+        Id const first = std::string("user-1");
+        Id const second = "user-1";
+        Id const other = "user-2";
+        CHECK(first == second);
+        CHECK(first.hash() == second.hash());
+        CHECK(first != other);
+        CHECK(first < other);
+        CHECK(second.str() == "user-1");
+        CHECK(Id::internedCount() == interned + 2);
+        CHECK(Id("").str().empty());
+        CHECK(Id() == Id(""));
+    }
+
+    SUBCASE("strings are freed with their last id") {
+        {
+            Id first = "user-1";
+            {
+                Id const copy = first;
+                Id moved = std::move(first);
+                CHECK(Id::internedCount() == interned + 1);
+                first = moved;
+            }
+            CHECK(Id::internedCount() == interned + 1);
+            CHECK(first.str() == "user-1");
+        }
+        CHECK(Id::internedCount() == interned);
+
+        Id again = "user-1";
+        CHECK(again.str() == "user-1");
+        again = "user-2";
+        CHECK(Id::internedCount() == interned + 1);
+    }
+
+    SUBCASE("decoded responses release their ids") {
+        {
+            auto response = Query::UserField::response(Json{
+                    {"data",
+                     {{"user",
+                       {{"id", "1"},
+                        {"name", "Ann"},
+                        {"active", true},
+                        {"friends", {{{"id", "2"}, {"name", "Bob"}, {"active", true}}}},
+                        {"bestFriend", {{"id", "2"}, {"name", "Bob"}, {"active", true}}},
+                        {"posts", Json::array()}}}}}});
+            auto const & user = std::get<0>(response);
+            REQUIRE(user);
+            REQUIRE(user->bestFriend);
+            CHECK(user->id == "1");
+            CHECK(user->bestFriend->id == (*user->friends)[0].id);
+            CHECK(Id::internedCount() == interned + 2);
+        }
+        CHECK(Id::internedCount() == interned);
+    }
+
+    SUBCASE("ids are interned and released concurrently") {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([i] {
+                for (int j = 0; j < 500; ++j) {
+                    Id const shared = "shared";
+                    Id const copy = shared;
+                    Id const own = "thread-" + std::to_string(i) + "-" + std::to_string(j % 10);
+                    CHECK(copy.str() == "shared");
+                    CHECK(own == Id("thread-" + std::to_string(i) + "-" + std::to_string(j % 10)));
+                }
+            });
+        }
+        for (auto & thread : threads) {
+            thread.join();
+        }
+        CHECK(Id::internedCount() == interned);
+    }
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,52 @@
+#include "Generated.hpp"
+#include "doctest.h"
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+TEST_CASE("lazy decoding") {
+    auto const user = [](char const * id, Json name) {
+        return Json{{"id", id}, {"name", std::move(name)}, {"active", true}, {"friends", Json::array()}};
+    };
+
+    SUBCASE("responses decode fields on first access and memoize them") {
+        auto response = Query::UserField::response(Json{{"data", {{"user", user("1", "Ann")}}}});
+        auto const & data = std::get<0>(response);
+        REQUIRE(data);
+        REQUIRE(data->name());
+        CHECK(*data->name() == "Ann");
+        CHECK(&data->name() == &data->name());
+        REQUIRE(data->friends());
+        CHECK(data->friends()->empty());
+        CHECK(!data->score());
+    }
+
+    SUBCASE("missing required fields throw on access") {
+        auto missingActive = user("1", "Ann");
+        missingActive.erase("active");
+        auto response = Query::UserField::response(Json{{"data", {{"user", missingActive}}}});
+        auto const & data = std::get<0>(response);
+        REQUIRE(data);
+        CHECK(data->id() == "1");
+        CHECK_THROWS(data->active());
+    }
+
+    SUBCASE("values decoded from one document outlive the json they were moved from") {
+        auto json = Json::array({user("1", "Ann"), user("2", nullptr)});
+        auto const users = decodeLazyDocument<std::vector<User>>(std::move(json));
+        REQUIRE(users.size() == 2);
+        CHECK(users[0].id() == "1");
+        CHECK(*users[0].name() == "Ann");
+        CHECK(!users[1].name());
+    }
+
+    SUBCASE("copies decode their own fields") {
+        auto const users = decodeLazyDocument<std::vector<User>>(Json::array({user("1", "Ann")}));
+        auto const copy = users[0];
+        CHECK(*copy.name() == "Ann");
+        CHECK(&copy.name() != &users[0].name());
+    }
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,47 @@
+#include "Generated.hpp"
+#include "doctest.h"
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+TEST_CASE("recursive fields") {
+    // Selected to a recursion depth of 1, so the posts' non-null author and comments are left out
+    auto const json = Json::parse(R"({"data": {"user": {
+        "id": "1", "active": true, "friends": [], "bestFriend": null, "posts": [{"id": "2", "title": "Post"}]
+    }}})");
+
+    SUBCASE("queries stop selecting them at the recursion depth") {
+        auto const query = Query::UserField::request("1").at("query").get<std::string>();
+        CHECK(query.find("posts") != std::string::npos);
+        CHECK(query.find("author") == std::string::npos);
+        CHECK(query.find("comments") == std::string::npos);
+    }
+
+    SUBCASE("non-null fields left out by the recursion depth decode as absent") {
+        auto const response = Query::UserField::response(json);
+        auto const & user = std::get<0>(response);
+        REQUIRE(user);
+        REQUIRE(user->posts);
+        REQUIRE(user->posts->size() == 1);
+        auto const & post = (*user->posts)[0];
+        CHECK(post.title == "Post");
+        CHECK(!post.author);
+        CHECK(!post.comments);
+    }
+
+    SUBCASE("checked decoding accepts them") {
+        auto const response = Query::UserField::tryResponse(json);
+        REQUIRE(std::holds_alternative<GraphqlResponse<Query::UserField::ResponseData>>(response));
+    }
+
+    SUBCASE("other non-null fields are still required") {
+        auto missingTitle = json;
+        missingTitle["data"]["user"]["posts"][0].erase("title");
+        auto const response = Query::UserField::tryResponse(missingTitle);
+        REQUIRE(std::holds_alternative<DecodeError>(response));
+        CHECK(std::get<DecodeError>(response).path == "data.user.posts[0].title");
+    }
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,131 @@
+#include "Generated.hpp"
+#include "doctest.h"
+#include <thread>
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+template <typename Operation, typename = void>
+struct HasCacheKey : std::false_type {};
+
+template <typename Operation>
+struct HasCacheKey<Operation, std::void_t<decltype(&Operation::cacheKey)>> : std::true_type {};
+
+static_assert(HasCacheKey<Query::SearchField>::value);
+static_assert(!HasCacheKey<Mutation::CreatePostField>::value);
+static_assert(!HasCacheKey<Subscription::PostAddedField>::value);
+
+TEST_CASE("result cache keys") {
+    auto const key = Query::SearchField::cacheKey("graphql", 10, 0.5);
+
+    SUBCASE("keys encode the arguments canonically") {
+        CHECK(key.operation == "query Search");
+        // The string's length and bytes, then whether the Int is present and its 8 little endian bytes
+        CHECK(Query::SearchField::cacheKey("ab", 1, std::nullopt).arguments ==
+              std::string("\x02\0\0\0\0\0\0\0ab\x01\x01\0\0\0\0\0\0\0\0", 20));
+        CHECK(Query::SearchField::cacheKey("graphql", 10, -0.0) == Query::SearchField::cacheKey("graphql", 10, 0.0));
+        CHECK(!(Query::SearchField::cacheKey("graphql", std::nullopt, 0.5) == key));
+    }
+
+    SUBCASE("keys are equal for equal arguments only") {
+        CHECK(key == Query::SearchField::cacheKey("graphql", 10, 0.5));
+        CHECK(!(key == Query::SearchField::cacheKey("graphql", 11, 0.5)));
+        CHECK(!(Query::UserField::cacheKey("1") == Query::NodeField::cacheKey("1")));
+    }
+
+    SUBCASE("input objects encode their fields") {
+        PostInput input{"Title", std::vector<std::string>{"a", "b"}, -0.0};
+        auto const inputKey = makeCacheKey("mutation CreatePost", input);
+        input.score = 0.0;
+        CHECK(makeCacheKey("mutation CreatePost", input) == inputKey);
+        input.tags->push_back("c");
+        CHECK(!(makeCacheKey("mutation CreatePost", input) == inputKey));
+    }
+
+    SUBCASE("hashes only depend on the encoding") {
+        // FNV-1a of "query User\n" and the encoding of "1"
+        uint64_t expected = 0xcbf29ce484222325ull;
+        for (auto const byte : std::string("query User\n\x01\0\0\0\0\0\0\0" "1", 20)) {
+            expected = (expected ^ static_cast<unsigned char>(byte)) * 0x100000001b3ull;
+        }
+        CHECK(Query::UserField::cacheKey("1").hash == expected);
+    }
+}
+
+TEST_CASE("result cache") {
+    auto const first = Query::UserField::cacheKey("1");
+    auto const second = Query::UserField::cacheKey("2");
+    auto const third = Query::UserField::cacheKey("3");
+
+    SUBCASE("results are found by equal keys") {
+        GraphqlResultCache cache{100, std::chrono::hours(1)};
+        cache.insert(first, std::string("first"), 5);
+        auto const found = cache.find<std::string>(Query::UserField::cacheKey("1"));
+        REQUIRE(found);
+        CHECK(*found == "first");
+        CHECK(!cache.find<std::string>(second));
+        // Results of another type aren't returned
+        CHECK(!cache.find<int>(first));
+    }
+
+    SUBCASE("keys whose hashes collide don't share results") {
+        GraphqlResultCache cache{100, std::chrono::hours(1)};
+        auto colliding = second;
+        colliding.hash = first.hash;
+        cache.insert(first, std::string("first"), 5);
+        CHECK(!cache.find<std::string>(colliding));
+        cache.insert(colliding, std::string("colliding"), 5);
+        CHECK(*cache.find<std::string>(first) == "first");
+        CHECK(*cache.find<std::string>(colliding) == "colliding");
+    }
+
+    SUBCASE("the least recently used results are evicted past capacity") {
+        GraphqlResultCache cache{10, std::chrono::hours(1)};
+        cache.insert(first, 1, 4);
+        cache.insert(second, 2, 4);
+        // Uses first, so that second is the least recently used
+        CHECK(cache.find<int>(first));
+        cache.insert(third, 3, 4);
+
+        CHECK(cache.size() == 8);
+        CHECK(cache.find<int>(first));
+        CHECK(!cache.find<int>(second));
+        CHECK(cache.find<int>(third));
+
+        // Results larger than the capacity aren't stored at all
+        cache.insert(second, 2, 11);
+        CHECK(!cache.find<int>(second));
+        CHECK(cache.size() == 8);
+    }
+
+    SUBCASE("results larger than the capacity still replace the result stored for their key") {
+        GraphqlResultCache cache{10, std::chrono::hours(1)};
+        cache.insert(first, 1, 4);
+        CHECK(*cache.insert(first, 2, 11) == 2);
+        CHECK(!cache.find<int>(first));
+        CHECK(cache.size() == 0);
+    }
+
+    SUBCASE("results expire after their time to live") {
+        GraphqlResultCache cache{10, std::chrono::milliseconds(1)};
+        cache.insert(first, 1, 4);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        CHECK(!cache.find<int>(first));
+        CHECK(cache.size() == 0);
+    }
+
+    SUBCASE("results can be erased") {
+        GraphqlResultCache cache{10, std::chrono::hours(1)};
+        cache.insert(first, 1, 4);
+        cache.insert(second, 2, 4);
+        cache.erase(first);
+        CHECK(!cache.find<int>(first));
+        CHECK(cache.size() == 4);
+        cache.clear();
+        CHECK(!cache.find<int>(second));
+        CHECK(cache.size() == 0);
+    }
+}
+
+TEST_SUITE_END;
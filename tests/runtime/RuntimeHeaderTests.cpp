@@ -0,0 +1,43 @@
+#include <type_traits>
+#include "Generated.hpp"
+#include "doctest.h"
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+TEST_CASE("runtime header") {
+    SUBCASE("the prelude comes from the runtime header") {
+        CHECK(CAFFQL_RUNTIME_VERSION > 0);
+        CHECK(CAFFQL_RUNTIME_ABSL == 0);
+        CHECK(std::is_same_v<GraphqlError, caffql::runtime::GraphqlError>);
+        CHECK(std::is_same_v<GraphqlResponse<User>, caffql::runtime::GraphqlResponse<User>>);
+        CHECK(std::is_same_v<Id, caffql::runtime::Id>);
+        CHECK(Query::UserField::operation == caffql::runtime::Operation::Query);
+    }
+
+    SUBCASE("optionals are serialized by the runtime header") {
+        CHECK(Json(optional<int>()).is_null());
+        CHECK(Json(optional<int>(3)) == 3);
+        CHECK(!Json().get<optional<int>>());
+        CHECK(Json(3).get<optional<int>>() == 3);
+    }
+
+    SUBCASE("responses are decoded with the runtime types") {
+        auto const response = Query::UserField::response(
+                Json{{"data", {{"user", {{"id", "1"}, {"name", "Ann"}, {"active", true}}}}}});
+        REQUIRE(response.index() == 0);
+        auto const & user = std::get<0>(response);
+        REQUIRE(user);
+        CHECK(user->id == "1");
+        CHECK(user->name == "Ann");
+        CHECK(!user->age);
+
+        auto const failure = Query::UserField::response(Json{{"errors", {{{"message", "Not found"}}}}});
+        REQUIRE(failure.index() == 1);
+        REQUIRE(std::get<1>(failure).size() == 1);
+        CHECK(std::get<1>(failure).front().message == "Not found");
+    }
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,72 @@
+#include "Generated.hpp"
+#include "doctest.h"
+
+using namespace runtime;
+
+TEST_SUITE_BEGIN("Runtime");
+
+TEST_CASE("simdjson backend") {
+    std::string const text = R"({"data": {"user": {
+        "id": "1", "name": "Ann", "score": 2.5, "active": true, "age": null, "friends": [
+            {"id": "2", "active": false, "friends": [], "posts": []}
+        ],
+        "bestFriend": null, "posts": [{"id": "3", "title": "Post", "comments": [{"text": "Hi", "author": null}]}]
+    }}})";
+
+    SUBCASE("parseResponse decodes response text in one pass") {
+        auto const response = Query::UserField::parseResponse(text);
+        auto const & user = std::get<0>(response);
+        REQUIRE(user);
+        CHECK(user->id == "1");
+        CHECK(*user->name == "Ann");
+        CHECK(*user->score == 2.5);
+        CHECK(user->active);
+        CHECK(!user->age);
+        REQUIRE(user->friends);
+        REQUIRE(user->friends->size() == 1);
+        CHECK((*user->friends)[0].id == "2");
+        CHECK(!(*user->friends)[0].active);
+        CHECK(!user->bestFriend);
+        REQUIRE(user->posts);
+        REQUIRE(user->posts->size() == 1);
+        auto const & post = (*user->posts)[0];
+        CHECK(post.title == "Post");
+        REQUIRE(post.comments);
+        CHECK(*(*post.comments)[0].text == "Hi");
+    }
+
+    SUBCASE("unions decode the implementation named by the typename") {
+        auto const response = Query::SearchField::parseResponse(R"({"data": {"search": [
+            {"__typename": "Post", "id": "1", "title": "Post"},
+            {"__typename": "User", "id": "2", "active": true},
+            {"__typename": "Page"}
+        ]}})");
+        auto const & results = std::get<0>(response);
+        REQUIRE(results.size() == 3);
+        CHECK(std::get<Post>(results[0]).title == "Post");
+        CHECK(std::get<User>(results[1]).id == "2");
+        CHECK(std::holds_alternative<UnknownSearchResult>(results[2]));
+    }
+
+    SUBCASE("errors are decoded instead of data") {
+        auto const response = Query::UserField::parseResponse(R"({"errors": [{"message": "Not found"}]})");
+        REQUIRE(std::holds_alternative<std::vector<GraphqlError>>(response));
+        CHECK(std::get<std::vector<GraphqlError>>(response)[0].message == "Not found");
+    }
+
+    SUBCASE("responses missing required fields throw") {
+        CHECK_THROWS_AS(Query::UserField::parseResponse(R"({"data": {"user": {"id": "1"}}})"), std::out_of_range);
+    }
+
+    SUBCASE("invalid responses throw") {
+        CHECK_THROWS_AS(Query::UserField::parseResponse(R"({"data": {"user": )"), simdjson::simdjson_error);
+    }
+
+    SUBCASE("response still decodes parsed json") {
+        auto const response = Query::UserField::response(Json::parse(text));
+        REQUIRE(std::get<0>(response));
+        CHECK(*std::get<0>(response)->name == "Ann");
+    }
+}
+
+TEST_SUITE_END;
@@ -1,8 +1,31 @@
 #include "BoxedOptional.hpp"
 #include "doctest.h"
+#include <thread>
 
 using namespace caffql;
 
+static size_t allocationCount = 0;
+
+// Counts allocations, so that tests can check how many boxes an operation allocates.
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+
+    template <typename U>
+    CountingAllocator(CountingAllocator<U> const &) {}
+
+    T * allocate(size_t count) {
+        ++allocationCount;
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T * pointer, size_t count) { std::allocator<T>().deallocate(pointer, count); }
+};
+
+using CountedOptional = BoxedOptional<int, CountingAllocator<int>>;
+
 TEST_SUITE_BEGIN("Boxed Optional");
 
 TEST_CASE("default construction does not have value") {
@@ -33,6 +56,109 @@ TEST_CASE("move constructing transfers the allocated value") {
     CHECK(&*b == address);
 }
 
+TEST_CASE("allocations") {
+    allocationCount = 0;
+
+    SUBCASE("constructing and copying allocate a box each") {
+        CountedOptional a{1};
+        auto b = a;
+        CountedOptional c;
+        c = a;
+        CHECK(allocationCount == 3);
+    }
+
+    SUBCASE("moving doesn't allocate") {
+        CountedOptional a{1};
+        auto b = std::move(a);
+        CountedOptional c;
+        c = std::move(b);
+        CHECK(allocationCount == 1);
+    }
+
+    SUBCASE("copying to an optional with a value reuses its box") {
+        CountedOptional a{1};
+        CountedOptional b{2};
+        auto const address = &*b;
+        b = a;
+        CHECK(allocationCount == 2);
+        CHECK(&*b == address);
+        CHECK(*b == 1);
+    }
+
+    SUBCASE("growing a vector moves its optionals instead of copying them") {
+        std::vector<CountedOptional> optionals;
+        for (int i = 0; i < 100; ++i) {
+            optionals.emplace_back(i);
+        }
+        CHECK(allocationCount == 100);
+    }
+}
+
+TEST_CASE("move only optionals can't be copied") {
+    using MoveOnlyOptional = BoxedOptional<int, std::allocator<int>, BoxCopying::MoveOnly>;
+    CHECK_FALSE(std::is_copy_constructible_v<MoveOnlyOptional>);
+    CHECK_FALSE(std::is_copy_assignable_v<MoveOnlyOptional>);
+    CHECK(std::is_nothrow_move_constructible_v<MoveOnlyOptional>);
+
+    MoveOnlyOptional a{3};
+    auto b = std::move(a);
+    CHECK(*b == 3);
+}
+
+TEST_CASE("pools reuse freed boxes") {
+    BoxedOptional<int, BoxPool<int>> a{1};
+    auto const address = &*a;
+    auto const freeCount = BoxPool<int>::freeCount();
+
+    a.reset();
+    CHECK(BoxPool<int>::freeCount() == freeCount + 1);
+
+    BoxedOptional<int, BoxPool<int>> b{2};
+    CHECK(&*b == address);
+    CHECK(BoxPool<int>::freeCount() == freeCount);
+}
+
+TEST_CASE("pools free boxes to the heap once their thread's free list is destroyed") {
+    // Constructed before the thread's free list, so destroyed after it
+    struct Holder {
+        BoxedOptional<int, BoxPool<int>> box;
+        size_t * freeCountAtDestruction;
+
+        ~Holder() {
+            box.reset();
+            *freeCountAtDestruction = BoxPool<int>::freeCount();
+        }
+    };
+
+    size_t freeCountAtDestruction = 1;
+    std::thread thread{[&] {
+        thread_local Holder holder{{}, &freeCountAtDestruction};
+        holder.box = 1;
+        BoxedOptional<int, BoxPool<int>>(2).reset();
+    }};
+    thread.join();
+
+    CHECK(freeCountAtDestruction == 0);
+}
+
+TEST_CASE("arenas allocate boxes while they are in scope") {
+    using ArenaOptional = BoxedOptional<int64_t, BoxArenaAllocator<int64_t>>;
+
+    BoxArena arena(64);
+    {
+        BoxArena::Scope scope{arena};
+        std::vector<ArenaOptional> optionals;
+        for (int i = 0; i < 100; ++i) {
+            optionals.emplace_back(i);
+        }
+        CHECK(*optionals[99] == 99);
+        CHECK(reinterpret_cast<uintptr_t>(&*optionals[99]) % alignof(int64_t) == 0);
+    }
+    CHECK(arena.size() == 100 * sizeof(int64_t));
+
+    CHECK_THROWS_AS(ArenaOptional(1), std::logic_error);
+}
+
 TEST_CASE("equality") {
     CHECK(BoxedOptional<int>(5) == BoxedOptional<int>(5));
     CHECK(BoxedOptional<int>() == BoxedOptional<int>());
@@ -28,10 +28,47 @@ TEST_CASE("custom type sorting") {
         CHECK(sorted == std::vector{a, b, c, d, e, f, g});
     }
 
-    SUBCASE("throws on circular type references") {
+    SUBCASE("types in a cycle are grouped and only the fields that refer to incomplete types are boxed") {
+        // Contains B, which refers back to it
         Type a{TypeKind::Object, "A", "", {Field{TypeRef{TypeKind::Object, "B"}, "b"}}};
-        Type b{TypeKind::Object, "B", "", {Field{TypeRef{TypeKind::Object, "A"}, "a"}}};
-        CHECK_THROWS(sortCustomTypesByDependencyOrder({a, b}));
+        // Has fields of type A and [B]
+        Type b{TypeKind::Object,
+               "B",
+               "",
+               {Field{TypeRef{TypeKind::Object, "A"}, "a"},
+                Field{TypeRef{TypeKind::List, {}, TypeRef{TypeKind::Object, "B"}}, "list"}}};
+        Type c{TypeKind::Enum, "C"};
+
+        auto components = sortCustomTypeComponents({c, b, a});
+        REQUIRE(components.size() == 2);
+        REQUIRE(components[0].size() == 2);
+        CHECK(components[1] == std::vector{c});
+
+        // B is declared first so that A can contain it
+        CHECK(components[0][0].name == "B");
+        auto const recursions = findFieldRecursions(components);
+        CHECK(fieldRecursion(recursions, "B", "a") == FieldRecursion::Boxed);
+        // Lists can hold incomplete types
+        CHECK(fieldRecursion(recursions, "B", "list") == FieldRecursion::Recursive);
+        CHECK(fieldRecursion(recursions, "A", "b") == FieldRecursion::Recursive);
+        CHECK(fieldRecursion(recursions, "C", "") == FieldRecursion::None);
+        // The schema model itself isn't marked
+        CHECK(components[0][0] == b);
+    }
+
+    SUBCASE("interfaces in a cycle follow their implementations") {
+        Type i{TypeKind::Interface, "I", "", {Field{TypeRef{TypeKind::Interface, "I"}, "parent"}}};
+        i.possibleTypes = {TypeRef{TypeKind::Object, "X"}};
+        Type x{TypeKind::Object, "X", "", i.fields};
+
+        auto components = sortCustomTypeComponents({i, x});
+        REQUIRE(components.size() == 1);
+        REQUIRE(components[0].size() == 2);
+        CHECK(components[0][0].name == "X");
+        auto const recursions = findFieldRecursions(components);
+        CHECK(fieldRecursion(recursions, "X", "parent") == FieldRecursion::Boxed);
+        // The interface's unknown implementation is declared before it
+        CHECK(fieldRecursion(recursions, "I", "parent") == FieldRecursion::Boxed);
     }
 
     SUBCASE("filters out non custom types") {
@@ -117,6 +154,125 @@ TEST_CASE("enum generation") {
 )";
         CHECK("\n" + generateEnumSerialization(enumType, 2) == expected);
     }
+
+    SUBCASE("serialization functions") {
+        std::string expected = R"(
+        inline void to_json(Json & json, EnumType const & value) {
+            switch (value) {
+            case EnumType::CaseOne:
+                json = "CASE_ONE";
+                break;
+            case EnumType::CaseTwo:
+                json = "CASE_TWO";
+                break;
+            default:
+                json = nullptr;
+                break;
+            }
+        }
+
+        inline void from_json(Json const & json, EnumType & value) {
+            if (json == "CASE_ONE") {
+                value = EnumType::CaseOne;
+            } else if (json == "CASE_TWO") {
+                value = EnumType::CaseTwo;
+            } else {
+                value = EnumType::Unknown;
+            }
+        }
+
+)";
+        CHECK("\n" + defineFunctionsInline(generateEnumSerializationFunctions(enumType, 2)) == expected);
+    }
+}
+
+TEST_CASE("out of line functions") {
+
+    SUBCASE("inline free functions are declared and defined in the same namespace") {
+        GeneratedCode code;
+        code += "    struct A {\n        int a;\n    };\n\n";
+        code += GeneratedFunction{
+                "void", "from_json(Json const & json, A & value)", "        json.at(\"a\").get_to(value.a);\n", 1};
+
+        CHECK(defineFunctionsInline(code) == R"(    struct A {
+        int a;
+    };
+
+    inline void from_json(Json const & json, A & value) {
+        json.at("a").get_to(value.a);
+    }
+
+)");
+
+        std::string declarations;
+        auto definitions = moveFunctionsOutOfLine(code, "", 1, declarations);
+
+        CHECK(declarations == R"(    struct A {
+        int a;
+    };
+
+    void from_json(Json const & json, A & value);
+
+)");
+        CHECK(definitions == R"(    void from_json(Json const & json, A & value) {
+        json.at("a").get_to(value.a);
+    }
+
+)");
+    }
+
+    SUBCASE("static member functions are qualified by their enclosing scopes") {
+        GeneratedCode code;
+        code += "        struct AField {\n\n";
+        code += "            static Operation constexpr operation = Operation::Query;\n\n";
+        code += "            using ResponseData = A;\n\n";
+        code += GeneratedFunction{"GraphqlResponse<ResponseData>",
+                                  "response(Json const & json)",
+                                  "                return ResponseData(json);\n",
+                                  3,
+                                  "AField::"};
+        code += "        };\n\n";
+
+        std::string declarations;
+        auto definitions = moveFunctionsOutOfLine(code, "Query::", 1, declarations);
+
+        CHECK(declarations == R"(        struct AField {
+
+            static Operation constexpr operation = Operation::Query;
+
+            using ResponseData = A;
+
+            static GraphqlResponse<ResponseData> response(Json const & json);
+
+        };
+
+)");
+        CHECK(definitions == R"(    auto Query::AField::response(Json const & json) -> GraphqlResponse<ResponseData> {
+        return ResponseData(json);
+    }
+
+)");
+    }
+
+    SUBCASE("descriptions and query documents that look like functions are left as they are") {
+        GeneratedCode code;
+        code += "    // static int description() {\n    // }\n";
+        code += GeneratedFunction{"Json",
+                                  "request()",
+                                  "        Json query = R\"(\n            query {\n            }\n        )\";\n"
+                                  "        return query;\n",
+                                  1,
+                                  ""};
+
+        std::string declarations;
+        auto definitions = moveFunctionsOutOfLine(code, "AField::", 0, declarations);
+
+        CHECK(declarations == "    // static int description() {\n    // }\n    static Json request();\n\n");
+        CHECK(definitions == "auto AField::request() -> Json {\n"
+                             "    Json query = R\"(\n        query {\n        }\n    )\";\n"
+                             "    return query;\n"
+                             "}\n\n");
+    }
 }
 
 TEST_CASE("interface generation") {
@@ -165,7 +321,7 @@ TEST_CASE("interface generation") {
         }
 
 )";
-        CHECK("\n" + generateInterfaceDeserialization(interfaceType, 2) == expected);
+        CHECK("\n" + defineFunctionsInline(generateInterfaceDeserialization(interfaceType, 2)) == expected);
     }
 }
 
@@ -196,7 +352,7 @@ TEST_CASE("union generation") {
         }
 
 )";
-        CHECK("\n" + generateUnionDeserialization(unionType, 2) == expected);
+        CHECK("\n" + defineFunctionsInline(generateUnionDeserialization(unionType, 2)) == expected);
     }
 }
 
@@ -222,7 +378,7 @@ TEST_CASE("object generation") {
         }
 
 )";
-        CHECK("\n" + generateObjectDeserialization(objectType, 2) == expected);
+        CHECK("\n" + defineFunctionsInline(generateObjectDeserialization(objectType, 2)) == expected);
     }
 }
 
@@ -249,7 +405,7 @@ TEST_CASE("input object generation") {
         }
 
 )";
-        CHECK("\n" + generateInputObjectSerialization(inputObjectType, 2) == expected);
+        CHECK("\n" + defineFunctionsInline(generateInputObjectSerialization(inputObjectType, 2)) == expected);
     }
 }
 
@@ -432,4 +588,1209 @@ TEST_CASE("query field generation") {
     }
 }
 
+TEST_CASE("query selection depth") {
+    CHECK(selectionDepth("") == 0);
+    CHECK(selectionDepth("query { field }") == 0);
+    CHECK(selectionDepth(R"(
+query {
+    object {
+        nested {
+            field
+        }
+        other
+    }
+}
+)") == 2);
+}
+
+TEST_CASE("recursive type generation") {
+    Type node{TypeKind::Object, "Node"};
+    node.fields = {Field{TypeRef{TypeKind::Scalar, "String"}, "name"},
+                   Field{TypeRef{TypeKind::Object, "Node"}, "next"}};
+
+    Type link{TypeKind::Object, "Link"};
+    link.fields = {Field{TypeRef{TypeKind::Object, "Link"}, "next"}};
+
+    Type query{TypeKind::Object, "Query"};
+    query.fields = {Field{node, "node"}, Field{link, "link"}};
+
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+    schema.types = {Type{TypeKind::Scalar, "String"}, node, link, query};
+
+    TypeMap typeMap;
+    for (auto const & type : schema.types) {
+        typeMap[type.name] = type;
+    }
+    auto const recursions = findFieldRecursions(sortCustomTypeComponents(schema.types));
+    std::vector<QueryVariable> variables;
+
+    SUBCASE("recursive fields are boxed and not required") {
+        auto next = node.fields[1];
+        CHECK(generateObject(node, 0, recursions).find("    BoxedOptional<Node> next;\n") != std::string::npos);
+        next.type = TypeRef{TypeKind::NonNull, {}, next.type};
+        CHECK_FALSE(isRequiredField(next, FieldRecursion::Boxed));
+    }
+
+    SUBCASE("non-null recursive fields stay optional, since the recursion depth can leave them out") {
+        Type post{TypeKind::Object, "Post"};
+        Type user{TypeKind::Object, "User"};
+        post.fields = {Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Object, "User"}}, "author"}};
+        user.fields = {Field{TypeRef{TypeKind::NonNull,
+                                     {},
+                                     TypeRef{TypeKind::List,
+                                             {},
+                                             TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Object, "Post"}}}},
+                             "posts"}};
+        auto const components = sortCustomTypeComponents({post, user});
+        auto const cycleRecursions = findFieldRecursions(components);
+        REQUIRE(components.size() == 1);
+        // User's list of posts can hold the incomplete Post, so User is declared first and Post's author isn't boxed
+        CHECK(components[0][0].name == "User");
+
+        auto const author = fieldRecursion(cycleRecursions, "Post", "author");
+        auto const posts = fieldRecursion(cycleRecursions, "User", "posts");
+        CHECK(author == FieldRecursion::Recursive);
+        CHECK(posts == FieldRecursion::Recursive);
+        CHECK(cppFieldTypeName(post.fields[0], author) == "optional<User>");
+        CHECK(cppFieldTypeName(user.fields[0], posts) == "optional<std::vector<Post>>");
+        CHECK_FALSE(isRequiredField(post.fields[0], author));
+        CHECK_FALSE(isRequiredField(user.fields[0], posts));
+
+        // Missing values are reset rather than default constructed
+        auto const deserialization = defineFunctionsInline(generateObjectDeserialization(user, 0, cycleRecursions));
+        CHECK(deserialization.find("json.at(\"posts\")") == std::string::npos);
+        CHECK(deserialization.find("value.posts.reset();") != std::string::npos);
+    }
+
+    SUBCASE("queries select recursive fields to their recursion depth") {
+        auto expected = R"(
+node {
+    name
+    next {
+        name
+    }
+}
+)";
+        CHECK("\n" + generateQueryField(query.fields[0], typeMap, "", variables, 0, 1, recursions) == expected);
+        CHECK(generateQueryField(query.fields[0], typeMap, "", variables, 0, 0, recursions) ==
+              "node {\n    name\n}\n");
+    }
+
+    SUBCASE("operations split across implementation files select recursive fields to their recursion depth") {
+        GenerationOptions options;
+        options.implementationFiles = 2;
+        auto const sources = generateSources(schema, "caffql", "Generated.hpp", options);
+        auto const implementations = sources.implementations[0] + sources.implementations[1];
+        CHECK(implementations.find("query Node {") != std::string::npos);
+        CHECK(implementations.find("next {\n                            name\n                        }\n") !=
+              std::string::npos);
+    }
+
+    SUBCASE("selection sets left without fields select the typename") {
+        CHECK(generateQueryField(query.fields[1], typeMap, "", variables, 0, 0, recursions) ==
+              "link {\n    __typename\n}\n");
+    }
+
+    SUBCASE("types in cycles are declared ahead and their functions are defined once all of them are complete") {
+        Type tree{TypeKind::Union, "Tree", "", {}, {}, {}, {}, {node}};
+        node.fields.push_back(Field{tree, "tree"});
+        schema.types = {Type{TypeKind::Scalar, "String"}, node, link, tree, query};
+
+        auto const header = generateTypes(schema, "caffql", {});
+        CHECK(header.find("template <typename T, typename Allocator = std::allocator<T>, BoxCopying copying = "
+                          "BoxCopying::Deep>\n    class BoxedOptional {") != std::string::npos);
+        CHECK(header.find("    struct Node;\n\n    using UnknownTree = monostate;\n") != std::string::npos);
+        CHECK(header.find("using Tree = ") == header.rfind("using Tree = "));
+
+        auto const declaration = header.find("    inline void from_json(Json const & json, Tree & value);\n");
+        CHECK(declaration != std::string::npos);
+        CHECK(declaration < header.find("    inline void from_json(Json const & json, Node & value) {\n"));
+    }
+
+    SUBCASE("fields selecting operation types are left out") {
+        Type payload{TypeKind::Object, "Payload", "", {Field{query, "query"}}};
+        query.fields.push_back(Field{payload, "payload"});
+        schema.types = {Type{TypeKind::Scalar, "String"}, node, link, payload, query};
+
+        CHECK(generateTypes(schema, "caffql", {}).find("struct Payload {\n    };") != std::string::npos);
+    }
+
+    SUBCASE("interface fields have the recursion of their implementations' fields") {
+        Type interface{TypeKind::Interface, "Authored", "", {Field{TypeRef{TypeKind::Object, "Author"}, "author"}}};
+        Type author{TypeKind::Object, "Author", "", {Field{TypeRef{TypeKind::Object, "Author"}, "author"}}};
+        Type book{TypeKind::Object, "Book", "", {Field{TypeRef{TypeKind::Object, "Author"}, "author"}}};
+        interface.possibleTypes = {author, book};
+
+        auto const interfaceRecursions = findFieldRecursions(sortCustomTypeComponents({interface, author, book}));
+        CHECK(fieldRecursion(interfaceRecursions, "Author", "author") == FieldRecursion::Boxed);
+        CHECK(fieldRecursion(interfaceRecursions, "Authored", "author") == FieldRecursion::Boxed);
+        CHECK(fieldRecursion(interfaceRecursions, "Book", "author") == FieldRecursion::Boxed);
+    }
+
+    SUBCASE("boxes use the allocator and copying chosen by the options") {
+        GenerationOptions options;
+        options.boxAllocator = BoxAllocator::Pool;
+        options.moveOnlyBoxes = true;
+        auto const header = generateTypes(schema, "caffql", options);
+        CHECK(header.find("struct BoxPool {") != std::string::npos);
+        CHECK(header.find("template <typename T, typename Allocator = BoxPool<T>, BoxCopying copying = "
+                          "BoxCopying::MoveOnly>\n    class BoxedOptional {") != std::string::npos);
+
+        options.boxAllocator = BoxAllocator::Arena;
+        CHECK(generateTypes(schema, "caffql", options).find("typename Allocator = BoxArenaAllocator<T>") !=
+              std::string::npos);
+    }
+
+    SUBCASE("box allocators by name") {
+        CHECK(boxAllocatorNamed("pool") == BoxAllocator::Pool);
+        CHECK(boxAllocatorName(BoxAllocator::Arena) == "arena");
+        CHECK_THROWS_AS(boxAllocatorNamed("stack"), std::invalid_argument);
+    }
+
+    SUBCASE("lazily decoded objects can't have move-only boxes") {
+        GenerationOptions options;
+        options.moveOnlyBoxes = true;
+        options.lazyDecoding = true;
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+    }
+
+    SUBCASE("schemas without cycles don't box") {
+        query.fields = {Field{TypeRef{TypeKind::Scalar, "String"}, "name"}};
+        schema.types = {Type{TypeKind::Scalar, "String"}, query};
+        CHECK(generateTypes(schema, "caffql", {}).find("BoxedOptional") == std::string::npos);
+    }
+}
+
+TEST_CASE("operation selection") {
+    auto const string = TypeRef{TypeKind::Scalar, "String"};
+    auto const user = TypeRef{TypeKind::Object, "User"};
+    auto const post = TypeRef{TypeKind::Object, "Post"};
+
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+    schema.mutationType = Schema::OperationType{"Mutation"};
+    schema.types = {
+            Type{TypeKind::Scalar, "String"},
+            Type{TypeKind::Scalar, "DateTime"},
+            Type{TypeKind::Object, "User", "", {Field{string, "name"}, Field{user, "friend"}}},
+            Type{TypeKind::Object,
+                 "Post",
+                 "",
+                 {Field{user, "author"}, Field{TypeRef{TypeKind::List, {}, TypeRef{TypeKind::Enum, "Tag"}}, "tags"}}},
+            Type{TypeKind::Enum, "Tag", "", {}, {}, {}, {EnumValue{"NEWS"}}},
+            Type{TypeKind::InputObject, "PostInput", "", {}, {InputValue{string, "text"}}},
+            Type{TypeKind::Object, "Query", "", {Field{user, "user"}, Field{post, "post"}}},
+            Type{TypeKind::Object,
+                 "Mutation",
+                 "",
+                 {Field{post, "createPost", {}, {InputValue{TypeRef{TypeKind::InputObject, "PostInput"}, "input"}}}}}};
+
+    GenerationOptions options;
+
+    SUBCASE("only the types that selected operations reach are generated") {
+        options.operations = {"Query.user"};
+        auto const header = generateTypes(schema, "caffql", options);
+        CHECK(header.find("struct User {") != std::string::npos);
+        CHECK(header.find("struct UserField {") != std::string::npos);
+        CHECK(header.find("PostField") == std::string::npos);
+        CHECK(header.find("struct Post {") == std::string::npos);
+        CHECK(header.find("enum class Tag") == std::string::npos);
+        CHECK(header.find("PostInput") == std::string::npos);
+        CHECK(header.find("DateTime") == std::string::npos);
+        CHECK(header.find("namespace Mutation") == std::string::npos);
+    }
+
+    SUBCASE("types reached through arguments are generated") {
+        options.operations = {"Mutation.createPost"};
+        auto const header = generateTypes(schema, "caffql", options);
+        CHECK(header.find("struct PostInput {") != std::string::npos);
+        CHECK(header.find("struct Post {") != std::string::npos);
+        CHECK(header.find("struct User {") != std::string::npos);
+        CHECK(header.find("enum class Tag") != std::string::npos);
+        CHECK(header.find("namespace Query") == std::string::npos);
+    }
+
+    SUBCASE("operations are named like Type.field") {
+        options.operations = {"Query.missing"};
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+        options.operations = {"User.name"};
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+    }
+}
+
+TEST_CASE("deprecated fields") {
+    SUBCASE("deprecation is read from introspection query responses") {
+        Field const deprecated = Json{{"name", "a"},
+                                      {"args", Json::array()},
+                                      {"type", {{"kind", "SCALAR"}, {"name", "Int"}}},
+                                      {"isDeprecated", true},
+                                      {"deprecationReason", "Use b"}};
+        CHECK((deprecated.isDeprecated && deprecated.deprecationReason == "Use b"));
+
+        EnumValue const value = Json{{"name", "A"}};
+        CHECK((!value.isDeprecated && !value.deprecationReason));
+    }
+
+    auto const string = TypeRef{TypeKind::Scalar, "String"};
+    auto const user = TypeRef{TypeKind::Object, "User"};
+
+    Field oldName{string, "oldName"};
+    oldName.isDeprecated = true;
+    Field deprecatedCode{string, "code"};
+    deprecatedCode.isDeprecated = true;
+    Field old{user, "old"};
+    old.isDeprecated = true;
+
+    Type node{TypeKind::Interface, "Node", "", {Field{string, "code"}}};
+    node.possibleTypes = {user};
+
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+    schema.types = {Type{TypeKind::Scalar, "String"},
+                    Type{TypeKind::Object, "User", "", {Field{string, "name"}, oldName, deprecatedCode}},
+                    node,
+                    Type{TypeKind::Object, "Query", "", {Field{user, "user"}, old}}};
+
+    GenerationOptions options;
+
+    SUBCASE("deprecated fields are generated by default") {
+        auto const header = generateTypes(schema, "caffql", options);
+        CHECK(header.find("oldName") != std::string::npos);
+        CHECK(header.find("struct OldField {") != std::string::npos);
+    }
+
+    SUBCASE("deprecated fields can be left out of types and queries") {
+        options.excludeDeprecated = true;
+        auto const header = generateTypes(schema, "caffql", options);
+        CHECK(header.find("oldName") == std::string::npos);
+        CHECK(header.find("struct OldField {") == std::string::npos);
+        // Node's accessor reads it from User
+        CHECK(header.find("optional<std::string> code;") != std::string::npos);
+    }
+
+    SUBCASE("kept deprecated fields and selected operations are generated") {
+        options.excludeDeprecated = true;
+        options.keptDeprecatedFields = {"User.oldName"};
+        options.operations = {"Query.old"};
+        auto const header = generateTypes(schema, "caffql", options);
+        CHECK(header.find("optional<std::string> oldName;") != std::string::npos);
+        CHECK(header.find("struct OldField {") != std::string::npos);
+    }
+
+    SUBCASE("kept fields must exist") {
+        options.excludeDeprecated = true;
+        options.keptDeprecatedFields = {"User.missing"};
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+    }
+}
+
+TEST_CASE("entity cache generation") {
+    TypeRef nonNullId{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "ID"}};
+
+    Type user{TypeKind::Object, "User"};
+    user.fields = {Field{nonNullId, "id"}, Field{TypeRef{TypeKind::Scalar, "String"}, "name"}};
+
+    Type comment{TypeKind::Object, "Comment"};
+    comment.fields = {Field{TypeRef{TypeKind::Scalar, "String"}, "text"}, Field{user, "author"}};
+
+    Type tag{TypeKind::Object, "Tag"};
+    tag.fields = {Field{TypeRef{TypeKind::Scalar, "ID"}, "id"}};
+
+    SUBCASE("entities are objects with a non null id") {
+        CHECK(isEntityType(user));
+        CHECK_FALSE(isEntityType(comment));
+        CHECK_FALSE(isEntityType(tag));
+    }
+
+    SUBCASE("entities are merged into records and other values containing them refer to them") {
+        auto generated = generateEntityCache({user, comment, tag}, {}, 0);
+
+        auto expectedUser = R"(
+    void normalize(User const & value, Normalized<User> & normalized, size_t depth) {
+        normalized.id = value.id;
+        // Merged into the fields written before
+        auto & record = userEntities[value.id];
+        record.id = normalizedValue(value.id, depth);
+        record.name = normalizedValue(value.name, depth);
+    }
+)";
+        auto expectedComment = R"(
+    void normalize(Comment const & value, Normalized<Comment> & normalized, size_t depth) {
+        EntityRecord<Comment> record;
+        record.text = normalizedValue(value.text, depth);
+        record.author = normalizedValue(value.author, depth);
+        normalized = std::make_shared<EntityRecord<Comment> const>(std::move(record));
+    }
+)";
+        CHECK(generated.find(expectedUser) != std::string::npos);
+        CHECK(generated.find(expectedComment) != std::string::npos);
+        CHECK(generated.find("struct NormalizedType<User> {\n    using type = EntityReference<User>;\n};") !=
+              std::string::npos);
+        CHECK(generated.find("NormalizedType<Tag>") == std::string::npos);
+        CHECK(generated.find("EntityMap<User> userEntities;\n") != std::string::npos);
+        CHECK(generated.find("tagEntities") == std::string::npos);
+    }
+
+    SUBCASE("recursive fields are only written and read within the recursion depth") {
+        user.fields.push_back(Field{user, "bestFriend"});
+        auto const recursions = findFieldRecursions(sortCustomTypeComponents({user}));
+        auto generated = generateEntityCache({user}, {}, 0, recursions);
+
+        CHECK(generated.find("        if (depth > 0) {\n"
+                             "            record.bestFriend = normalizedValue(value.bestFriend, depth - 1);\n"
+                             "        }\n") != std::string::npos);
+        CHECK(generated.find("        if (record.bestFriend && depth > 0) {\n"
+                             "            denormalize(*record.bestFriend, value.bestFriend, depth - 1);\n"
+                             "        }\n") != std::string::npos);
+    }
+
+    SUBCASE("lazily decoded entities can't be cached") {
+        Schema schema;
+        schema.types = {Type{TypeKind::Scalar, "ID"}, Type{TypeKind::Scalar, "String"}, user};
+        GenerationOptions options;
+        options.entityCache = true;
+        options.lazyDecoding = true;
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+    }
+}
+
+TEST_CASE("incremental generation") {
+    Type object{TypeKind::Object, "Object"};
+    object.fields = {Field{TypeRef{TypeKind::Scalar, "Int"}, "count"}};
+
+    Type other{TypeKind::Object, "Other"};
+    other.fields = {Field{TypeRef{TypeKind::Scalar, "String"}, "text"}};
+
+    Type query{TypeKind::Object, "Query"};
+    query.fields = {Field{TypeRef{TypeKind::Object, "Object"}, "object"}};
+
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+    schema.types = {Type{TypeKind::Scalar, "Int"}, Type{TypeKind::Scalar, "String"}, object, other, query};
+
+    GenerationCache cache;
+    auto const generated = generateSources(schema, "caffql", "", {}, nullptr, &cache).header;
+
+    CHECK(cache.renderedTypeCount == 3);
+    CHECK(cache.reusedTypeCount == 0);
+
+    SUBCASE("unchanged types are reused") {
+        CHECK(generateSources(schema, "caffql", "", {}, nullptr, &cache).header == generated);
+        CHECK(cache.renderedTypeCount == 0);
+        CHECK(cache.reusedTypeCount == 3);
+    }
+
+    SUBCASE("changed types are rendered") {
+        schema.types[3].description = "Changed";
+        CHECK(generateSources(schema, "caffql", "", {}, nullptr, &cache).header == generateTypes(schema, "caffql", {}));
+        CHECK(cache.renderedTypeCount == 1);
+    }
+
+    SUBCASE("operation types are rendered when types they select change") {
+        schema.types[2].fields.push_back(Field{TypeRef{TypeKind::Scalar, "String"}, "name"});
+        CHECK(generateSources(schema, "caffql", "", {}, nullptr, &cache).header == generateTypes(schema, "caffql", {}));
+        CHECK(cache.renderedTypeCount == 2);
+    }
+
+    SUBCASE("changed options render everything") {
+        GenerationOptions options;
+        options.lazyDecoding = true;
+        generateSources(schema, "caffql", "", options, nullptr, &cache);
+        CHECK(cache.renderedTypeCount == 3);
+    }
+}
+
+TEST_CASE("incremental schema parsing") {
+    auto type = [](char const * kind, char const * name) {
+        return Json{{"kind", kind},
+                    {"name", name},
+                    {"description", nullptr},
+                    {"fields", nullptr},
+                    {"inputFields", nullptr},
+                    {"interfaces", nullptr},
+                    {"enumValues", nullptr},
+                    {"possibleTypes", nullptr}};
+    };
+
+    Json json = {{"data",
+                  {{"__schema",
+                    {{"queryType", {{"name", "Query"}}},
+                     {"mutationType", nullptr},
+                     {"subscriptionType", nullptr},
+                     {"types", {type("SCALAR", "Int"), type("ENUM", "Kind"), type("OBJECT", "Query")}}}}}}};
+    json["data"]["__schema"]["types"][1]["enumValues"] = {
+            {{"name", "FIRST"}, {"description", "\"Quoted\" {braces}"}, {"isDeprecated", false}}};
+
+    SchemaParseCache cache;
+    auto const schema = parseSchema(json.dump(), &cache);
+    Schema const expected = json.at("data").at("__schema");
+
+    CHECK(schema.queryType->name == "Query");
+    CHECK(schema.types == expected.types);
+    CHECK(cache.types.size() == 3);
+
+    SUBCASE("changed types are parsed") {
+        json["data"]["__schema"]["types"][2]["description"] = "Changed";
+        Schema const changed = json.at("data").at("__schema");
+        CHECK(parseSchema(json.dump(2), &cache).types == changed.types);
+    }
+
+    SUBCASE("invalid json throws") {
+        CHECK_THROWS_AS(parseSchema(R"({"data": {"__schema": {"types": [)", &cache), Json::parse_error);
+    }
+}
+
+TEST_CASE("lazy object generation") {
+    Type objectType{TypeKind::Object, "ObjectType"};
+    objectType.fields = {Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Object, "FieldType"}}, "field"},
+                         Field{TypeRef{TypeKind::Scalar, "Int"}, "count"}};
+
+    SUBCASE("type") {
+        std::string expected = R"(
+        struct ObjectType {
+            ObjectType() = default;
+            explicit ObjectType(LazyNode node) : lazyNode{std::move(node)} {}
+
+            FieldType const & field() const { return decodeLazyField(lazyNode, "field", true, decoded.field); }
+            optional<int32_t> const & count() const { return decodeLazyField(lazyNode, "count", false, decoded.count); }
+
+        private:
+            LazyNode lazyNode;
+            mutable struct {
+                optional<FieldType> field;
+                optional<optional<int32_t>> count;
+            } decoded;
+        };
+
+)";
+
+        CHECK("\n" + generateLazyObject(objectType, 2) == expected);
+    }
+
+    SUBCASE("deserialization") {
+        std::string expected = R"(
+        inline void decodeLazy(LazyNode const & node, ObjectType & value) {
+            value = ObjectType(node);
+        }
+
+        inline void from_json(Json const & json, ObjectType & value) {
+            value = decodeLazyDocument<ObjectType>(json);
+        }
+
+)";
+        CHECK("\n" + defineFunctionsInline(generateLazyObjectDeserialization(objectType, 2)) == expected);
+    }
+
+    SUBCASE("union deserialization") {
+        Type unionType{TypeKind::Union, "UnionType"};
+        unionType.possibleTypes = {TypeRef{TypeKind::Object, "A"}};
+
+        std::string expected = R"(
+        inline void decodeLazy(LazyNode const & node, UnionType & value) {
+            std::string occupiedType = node.json->at("__typename");
+            if (occupiedType == "A") {
+                value = {A(node)};
+            } else {
+                value = {UnknownUnionType()};
+            }
+        }
+
+        inline void from_json(Json const & json, UnionType & value) {
+            value = decodeLazyDocument<UnionType>(json);
+        }
+
+)";
+        CHECK("\n" + defineFunctionsInline(generateLazyUnionDeserialization(unionType, 2)) == expected);
+    }
+}
+
+TEST_CASE("compact object generation") {
+    Type objectType{TypeKind::Object, "ObjectType"};
+    objectType.fields = {Field{TypeRef{TypeKind::Scalar, "Boolean"}, "isActive"},
+                         Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "String"}}, "name"},
+                         Field{TypeRef{TypeKind::Scalar, "Int"}, "age"}};
+
+    SUBCASE("type") {
+        std::string expected = R"(
+        struct ObjectType {
+            std::string name;
+            int32_t age_ = {};
+            bool isActive_ = {};
+            PresenceBits<2> presence;
+
+            optional<bool> isActive() const { return presence.test(0) ? optional<bool>(isActive_) : optional<bool>(); }
+            void setIsActive(optional<bool> value) {
+                presence.set(0, value.has_value());
+                isActive_ = value.value_or(bool());
+            }
+            optional<int32_t> age() const { return presence.test(1) ? optional<int32_t>(age_) : optional<int32_t>(); }
+            void setAge(optional<int32_t> value) {
+                presence.set(1, value.has_value());
+                age_ = value.value_or(int32_t());
+            }
+        };
+
+)";
+
+        CHECK("\n" + generateCompactObject(objectType, 2) == expected);
+    }
+
+    SUBCASE("presence tracked fields are stored among the other members by alignment") {
+        objectType.fields.push_back(Field{TypeRef{TypeKind::Scalar, "Float"}, "score"});
+        objectType.fields.push_back(Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "Int"}}, "rank"});
+        auto const generated = generateCompactObject(objectType, 0);
+        CHECK(generated.find("    std::string name;\n"
+                             "    double score_ = {};\n"
+                             "    int32_t age_ = {};\n"
+                             "    int32_t rank;\n"
+                             "    bool isActive_ = {};\n"
+                             "    PresenceBits<3> presence;\n") != std::string::npos);
+    }
+
+    SUBCASE("storage names don't collide with fields") {
+        objectType.fields.push_back(Field{TypeRef{TypeKind::Scalar, "String"}, "age_"});
+        objectType.fields.push_back(Field{TypeRef{TypeKind::Scalar, "String"}, "presence"});
+        auto const generated = generateCompactObject(objectType, 0);
+        CHECK(generated.find("    optional<std::string> age_;\n") != std::string::npos);
+        CHECK(generated.find("    int32_t age_1 = {};\n") != std::string::npos);
+        CHECK(generated.find("    PresenceBits<2> presence1;\n") != std::string::npos);
+        CHECK(generated.find("return presence1.test(1) ? optional<int32_t>(age_1) : optional<int32_t>(); }") !=
+              std::string::npos);
+    }
+
+    SUBCASE("deserialization") {
+        std::string expected = R"(
+        inline void from_json(Json const & json, ObjectType & value) {
+            {
+                auto it = json.find("isActive");
+                value.setIsActive(it != json.end() ? it->get<optional<bool>>() : optional<bool>());
+            }
+            json.at("name").get_to(value.name);
+            {
+                auto it = json.find("age");
+                value.setAge(it != json.end() ? it->get<optional<int32_t>>() : optional<int32_t>());
+            }
+        }
+
+)";
+        CHECK("\n" + defineFunctionsInline(generateCompactObjectDeserialization(objectType, 2)) == expected);
+    }
+
+    SUBCASE("layout report") {
+        GenerationOptions options;
+        options.compactLayout = true;
+
+        std::string expected = R"(
+        struct TypeLayout {
+            char const * name;
+            size_t size;
+            // Bytes of size that no member uses
+            size_t padding;
+        };
+
+        inline std::vector<TypeLayout> layoutReport() {
+            return {
+                {"ObjectType", sizeof(ObjectType), sizeof(ObjectType) - (sizeof(ObjectType::isActive_) + sizeof(ObjectType::name) + sizeof(ObjectType::age_) + sizeof(ObjectType::presence))},
+            };
+        }
+
+)";
+        CHECK("\n" + generateLayoutReport({objectType}, options, 2) == expected);
+    }
+}
+
+TEST_CASE("interned id generation") {
+    Type query{TypeKind::Object, "Query"};
+    query.fields = {Field{TypeRef{TypeKind::Scalar, "ID"}, "id"}};
+
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+    schema.types = {Type{TypeKind::Scalar, "ID"}, query};
+
+    GenerationOptions options;
+    options.internedIds = true;
+    auto const generated = generateTypes(schema, "caffql", options);
+
+    SUBCASE("id is a class instead of a string") {
+        CHECK(generated.find("using Id = std::string;") == std::string::npos);
+        CHECK(generated.find("class Id {") != std::string::npos);
+        CHECK(generateTypes(schema, "caffql", {}).find("using Id = std::string;") != std::string::npos);
+    }
+
+    SUBCASE("interned strings are reference counted") {
+        CHECK(generated.find("#include <atomic>") != std::string::npos);
+        CHECK(generated.find("std::atomic<size_t> references{1};") != std::string::npos);
+        CHECK(generated.find("static size_t internedCount()") != std::string::npos);
+    }
+
+    SUBCASE("hash specialization") {
+        std::string expected = R"(namespace std {
+
+    template <>
+    struct hash<caffql::Id> {
+        size_t operator()(caffql::Id const & id) const { return id.hash(); }
+    };
+
+} // namespace std
+)";
+        CHECK(generated.find(expected) != std::string::npos);
+    }
+}
+
+TEST_CASE("custom scalar generation") {
+    Type scalar{TypeKind::Scalar, "DateTime"};
+
+    SUBCASE("custom scalars are named after the scalar") {
+        CHECK(cppTypeName(TypeRef{TypeKind::Scalar, "DateTime"}) == "optional<DateTime>");
+    }
+
+    SUBCASE("unmapped scalars are json") {
+        CHECK(generateCustomScalar(scalar, std::nullopt, 1) == "    using DateTime = Json;\n\n");
+        CHECK(defineFunctionsInline(generateCustomScalarSerialization(scalar, std::nullopt, 1)).empty());
+    }
+
+    SUBCASE("mappings without a codec are aliases") {
+        ScalarMapping mapping = Json{{"type", "int64_t"}};
+        CHECK(generateCustomScalar(scalar, mapping, 1) == "    using DateTime = int64_t;\n\n");
+        CHECK(defineFunctionsInline(generateCustomScalarSerialization(scalar, mapping, 1)).empty());
+    }
+
+    SUBCASE("mappings with a codec are wrappers") {
+        ScalarMapping mapping =
+                Json{{"type", "int64_t"}, {"decode", "parseDateTime"}, {"encode", "formatDateTime"}};
+
+        std::string expectedType = R"(
+        struct DateTime {
+            int64_t value{};
+
+            DateTime() = default;
+            DateTime(int64_t value) : value{std::move(value)} {}
+            operator int64_t const &() const { return value; }
+        };
+
+)";
+        CHECK("\n" + generateCustomScalar(scalar, mapping, 2) == expectedType);
+
+        std::string expectedSerialization = R"(
+        inline void from_json(Json const & json, DateTime & value) {
+            value.value = parseDateTime(json);
+        }
+
+        inline void to_json(Json & json, DateTime const & value) {
+            json = formatDateTime(value.value);
+        }
+
+)";
+        CHECK("\n" + defineFunctionsInline(generateCustomScalarSerialization(scalar, mapping, 2)) ==
+              expectedSerialization);
+    }
+
+    SUBCASE("non null fields are decoded with get") {
+        Field field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "DateTime"}}, "at"};
+        CHECK(generateFieldDeserialization(field, 1) == "    value.at = json.at(\"at\").get<DateTime>();\n");
+    }
+
+    SUBCASE("codecs need both functions") {
+        CHECK_THROWS_AS(Json({{"type", "int64_t"}, {"decode", "parseDateTime"}}).get<ScalarMapping>(),
+                        std::invalid_argument);
+    }
+}
+
+TEST_CASE("runtime header generation") {
+    Type query{TypeKind::Object, "Query"};
+    query.fields = {Field{TypeRef{TypeKind::Scalar, "ID"}, "id"}};
+
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+    schema.types = {Type{TypeKind::Scalar, "ID"}, query};
+
+    GenerationOptions options;
+    options.runtimeHeader = "caffql/Runtime.hpp";
+    auto const generated = generateTypes(schema, "caffql", options);
+    auto const runtime = generateRuntimeHeader(AlgebraicNamespace::Std);
+
+    SUBCASE("the prelude is only in the runtime header") {
+        for (auto const prelude : {"struct adl_serializer", "struct GraphqlError", "enum class Operation"}) {
+            CHECK(generated.find(prelude) == std::string::npos);
+            CHECK(runtime.find(prelude) != std::string::npos);
+        }
+    }
+
+    SUBCASE("generated headers include the runtime header and use its declarations") {
+        CHECK(generated.find("#include \"caffql/Runtime.hpp\"") != std::string::npos);
+        CHECK(generated.find("CAFFQL_RUNTIME_ABSL != 0") != std::string::npos);
+        CHECK(generated.find("    using ::caffql::runtime::GraphqlResponse;\n") != std::string::npos);
+        CHECK(generated.find("    using ::caffql::runtime::Id;\n") != std::string::npos);
+    }
+
+    SUBCASE("optional serialization is defined once") {
+        CHECK(runtime.find("#ifndef CAFFQL_STD_OPTIONAL_SERIALIZATION") != std::string::npos);
+        CHECK(generateTypes(schema, "caffql", {}).find("#ifndef CAFFQL_STD_OPTIONAL_SERIALIZATION") !=
+              std::string::npos);
+    }
+}
+
+TEST_CASE("json backend generation") {
+    Type object{TypeKind::Object, "A"};
+    object.fields = {Field{TypeRef{TypeKind::NonNull, std::nullopt, TypeRef{TypeKind::Scalar, "ID"}}, "id"},
+                     Field{TypeRef{TypeKind::Scalar, "Int"}, "count"}};
+
+    SUBCASE("objects are decoded in one pass over their fields") {
+        std::string expected = R"(    inline void decodeOnDemandFields(simdjson::ondemand::object json, A & value) {
+        size_t requiredFieldCount = 0;
+        for (simdjson::ondemand::field field : json) {
+            auto const key = field.escaped_key();
+            if (key == "id") {
+                decodeOnDemand(field.value(), value.id);
+                ++requiredFieldCount;
+            } else if (key == "count") {
+                decodeOnDemand(field.value(), value.count);
+            }
+        }
+        if (requiredFieldCount < 1) {
+            throw std::out_of_range("A is missing a required field");
+        }
+    }
+
+    inline void decodeOnDemand(simdjson::ondemand::value json, A & value) {
+        decodeOnDemandFields(json.get_object(), value);
+    }
+
+)";
+        CHECK(defineFunctionsInline(generateOnDemandObjectDecoding(object, false, 1)) == expected);
+    }
+
+    SUBCASE("presence tracked fields of compact objects are set") {
+        auto const generated = defineFunctionsInline(generateOnDemandObjectDecoding(object, true, 1));
+        CHECK(generated.find("decodeOnDemand(field.value(), decoded);\n                value.setCount(decoded);") !=
+              std::string::npos);
+    }
+
+    SUBCASE("variants rewind after reading the typename") {
+        Type union_{TypeKind::Union, "U"};
+        union_.possibleTypes = {TypeRef{TypeKind::Object, "A"}};
+        std::string expected = R"(    inline void decodeOnDemand(simdjson::ondemand::value json, U & value) {
+        simdjson::ondemand::object object = json.get_object();
+        std::string_view const occupiedType = object.find_field_unordered("__typename").get_string();
+        object.reset();
+        if (occupiedType == "A") {
+            A implementation{};
+            decodeOnDemandFields(object, implementation);
+            value = {std::move(implementation)};
+        } else {
+            value = {UnknownU()};
+        }
+    }
+
+)";
+        CHECK(defineFunctionsInline(generateOnDemandUnionDecoding(union_, 1)) == expected);
+    }
+
+    SUBCASE("parseResponse decodes with the backend") {
+        Field field{TypeRef{TypeKind::Object, "A"}, "a"};
+        CHECK(defineFunctionsInline(generateOperationParseResponseFunction(field, 0)) ==
+              "static GraphqlResponse<ResponseData> parseResponse(std::string_view text) {\n"
+              "    return parseOnDemandResponse<ResponseData>(text, \"a\", false);\n"
+              "}\n\n");
+    }
+
+    SUBCASE("only backends decoding text generate parseResponse") {
+        Type query{TypeKind::Object, "Query", "", {Field{TypeRef{TypeKind::Object, "A"}, "a"}}};
+        Schema schema;
+        schema.queryType = Schema::OperationType{"Query"};
+        schema.types = {Type{TypeKind::Scalar, "ID"}, Type{TypeKind::Scalar, "Int"}, object, query};
+
+        auto const header = generateTypes(schema, "caffql", {});
+        CHECK(header.find("parseResponse") == std::string::npos);
+        CHECK(header.find("#include <string_view>") == std::string::npos);
+
+        GenerationOptions options;
+        options.jsonBackend = JsonBackend::Simdjson;
+        auto const onDemandHeader = generateTypes(schema, "caffql", options);
+        CHECK(onDemandHeader.find("#include <string_view>\n#include \"simdjson.h\"") != std::string::npos);
+        CHECK(onDemandHeader.find("inline void decodeOnDemandFields(simdjson::ondemand::object json, A & value) {") !=
+              std::string::npos);
+        CHECK(onDemandHeader.find("return parseOnDemandResponse<ResponseData>(text, \"a\", false);") !=
+              std::string::npos);
+    }
+
+    SUBCASE("backends by name") {
+        CHECK(jsonBackendNamed("simdjson") == JsonBackend::Simdjson);
+        CHECK(jsonBackendName(JsonBackend::Nlohmann) == "nlohmann");
+        CHECK_THROWS_AS(jsonBackendNamed("fast"), std::invalid_argument);
+    }
+
+    SUBCASE("lazy decoding needs json documents") {
+        Schema schema;
+        schema.types = {object};
+        GenerationOptions options;
+        options.jsonBackend = JsonBackend::Simdjson;
+        options.lazyDecoding = true;
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+    }
+}
+
+TEST_CASE("checked decoding generation") {
+    Type object{TypeKind::Object, "A"};
+    object.fields = {Field{TypeRef{TypeKind::NonNull, std::nullopt, TypeRef{TypeKind::Scalar, "ID"}}, "id"},
+                     Field{TypeRef{TypeKind::Scalar, "Int"}, "count"}};
+
+    SUBCASE("objects return false at the first field that fails") {
+        std::string expected =
+                R"(    inline bool tryDecodeFields(Json const & json, A & value, DecodePath const & path, DecodeError & error) {
+        if (!tryDecodeField(json, "id", true, value.id, path, error)) {
+            return false;
+        }
+        if (!tryDecodeField(json, "count", false, value.count, path, error)) {
+            return false;
+        }
+        return true;
+    }
+
+    inline bool tryDecode(Json const & json, A & value, DecodePath const & path, DecodeError & error) {
+        if (!json.is_object()) {
+            return decodeFailure(path, DecodeErrorCode::TypeMismatch, error);
+        }
+        return tryDecodeFields(json, value, path, error);
+    }
+
+)";
+        CHECK(defineFunctionsInline(generateCheckedObjectDecoding(object, false, 1)) == expected);
+    }
+
+    SUBCASE("presence tracked fields of compact objects are set") {
+        auto const generated = defineFunctionsInline(generateCheckedObjectDecoding(object, true, 1));
+        CHECK(generated.find("optional<int32_t> decoded;\n"
+                             "            if (!tryDecodeField(json, \"count\", false, decoded, path, error)) {\n"
+                             "                return false;\n"
+                             "            }\n"
+                             "            value.setCount(decoded);") != std::string::npos);
+    }
+
+    SUBCASE("operations decode their field of the response's data") {
+        Field field{TypeRef{TypeKind::NonNull, std::nullopt, TypeRef{TypeKind::Object, "A"}}, "a"};
+        std::string expected = R"(static DecodeResult<GraphqlResponse<ResponseData>> tryResponse(Json const & json) {
+    return tryDecodeResponse<ResponseData>(json, "a", true);
+}
+
+static DecodeResult<GraphqlResponse<ResponseData>> tryParseResponse(std::string_view text) {
+    auto const json = Json::parse(text, nullptr, false);
+    if (json.is_discarded()) {
+        return DecodeError{DecodeErrorCode::InvalidJson, ""};
+    }
+    return tryResponse(json);
+}
+
+)";
+        CHECK(defineFunctionsInline(generateOperationTryResponseFunctions(field, 0)) == expected);
+    }
+
+    SUBCASE("lazy decoding can't report errors up front") {
+        Schema schema;
+        schema.types = {object};
+        GenerationOptions options;
+        options.checkedDecoding = true;
+        options.lazyDecoding = true;
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+    }
+}
+
+TEST_CASE("table decoding generation") {
+    Type object{TypeKind::Object, "A"};
+    Field deferred{TypeRef{TypeKind::NonNull, std::nullopt, TypeRef{TypeKind::Object, "B"}}, "b"};
+    deferred.delivery = IncrementalDelivery::Deferred;
+    object.fields = {Field{TypeRef{TypeKind::NonNull, std::nullopt, TypeRef{TypeKind::Scalar, "ID"}}, "id"},
+                     Field{TypeRef{TypeKind::Scalar, "Int"}, "count"},
+                     Field{TypeRef{TypeKind::List, std::nullopt, TypeRef{TypeKind::Enum, "E"}}, "values"},
+                     deferred};
+
+    SUBCASE("objects decode from a table of their fields") {
+        std::string expected = R"(    inline void from_json(Json const & json, A & value) {
+        static constexpr FieldDescriptor fields[] = {
+            {"id", offsetof(A, id), FieldKind::Id, false, true, nullptr},
+            {"count", offsetof(A, count), FieldKind::Int, true, false, nullptr},
+            {"values", offsetof(A, values), FieldKind::Value, true, false, decodeFieldValue<optional<std::vector<optional<E>>>>},
+            {"b", offsetof(A, b), FieldKind::Value, false, false, decodeFieldValue<B>},
+        };
+        decodeFields(json, &value, fields, 4);
+    }
+
+)";
+        CHECK(defineFunctionsInline(generateTableDeserialization("A", object, 1)) == expected);
+    }
+
+    SUBCASE("objects without fields have no table") {
+        CHECK(defineFunctionsInline(generateTableDeserialization("A", Type{TypeKind::Object, "A"}, 0)) ==
+              "inline void from_json(Json const & json, A & value) {\n}\n\n");
+    }
+
+    SUBCASE("interfaces decode their unknown implementation from a table") {
+        Type interface{TypeKind::Interface, "I", "", {object.fields[0]}};
+        interface.possibleTypes = {TypeRef{TypeKind::Object, "A"}};
+        Schema schema;
+        schema.types = {Type{TypeKind::Scalar, "ID"}, interface};
+        GenerationOptions options;
+        options.tableDecoding = true;
+
+        auto const header = generateTypes(schema, "caffql", options);
+        CHECK(header.find("inline void decodeFields(") != std::string::npos);
+        CHECK(header.find("{\"id\", offsetof(UnknownI, id), FieldKind::Id, false, true, nullptr},") !=
+              std::string::npos);
+    }
+
+    SUBCASE("lazy and compact objects can't be decoded from tables") {
+        Schema schema;
+        schema.types = {Type{TypeKind::Scalar, "ID"}, Type{TypeKind::Scalar, "Int"}, object};
+        GenerationOptions options;
+        options.tableDecoding = true;
+        options.lazyDecoding = true;
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+        options.lazyDecoding = false;
+        options.compactLayout = true;
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+    }
+}
+
+TEST_CASE("incremental delivery generation") {
+    auto const string = TypeRef{TypeKind::NonNull, std::nullopt, TypeRef{TypeKind::Scalar, "String"}};
+
+    Type node{TypeKind::Interface, "Node", {}, {Field{string, "body"}}};
+    node.possibleTypes = {TypeRef{TypeKind::Object, "Post"}};
+
+    Type post{TypeKind::Object, "Post", {}, {Field{string, "title"}, Field{string, "body"}}};
+    post.interfaces = {TypeRef{TypeKind::Interface, "Node"}};
+
+    Type query{TypeKind::Object, "Query"};
+    query.fields = {Field{TypeRef{TypeKind::List, std::nullopt, TypeRef{TypeKind::Object, "Post"}}, "posts"},
+                    Field{TypeRef{TypeKind::Interface, "Node"}, "node"}};
+
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+    schema.types = {node, post, query};
+
+    GenerationOptions options;
+    options.deferredFields = {"Node.body"};
+    options.streamedFields = {"Query.posts"};
+
+    SUBCASE("deferred fields are selected in fragments and streamed lists with no initial items") {
+        auto const generated = generateTypes(schema, "caffql", options);
+        CHECK(generated.find(R"(
+                        posts @stream(initialCount: 0) {
+                            title
+                            ... @defer {
+                                body
+                            }
+                        }
+)") != std::string::npos);
+        // Post's body is deferred with Node's, and so only selected once
+        CHECK(generated.find(R"(
+                        node {
+                            __typename
+                            ... @defer {
+                                body
+                            }
+                            ...on Post {
+                                title
+                            }
+                        }
+)") != std::string::npos);
+    }
+
+    SUBCASE("deferred non null fields aren't required") {
+        Field field{string, "body"};
+        field.delivery = IncrementalDelivery::Deferred;
+        CHECK(!isRequiredField(field));
+        CHECK(generateFieldDeserialization(field, 0) == R"({
+    auto it = json.find("body");
+    if (it != json.end()) {
+        it->get_to(value.body);
+    }
+}
+)");
+    }
+
+    SUBCASE("objects merge deferred fields and follow paths through fields that can contain them") {
+        Type user{TypeKind::Object, "User"};
+        Field bio{string, "bio"};
+        bio.delivery = IncrementalDelivery::Deferred;
+        user.fields = {Field{string, "name"}, bio, Field{TypeRef{TypeKind::Object, "Post"}, "pinned"}};
+
+        std::string expected = R"(inline void applyIncremental(Json const & entry, Json const & path, size_t depth, User & value) {
+    if (depth == path.size()) {
+        auto const & data = entry.at("data");
+        {
+            auto it = data.find("bio");
+            if (it != data.end()) {
+                value.bio = it->get<std::string>();
+            }
+        }
+        return;
+    }
+    auto const & key = path.at(depth).get_ref<std::string const &>();
+    if (key == "pinned") {
+        applyIncremental(entry, path, depth + 1, value.pinned);
+    } else {
+        throw incrementalPathError(path);
+    }
+}
+
+)";
+        CHECK(defineFunctionsInline(generateIncrementalObjectDecoding(user, false, 0)) == expected);
+    }
+
+    SUBCASE("objects without deferred or nested fields reject every path") {
+        Type tag{TypeKind::Object, "Tag", "", {Field{string, "name"}}};
+        CHECK(defineFunctionsInline(generateIncrementalObjectDecoding(tag, false, 0)) ==
+              "inline void applyIncremental(Json const &, Json const & path, size_t, Tag &) {\n"
+              "    throw incrementalPathError(path);\n"
+              "}\n\n");
+    }
+
+    SUBCASE("operations apply payloads to their data") {
+        auto const generated = generateTypes(schema, "caffql", options);
+        CHECK(generated.find("static IncrementalPayload applyPayload(Json const & payload, ResponseData & data) {\n"
+                             "                return applyIncrementalPayload(payload, \"posts\", data);\n") !=
+              std::string::npos);
+    }
+
+    SUBCASE("invalid fields") {
+        options.deferredFields = {"Post.missing"};
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+
+        options.deferredFields = {"Query.posts"};
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+
+        options.deferredFields = {};
+        options.streamedFields = {"Post.title"};
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+    }
+
+    SUBCASE("lazy decoding can't apply payloads") {
+        options.lazyDecoding = true;
+        CHECK_THROWS_AS(generateTypes(schema, "caffql", options), std::invalid_argument);
+    }
+}
+
+TEST_CASE("async operation generation") {
+    std::vector<QueryVariable> variables{
+            {"id", TypeRef{TypeKind::NonNull, std::nullopt, TypeRef{TypeKind::Scalar, "ID"}}},
+            {"first", TypeRef{TypeKind::Scalar, "Int"}}};
+
+    auto const code = generateOperationExecuteFunction(variables, 0);
+    auto const generated = defineFunctionsInline(code);
+
+    SUBCASE("execute takes the request's arguments by value") {
+        CHECK(generated == "template <GraphqlTransport Transport> static GraphqlTask<GraphqlResponse<ResponseData>> "
+                           "execute(Transport & transport, Id id, optional<int32_t> first) {\n"
+                           "    co_return response(co_await transport.send(request(id, first)));\n"
+                           "}\n\n");
+    }
+
+    SUBCASE("execute stays in the header with implementation files") {
+        std::string declarations;
+        CHECK(moveFunctionsOutOfLine(code, "", 0, declarations).empty());
+        CHECK(declarations == generated);
+    }
+
+    SUBCASE("headers check that coroutines are available") {
+        Schema schema;
+        GenerationOptions options;
+        options.asyncOperations = true;
+        auto const header = generateTypes(schema, "caffql", options);
+        CHECK(header.find("#if !defined(__cpp_impl_coroutine)\n#error") != std::string::npos);
+        CHECK(header.find("#include <coroutine>") != std::string::npos);
+        CHECK(header.find("class LocalGraphqlTransport {") != std::string::npos);
+    }
+}
+
+TEST_CASE("coalesced request generation") {
+    std::vector<QueryVariable> variables{
+            {"id", TypeRef{TypeKind::NonNull, std::nullopt, TypeRef{TypeKind::Scalar, "ID"}}},
+            {"first", TypeRef{TypeKind::Scalar, "Int"}}};
+    Field field{TypeRef{TypeKind::Object, "User"}, "user"};
+
+    auto const generated = defineFunctionsInline(generateOperationFetchFunction(field, Operation::Query, variables, 0));
+
+    SUBCASE("fetch takes the request's arguments and names the operation") {
+        CHECK(generated == "static std::shared_ptr<GraphqlResponse<ResponseData> const> "
+                           "fetch(GraphqlRequestCoalescer & coalescer, Id const & id, optional<int32_t> first) {\n"
+                           "    return coalescer.fetch<ResponseData>(makeCacheKey(\"query User\", id, first), "
+                           "request(id, first), &response);\n"
+                           "}\n\n");
+    }
+
+    SUBCASE("headers include the coalescer") {
+        Schema schema;
+        GenerationOptions options;
+        options.coalescedRequests = true;
+        auto const header = generateTypes(schema, "caffql", options);
+        CHECK(header.find("#include <future>") != std::string::npos);
+        CHECK(header.find("class GraphqlRequestCoalescer {") != std::string::npos);
+        CHECK(header.find("struct GraphqlCacheKey {") != std::string::npos);
+    }
+
+    SUBCASE("only queries are coalesced") {
+        auto const user = TypeRef{TypeKind::Object, "User"};
+        Schema schema;
+        schema.queryType = Schema::OperationType{"Query"};
+        schema.mutationType = Schema::OperationType{"Mutation"};
+        schema.subscriptionType = Schema::OperationType{"Subscription"};
+        schema.types = {Type{TypeKind::Object, "User", "", {Field{TypeRef{TypeKind::Scalar, "String"}, "name"}}},
+                        Type{TypeKind::Object, "Query", "", {Field{user, "user"}}},
+                        Type{TypeKind::Object, "Mutation", "", {Field{user, "renameUser"}}},
+                        Type{TypeKind::Object, "Subscription", "", {Field{user, "userRenamed"}}},
+                        Type{TypeKind::Scalar, "String"}};
+        GenerationOptions options;
+        options.coalescedRequests = true;
+        auto const header = generateTypes(schema, "caffql", options);
+
+        auto const operationType = [&](std::string const & name) {
+            auto const begin = header.find("struct " + name + " {");
+            REQUIRE(begin != std::string::npos);
+            return header.substr(begin, header.find("\n        };", begin) - begin);
+        };
+        CHECK(operationType("UserField").find(" fetch(") != std::string::npos);
+        CHECK(operationType("RenameUserField").find(" fetch(") == std::string::npos);
+        CHECK(operationType("UserRenamedField").find(" fetch(") == std::string::npos);
+    }
+}
+
+TEST_CASE("result cache generation") {
+    std::vector<QueryVariable> variables{
+            {"id", TypeRef{TypeKind::NonNull, std::nullopt, TypeRef{TypeKind::Scalar, "ID"}}},
+            {"first", TypeRef{TypeKind::Scalar, "Int"}}};
+    Field field{TypeRef{TypeKind::Object, "User"}, "user"};
+
+    SUBCASE("cache keys are made of the operation's name and arguments") {
+        CHECK(defineFunctionsInline(generateOperationCacheKeyFunction(field, Operation::Query, variables, 0)) ==
+              "static GraphqlCacheKey cacheKey(Id const & id, optional<int32_t> first) {\n"
+              "    return makeCacheKey(\"query User\", id, first);\n"
+              "}\n\n");
+    }
+
+    SUBCASE("input objects encode their fields one after another") {
+        Type filter{TypeKind::InputObject,
+                    "Filter",
+                    {},
+                    {},
+                    {InputValue{TypeRef{TypeKind::Scalar, "String"}, "text"},
+                     InputValue{TypeRef{TypeKind::Scalar, "Int"}, "limit"}}};
+        CHECK(defineFunctionsInline(generateInputObjectCacheKeyEncoding(filter, 0)) ==
+              "inline void encodeCacheArgument(std::string & bytes, Filter const & value) {\n"
+              "    encodeCacheArgument(bytes, value.text);\n"
+              "    encodeCacheArgument(bytes, value.limit);\n"
+              "}\n\n");
+    }
+
+    SUBCASE("headers include the cache") {
+        Schema schema;
+        GenerationOptions options;
+        options.resultCache = true;
+        auto const header = generateTypes(schema, "caffql", options);
+        CHECK(header.find("#include <list>") != std::string::npos);
+        CHECK(header.find("class GraphqlResultCache {") != std::string::npos);
+    }
+}
+
 TEST_SUITE_END;
@@ -0,0 +1,223 @@
+#include "SdlParser.hpp"
+#include "doctest.h"
+
+using namespace caffql;
+
+TEST_SUITE_BEGIN("SDL Parser");
+
+static TypeRef named(TypeKind kind, char const * name) {
+    return TypeRef{kind, std::string(name)};
+}
+
+static TypeRef nonNull(TypeRef type) {
+    return TypeRef{TypeKind::NonNull, std::nullopt, std::move(type)};
+}
+
+static TypeRef list(TypeRef type) {
+    return TypeRef{TypeKind::List, std::nullopt, std::move(type)};
+}
+
+static Schema parse(std::string const & text) {
+    return parseSdlSchema({{"schema.graphql", text}});
+}
+
+TEST_CASE("type definitions") {
+    auto const schema = parse(R"(
+"""
+A person
+  with an indented line
+"""
+type User implements Node & Named {
+  id: ID!
+  "The name"
+  name(format: NameFormat = FULL, limit: Int = 10): String @deprecated(reason: "Use names")
+  friends: [User!]!
+}
+
+interface Node { id: ID! }
+interface Named { name: String }
+union SearchResult = | User | Post
+type Post implements Node { id: ID!, tags: [String] }
+enum NameFormat { "Everything" FULL SHORT }
+input Filter { text: String = "a", ids: [ID!] = [], nested: Filter }
+scalar DateTime @specifiedBy(url: "https://example.com")
+directive @auth(role: String) repeatable on FIELD_DEFINITION | OBJECT
+
+# Operations
+type Query {
+  search(filter: Filter): [SearchResult]
+  node(id: ID!): Node
+}
+)");
+
+    auto const id = named(TypeKind::Scalar, "ID");
+    auto const string = named(TypeKind::Scalar, "String");
+    auto const user = named(TypeKind::Object, "User");
+    auto const post = named(TypeKind::Object, "Post");
+
+    std::vector<Type> const expected{
+            {TypeKind::Object,
+             "User",
+             "A person\n  with an indented line",
+             {Field{nonNull(id), "id"},
+              Field{string,
+                    "name",
+                    "The name",
+                    {InputValue{named(TypeKind::Enum, "NameFormat"), "format"},
+                     InputValue{named(TypeKind::Scalar, "Int"), "limit"}},
+                    true,
+                    "Use names"},
+              Field{nonNull(list(nonNull(user))), "friends"}},
+             {},
+             {named(TypeKind::Interface, "Node"), named(TypeKind::Interface, "Named")}},
+            {TypeKind::Interface, "Node", {}, {Field{nonNull(id), "id"}}, {}, {}, {}, {user, post}},
+            {TypeKind::Interface, "Named", {}, {Field{string, "name"}}, {}, {}, {}, {user}},
+            {TypeKind::Union, "SearchResult", {}, {}, {}, {}, {}, {user, post}},
+            {TypeKind::Object,
+             "Post",
+             {},
+             {Field{nonNull(id), "id"}, Field{list(string), "tags"}},
+             {},
+             {named(TypeKind::Interface, "Node")}},
+            {TypeKind::Enum, "NameFormat", {}, {}, {}, {}, {EnumValue{"FULL", "Everything"}, EnumValue{"SHORT"}}},
+            {TypeKind::InputObject,
+             "Filter",
+             {},
+             {},
+             {InputValue{string, "text"},
+              InputValue{list(nonNull(id)), "ids"},
+              InputValue{named(TypeKind::InputObject, "Filter"), "nested"}}},
+            {TypeKind::Scalar, "DateTime"},
+            {TypeKind::Object,
+             "Query",
+             {},
+             {Field{list(named(TypeKind::Union, "SearchResult")),
+                    "search",
+                    {},
+                    {InputValue{named(TypeKind::InputObject, "Filter"), "filter"}}},
+              Field{named(TypeKind::Interface, "Node"), "node", {}, {InputValue{nonNull(id), "id"}}}}},
+            {TypeKind::Scalar, "Int"},
+            {TypeKind::Scalar, "Float"},
+            {TypeKind::Scalar, "String"},
+            {TypeKind::Scalar, "Boolean"},
+            {TypeKind::Scalar, "ID"}};
+
+    REQUIRE(schema.types.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        INFO(expected[i].name);
+        CHECK(schema.types[i] == expected[i]);
+    }
+
+    SUBCASE("operation types have default names without a schema definition") {
+        REQUIRE(schema.queryType);
+        CHECK(schema.queryType->name == "Query");
+        CHECK_FALSE(schema.mutationType);
+        CHECK_FALSE(schema.subscriptionType);
+    }
+}
+
+TEST_CASE("strings") {
+    SUBCASE("escape sequences") {
+        auto const schema = parse(R"("café 😀 \"quoted\"\n" scalar A)");
+        CHECK(schema.types.front().description == "caf\xC3\xA9 \xF0\x9F\x98\x80 \"quoted\"\n");
+    }
+
+    SUBCASE("block strings") {
+        auto const schema = parse("\"\"\"\n    First\n      Second\n\n    Third \\\"\"\"\n  \"\"\"\nscalar A");
+        CHECK(schema.types.front().description == "First\n  Second\n\nThird \"\"\"");
+    }
+}
+
+TEST_CASE("deprecation") {
+    auto const schema = parse(R"(
+type Query { a: Int @deprecated, b: Int @deprecated(reason: "Use a") @auth, c: Int @auth }
+enum E { X @deprecated Y }
+)");
+
+    auto const & fields = schema.types[0].fields;
+    CHECK((fields[0].isDeprecated && fields[0].deprecationReason == "No longer supported"));
+    CHECK((fields[1].isDeprecated && fields[1].deprecationReason == "Use a"));
+    CHECK((!fields[2].isDeprecated && !fields[2].deprecationReason));
+
+    auto const & values = schema.types[1].enumValues;
+    CHECK((values[0].isDeprecated && values[0].deprecationReason == "No longer supported"));
+    CHECK_FALSE(values[1].isDeprecated);
+}
+
+TEST_CASE("extensions across sources") {
+    auto const schema = parseSdlSchema(
+            {{"a.graphql",
+              "schema { query: Query }\n"
+              "type Query { a: Int }\n"
+              "enum E { X }\n"
+              "union U = A\n"
+              "type A { id: ID }\n"
+              "interface I { id: ID }\n"
+              "type Mutation { m: Int }\n"},
+             {"b.graphql",
+              "extend type Query { b: E }\n"
+              "extend enum E { Y }\n"
+              "extend union U = B\n"
+              "type B { id: ID }\n"
+              "extend type A implements I\n"
+              "extend schema { mutation: Mutation }\n"}});
+
+    auto type = [&](std::string const & name) {
+        return *std::find_if(schema.types.begin(), schema.types.end(), [&](Type const & type) {
+            return type.name == name;
+        });
+    };
+
+    CHECK(type("Query").fields.size() == 2);
+    CHECK(type("Query").fields[1].type == named(TypeKind::Enum, "E"));
+    CHECK(type("E").enumValues.size() == 2);
+    CHECK(type("U").possibleTypes == std::vector<TypeRef>{named(TypeKind::Object, "A"), named(TypeKind::Object, "B")});
+    CHECK(type("I").possibleTypes == std::vector<TypeRef>{named(TypeKind::Object, "A")});
+
+    REQUIRE(schema.mutationType);
+    CHECK(schema.mutationType->name == "Mutation");
+    CHECK_FALSE(schema.subscriptionType);
+}
+
+TEST_CASE("errors name their location") {
+    auto error = [](std::string const & text) {
+        try {
+            parse(text);
+        } catch (std::invalid_argument const & e) {
+            return std::string(e.what());
+        }
+        return std::string();
+    };
+
+    CHECK(error("type Query {\n  a: Missing\n}") == "schema.graphql:2:6: Unknown type Missing");
+    CHECK(error("type A { a: Int }\ntype A { b: Int }") == "schema.graphql:2:1: Type A is already defined");
+    CHECK(error("extend type B { a: Int }") == "schema.graphql:1:8: Cannot extend undefined type B");
+    CHECK(error("type A { a: Int }\nextend type A { a: Int }") == "schema.graphql:2:8: A already has field a");
+    CHECK(error("type A { a: Int }\nextend enum A { X }") == "schema.graphql:2:8: Cannot extend A as an enum");
+    CHECK(error("scalar S\nunion U = S") == "schema.graphql:2:11: Union member S is not an object type");
+    CHECK(error("query { a }") == "schema.graphql:1:1: Executable definitions are not supported in a schema");
+    CHECK(error("type A { a Int }") == "schema.graphql:1:12: Expected ':', found 'Int'");
+    CHECK(error("type A {") == "schema.graphql:1:9: Expected a name, found end of file");
+    CHECK(error("\"abc\ntype A") == "schema.graphql:1:1: Unterminated string");
+}
+
+TEST_CASE("schema sources") {
+    CHECK(isSdlSchema("type Query { a: Int }"));
+    CHECK(isSdlSchema("# Comment\n{"));
+    CHECK_FALSE(isSdlSchema("\n  {\"data\": {}}"));
+
+    SUBCASE("introspection query responses are parsed as json") {
+        auto const schema = parseSchemaSources({{"schema.json", R"({"data": {"__schema": {
+            "queryType": {"name": "Query"},
+            "types": [{"kind": "SCALAR", "name": "Int"}]
+        }}})"}});
+        CHECK(schema.queryType->name == "Query");
+        CHECK(schema.types.size() == 1);
+    }
+
+    SUBCASE("only schema definition language can be split across files") {
+        CHECK_THROWS_AS(parseSchemaSources({{"a.graphql", "scalar A"}, {"b.json", "{}"}}), std::invalid_argument);
+    }
+}
+
+TEST_SUITE_END;
@@ -1,3 +1,5 @@
 // Copyright (C) 2019 Caffeine Inc
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+// doctest 2.3.1 sizes its signal stack with SIGSTKSZ, which is no longer a constant expression in newer glibc
+#define DOCTEST_CONFIG_NO_POSIX_SIGNALS
 #include "doctest.h"